@@ -1,5 +1,42 @@
-mov rdi,  0x10f00 ; or'ed flags
-mov rsi, 0 ; address of new stack pointer
+; one scheduler thread runs every Thread-mode check
+; timers are kept at the bottom of the scheduler stack: [elapsed], then for each check
+; [remaining, interval, base interval, max interval] (dwords, seconds)
+
+xor rdi, rdi ; any address
+mov rsi, 0x10000 ; scheduler stack size
+mov rdx, 3 ; PROT_READ | PROT_WRITE
+mov r10, 0x22 ; MAP_PRIVATE | MAP_ANONYMOUS
+mov r8, -1
+xor r9, r9
+mov rax, 9 ; syscall mmap
+syscall ; syscall
+
+cmp rax, -4096
+ja _parent ; no memory for scheduler
+
+mov rbx, rax ; timers
+
+call __dtimers_end
+(rsj?^_^dtimers^_^?rsj)
+__dtimers_end:
+pop rsi ; base and max intervals of checks
+lea rdi, [rbx + 16]
+mov ecx, (?^_^dcount^_^?)
+
+__dinit:
+	mov eax, [rsi]
+	mov [rdi], eax ; remaining
+	mov [rdi + 4], eax ; interval
+	mov [rdi + 8], eax ; base interval
+	mov eax, [rsi + 4]
+	mov [rdi + 12], eax ; max interval
+	add rsi, 8
+	add rdi, 16
+	dec ecx
+	jnz __dinit
+
+mov rdi, 0x10f00 ; or'ed flags
+lea rsi, [rbx + 0x10000] ; address of new stack pointer
 xor rdx, rdx
 xor r10, r10
 xor r8, r8
@@ -9,74 +46,37 @@ syscall ; syscall
 or rax, 0
 jnz _parent
 
-new_thread:
-
-	mov rdi,  0x10f00 ; or'ed flags
-	mov rsi, 0 ; address of new stack pointer
-	xor rdx, rdx
-	xor r10, r10
-	xor r8, r8
-	mov rax, 56 ; syscall clone
-	syscall ; syscall
-
-	or rax, 0
-	jnz __ntroutine
-
-		; debugger detection
-
-		(rsj?^_^ddetectionmethod^_^?rsj)
-
-		cmp (?^_^ddret^_^?), 0
-		jge __nondbg
-
-		call _dbg
-		db 'debugged!!!!!', 0xa, 0
-_dbg:
-		mov rdi, 1
-		pop rsi
-		mov rdx, 14
-		mov rax, 1 ; syscall write
-		syscall
-
-		(rsj?^_^ddetectionhandler^_^?rsj)
-
-__nondbg:
-		call _nondbg
-		db 'non-debugged!', 0xa, 0
-_nondbg:
-		mov rdi, 1
-		pop rsi
-		mov rdx, 14
-		mov rax, 1 ; syscall write
-		syscall
-
-		mov rdi, 178
-		mov rax, 60 ; syscall exit
-		syscall 
-
-__ntroutine:
-
-	mov r15, rax ; save thread id
-
-	push (?^_^sleep1^_^?) ; value should be a parameter
-	push (?^_^sleep2^_^?) ; value should be a parameter
+__dscheduler:
+
+	; find nearest timer
+	lea rsi, [rbx + 16]
+	mov ecx, (?^_^dcount^_^?)
+	mov eax, -1
+__dmin:
+	mov edx, [rsi]
+	cmp edx, eax
+	cmovb eax, edx
+	add rsi, 16
+	dec ecx
+	jnz __dmin
+
+	mov [rbx], eax ; elapsed
+
+	push 0 ; tv_nsec
+	push rax ; tv_sec
+__dsleep:
 	mov rdi, rsp
-	xor rsi, rsi
-	mov rax, 35 ; syscall nanosleep 
+	mov rsi, rsp ; remaining time is written back when interrupted
+	mov rax, 35 ; syscall nanosleep
 	syscall ; syscall
+	cmp rax, -4 ; EINTR
+	je __dsleep
 	pop rax
 	pop rax
 
-	mov rax, 39 ; getpid
-	syscall
-
-	; kill debugger detection thread
-	mov rdi, r15
-	mov rsi, 1 ; SIGHUP
-	mov rdx, rax ; pid 
-	mov rax, 234
-	syscall
+	; run expired checks
+	(rsj?^_^ddetectionmethod^_^?rsj)
 
-	jmp new_thread
+	jmp __dscheduler
 
 _parent:
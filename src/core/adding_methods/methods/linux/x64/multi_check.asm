@@ -0,0 +1,50 @@
+	mov eax, [rbx]
+	sub [rbx + (?^_^dtimer^_^?)], eax
+	jnz __dnext_(?^_^did^_^?)
+
+	; check runs in a new thread on scheduler stack, scheduler waits for it
+	mov rdi, 0x14f00 ; or'ed flags
+	xor rsi, rsi ; address of new stack pointer
+	xor rdx, rdx
+	xor r10, r10
+	xor r8, r8
+	mov rax, 56 ; syscall clone
+	syscall ; syscall
+
+	or rax, 0
+	jnz __dback_(?^_^did^_^?)
+
+		; debugger detection
+
+		(rsj?^_^ddetectionmethod^_^?rsj)
+
+		cmp (?^_^ddret^_^?), 0
+		jge __dclean_(?^_^did^_^?)
+
+		mov dword [rbx + (?^_^dtimer^_^?) + 4], 0 ; detected, reset backoff
+
+		(rsj?^_^ddetectionhandler^_^?rsj)
+
+__dclean_(?^_^did^_^?):
+		xor rdi, rdi
+		mov rax, 60 ; syscall exit
+		syscall
+
+__dback_(?^_^did^_^?):
+	mov eax, [rbx + (?^_^dtimer^_^?) + 4]
+	test eax, eax
+	jnz __dbackoff_(?^_^did^_^?)
+	mov eax, [rbx + (?^_^dtimer^_^?) + 8] ; base interval
+	jmp __dset_(?^_^did^_^?)
+
+__dbackoff_(?^_^did^_^?):
+	shl eax, 1 ; nothing detected, double interval
+	cmp eax, [rbx + (?^_^dtimer^_^?) + 12]
+	jbe __dset_(?^_^did^_^?)
+	mov eax, [rbx + (?^_^dtimer^_^?) + 12] ; max interval
+
+__dset_(?^_^did^_^?):
+	mov [rbx + (?^_^dtimer^_^?) + 4], eax
+	mov [rbx + (?^_^dtimer^_^?)], eax
+
+__dnext_(?^_^did^_^?):
@@ -0,0 +1,31 @@
+; check runs every (?^_^dcalls^_^?) calls or every (?^_^dcycles^_^?) cycles, whichever comes first (0 - no limit of this kind)
+; state is kept in a zeroed, writable data block: dd calls left, dd 0, dq time stamp counter of last check
+
+db 0x48, 0x8d, 0x0d ; lea rcx, [rel state]
+dd (?^_^dyn_magic!data^_^?) ; offset to the state, patched after the file is changed
+
+mov eax, (?^_^dcalls^_^?)
+test eax, eax
+jz __drate_cycles
+dec dword [rcx]
+jle __drate_run
+
+__drate_cycles:
+mov rdx, (?^_^dcycles^_^?)
+test rdx, rdx
+jz old_stack
+rdtsc
+shl rdx, 32
+or rax, rdx
+sub rax, [rcx + 8]
+mov rdx, (?^_^dcycles^_^?)
+cmp rax, rdx
+jb old_stack
+
+__drate_run:
+rdtsc
+shl rdx, 32
+or rax, rdx
+mov [rcx + 8], rax
+mov dword [rcx], (?^_^dcalls^_^?)
+
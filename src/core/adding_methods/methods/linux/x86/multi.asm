@@ -1,5 +1,42 @@
+; one scheduler thread runs every Thread-mode check
+; timers are kept at the bottom of the scheduler stack: [elapsed], then for each check
+; [remaining, interval, base interval, max interval] (dwords, seconds)
+
+xor ebx, ebx ; any address
+mov ecx, 0x10000 ; scheduler stack size
+mov edx, 3 ; PROT_READ | PROT_WRITE
+mov esi, 0x22 ; MAP_PRIVATE | MAP_ANONYMOUS
+mov edi, -1
+xor ebp, ebp
+mov eax, 192 ; syscall mmap2
+int 0x80 ; syscall
+
+cmp eax, -4096
+ja _parent ; no memory for scheduler
+
+mov ebp, eax ; timers
+
+call __dtimers_end
+(rsj?^_^dtimers^_^?rsj)
+__dtimers_end:
+pop esi ; base and max intervals of checks
+lea edi, [ebp + 16]
+mov ecx, (?^_^dcount^_^?)
+
+__dinit:
+	mov eax, [esi]
+	mov [edi], eax ; remaining
+	mov [edi + 4], eax ; interval
+	mov [edi + 8], eax ; base interval
+	mov eax, [esi + 4]
+	mov [edi + 12], eax ; max interval
+	add esi, 8
+	add edi, 16
+	dec ecx
+	jnz __dinit
+
 mov ebx, 0x10f00 ; or'ed flags
-xor ecx, ecx
+lea ecx, [ebp + 0x10000] ; address of new stack pointer
 xor edx, edx ; parent tid
 xor esi, esi ; child tid
 xor edi, edi ; regs
@@ -9,74 +46,37 @@ int 0x80 ; syscall
 or eax, 0
 jnz _parent
 
-new_thread:
-
-	mov ebx, 0x10f00 ; or'ed flags
-	xor ecx, ecx
-	xor edx, edx ; parent tid
-	xor esi, esi ; child tid
-	xor edi, edi ; regs
-	mov eax, 120 ; syscall clone
-	int 0x80 ; syscall
-
-	or eax, 0
-	jnz __ntroutine
-
-		; debugger detection
-
-		(rsj?^_^ddetectionmethod^_^?rsj)
-
-		cmp (?^_^ddret^_^?), 0
-		jge __nondbg
-
-		call _dbg
-		db 'debugged!!!!!', 0xa, 0
-_dbg:
-		mov ebx, 1
-		pop ecx
-		mov edx, 14
-		mov eax, 4 ; syscall write
-		int 0x80
-
-		(rsj?^_^ddetectionhandler^_^?rsj)
-
-__nondbg:
-		call _nondbg
-		db 'non-debugged!', 0xa, 0
-_nondbg:
-		mov ebx, 1
-		pop ecx
-		mov edx, 14
-		mov eax, 4 ; syscall write
-		int 0x80
-
-		mov ebx, 178
-		mov eax, 1 ; syscall exit
-		int 0x80
-
-__ntroutine:
-
-	push eax ; save thread id	
-
-	push (?^_^sleep1^_^?) ; value should be a parameter
-	push (?^_^sleep2^_^?) ; value should be a parameter
+__dscheduler:
+
+	; find nearest timer
+	lea esi, [ebp + 16]
+	mov ecx, (?^_^dcount^_^?)
+	mov eax, -1
+__dmin:
+	mov edx, [esi]
+	cmp edx, eax
+	cmovb eax, edx
+	add esi, 16
+	dec ecx
+	jnz __dmin
+
+	mov [ebp], eax ; elapsed
+
+	push 0 ; tv_nsec
+	push eax ; tv_sec
+__dsleep:
 	mov ebx, esp
-	xor ecx, ecx
-	mov eax, 162 ; syscall nanosleep 
+	mov ecx, esp ; remaining time is written back when interrupted
+	mov eax, 162 ; syscall nanosleep
 	int 0x80 ; syscall
+	cmp eax, -4 ; EINTR
+	je __dsleep
 	pop eax
 	pop eax
 
-	mov eax, 20 ; getpid
-	int 0x80
-
-	; kill debugger detection thread
-	pop ebx ; thread id
-	mov ecx, 1 ; SIGHUP
-	mov edx, eax; pid
-	mov eax, 270; tgkill
-	int 0x80 
+	; run expired checks
+	(rsj?^_^ddetectionmethod^_^?rsj)
 
-jmp new_thread
+	jmp __dscheduler
 
 _parent:
@@ -0,0 +1,50 @@
+	mov eax, [ebp]
+	sub [ebp + (?^_^dtimer^_^?)], eax
+	jnz __dnext_(?^_^did^_^?)
+
+	; check runs in a new thread on scheduler stack, scheduler waits for it
+	mov ebx, 0x14f00 ; or'ed flags
+	xor ecx, ecx
+	xor edx, edx ; parent tid
+	xor esi, esi ; child tid
+	xor edi, edi ; regs
+	mov eax, 120 ; syscall clone
+	int 0x80 ; syscall
+
+	or eax, 0
+	jnz __dback_(?^_^did^_^?)
+
+		; debugger detection
+
+		(rsj?^_^ddetectionmethod^_^?rsj)
+
+		cmp (?^_^ddret^_^?), 0
+		jge __dclean_(?^_^did^_^?)
+
+		mov dword [ebp + (?^_^dtimer^_^?) + 4], 0 ; detected, reset backoff
+
+		(rsj?^_^ddetectionhandler^_^?rsj)
+
+__dclean_(?^_^did^_^?):
+		xor ebx, ebx
+		mov eax, 1 ; syscall exit
+		int 0x80
+
+__dback_(?^_^did^_^?):
+	mov eax, [ebp + (?^_^dtimer^_^?) + 4]
+	test eax, eax
+	jnz __dbackoff_(?^_^did^_^?)
+	mov eax, [ebp + (?^_^dtimer^_^?) + 8] ; base interval
+	jmp __dset_(?^_^did^_^?)
+
+__dbackoff_(?^_^did^_^?):
+	shl eax, 1 ; nothing detected, double interval
+	cmp eax, [ebp + (?^_^dtimer^_^?) + 12]
+	jbe __dset_(?^_^did^_^?)
+	mov eax, [ebp + (?^_^dtimer^_^?) + 12] ; max interval
+
+__dset_(?^_^did^_^?):
+	mov [ebp + (?^_^dtimer^_^?) + 4], eax
+	mov [ebp + (?^_^dtimer^_^?)], eax
+
+__dnext_(?^_^did^_^?):
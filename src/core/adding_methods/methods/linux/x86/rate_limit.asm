@@ -0,0 +1,32 @@
+; check runs every (?^_^dcalls^_^?) calls or every (?^_^dcycles^_^?) cycles, whichever comes first (0 - no limit of this kind)
+; state is kept in a zeroed, writable data block: dd calls left, dd 0, dd 0, dd 0 - time stamp counter of last check
+
+call $+5
+pop ecx
+add ecx, (?^_^dyn_magic!data^_^?) ; offset to the state, patched after the file is changed
+
+mov eax, (?^_^dcalls^_^?)
+test eax, eax
+jz __drate_cycles
+dec dword [ecx]
+jle __drate_run
+
+__drate_cycles:
+mov eax, (?^_^dcycles_lo^_^?)
+or eax, (?^_^dcycles_hi^_^?)
+jz old_stack
+rdtsc
+sub eax, [ecx + 8]
+sbb edx, [ecx + 12]
+cmp edx, (?^_^dcycles_hi^_^?)
+ja __drate_run
+jb old_stack
+cmp eax, (?^_^dcycles_lo^_^?)
+jb old_stack
+
+__drate_run:
+rdtsc
+mov [ecx + 8], eax
+mov [ecx + 12], edx
+mov dword [ecx], (?^_^dcalls^_^?)
+
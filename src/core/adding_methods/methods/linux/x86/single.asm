@@ -1,3 +1,5 @@
+(rsj?^_^dratelimit^_^?rsj)
+
 (rsj?^_^ddetectionmethod^_^?rsj)
 
 cmp (?^_^ddret^_^?), 0
@@ -0,0 +1,314 @@
+#include <core/adding_methods/wrappers/callsiteprofile.h>
+
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <algorithm>
+#include <cmath>
+
+#include <helper/logger/dlogger.h>
+
+const double CallSiteProfile::hotFraction = 0.001;
+const uint8_t CallSiteProfile::callSize = 5;
+const QByteArray CallSiteProfile::dumpMagic("DPRF", 4);
+const uint32_t CallSiteProfile::dumpVersion = 1;
+const uint32_t CallSiteProfile::dumpHeaderSize = 16;
+
+CallSiteProfile::CallSiteProfile() :
+    totalHits(0),
+    period(1),
+    cycles(0)
+{
+}
+
+bool CallSiteProfile::load(const QString &path)
+{
+    QFile f(path);
+    if(!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        LOG_ERROR(QString("Cannot open profile file: %1").arg(path));
+        return false;
+    }
+
+    samples.clear();
+    totalHits = 0;
+    period = 1;
+    cycles = 0;
+
+    // Zrzut liczników z pliku zabezpieczonego w trybie profilującym
+    if(f.peek(dumpMagic.size()) == dumpMagic)
+    {
+        QList<uint64_t> sites, counters;
+        if(!parseDump(f.readAll(), sites, counters))
+        {
+            LOG_ERROR(QString("Invalid profile dump: %1").arg(path));
+            return false;
+        }
+
+        for(int i = 0; i < sites.length(); ++i)
+        {
+            samples[sites[i]] += counters[i];
+            totalHits += counters[i];
+        }
+
+        LOG_MSG(QString("Profile dump: %1 sites, %2 hits").arg(sites.length()).arg(totalHits));
+
+        return true;
+    }
+
+    uint64_t base = 0;
+    int lineNo = 0;
+    QTextStream in(&f);
+
+    while(!in.atEnd())
+    {
+        QStringList fields = in.readLine().simplified().split(' ', QString::SkipEmptyParts);
+        ++lineNo;
+
+        if(fields.isEmpty())
+            continue;
+
+        bool ok = true;
+
+        if(fields[0].startsWith('#'))
+        {
+            if(fields.length() < 3 || fields[0] != "#")
+                continue;
+
+            if(fields[1] == "base")
+                base = fields[2].toULongLong(&ok, 16);
+            else if(fields[1] == "period")
+                period = fields[2].toULongLong(&ok);
+            else if(fields[1] == "cycles")
+                cycles = fields[2].toULongLong(&ok);
+        }
+        else
+        {
+            uint64_t count = 0, addr = 0;
+
+            if(fields.length() >= 2)
+            {
+                count = fields[0].toULongLong(&ok);
+                if(ok)
+                    addr = fields[1].toULongLong(&ok, 16);
+            }
+            else
+                ok = false;
+
+            if(ok && addr >= base)
+            {
+                samples[addr - base] += count;
+                totalHits += count;
+            }
+        }
+
+        if(!ok)
+        {
+            LOG_ERROR(QString("Invalid profile line %1: %2").arg(lineNo).arg(path));
+            samples.clear();
+            totalHits = 0;
+            return false;
+        }
+    }
+
+    if(!period)
+        period = 1;
+
+    LOG_MSG(QString("Profile: %1 addresses, %2 hits, period %3").arg(samples.size()).arg(totalHits).arg(period));
+
+    return true;
+}
+
+bool CallSiteProfile::isEmpty() const
+{
+    return !totalHits;
+}
+
+uint64_t CallSiteProfile::hits(uint64_t addr) const
+{
+    uint64_t h = 0;
+
+    for(QMap<uint64_t, uint64_t>::const_iterator it = samples.lowerBound(addr);
+        it != samples.end() && it.key() <= addr + callSize; ++it)
+        h += it.value();
+
+    return h;
+}
+
+QList<int> CallSiteProfile::selectSites(const QList<uint64_t> &sites, uint8_t coverage,
+                                        std::default_random_engine &gen) const
+{
+    QList<int> selected;
+    coverage = coverage > 100 ? 100 : coverage;
+
+    if(isEmpty())
+    {
+        std::uniform_int_distribution<int> prob(0, 99);
+
+        for(int i = 0; i < sites.length(); ++i)
+            if(prob(gen) < coverage)
+                selected.append(i);
+
+        return selected;
+    }
+
+    // Losowanie bez zwracania z wagą 1 / (1 + trafienia): klucz u^(1 + trafienia), porównywany logarytmami
+    std::uniform_real_distribution<double> u(0., 1.);
+    QList<QPair<double, int> > keys;
+    int hot = 0;
+
+    for(int i = 0; i < sites.length(); ++i)
+    {
+        uint64_t h = hits(sites[i]);
+
+        if(h && h > hotFraction * totalHits)
+        {
+            ++hot;
+            continue;
+        }
+
+        keys.append(QPair<double, int>((1. + h) * std::log(std::max(u(gen), 1e-300)), i));
+    }
+
+    std::sort(keys.begin(), keys.end(), [](const QPair<double, int> &a, const QPair<double, int> &b) -> bool {
+        return a.first > b.first;
+    });
+
+    int budget = (sites.length() * coverage + 99) / 100;
+    for(int i = 0; i < keys.length() && i < budget; ++i)
+        selected.append(keys[i].second);
+
+    std::sort(selected.begin(), selected.end());
+
+    LOG_MSG(QString("Profile: %1 of %2 call sites selected (budget %3), %4 hot sites excluded")
+            .arg(selected.length()).arg(sites.length()).arg(budget).arg(hot));
+
+    return selected;
+}
+
+void CallSiteProfile::report(const QString &name, const QList<uint64_t> &sites, uint64_t stubCycles) const
+{
+    if(isEmpty())
+        return;
+
+    uint64_t h = 0;
+    foreach(uint64_t addr, sites)
+        h += hits(addr);
+
+    // Każde trafienie to period przejść przez dodany kod; liczba cykli kodu jest dolnym oszacowaniem
+    uint64_t extra = h * period * stubCycles;
+
+    QString msg = QString("%1: %2 sites, %3 of %4 profile hits (%5%), projected overhead: %6 cycles")
+            .arg(name).arg(sites.length()).arg(h).arg(totalHits)
+            .arg(100. * h / totalHits, 0, 'f', 3).arg(extra);
+
+    if(cycles)
+        msg.append(QString(" (%1% of profiled run)").arg(100. * extra / cycles, 0, 'f', 3));
+
+    LOG_MSG(msg);
+}
+
+uint32_t CallSiteProfile::dumpCounterOffset(int index)
+{
+    return dumpHeaderSize + sizeof(uint64_t) * index;
+}
+
+uint32_t CallSiteProfile::dumpMapSize(int count)
+{
+    return dumpCounterOffset(count);
+}
+
+bool CallSiteProfile::createDump(const QString &path, const QList<uint64_t> &sites)
+{
+    uint32_t count = sites.length();
+    uint32_t reserved = 0;
+
+    QByteArray data(dumpMagic);
+    data.append(reinterpret_cast<const char*>(&dumpVersion), sizeof(uint32_t));
+    data.append(reinterpret_cast<const char*>(&count), sizeof(uint32_t));
+    data.append(reinterpret_cast<const char*>(&reserved), sizeof(uint32_t));
+    data.append(QByteArray(sizeof(uint64_t) * count, '\0'));
+
+    foreach(uint64_t addr, sites)
+        data.append(reinterpret_cast<const char*>(&addr), sizeof(uint64_t));
+
+    QFile f(path);
+    if(!f.open(QIODevice::WriteOnly) || f.write(data) != data.size())
+    {
+        LOG_ERROR(QString("Cannot write profile dump: %1").arg(path));
+        return false;
+    }
+
+    LOG_MSG(QString("Profile dump with %1 counters created: %2").arg(count).arg(path));
+
+    return true;
+}
+
+bool CallSiteProfile::parseDump(const QByteArray &data, QList<uint64_t> &sites, QList<uint64_t> &counters)
+{
+    if(static_cast<uint32_t>(data.size()) < dumpHeaderSize || !data.startsWith(dumpMagic))
+        return false;
+
+    const uint32_t *header = reinterpret_cast<const uint32_t*>(data.constData());
+    uint32_t count = header[2];
+
+    if(header[1] != dumpVersion ||
+            static_cast<uint64_t>(data.size()) < dumpHeaderSize + 2 * sizeof(uint64_t) * static_cast<uint64_t>(count))
+        return false;
+
+    const uint64_t *cnt = reinterpret_cast<const uint64_t*>(data.constData() + dumpHeaderSize);
+    const uint64_t *addr = cnt + count;
+
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        counters.append(cnt[i]);
+        sites.append(addr[i]);
+    }
+
+    return true;
+}
+
+bool CallSiteProfile::heatReport(const QString &path)
+{
+    QFile f(path);
+    if(!f.open(QIODevice::ReadOnly))
+    {
+        LOG_ERROR(QString("Cannot open profile dump: %1").arg(path));
+        return false;
+    }
+
+    QList<uint64_t> sites, counters;
+    if(!parseDump(f.readAll(), sites, counters))
+    {
+        LOG_ERROR(QString("Invalid profile dump: %1").arg(path));
+        return false;
+    }
+
+    QList<QPair<uint64_t, uint64_t> > heat;
+    uint64_t total = 0, fired = 0;
+
+    for(int i = 0; i < sites.length(); ++i)
+    {
+        heat.append(QPair<uint64_t, uint64_t>(counters[i], sites[i]));
+        total += counters[i];
+        fired += counters[i] ? 1 : 0;
+    }
+
+    std::sort(heat.begin(), heat.end(), [](const QPair<uint64_t, uint64_t> &a, const QPair<uint64_t, uint64_t> &b) -> bool {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+
+    LOG_MSG(QString("%1: %2 of %3 sites fired, %4 hits").arg(path).arg(fired).arg(sites.length()).arg(total));
+
+    typedef QPair<uint64_t, uint64_t> heat_t;
+    foreach(const heat_t &h, heat)
+    {
+        if(!h.first)
+            break;
+
+        LOG_MSG(QString("0x%1\t%2\t%3%").arg(h.second, 0, 16).arg(h.first)
+                .arg(100. * h.first / total, 0, 'f', 3));
+    }
+
+    return true;
+}
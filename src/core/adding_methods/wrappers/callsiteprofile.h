@@ -0,0 +1,159 @@
+#ifndef CALLSITEPROFILE_H
+#define CALLSITEPROFILE_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include <random>
+
+/**
+ * @brief Profil wykonania programu, wykorzystywany przy wyborze miejsc wywołań do zaciemniania i trampolin.
+ *
+ * Plik profilu jest plikiem tekstowym, w którym każda linia zawiera liczbę trafień i adres (szesnastkowo),
+ * czyli format wyjścia polecenia:
+ *     perf script -F ip | sort | uniq -c > profile.txt
+ * Linie zaczynające się od '#' są komentarzami, z wyjątkiem opcjonalnych nagłówków:
+ *     # base <adres>    - adres załadowania odejmowany od adresów (pliki PIE i biblioteki),
+ *     # period <n>      - liczba zdarzeń na jedną próbkę (perf record -c n), domyślnie 1,
+ *     # cycles <n>      - liczba cykli całego profilowanego przebiegu (np. z perf stat), do raportu narzutu.
+ *
+ * Profilem może być też plik zrzutu liczników, zapisywany przez plik zabezpieczony w trybie profilującym.
+ * Zrzut ma nagłówek (magic "DPRF", wersja, liczba miejsc, zarezerwowane - po 4 bajty), 64-bitowe liczniki
+ * kolejnych miejsc oraz ich adresy. Plik jest tworzony w czasie zabezpieczania, a program odwzorowuje
+ * (MAP_SHARED) jego część z licznikami, więc po zakończeniu programu liczniki są zapisane w pliku.
+ */
+class CallSiteProfile
+{
+public:
+    /**
+     * @brief Konstruktor pustego profilu.
+     */
+    CallSiteProfile();
+
+    /**
+     * @brief Wczytuje profil z pliku.
+     * @param path ścieżka do pliku profilu.
+     * @return True jeżeli plik został wczytany, False w innych przypadkach.
+     */
+    bool load(const QString &path);
+
+    /**
+     * @brief Sprawdza czy profil zawiera jakiekolwiek próbki.
+     * @return True jeżeli profil jest pusty.
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Liczba trafień miejsca wywołania: instrukcji call oraz adresu powrotu z niej.
+     * @param addr adres wirtualny instrukcji call.
+     * @return Liczba trafień.
+     */
+    uint64_t hits(uint64_t addr) const;
+
+    /**
+     * @brief Wybiera miejsca wywołań do zmiany.
+     *
+     * Bez profilu każde miejsce jest wybierane z prawdopodobieństwem coverage%. Z profilem wybierane jest
+     * coverage% wszystkich miejsc, w pierwszej kolejności zimnych: gorące miejsca są pomijane, a pozostałe
+     * losowane z wagą odwrotnie proporcjonalną do liczby trafień.
+     * @param sites adresy instrukcji call.
+     * @param coverage procent miejsc do zmiany.
+     * @param gen generator liczb losowych.
+     * @return Indeksy wybranych miejsc, w kolejności rosnącej.
+     */
+    QList<int> selectSites(const QList<uint64_t> &sites, uint8_t coverage, std::default_random_engine &gen) const;
+
+    /**
+     * @brief Wypisuje raport przewidywanego narzutu wybranych miejsc.
+     * @param name nazwa zmiany (do raportu).
+     * @param sites adresy wybranych instrukcji call.
+     * @param stubCycles szacowana liczba cykli jednego przejścia przez dodany kod.
+     */
+    void report(const QString &name, const QList<uint64_t> &sites, uint64_t stubCycles) const;
+
+    /**
+     * @brief Tworzy plik zrzutu z wyzerowanymi licznikami.
+     * @param path ścieżka do pliku zrzutu.
+     * @param sites adresy miejsc, kolejność odpowiada indeksom liczników.
+     * @return True jeżeli plik został zapisany, False w innych przypadkach.
+     */
+    static bool createDump(const QString &path, const QList<uint64_t> &sites);
+
+    /**
+     * @brief Wypisuje raport trafień miejsc z pliku zrzutu, od najgorętszego.
+     * @param path ścieżka do pliku zrzutu.
+     * @return True jeżeli plik został wczytany, False w innych przypadkach.
+     */
+    static bool heatReport(const QString &path);
+
+    /**
+     * @brief Przesunięcie licznika miejsca w pliku zrzutu.
+     * @param index indeks miejsca.
+     * @return Przesunięcie w bajtach.
+     */
+    static uint32_t dumpCounterOffset(int index);
+
+    /**
+     * @brief Rozmiar części pliku zrzutu odwzorowywanej przez program (nagłówek i liczniki).
+     * @param count liczba miejsc.
+     * @return Rozmiar w bajtach.
+     */
+    static uint32_t dumpMapSize(int count);
+
+private:
+    /**
+     * @brief Wczytuje liczniki z pliku zrzutu.
+     * @param data zawartość pliku.
+     * @param sites adresy miejsc.
+     * @param counters liczniki miejsc.
+     * @return True jeżeli plik jest poprawnym zrzutem, False w innych przypadkach.
+     */
+    static bool parseDump(const QByteArray &data, QList<uint64_t> &sites, QList<uint64_t> &counters);
+
+    /**
+     * @brief Sygnatura pliku zrzutu.
+     */
+    static const QByteArray dumpMagic;
+
+    /**
+     * @brief Wersja formatu pliku zrzutu.
+     */
+    static const uint32_t dumpVersion;
+
+    /**
+     * @brief Rozmiar nagłówka pliku zrzutu.
+     */
+    static const uint32_t dumpHeaderSize;
+
+    /**
+     * @brief Próg trafień (jako część wszystkich trafień), powyżej którego miejsce jest uznawane za gorące.
+     */
+    static const double hotFraction;
+
+    /**
+     * @brief Rozmiar instrukcji call rel32 - kolejny adres jest adresem powrotu.
+     */
+    static const uint8_t callSize;
+
+    /**
+     * @brief Liczba trafień pod kolejnymi adresami.
+     */
+    QMap<uint64_t, uint64_t> samples;
+
+    /**
+     * @brief Suma wszystkich trafień.
+     */
+    uint64_t totalHits;
+
+    /**
+     * @brief Liczba zdarzeń na jedną próbkę.
+     */
+    uint64_t period;
+
+    /**
+     * @brief Liczba cykli profilowanego przebiegu, 0 jeżeli nieznana.
+     */
+    uint64_t cycles;
+};
+
+#endif // CALLSITEPROFILE_H
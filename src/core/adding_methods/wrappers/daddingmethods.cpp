@@ -1,10 +1,9 @@
 #include <core/adding_methods/wrappers/daddingmethods.h>
 
-#include <chrono>
 #include <QProcess>
 
-#include <helper/settings_parser/dsettings.h>
 #include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
 
 const QMap<Registers_x86, QString> AsmCodeGenerator::regs_x86 = {
     { Registers_x86::EAX, enum_stringify(Registers_x86::EAX) },
@@ -47,7 +46,7 @@ const QMap<AsmCodeGenerator::Instructions, QString> AsmCodeGenerator::instructio
 template <typename Reg>
 DAddingMethods<Reg>::DAddingMethods(BinaryFile *f) :
     file(f),
-    r_gen(std::chrono::system_clock::now().time_since_epoch().count())
+    r_gen(DJobContext::current().nextSeed())
 {
     arch_type = {
         { ArchitectureType::BITS32, "[bits 32]" },
@@ -61,7 +60,7 @@ template <typename Register>
 bool DAddingMethods<Register>::pack(QString file_path, DAddingMethods::CompressionLevel level, DAddingMethods::CompressionOptions opt)
 {
     QProcess upx;
-    QString upx_path = DSettings::getSettings().getUpxPath();
+    QString upx_path = DJobContext::current().getUpxPath();
     QList<QString> params = { "-f" };
 
     if(level == CompressionLevel::BEST)
@@ -106,6 +105,17 @@ const QMap<QString, typename Wrapper<Reg>::WrapperType> Wrapper<Reg>::wrapperTyp
 template const QMap<QString, Wrapper<Registers_x86>::WrapperType> Wrapper<Registers_x86>::wrapperTypes;
 template const QMap<QString, Wrapper<Registers_x64>::WrapperType> Wrapper<Registers_x64>::wrapperTypes;
 
+template <typename Reg>
+const QMap<QString, QPair<typename DAddingMethods<Reg>::ArchitectureType, typename DAddingMethods<Reg>::SystemType>> Wrapper<Reg>::architectures =
+{
+    { "win_x86", qMakePair(DAddingMethods<Reg>::ArchitectureType::BITS32, DAddingMethods<Reg>::SystemType::Windows) },
+    { "lin_x86", qMakePair(DAddingMethods<Reg>::ArchitectureType::BITS32, DAddingMethods<Reg>::SystemType::Linux) },
+    { "win_x64", qMakePair(DAddingMethods<Reg>::ArchitectureType::BITS64, DAddingMethods<Reg>::SystemType::Windows) },
+    { "lin_x64", qMakePair(DAddingMethods<Reg>::ArchitectureType::BITS64, DAddingMethods<Reg>::SystemType::Linux) }
+};
+template const QMap<QString, QPair<DAddingMethods<Registers_x86>::ArchitectureType, DAddingMethods<Registers_x86>::SystemType>> Wrapper<Registers_x86>::architectures;
+template const QMap<QString, QPair<DAddingMethods<Registers_x64>::ArchitectureType, DAddingMethods<Registers_x64>::SystemType>> Wrapper<Registers_x64>::architectures;
+
 template <typename Reg>
 const QMap<QString, typename DAddingMethods<Reg>::CallingMethod> DAddingMethods<Reg>::callingMethods =
 {
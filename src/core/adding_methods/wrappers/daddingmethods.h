@@ -11,6 +11,8 @@
 #include <core/file_types/codedefines.h>
 #include <core/file_types/binaryfile.h>
 #include <core/file_types/elffile.h>
+#include <core/adding_methods/wrappers/callsiteprofile.h>
+#include <helper/desc_catalog/ddescriptioncatalog.h>
 
 template <typename RegistersType>
 class Wrapper;
@@ -120,6 +122,18 @@ public:
      */
     static bool pack(QString file_path, CompressionLevel level = CompressionLevel::BEST, CompressionOptions opt = CompressionOptions::Default);
 
+    /**
+     * @brief Ustawia profil wykonania, według którego wybierane są miejsca zaciemniania i trampolin.
+     * @param p Profil wykonania.
+     */
+    void setProfile(const CallSiteProfile &p) { profile = p; }
+
+    /**
+     * @brief Włącza tryb profilujący: każde zmienione miejsce zlicza swoje wykonania w pliku zrzutu.
+     * @param prefix Przedrostek ścieżek plików zrzutu (pusty wyłącza tryb profilujący).
+     */
+    void setProfileBuild(const QString &prefix) { profile_build = prefix; }
+
 protected:
     /**
      * @brief Plik binarny.
@@ -136,6 +150,16 @@ protected:
      */
     std::default_random_engine r_gen;
 
+    /**
+     * @brief Profil wykonania (pusty, jeżeli miejsca są wybierane losowo).
+     */
+    CallSiteProfile profile;
+
+    /**
+     * @brief Przedrostek ścieżek plików zrzutu liczników, pusty jeżeli tryb profilujący jest wyłączony.
+     */
+    QString profile_build;
+
 public:
     /**
      * @brief Mapa konwertująca ciągi znaków na CallingMethod.
@@ -145,6 +169,9 @@ public:
 
 /**
  * @brief Klasa generowania źródłowego kodu assembly.
+ *
+ * Używana tam, gdzie kod jest składany z tekstu opisów metod. Kod budowany wyłącznie
+ * z pojedynczych instrukcji jest generowany bez asemblera przez DCodeEmitter.
  */
 class AsmCodeGenerator {
     static const QMap<Registers_x86, QString> regs_x86;
@@ -501,6 +528,28 @@ public:
      */
     bool obfuscation;
 
+    /**
+     * @brief Sprawdzenie w tramplinie jest wykonywane co tyle wywołań (0 - bez warunku na liczbę wywołań).
+     * Wystarcza spełnienie jednego z warunków: rate_calls lub rate_cycles.
+     */
+    uint32_t rate_calls;
+
+    /**
+     * @brief Sprawdzenie w tramplinie jest wykonywane, gdy od poprzedniego minęło tyle cykli procesora (rdtsc)
+     * (0 - bez warunku na czas).
+     */
+    uint64_t rate_cycles;
+
+    /**
+     * @brief Odstęp między sprawdzeniami w wątku w sekundach (0 - wartość z opakowania wątku).
+     */
+    uint16_t sleep_time;
+
+    /**
+     * @brief Maksymalny odstęp między sprawdzeniami w wątku, do którego jest podwajany, gdy nic nie wykryto.
+     */
+    uint16_t max_sleep_time;
+
     /**
      * @brief Destruktor.
      */
@@ -524,12 +573,16 @@ public:
         detect_handler = nullptr;
         only_rwx = w.only_rwx;
         obfuscation = w.obfuscation;
+        rate_calls = w.rate_calls;
+        rate_cycles = w.rate_cycles;
+        sleep_time = w.sleep_time;
+        max_sleep_time = w.max_sleep_time;
     }
 
     /**
      * @brief Konstruktor.
      */
-    Wrapper(){ detect_handler = nullptr; }
+    Wrapper(){ detect_handler = nullptr; rate_calls = 0; rate_cycles = 0; sleep_time = 0; max_sleep_time = 0; }
 
     /**
      * @brief Reprezentacja stringów typami opakowań.
@@ -570,27 +623,12 @@ public:
         // description
         description = json["description"].toString();
 
-        // arch_type
-        QRegExp x86arch("^(win|lin)_x86$");
-        QRegExp x64arch("^(win|lin)_x64$");
+        // arch_type, system_type
         QString arch_str = json["architecture"].toString();
-        if(arch_str.contains(x86arch))
-            arch_type = DAddingMethods<RegistersType>::ArchitectureType::BITS32;
-        else if(arch_str.contains(x64arch))
-            arch_type = DAddingMethods<RegistersType>::ArchitectureType::BITS64;
-        else
-            return false;
-
-        // system_type
-        QRegExp system_win("^win_(x86|x64)$");
-        QRegExp system_lin("^lin_(x86|x64)$");
-        QString system_str = json["architecture"].toString();
-        if(system_str.contains(system_win))
-            system_type = DAddingMethods<RegistersType>::SystemType::Windows;
-        else if(system_str.contains(system_lin))
-            system_type = DAddingMethods<RegistersType>::SystemType::Linux;
-        else
+        if(!architectures.contains(arch_str))
             return false;
+        arch_type = architectures[arch_str].first;
+        system_type = architectures[arch_str].second;
 
         // wrapper_type
         wrapper_type = wrapperTypes[json["type"].toString()];
@@ -635,13 +673,9 @@ public:
         ret = registerTypes[json["returns"].toString()];
 
         // code
-        QFile codeFile(json["path"].toString());
-        if(!codeFile.open(QIODevice::ReadOnly | QIODevice::Text))
+        if(!DDescriptionCatalog::readCode(json["path"].toString(), code))
             return false;
 
-        code = codeFile.readAll();
-        codeFile.close();
-
         // detect_handler
         detect_handler = nullptr;
 
@@ -655,6 +689,16 @@ public:
         if (json["obfuscation"].toString() == QString("no"))
             obfuscation = false;
 
+        // rate limit of checks in trampolines
+        rate_calls = json["rate_calls"].toString().toUInt();
+        rate_cycles = json["rate_cycles"].toString().toULongLong();
+
+        // interval of checks in a thread
+        sleep_time = json["sleep_time"].toString().toUShort();
+        max_sleep_time = sleep_time;
+        if (json.contains("max_sleep_time"))
+            max_sleep_time = json["max_sleep_time"].toString().toUShort();
+
         return true;
     }
 
@@ -664,6 +708,12 @@ private:
      */
     static const QMap<QString,RegistersType> registerTypes;
 
+    /**
+     * @brief Architektura i system docelowy dla wartości pola "architecture".
+     */
+    static const QMap<QString, QPair<typename DAddingMethods<RegistersType>::ArchitectureType,
+                                     typename DAddingMethods<RegistersType>::SystemType>> architectures;
+
     /**
      * @brief write zapisujemy obiekt this do pliku json
      * @param json obiekt do którego zapisujemy
@@ -713,16 +763,36 @@ template <typename RegistersType>
 class ThreadWrapper : public Wrapper<RegistersType> {
 public:
     QList<Wrapper<RegistersType>*> thread_actions;
-    uint16_t sleep_time;
 
-    ThreadWrapper() { sleep_time = 5; }
+    /**
+     * @brief Kod pojedynczego sprawdzenia uruchamianego przez wspólny wątek.
+     */
+    QByteArray check_code;
+
+    ThreadWrapper() { this->sleep_time = 5; this->max_sleep_time = 5; }
     ThreadWrapper(const ThreadWrapper& w) : Wrapper<RegistersType>(w) {
-        sleep_time = 5;
+        check_code = w.check_code;
     }
 
     virtual bool read(const QJsonObject & json) override {
-        sleep_time = 5;
-        return Wrapper<RegistersType>::read(json);
+        if (!Wrapper<RegistersType>::read(json))
+            return false;
+
+        // default interval, used by checks that do not set their own
+        if (!json.contains("sleep_time")) {
+            this->sleep_time = 5;
+            if (!json.contains("max_sleep_time"))
+                this->max_sleep_time = 5;
+        }
+
+        // code of a single check, wrapped by the thread code
+        check_code.clear();
+        if (json.contains("check_path")) {
+            if (!DDescriptionCatalog::readCode(json["check_path"].toString(), check_code))
+                return false;
+        }
+
+        return true;
     }
 };
 
@@ -753,14 +823,29 @@ class TrampolineWrapper : public Wrapper<RegistersType> {
 public:
     Wrapper<RegistersType> *tramp_action;
 
+    /**
+     * @brief Kod ograniczający częstość sprawdzeń w tramplinie.
+     */
+    QByteArray rate_limit_code;
+
     TrampolineWrapper() { tramp_action = nullptr; }
     TrampolineWrapper(const TrampolineWrapper& w) : Wrapper<RegistersType>(w) {
         tramp_action = nullptr;
+        rate_limit_code = w.rate_limit_code;
     }
 
     virtual bool read(const QJsonObject & json) override {
         tramp_action = nullptr;
-        return Wrapper<RegistersType>::read(json);
+        if (!Wrapper<RegistersType>::read(json))
+            return false;
+
+        rate_limit_code.clear();
+        if (json.contains("rate_limit_path")) {
+            if (!DDescriptionCatalog::readCode(json["rate_limit_path"].toString(), rate_limit_code))
+                return false;
+        }
+
+        return true;
     }
 };
 
@@ -1,25 +1,22 @@
 #include <core/adding_methods/wrappers/elfaddingmethods.h>
 
-#include <QProcess>
-#include <QFileInfo>
-#include <QTemporaryFile>
 #include <QDebug>
+#include <QFileInfo>
 #include <QMap>
 
+#include <core/assembler/dassembler.h>
+#include <core/disassembler/lengthdecoder.h>
+#include <core/file_types/crc32c.h>
 #include <helper/json_parser/djsonparser.h>
-#include <helper/settings_parser/dsettings.h>
+#include <helper/job_context/djobcontext.h>
 #include <helper/logger/dlogger.h>
 
 template <typename RegistersType>
 const QMap<typename ELFAddingMethods<RegistersType>::ErrorCode, QString> ELFAddingMethods<RegistersType>::error_desc = {
+    { ELFAddingMethods<RegistersType>::ErrorCode::AssemblingFailed,
+      QString("Failed to assemble generated code.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::BinaryFileNoElf,
       QString("Invalid Elf file structure!") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::CompiledFileOpenFailed,
-      QString("Failed to open file with compiled code.") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::FileToCompileOpenFailed,
-      QString("Failed to open file with assembly code.") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::FileToCompileWriteFailed,
-      QString("Failed to write to file with assembly code.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::GetEntryPointFailed,
       QString("Failed to get entry point from specified ELF file.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::GetRelativeAddressFailed,
@@ -38,14 +35,12 @@ const QMap<typename ELFAddingMethods<RegistersType>::ErrorCode, QString> ELFAddi
       QString("Invalid address size align for ELF file architecture.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::InvalidElfFile,
       QString("Given file is not a valid ELF file!") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::NasmExecutionFailed,
-      QString("Failed to start nasm compiler") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::NdisasmExecutionFailed,
-      QString("Failed to start ndisasm decompiler") },
     { ELFAddingMethods<RegistersType>::ErrorCode::NullInjectDescription,
       QString("Loading inject description failed.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::NullWrapper,
       QString("Loading wrapper failed.") },
+    { ELFAddingMethods<RegistersType>::ErrorCode::ProfileDumpFailed,
+      QString("Failed to create profile dump file.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::SegmentExtensionFailed,
       QString("Failed to extend segment in specified ELF file.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::SetEntryPointFailed,
@@ -56,8 +51,6 @@ const QMap<typename ELFAddingMethods<RegistersType>::ErrorCode, QString> ELFAddi
       QString("Failed to set section content in specified ELF file.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::Success,
       QString("Success") },
-    { ELFAddingMethods<RegistersType>::ErrorCode::TempFileOpenFailed,
-      QString("Failed to open temporary file.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::TemplateErrorWTF,
       QString("Invalid template type WTF??????.") },
     { ELFAddingMethods<RegistersType>::ErrorCode::TrampolineAddressAbsence,
@@ -69,7 +62,8 @@ const QMap<typename ELFAddingMethods<RegistersType>::ErrorCode, QString> ELFAddi
 template <typename RegistersType>
 ELFAddingMethods<RegistersType>::ELFAddingMethods(ELF *f) :
     DAddingMethods<RegistersType>(f),
-    tramp_code_cover(5)
+    tramp_code_cover(5),
+    profile_dumps(0)
 {
     placeholder_id = {
         { PlaceholderTypes::PARAM_PRE,          QString("(?^_^")     },
@@ -81,8 +75,13 @@ ELFAddingMethods<RegistersType>::ELFAddingMethods(ELF *f) :
     placeholder_mnm = {
         { PlaceholderMnemonics::DDETECTIONHANDLER,  mnemonic_stringify(PlaceholderMnemonics::DDETECTIONHANDLER) },
         { PlaceholderMnemonics::DDETECTIONMETHOD,   mnemonic_stringify(PlaceholderMnemonics::DDETECTIONMETHOD)  },
-        { PlaceholderMnemonics::DDRET,              mnemonic_stringify(PlaceholderMnemonics::DDRET)             }
+        { PlaceholderMnemonics::DDRET,              mnemonic_stringify(PlaceholderMnemonics::DDRET)             },
+        { PlaceholderMnemonics::DTIMERS,            mnemonic_stringify(PlaceholderMnemonics::DTIMERS)           },
+        { PlaceholderMnemonics::DRATELIMIT,         mnemonic_stringify(PlaceholderMnemonics::DRATELIMIT)        }
     };
+
+    // values known only after the file edit session, written into compiled code at slot offsets
+    patch_slots = { "magic!sec_size", "magic!sec_checksum", "dyn_magic!offset", "dyn_magic!data" };
 }
 template ELFAddingMethods<Registers_x86>::ELFAddingMethods(ELF *f);
 template ELFAddingMethods<Registers_x64>::ELFAddingMethods(ELF *f);
@@ -97,6 +96,9 @@ uint64_t
 ELFAddingMethods<RegistersType>::fill_params(QString &code, const QMap<QString, QString> &params) {
     uint64_t cnt = 0;
     foreach (QString param, params.keys()) {
+        if (patch_slots.contains(param))
+            continue;
+
         QString plc_param(QString("%1%2%3").arg(placeholder_id[PlaceholderTypes::PARAM_PRE], param,
                           placeholder_id[PlaceholderTypes::PARAM_POST]));
 
@@ -108,42 +110,78 @@ ELFAddingMethods<RegistersType>::fill_params(QString &code, const QMap<QString,
 
 template <typename RegistersType>
 typename ELFAddingMethods<RegistersType>::ErrorCode
-ELFAddingMethods<RegistersType>::fill_magic_params(QMap<QString, QString> &params, const ELF *elf) {
-    static QString magic_sec_size("magic!sec_size"),
-                   magic_sec_checksum("magic!sec_checksum");
+ELFAddingMethods<RegistersType>::fill_patch_slots(const pending_method &pm, Elf64_Addr nva, Elf64_Off file_off,
+                                                  Elf64_Addr data_va, Elf64_Addr counters_va) {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if(!elf)
+        return ErrorCode::BinaryFileNoElf;
 
-    if (!params.contains(magic_sec_size) && !params.contains(magic_sec_checksum))
+    if (pm.patch_slots.isEmpty())
         return ErrorCode::Success;
 
-    QPair<QByteArray, Elf64_Addr> section_data;
-    if (!elf->get_section_content(ELF::SectionType::TEXT, section_data))
+    QPair<QByteArray, Elf64_Addr> text_data;
+    if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
         return ErrorCode::GetSectionContentFailed;
 
-    if (params.contains(magic_sec_size))
-        params[magic_sec_size] = QString::number(section_data.first.size());
-    if (params.contains(magic_sec_checksum)) {
-        /*
-        // TODO: calculate dummy checksum
-        uint32_t checksum = 0;
-        foreach (unsigned char b, section_data.first)
-            checksum += b;
-        */
-        // fill checksum after
-        params[magic_sec_checksum] = QString::number(0x1ee74b1d);
+    foreach (const DCodeObject::Slot &slot, pm.patch_slots) {
+        Elf64_Addr value;
+
+        // later edit sessions may still patch .text, these slots are filled by fill_checksum_slots
+        if (slot.name == "magic!sec_size" || slot.name == "magic!sec_checksum") {
+            checksum_slots.push_back(qMakePair(nva + slot.offset, slot.name));
+            continue;
+        }
+
+        if (slot.name == "dyn_magic!data" || slot.name == "dyn_magic!counters") {
+            Elf64_Addr target = slot.name == "dyn_magic!data" ? data_va : counters_va;
+            if (!target)
+                return ErrorCode::WrapperGenCodeFailed;
+
+            // x86: offset from the popped return address of call $+5 (2-byte opcode before the slot),
+            // x64: RIP-relative displacement, counted from the end of the slot
+            value = elf->is_x86() ? target - (nva + slot.offset - 3) : target - (nva + slot.offset + 4);
+        }
+        else
+            // offset from the popped return address of call $+5 (add instruction before the slot) to .text
+            value = text_data.second - (nva + slot.offset - (elf->is_x86() ? 3 : 4));
+
+        if (!elf->set_relative_address(file_off + slot.offset, value))
+            return ErrorCode::SetRelativeAddressFailed;
     }
 
     return ErrorCode::Success;
 }
 
-// bool ELFAddingMethods::fill_magic_checksum(const ELF64_Addr vaddr, ELF *elf, uint32_t &checksum) {
-    /*
-    static uint32_t code_cheksum_magic = 0x1ee74b1d;
-    int j = 0;
-    while ((j = compiled_code.indexOf(static_cast<const char *>(&code_cheksum_magic), j + 1)) != -1)
-        if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-            return false;
-    */
-// }
+template <typename RegistersType>
+typename ELFAddingMethods<RegistersType>::ErrorCode
+ELFAddingMethods<RegistersType>::fill_checksum_slots() {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if(!elf)
+        return ErrorCode::BinaryFileNoElf;
+
+    if (checksum_slots.isEmpty())
+        return ErrorCode::Success;
+
+    QPair<QByteArray, Elf64_Addr> text_data;
+    if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
+        return ErrorCode::GetSectionContentFailed;
+
+    // CRC32C of the final .text, the same as computed by the injected check
+    uint32_t checksum = Crc32c::compute(text_data.first);
+
+    typedef QPair<Elf64_Addr, QString> slot_t;
+    foreach (const slot_t &slot, checksum_slots) {
+        // added code may have moved in file since the slot was recorded, its address has not
+        Elf64_Off file_off;
+        if (!elf->get_file_offset(slot.first, file_off))
+            return ErrorCode::SetRelativeAddressFailed;
+
+        if (!elf->set_relative_address(file_off, slot.second == "magic!sec_size" ? text_data.first.size() : checksum))
+            return ErrorCode::SetRelativeAddressFailed;
+    }
+
+    return ErrorCode::Success;
+}
 
 template <typename RegistersType>
 uint64_t
@@ -159,29 +197,17 @@ ELFAddingMethods<RegistersType>::fill_placeholders(QString &code, const QString
 
 template <typename RegistersType>
 typename ELFAddingMethods<RegistersType>::ErrorCode
-ELFAddingMethods<RegistersType>::compile(const QString &code2compile, QByteArray &compiled_code) {
-    // TODO: change
-    QFile file("tocompile.asm");
-    if (!file.open(QIODevice::WriteOnly))
-        return ErrorCode::FileToCompileOpenFailed;
-
-    if (file.write(code2compile.toStdString().c_str(), code2compile.length()) != code2compile.length())
-        return ErrorCode::FileToCompileWriteFailed;
-
-    file.close();
+ELFAddingMethods<RegistersType>::compile(const QString &code2compile, DCodeObject &compiled_code) {
+    uint8_t bits = std::is_same<RegistersType, Registers_x64>::value ? 64 : 32;
 
-    // TODO: change file names and etc.
-    if (QProcess::execute(DSettings::getSettings().getNasmPath(), { "tocompile.asm" }))
-        return ErrorCode::NasmExecutionFailed;
+    QMap<QString, QString> placeholders;
+    foreach (const QString &slot, patch_slots)
+        placeholders[slot] = QString("%1%2%3").arg(placeholder_id[PlaceholderTypes::PARAM_PRE], slot,
+                                                   placeholder_id[PlaceholderTypes::PARAM_POST]);
 
-    file.setFileName("tocompile");
+    if (!DCodeObject::assemble(code2compile, bits, placeholders, compiled_code))
+        return ErrorCode::AssemblingFailed;
 
-    if (!file.open(QIODevice::ReadOnly))
-        return ErrorCode::CompiledFileOpenFailed;
-
-    compiled_code = file.readAll();
-
-    file.close();
     return ErrorCode::Success;
 }
 
@@ -208,7 +234,8 @@ ELFAddingMethods<RegistersType>::get_addresses(const QByteArray &addr_data, uint
 
 template <typename RegistersType>
 typename ELFAddingMethods<RegistersType>::ErrorCode
-ELFAddingMethods<RegistersType>::wrapper_gen_code(Wrapper<RegistersType> *wrap, QString &code) {
+ELFAddingMethods<RegistersType>::wrapper_gen_code(Wrapper<RegistersType> *wrap, QString &code,
+                                                  const LivenessAnalyzer::Result *live) {
     if (!wrap)
         return ErrorCode::NullWrapper;
 
@@ -223,11 +250,18 @@ ELFAddingMethods<RegistersType>::wrapper_gen_code(Wrapper<RegistersType> *wrap,
     if (wrap->used_regs.indexOf(wrap->ret) != -1)
         wrap->used_regs.removeAll(wrap->ret);
 
+    // registers dead after the code do not have to be saved
+    QList<RegistersType> saved_regs;
+    foreach (RegistersType reg, wrap->used_regs)
+        if (!live || LivenessAnalyzer::isLive(*live, reg))
+            saved_regs.push_back(reg);
+
     // save flag register
-    code.append(AsmCodeGenerator::save_flags<RegistersType>());
+    if (!live || live->flags)
+        code.append(AsmCodeGenerator::save_flags<RegistersType>());
 
     // generate push registers
-    code.append(AsmCodeGenerator::push_regs<RegistersType>(wrap->used_regs));
+    code.append(AsmCodeGenerator::push_regs<RegistersType>(saved_regs));
 
     code.append(wrap->code);
     // fill params
@@ -235,25 +269,78 @@ ELFAddingMethods<RegistersType>::wrapper_gen_code(Wrapper<RegistersType> *wrap,
 
     // generate pop registers
     QList<RegistersType> rused_args;
-    rused_args.reserve(wrap->used_regs.size());
-    std::reverse_copy(wrap->used_regs.begin(), wrap->used_regs.end(), std::back_inserter(rused_args));
+    rused_args.reserve(saved_regs.size());
+    std::reverse_copy(saved_regs.begin(), saved_regs.end(), std::back_inserter(rused_args));
 
     // restore registers
     code.append(AsmCodeGenerator::pop_regs<RegistersType>(rused_args));
 
     // restore flag register
-    code.append(AsmCodeGenerator::restore_flags<RegistersType>());
+    if (!live || live->flags)
+        code.append(AsmCodeGenerator::restore_flags<RegistersType>());
+
+    return ErrorCode::Success;
+}
+template typename ELFAddingMethods<Registers_x86>::ErrorCode ELFAddingMethods<Registers_x86>::wrapper_gen_code(Wrapper<Registers_x86> *wrap, QString &code,
+                                                                                                               const LivenessAnalyzer::Result *live);
+template typename ELFAddingMethods<Registers_x64>::ErrorCode ELFAddingMethods<Registers_x64>::wrapper_gen_code(Wrapper<Registers_x64> *wrap, QString &code,
+                                                                                                               const LivenessAnalyzer::Result *live);
+
+template <typename RegistersType>
+typename ELFAddingMethods<RegistersType>::ErrorCode
+ELFAddingMethods<RegistersType>::select_trampoline_sites(QList<QPair<Elf64_Addr, Elf64_Addr> > &tramp_file_off, Elf64_Addr &base_off,
+                                                         QPair<QByteArray, Elf64_Addr> &text_data, LivenessAnalyzer::Result &live) {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if(!elf)
+        return ErrorCode::BinaryFileNoElf;
+
+    QList<Elf64_Addr> __file_off;
+    ErrorCode ec = get_address_offsets_from_text_section(__file_off, base_off, text_data);
+    if (ec != ErrorCode::Success)
+        return ec;
+
+    int32_t rva;
+    Elf64_Addr inst_addr, target;
+    LivenessAnalyzer liveness(elf->is_x64());
+    const uint8_t *text = reinterpret_cast<const uint8_t*>(text_data.first.constData());
+
+    live.regs = 0;
+    live.flags = false;
+
+    QList<uint64_t> sites;
+    foreach (Elf64_Addr off, __file_off)
+        sites.push_back(text_data.second + off - base_off - 1);
+
+    QList<int> selected = DAddingMethods<RegistersType>::profile.selectSites(sites, tramp_code_cover,
+                                                                             DAddingMethods<RegistersType>::r_gen);
+
+    foreach (int idx, selected) {
+        Elf64_Addr off = __file_off[idx];
+        if (!elf->get_relative_address(off, rva))
+            return ErrorCode::GetRelativeAddressFailed;
+
+        inst_addr = text_data.second + off - base_off;
+        target = inst_addr + rva + 4;
+        tramp_file_off.push_back(QPair<Elf64_Addr, Elf64_Addr>(off, target));
+
+        // all trampolines share one code, so it saves registers live at any of the targets
+        LivenessAnalyzer::Result site = LivenessAnalyzer::allLive();
+        if (target >= text_data.second && target < text_data.second + text_data.first.size())
+            site = liveness.analyze(text + (target - text_data.second),
+                                    text_data.first.size() - (target - text_data.second));
+
+        live.regs |= site.regs;
+        live.flags |= site.flags;
+    }
 
     return ErrorCode::Success;
 }
-template typename ELFAddingMethods<Registers_x86>::ErrorCode ELFAddingMethods<Registers_x86>::wrapper_gen_code(Wrapper<Registers_x86> *wrap, QString &code);
-template typename ELFAddingMethods<Registers_x64>::ErrorCode ELFAddingMethods<Registers_x64>::wrapper_gen_code(Wrapper<Registers_x64> *wrap, QString &code);
 
 template <typename RegistersType>
-void ELFAddingMethods<RegistersType>::get_file_offsets_from_opcodes(QStringList &opcodes, QList<Elf64_Addr> &file_off,
+void ELFAddingMethods<RegistersType>::get_file_offsets_from_opcodes(const QVector<uint32_t> &opcodes, QList<Elf64_Addr> &file_off,
                                                                     Elf64_Addr base_off) {
-    foreach(QString op, opcodes)
-        file_off.append(op.mid(0, 8).toUInt(NULL, 16) + base_off + 1);
+    foreach(uint32_t op, opcodes)
+        file_off.append(op + base_off);
 }
 
 template <typename RegistersType>
@@ -268,40 +355,18 @@ ELFAddingMethods<RegistersType>::get_address_offsets_from_text_section(QList<Elf
     if (!elf->is_valid())
         return ErrorCode::InvalidElfFile;
 
-    QTemporaryFile temp_file;
-    if(!temp_file.open())
-        return ErrorCode::TempFileOpenFailed;
-
-    // section .text deassembling
     if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
         return ErrorCode::GetSectionContentFailed;
 
-    temp_file.write(text_data.first);
-    temp_file.flush();
-
-    QProcess ndisasm;
-
-    ndisasm.setProcessChannelMode(QProcess::MergedChannels);
-
-    ndisasm.start(DSettings::getSettings().getNdisasmPath(),
-                  {"-a", "-b", elf->is_x64() ? "64" : "32", QFileInfo(temp_file).absoluteFilePath()});
-
-    if(!ndisasm.waitForStarted())
-        return ErrorCode::NdisasmExecutionFailed;
-
-    QByteArray assembly;
-
-    while(ndisasm.waitForReadyRead(-1))
-        assembly.append(ndisasm.readAll());
-
-    // get call and jmp instructions
-    QStringList asm_inst = QString(assembly).split(CodeDefines<RegistersType>::newLineRegExp, QString::SkipEmptyParts);
-    QStringList call_inst = asm_inst.filter(CodeDefines<RegistersType>::callRegExp);
-    QStringList jmp_inst = asm_inst.filter(CodeDefines<RegistersType>::jmpRegExp);
+    // get call and jmp instructions from section .text
+    QVector<uint32_t> call_inst, jmp_inst;
+    LengthDecoder(elf->is_x64()).findRelativeBranches(text_data.first, call_inst, jmp_inst,
+                                                      DJobContext::current().getDisassemblerThreads());
 
     if (!elf->get_section_file_off(ELF::SectionType::TEXT, base_off))
         return ErrorCode::GetSectionFileOffsetFailed;
 
+    __file_off.reserve(__file_off.size() + call_inst.size() + jmp_inst.size());
     get_file_offsets_from_opcodes(call_inst, __file_off, base_off);
     get_file_offsets_from_opcodes(jmp_inst, __file_off, base_off);
 
@@ -345,54 +410,124 @@ ELFAddingMethods<RegistersType>::safe_obfuscate(uint8_t code_cover, uint8_t min_
 
     QList<rel_jmp_info> tramp_file_off; // < <offset in added data, offset in file>,  virtual address>
 
-    // TODO: should be changed
-    std::uniform_int_distribution<int> prob(0, 99);
     uint8_t coverage = code_cover > 100 ? 100 : code_cover;
     static QByteArray fake_jmp("\xe9\xde\xad\xbe\xef", 5);
 
-    // add a trash code
-    QByteArray trash_code;
-    foreach (Elf64_Addr off, __file_off) {
-        if(prob(DAddingMethods<RegistersType>::r_gen) >= coverage)
-            continue;
+    QList<uint64_t> sites, selected_sites;
+    foreach (Elf64_Addr off, __file_off)
+        sites.push_back(text_data.second + off - base_off - 1);
+
+    QList<int> selected = DAddingMethods<RegistersType>::profile.selectSites(sites, coverage,
+                                                                             DAddingMethods<RegistersType>::r_gen);
+
+    // profiling build: counters mapping routine goes first, each stub counts its executions,
+    // the pointer to the mapped counters is kept in writable data
+    bool profile_build = !DAddingMethods<RegistersType>::profile_build.isEmpty();
+    QString dump_path;
+    pending_method pm;
+    uint32_t slot_off = 0;
+
+    if (profile_build) {
+        dump_path = profile_dump_path("obfuscation");
+        full_compiled_code = CodeDefines<RegistersType>::profileRuntime(dump_path,
+                                                                        CallSiteProfile::dumpMapSize(selected.size()),
+                                                                        &slot_off);
+        pm.patch_slots.push_back({ "dyn_magic!counters", slot_off });
+    }
+
+    // add a trash code, stubs are placed in order of their call sites
+    QList<QByteArray> trash_codes;
+    StubLayout layout;
+    uint32_t counter_size = profile_build ? CodeDefines<RegistersType>::profileCounter(0, 0).size() : 0;
+
+    foreach (int idx, selected) {
+        selected_sites.push_back(sites[idx]);
+        trash_codes.push_back(CodeDefines<RegistersType>::obfuscate(DAddingMethods<RegistersType>::r_gen, min_len, max_len));
+        layout.add(sites[idx], counter_size + trash_codes.last().size() + fake_jmp.size());
+    }
+
+    layout.arrange(full_compiled_code.size());
+
+    foreach (int i, layout.order()) {
+        Elf64_Addr off = __file_off[selected[i]];
 
         if (!elf->get_relative_address(off, rva))
             return ErrorCode::GetRelativeAddressFailed;
 
         inst_addr = text_data.second + off - base_off;
-        trash_code = CodeDefines<RegistersType>::obfuscate(DAddingMethods<RegistersType>::r_gen, min_len, max_len);
+        full_compiled_code.append(CodeDefines<RegistersType>::nops(layout.offset(i) - full_compiled_code.size()));
+
+        if (profile_build) {
+            uint32_t counter_off = full_compiled_code.size();
+            full_compiled_code.append(CodeDefines<RegistersType>::profileCounter(-full_compiled_code.size(),
+                                                                                 CallSiteProfile::dumpCounterOffset(i),
+                                                                                 &slot_off));
+            pm.patch_slots.push_back({ "dyn_magic!counters", counter_off + slot_off });
+        }
 
-        tramp_file_off.push_back(rel_jmp_info(full_compiled_code.size(), trash_code.size() + fake_jmp.size(),
+        tramp_file_off.push_back(rel_jmp_info(layout.offset(i), counter_size + trash_codes[i].size() + fake_jmp.size(),
                                               off, inst_addr + rva + 4));
 
-        full_compiled_code.append(trash_code);
+        full_compiled_code.append(trash_codes[i]);
         full_compiled_code.append(fake_jmp);
     }
 
-    Elf64_Addr nva;
-    Elf64_Off file_off;
+    if (full_compiled_code.isEmpty())
+        return ErrorCode::Success;
 
-    // TODO: change only_x value
-    if (!elf->extend_segment(full_compiled_code, false, nva, file_off))
+    // jumps are patched in one edit session, together with adding the code and the counters pointer
+    if (!elf->begin_edit())
         return ErrorCode::SegmentExtensionFailed;
 
+    // TODO: change only_x value
+    int payload_id = elf->queue_payload(full_compiled_code, false, layout.alignment());
+    int counters_id = profile_build ? elf->queue_data(sizeof(Elf64_Addr), sizeof(Elf64_Addr)) : -1;
+
+    ec = payload_id < 0 || (profile_build && counters_id < 0) ? ErrorCode::SegmentExtensionFailed : ErrorCode::Success;
+
     foreach (auto fo_addr, tramp_file_off) {
-        // 5 - size of call instruction (minus 1 byte for call byte)
-        if (!elf->set_relative_address(fo_addr.fdata_off,
-                                       nva + fo_addr.ndata_off - (text_data.second + fo_addr.fdata_off - base_off) - 4))
-            return ErrorCode::SetRelativeAddressFailed;
-        /*
-        qDebug() << "jumping on : " << QString("0x%1").arg(text_data.second + fo_addr.fdata_off - base_off - 1, 0, 16)
-                 << "to: " << QString("0x%1").arg(nva + fo_addr.ndata_off, 0, 16);
-        */
+        if (ec != ErrorCode::Success)
+            break;
+
+        // call site jumps to the stub, the stub ends with a jump to the original call target
+        if (!elf->queue_relative_patch(fo_addr.fdata_off, text_data.second + fo_addr.fdata_off - base_off,
+                                       payload_id, fo_addr.ndata_off) ||
+                !elf->queue_relative_patch(payload_id, fo_addr.ndata_off + fo_addr.ndata_size - 4, fo_addr.data_vaddr))
+            ec = ErrorCode::SetRelativeAddressFailed;
+    }
+
+    QList<QPair<Elf64_Addr, Elf64_Off> > placement;
+    if (ec == ErrorCode::Success && !elf->commit_edit(placement))
+        ec = ErrorCode::SegmentExtensionFailed;
+
+    Elf64_Addr nva = 0;
+    if (ec == ErrorCode::Success) {
+        nva = placement[payload_id].first;
+        ec = fill_patch_slots(pm, nva, placement[payload_id].second, 0,
+                              profile_build ? placement[counters_id].first : 0);
+    }
+
+    // jumps in .text were changed, checksums of earlier secure() calls have to follow
+    if (ec == ErrorCode::Success)
+        ec = fill_checksum_slots();
+
+    if (ec == ErrorCode::Success && profile_build && !CallSiteProfile::createDump(dump_path, selected_sites))
+        ec = ErrorCode::ProfileDumpFailed;
+
+    if (ec != ErrorCode::Success) {
+        elf->rollback_edit();
+        return ec;
+    }
+
+    elf->end_edit();
+
+    foreach (auto fo_addr, tramp_file_off)
         LOG_MSG(QString("Jumping on: 0x%1 to: 0x%2").arg(text_data.second + fo_addr.fdata_off - base_off - 1, 0, 16).arg(
                                                          nva + fo_addr.ndata_off, 0, 16));
 
-        // set new relative address for jmp
-        if (!elf->set_relative_address(file_off + (fo_addr.ndata_off + fo_addr.ndata_size) - 4,
-                                       fo_addr.data_vaddr - (nva + ((fo_addr.ndata_off + fo_addr.ndata_size) - fake_jmp.size())) - 5))
-            return ErrorCode::SetRelativeAddressFailed;
-    }
+    // executed part of the trash code: jump over the trash and jump back
+    DAddingMethods<RegistersType>::profile.report("Obfuscation", selected_sites, 2);
+    layout.report("Obfuscation", nva);
 
     return ErrorCode::Success;
 }
@@ -400,26 +535,217 @@ ELFAddingMethods<RegistersType>::safe_obfuscate(uint8_t code_cover, uint8_t min_
 template <typename RegistersType>
 bool
 ELFAddingMethods<RegistersType>::secure(const QList<typename DAddingMethods<RegistersType>::InjectDescription*> &inject_desc) {
-    ErrorCode ec;
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if (!elf || !elf->begin_edit()) {
+        LOG_ERROR(error_desc[elf ? ErrorCode::InvalidElfFile : ErrorCode::BinaryFileNoElf]);
+        return false;
+    }
+
+    QList<pending_method> pending;
+    ErrorCode ec = ErrorCode::Success;
+    int checksum_slots_count = checksum_slots.size();
+
+    // all thread checks are run by one scheduler thread, added in place of the first of them
+    QList<typename DAddingMethods<RegistersType>::InjectDescription*> thread_checks;
+    foreach(typename DAddingMethods<RegistersType>::InjectDescription* id, inject_desc)
+        if (id && id->cm == DAddingMethods<RegistersType>::CallingMethod::Thread)
+            thread_checks.push_back(id);
+
+    bool scheduler_added = false;
+
     foreach(typename DAddingMethods<RegistersType>::InjectDescription* id, inject_desc) {
-        ec = secure_one(id);
-        if(ec != ErrorCode::Success) {
-            LOG_ERROR(error_desc[ec]);
-            return false;
+        if (id && id->cm == DAddingMethods<RegistersType>::CallingMethod::Thread) {
+            if (scheduler_added)
+                continue;
+            scheduler_added = true;
         }
+
+        // methods which change the same place in file have to see each other's changes
+        bool conflict = false;
+        foreach (const pending_method &p, pending)
+            conflict |= id && edit_conflict(p.cm, id->cm);
+
+        if (conflict) {
+            ec = flush_pending(pending);
+            if (ec != ErrorCode::Success)
+                break;
+        }
+
+        pending_method pm;
+        ec = prepare_one(id, pm, thread_checks);
+        if (ec != ErrorCode::Success)
+            break;
+        pending.push_back(pm);
+    }
+
+    if (ec == ErrorCode::Success)
+        ec = flush_pending(pending);
+
+    // .text does not change any more in this call
+    if (ec == ErrorCode::Success)
+        ec = fill_checksum_slots();
+
+    if (ec != ErrorCode::Success) {
+        elf->rollback_edit();
+        checksum_slots = checksum_slots.mid(0, checksum_slots_count);
+        LOG_ERROR(error_desc[ec]);
+        return false;
     }
+
+    elf->end_edit();
     return true;
 }
 template bool ELFAddingMethods<Registers_x86>::secure(const QList<DAddingMethods<Registers_x86>::InjectDescription *> &inject_desc);
 template bool ELFAddingMethods<Registers_x64>::secure(const QList<DAddingMethods<Registers_x64>::InjectDescription *> &inject_desc);
 
+template <typename RegistersType>
+bool
+ELFAddingMethods<RegistersType>::edit_conflict(typename DAddingMethods<RegistersType>::CallingMethod a,
+                                               typename DAddingMethods<RegistersType>::CallingMethod b) {
+    typedef typename DAddingMethods<RegistersType>::CallingMethod cm_t;
+
+    // both change entry point
+    if ((a == cm_t::OEP || a == cm_t::Thread) && (b == cm_t::OEP || b == cm_t::Thread))
+        return true;
+
+    // both change the same section or the same call sites
+    return a == b;
+}
+
+template <typename RegistersType>
+typename ELFAddingMethods<RegistersType>::ErrorCode
+ELFAddingMethods<RegistersType>::flush_pending(QList<pending_method> &pending) {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if (!elf)
+        return ErrorCode::BinaryFileNoElf;
+
+    QList<QPair<Elf64_Addr, Elf64_Off> > placement;
+    if (!elf->commit_edit(placement))
+        return ErrorCode::SegmentExtensionFailed;
+
+    ErrorCode ec;
+    foreach (const pending_method &pm, pending) {
+        ec = finish_one(pm, placement[pm.payload_id].first, placement[pm.payload_id].second,
+                        pm.data_id < 0 ? 0 : placement[pm.data_id].first,
+                        pm.counters_id < 0 ? 0 : placement[pm.counters_id].first);
+        if (ec != ErrorCode::Success)
+            return ec;
+    }
+
+    pending.clear();
+    return ErrorCode::Success;
+}
+
+template <typename RegistersType>
+void
+ELFAddingMethods<RegistersType>::rate_limit_gen_code(TrampolineWrapper<RegistersType> *trmwrapper, QString &code) {
+    code.clear();
+
+    uint32_t calls = trmwrapper->tramp_action->rate_calls;
+    uint64_t cycles = trmwrapper->tramp_action->rate_cycles;
+    if (!calls && !cycles) {
+        calls = trmwrapper->rate_calls;
+        cycles = trmwrapper->rate_cycles;
+    }
+
+    // check on every call needs no limiter
+    if (calls == 1 || (!calls && !cycles))
+        return;
+
+    if (trmwrapper->rate_limit_code.isEmpty()) {
+        LOG_WARN("Rate limit requested, but trampoline wrapper has no rate limiter code.");
+        return;
+    }
+
+    // 0 turns off the limit of the given kind
+    code = QString(trmwrapper->rate_limit_code);
+    fill_params(code, {
+                    { "dcalls",     QString::number(calls)                      },
+                    { "dcycles",    QString::number(cycles)                     },
+                    { "dcycles_lo", QString::number(cycles & 0xffffffff)        },
+                    { "dcycles_hi", QString::number(cycles >> 32)               }
+                });
+
+    LOG_MSG(QString("Trampoline check rate limit: every %1 calls or every %2 cycles, whichever comes first")
+            .arg(calls ? QString::number(calls) : QString("-")).arg(cycles ? QString::number(cycles) : QString("-")));
+}
+
+template <typename RegistersType>
+typename ELFAddingMethods<RegistersType>::ErrorCode
+ELFAddingMethods<RegistersType>::thread_checks_gen_code(const QList<typename DAddingMethods<RegistersType>::InjectDescription*> &thread_checks,
+                                                        QString &code, QString &timers, uint32_t &count) {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if(!elf)
+        return ErrorCode::BinaryFileNoElf;
+
+    QStringList scheduled;
+    ErrorCode ec;
+
+    count = 0;
+
+    foreach (typename DAddingMethods<RegistersType>::InjectDescription *id, thread_checks) {
+        ThreadWrapper<RegistersType> *twrapper =
+                dynamic_cast<ThreadWrapper<RegistersType>*>(id->adding_method);
+        if (!twrapper || twrapper->thread_actions.isEmpty() || !twrapper->thread_actions[0] || !twrapper->detect_handler)
+            return ErrorCode::NullWrapper;
+
+        if (twrapper->check_code.isEmpty())
+            return ErrorCode::WrapperGenCodeFailed;
+
+        Wrapper<RegistersType> *action = twrapper->thread_actions[0];
+
+        // labels of the same method would be defined twice in scheduler code
+        if (scheduled.contains(action->name)) {
+            LOG_WARN(QString("Thread check %1 is already scheduled, skipping.").arg(action->name));
+            continue;
+        }
+        scheduled.push_back(action->name);
+
+        // timers layout is described in multi.asm
+        QString check(twrapper->check_code);
+        QMap<QString, QString> params = {
+            { "did",    QString::number(count) },
+            { "dtimer", QString::number(16 + 16 * count) },
+            { placeholder_mnm[PlaceholderMnemonics::DDRET], elf->is_x86() ?
+              AsmCodeGenerator::get_reg<Registers_x86>(static_cast<Registers_x86>(action->ret)) :
+              AsmCodeGenerator::get_reg<Registers_x64>(static_cast<Registers_x64>(action->ret)) }
+        };
+        fill_params(check, params);
+
+        QString code_method, code_handler;
+
+        ec = wrapper_gen_code(action, code_method);
+        if (ec != ErrorCode::Success)
+            return ec;
+        ec = wrapper_gen_code(twrapper->detect_handler, code_handler);
+        if (ec != ErrorCode::Success)
+            return ec;
+
+        fill_placeholders(check, code_handler, PlaceholderMnemonics::DDETECTIONHANDLER);
+        fill_placeholders(check, code_method, PlaceholderMnemonics::DDETECTIONMETHOD);
+        code.append(check);
+
+        // interval grows twice with each check that detected nothing, up to max;
+        // a check's own description takes precedence over the thread wrapper
+        uint16_t sleep_time = action->sleep_time ? action->sleep_time : twrapper->sleep_time;
+        uint16_t max_sleep_time = action->sleep_time ? action->max_sleep_time : twrapper->max_sleep_time;
+        uint16_t interval = std::max<uint16_t>(sleep_time, 1);
+        timers.append(QString("dd %1, %2\n").arg(interval).arg(std::max(max_sleep_time, interval)));
+        ++count;
+    }
+
+    return ErrorCode::Success;
+}
+
 template <typename RegistersType>
 typename ELFAddingMethods<RegistersType>::ErrorCode
-ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersType>::InjectDescription *i_desc) {
+ELFAddingMethods<RegistersType>::prepare_one(typename DAddingMethods<RegistersType>::InjectDescription *i_desc,
+                                             pending_method &pm,
+                                             const QList<typename DAddingMethods<RegistersType>::InjectDescription*> &thread_checks) {
     QString code2compile,
             code_ddetect_handler,
             code_ddetect;
-    QByteArray compiled_code;
+    DCodeObject compiled_object;
     ErrorCode ec;
 
     ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
@@ -456,8 +782,27 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
 
     i_desc->adding_method->ret = RegistersType::None;
 
+    // trampoline sites are chosen first, the code has to preserve only registers live at their targets
+    QList<QPair<Elf64_Addr, Elf64_Addr> > tramp_file_off;
+    Elf64_Addr base_off = 0;
+    QPair<QByteArray, Elf64_Addr> text_data;
+    LivenessAnalyzer::Result live = LivenessAnalyzer::allLive();
+    bool trampoline = i_desc->cm == DAddingMethods<RegistersType>::CallingMethod::Trampoline;
+
+    if (trampoline) {
+        ec = select_trampoline_sites(tramp_file_off, base_off, text_data, live);
+        if (ec != ErrorCode::Success)
+            return ec;
+
+        if (!tramp_file_off.size())
+            return ErrorCode::TrampolineAddressAbsence;
+
+        LOG_MSG(QString("Trampolines: %1, live registers mask: 0x%2, flags: %3").arg(tramp_file_off.size())
+                .arg(live.regs, 0, 16).arg(live.flags ? "saved" : "dead"));
+    }
+
     // 0. take code from input
-    ec = wrapper_gen_code(i_desc->adding_method, code2compile);
+    ec = wrapper_gen_code(i_desc->adding_method, code2compile, trampoline ? &live : nullptr);
     if (ec != ErrorCode::Success)
         return ec;
 
@@ -466,8 +811,7 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
     if (ec != ErrorCode::Success)
         return ec;
 
-    bool dyn_magic = false;
-    static QString dynmagic_offset("dyn_magic!offset");
+    QString code_rate_limit;
 
     // 2. generate code for debugger detection method
     switch (i_desc->cm) {
@@ -476,29 +820,21 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
                 dynamic_cast<OEPWrapper<RegistersType>*>(i_desc->adding_method);
         if (!oepwrapper)
             return ErrorCode::NullWrapper;
-        ec = fill_magic_params(oepwrapper->oep_action->static_params, elf);
-        if (ec != ErrorCode::Success)
-            return ec;
         ec = wrapper_gen_code(oepwrapper->oep_action, code_ddetect);
         if (ec != ErrorCode::Success)
             return ec;
-        if (oepwrapper->oep_action->static_params.contains(dynmagic_offset))
-            dyn_magic = true;
         break;
     }
     case DAddingMethods<RegistersType>::CallingMethod::Thread: {
-        ThreadWrapper<RegistersType> *twrapper =
-                dynamic_cast<ThreadWrapper<RegistersType>*>(i_desc->adding_method);
-        if (!twrapper)
-            return ErrorCode::NullWrapper;
-        ec = fill_magic_params(twrapper->thread_actions[0]->static_params, elf);
+        QString code_timers;
+        uint32_t count = 0;
+        ec = thread_checks_gen_code(thread_checks, code_ddetect, code_timers, count);
         if (ec != ErrorCode::Success)
             return ec;
-        ec = wrapper_gen_code(twrapper->thread_actions[0], code_ddetect);
-        if (ec != ErrorCode::Success)
-            return ec;
-        if (twrapper->thread_actions[0]->static_params.contains(dynmagic_offset))
-            dyn_magic = true;
+        fill_placeholders(code2compile, code_timers, PlaceholderMnemonics::DTIMERS);
+        fill_params(code2compile, { { "dcount", QString::number(count) } });
+
+        LOG_MSG(QString("Thread checks: %1, run by one scheduler thread").arg(count));
         break;
     }
     case DAddingMethods<RegistersType>::CallingMethod::Trampoline:
@@ -509,14 +845,13 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
                 dynamic_cast<TrampolineWrapper<RegistersType>*>(i_desc->adding_method);
         if (!trmwrapper)
             return ErrorCode::NullWrapper;
-        ec = fill_magic_params(trmwrapper->tramp_action->static_params, elf);
-        if (ec != ErrorCode::Success)
-            return ec;\
         ec = wrapper_gen_code(trmwrapper->tramp_action, code_ddetect);
         if (ec != ErrorCode::Success)
             return ec;
-        if (trmwrapper->tramp_action->static_params.contains(dynmagic_offset))
-            dyn_magic = true;
+
+        // init routines run once, only trampolines are worth limiting
+        if (trampoline)
+            rate_limit_gen_code(trmwrapper, code_rate_limit);
         break;
     }
 
@@ -525,6 +860,7 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
     }
 
     // 3. merge code
+    fill_placeholders(code2compile, code_rate_limit, PlaceholderMnemonics::DRATELIMIT);
     fill_placeholders(code2compile, code_ddetect_handler, PlaceholderMnemonics::DDETECTIONHANDLER);
     fill_placeholders(code2compile, code_ddetect, PlaceholderMnemonics::DDETECTIONMETHOD);
 
@@ -532,66 +868,51 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
     if (!elf->get_entry_point(oldep))
         return ErrorCode::GetEntryPointFailed;
 
-    // 4. compile code
-    ec = compile(code2compile, compiled_code);
+    // 4. compile code, values known after the file edit session are left in patch slots
+    ec = compile(code2compile, compiled_object);
     if (ec != ErrorCode::Success)
         return ec;
 
-    // 5. secure elf file
+    // 5. queue code in file edit session
+    typedef DCodeEmitter<RegistersType> Emitter;
+    Emitter emitter;
 
-    Elf64_Addr nva;
-    Elf64_Off file_off;
-    // TODO: change
-    static QByteArray fake_jmp("\xe9\xde\xad\xbe\xef", 5);
+    // jump back to original code is emitted to an external label, its target is patched during commit
+    typename Emitter::Label back = emitter.newLabel();
+    typename Emitter::Label copy_add = emitter.newLabel();
+    typename Emitter::Label mprotect_add = emitter.newLabel();
 
-    switch(i_desc->cm) {
-    case DAddingMethods<RegistersType>::CallingMethod::Thread:
-    case DAddingMethods<RegistersType>::CallingMethod::OEP: {
-        Elf64_Addr oep;
-        // add fake relative jump to the code and repair it after
-        compiled_code.append(fake_jmp);
+    emitter.append(compiled_object.getCode());
 
-        if (!elf->extend_segment(compiled_code, i_desc->change_x_only, nva, file_off))
-            return ErrorCode::SegmentExtensionFailed;
-
-        if (!elf->set_entry_point(nva, &oep))
-            return ErrorCode::SetEntryPointFailed;
+    pm.cm = i_desc->cm;
 
-        // set new relative address for jmp
-        if (!elf->set_relative_address(file_off + compiled_code.size() - 4, oep - (nva + (compiled_code.size() - fake_jmp.size())) - 5))
-            return ErrorCode::SetRelativeAddressFailed;
+    // rate limiter state: dd calls left, dd 0, dq time stamp counter of last check
+    if (!code_rate_limit.isEmpty()) {
+        pm.data_id = elf->queue_data(16, 8);
+        if (pm.data_id < 0)
+            return ErrorCode::SegmentExtensionFailed;
+    }
 
-        if (dyn_magic) {
-            QPair<QByteArray, Elf64_Addr> text_data;
-            if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
-                return ErrorCode::GetSectionContentFailed;
-
-            int j = 0;
-            while ((j = compiled_code.indexOf("\xba\xda\xda\xba", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-                    return ErrorCode::SetRelativeAddressFailed;
-
-            static uint32_t code_cheksum_magic = 0x1ee74b1d;
-            j = 0;
-            uint32_t checksum = 0;
-            foreach (unsigned char b, text_data.first)
-                checksum += b;
-            while ((j = compiled_code.indexOf("\x1d\x4b\xe7\x1e", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, checksum))
-                    return ErrorCode::SetRelativeAddressFailed;
-        }
+    Elf64_Addr back_jmp_addr = 0;
 
-        LOG_MSG(QString("New entry point: 0x%1").arg(nva, 0, 16));
+    switch(i_desc->cm) {
+    case DAddingMethods<RegistersType>::CallingMethod::Thread:
+    case DAddingMethods<RegistersType>::CallingMethod::OEP: {
+        emitter.jmp(back);
+        back_jmp_addr = oldep;
         break;
     }
+    case DAddingMethods<RegistersType>::CallingMethod::INIT_ARRAY:
     case DAddingMethods<RegistersType>::CallingMethod::CTORS: {
-        QPair<QByteArray, Elf64_Addr> section_data;
-        if (!elf->get_section_content(ELF::SectionType::CTORS, section_data))
+        ELF::SectionType sec_type = i_desc->cm == DAddingMethods<RegistersType>::CallingMethod::CTORS ?
+                    ELF::SectionType::CTORS : ELF::SectionType::INIT_ARRAY;
+
+        if (!elf->get_section_content(sec_type, pm.section_data))
             return ErrorCode::GetSectionContentFailed;
 
         QList<Elf64_Addr> addresses;
         uint8_t addr_size = elf->is_x86() ? sizeof(Elf32_Addr) : sizeof(Elf64_Addr);
-        ec = get_addresses(section_data.first, addr_size, addresses, { 0 });
+        ec = get_addresses(pm.section_data.first, addr_size, addresses, { 0 });
         if (ec != ErrorCode::Success)
             return ec;
 
@@ -602,48 +923,12 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
         // TODO: address should be randomized, not always 0
         int idx = 0;
 
-        compiled_code.append(fake_jmp);
-
-        if (!elf->extend_segment(compiled_code, i_desc->change_x_only, nva, file_off))
-            return ErrorCode::SegmentExtensionFailed;
-
-        // set new relative address for jmp
-        if (!elf->set_relative_address(file_off + compiled_code.size() - 4,
-                                       addresses[idx] - (nva + (compiled_code.size() - fake_jmp.size())) - 5))
-            return ErrorCode::SetRelativeAddressFailed;
-
-        // set section content, set filler for elf function
-        section_data.first.replace(idx * addr_size, addr_size, QByteArray(reinterpret_cast<const char *>(&nva), addr_size));
-
-        if (!elf->set_section_content(ELF::SectionType::CTORS, section_data.first))
-            return ErrorCode::SetSectionContentFailed;
-
-        if (dyn_magic) {
-            QPair<QByteArray, Elf64_Addr> text_data;
-            if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
-                return ErrorCode::GetSectionContentFailed;
-
-            int j = 0;
-            while ((j = compiled_code.indexOf("\xba\xda\xda\xba", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-                    return ErrorCode::SetRelativeAddressFailed;
-
-            static uint32_t code_cheksum_magic = 0x1ee74b1d;
-            j = 0;
-            uint32_t checksum = 0;
-            foreach (unsigned char b, text_data.first)
-                checksum += b;
-            while ((j = compiled_code.indexOf("\x1d\x4b\xe7\x1e", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, checksum))
-                    return ErrorCode::SetRelativeAddressFailed;
-        }
-
-        LOG_MSG(QString("Data added at: 0x%1").arg(nva, 0, 16));
-
+        emitter.jmp(back);
+        back_jmp_addr = addresses[idx];
         break;
     }
     case DAddingMethods<RegistersType>::CallingMethod::INIT: {
-        QPair<QByteArray, Elf64_Addr> section_data;
+        QPair<QByteArray, Elf64_Addr> &section_data = pm.section_data;
         if (!elf->get_section_content(ELF::SectionType::INIT, section_data))
             return ErrorCode::GetSectionContentFailed;
 
@@ -665,31 +950,30 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
         // restore old memory protection
         // jmp to init code
 
-        // compiled_code = debugger detection + jmp to copy routine
+        // first eight registers have the same positions in Registers_x86 and Registers_x64
+        auto reg = [](Registers_x86 r) { return static_cast<RegistersType>(static_cast<int>(r)); };
+        typename Emitter::Label init_end = emitter.newLabel();
+        typename Emitter::Label copy_base = emitter.newLabel();
+        typename Emitter::Label mprotect_base = emitter.newLabel();
+
         // TODO: save flags here, shitiest solution ever
-        compiled_code.append('\x9c'); // pushf | pushfq
-        compiled_code.append(CodeDefines<RegistersType>::saveAll());
+        emitter.pushFlags();
+        emitter.append(CodeDefines<RegistersType>::saveAll());
 
-        // TODO: should be redone
         // store init data address on stack
-        compiled_code.append(CodeDefines<Registers_x86>::callRelative(section_data.first.size()));
-
-        // compiled_code = debugger detection + jmp to copy routine + previous init
-        compiled_code.append(section_data.first);
-
-        compiled_code.append(CodeDefines<Registers_x86>::restoreRegister(Registers_x86::ESI));
-        // TODO: change
-        compiled_code.append("\xe8\x00\x00\x00\x00", 5); // call $+5
-        compiled_code.append(CodeDefines<Registers_x86>::restoreRegister(Registers_x86::EDI)); // pop (e|r)di
+        emitter.call(init_end);
+        emitter.append(section_data.first);
+        emitter.bind(init_end);
+        emitter.pop(reg(Registers_x86::ESI));
 
-        Elf64_Off offset_to_get_init_section_code_addr_copy = compiled_code.size();
+        // (e|r)di <--- address of current instruction, moved to init section during commit
+        emitter.call(copy_base);
+        emitter.bind(copy_base);
+        emitter.pop(reg(Registers_x86::EDI));
+        emitter.bind(copy_add);
+        emitter.addRegImm32(reg(Registers_x86::EDI), 0);
 
-        static QByteArray fake_add_edi("\x81\xc7\x00\x00\x00\x00", 6);
-        static QByteArray fake_add_rdi("\x48\x81\xc7\x00\x00\x00\x00", 7);
-
-        compiled_code.append(elf->is_x86() ? fake_add_edi : fake_add_rdi); // sub (e|r)di, 0
-
-        compiled_code.append(CodeDefines<RegistersType>::saveAll());
+        emitter.append(CodeDefines<RegistersType>::saveAll());
 
         // ========
         // mprotect
@@ -698,287 +982,254 @@ ELFAddingMethods<RegistersType>::secure_one(typename DAddingMethods<RegistersTyp
         int init_size = section_data.first.size();
         unsigned int prot_flags_w = prot_flags | PF_W;
 
-        compiled_code.append(QByteArray(1, '\xba') + QByteArray(reinterpret_cast<const char*>(&prot_flags_w),
-                                                                sizeof(unsigned int))); // mov (e|r)dx, flags
-        compiled_code.append("\x31\xc0"); // xor eax, eax
-
-        if (elf->is_x86())
-            compiled_code.append(QByteArray(1, '\xb8') + QByteArray(reinterpret_cast<const char*>(&align),
-                                                                    sizeof(uint32_t))); // mov eax, page_align
-        else
-            compiled_code.append(QByteArray("\x48\xb8", 2) + QByteArray(reinterpret_cast<const char*>(&align),
-                                                                        sizeof(uint64_t))); // mov rax, page_align
-
-        compiled_code.append(elf->is_x86() ? QByteArray("\xff\xc8", 2) : QByteArray("\x48\xff\xc8", 3)); // dec (e|r)ax
-        compiled_code.append(elf->is_x86() ? QByteArray("\xF7\xD0", 2) : QByteArray("\x48\xF7\xD0", 3)); // not (e|r)ax
-
-        compiled_code.append("\xe8\x00\x00\x00\x00", 5); // call $+5
-        compiled_code.append(CodeDefines<Registers_x86>::restoreRegister(Registers_x86::EDI)); // pop (e|r)di <--- address of current instruction
+        emitter.movRegImm(reg(Registers_x86::EDX), prot_flags_w);
 
-        Elf64_Off offset_to_get_init_section_code_addr_mprotect = compiled_code.size();
+        // (e|r)ax <--- page mask
+        emitter.movRegImm(reg(Registers_x86::EAX), align);
+        emitter.decReg(reg(Registers_x86::EAX));
+        emitter.notReg(reg(Registers_x86::EAX));
 
-        compiled_code.append(elf->is_x86() ? fake_add_edi : fake_add_rdi); // sub (e|r)di, 0
+        emitter.call(mprotect_base);
+        emitter.bind(mprotect_base);
+        emitter.pop(reg(Registers_x86::EDI));
+        emitter.bind(mprotect_add);
+        emitter.addRegImm32(reg(Registers_x86::EDI), 0);
 
         // round page
-        compiled_code.append(elf->is_x86() ? QByteArray("\x89\xFB", 2) :
-                                             QByteArray("\x48\x89\xFB", 3)); // mov (e|r)bx, (e|r)di
-
-        compiled_code.append(elf->is_x86() ? QByteArray("\x21\xc7", 2) :
-                                             QByteArray("\x48\x21\xc7", 3)); // and (e|r)di, (r|e)ax
-
-        compiled_code.append(elf->is_x86() ? QByteArray("\x29\xFB", 2) :
-                                             QByteArray("\x48\x29\xFB", 3)); // sub bx, di <----- bx size of page
-
-        compiled_code.append(QByteArray("\x81\xc3", 2) +
-                             QByteArray(reinterpret_cast<const char*>(&init_size), sizeof(int))); // mov ebx, init_size
+        emitter.opRegReg(Emitter::Operation::Mov, reg(Registers_x86::EBX), reg(Registers_x86::EDI));
+        emitter.opRegReg(Emitter::Operation::And, reg(Registers_x86::EDI), reg(Registers_x86::EAX));
+        emitter.opRegReg(Emitter::Operation::Sub, reg(Registers_x86::EBX), reg(Registers_x86::EDI));
+        emitter.addRegImm32(reg(Registers_x86::EBX), init_size);
 
         // dx <--- flags
         // bx <--- memory size
         // di <--- page_vaddr
 
-        compiled_code.append(elf->is_x86() ? QByteArray("\xB8\x7D\x00\x00\x00", 5) :
-                                             QByteArray("\xB8\x0A\x00\x00\x00", 5)); // mov eax, syscall_num
+        emitter.movRegImm(reg(Registers_x86::EAX), elf->is_x86() ? 0x7d : 0x0a); // syscall_num
 
         if (elf->is_x86()) {
-            compiled_code.append(QByteArray("\x89\xD9", 2)); // mov ecx, ebx
-            compiled_code.append(QByteArray("\x89\xFB", 2)); // mov ebx, edi
+            emitter.opRegReg(Emitter::Operation::Mov, reg(Registers_x86::ECX), reg(Registers_x86::EBX));
+            emitter.opRegReg(Emitter::Operation::Mov, reg(Registers_x86::EBX), reg(Registers_x86::EDI));
         }
         else {
-            compiled_code.append(QByteArray("\x48\x89\xDE", 3)); // mov rsi, rdx
+            emitter.opRegReg(Emitter::Operation::Mov, reg(Registers_x86::ESI), reg(Registers_x86::EBX));
         }
 
-        compiled_code.append(elf->is_x86() ? QByteArray("\xCD\x80") : QByteArray("\x0F\x05", 2)); // syscall
+        emitter.syscall();
 
-        compiled_code.append(CodeDefines<RegistersType>::restoreAll());
-
-
-        // save all registers now before using an mprotect
-
-        // mov ecx, init_section_len , don't use rcx cause
-        // TODO: probably should xor rax, rax
-        compiled_code.append("\x31\xc9"); // xor eax, eax
-        compiled_code.append(QByteArray(1, '\xb9') +
-                             QByteArray(reinterpret_cast<const char*>(&init_size), sizeof(int)));
+        emitter.append(CodeDefines<RegistersType>::restoreAll());
 
         // make a copy to init section
-        // rep movsb
-        compiled_code.append("\xf3\xa4", 2);
+        emitter.movRegImm(reg(Registers_x86::ECX), init_size);
+        emitter.repMovsb();
 
         // ===========================================
         // TODO: call mprotect here for READ ^ EXECUTE
-        // TODO: restore flags here
         // ===========================================
 
         // restore regs
-        // TODO: save flags here, shitiest solution ever
-        compiled_code.append(CodeDefines<RegistersType>::restoreAll());
-        compiled_code.append('\x9d'); // popf | popfq
+        emitter.append(CodeDefines<RegistersType>::restoreAll());
+        emitter.popFlags();
 
         // jmp to init
-        static QByteArray fake_jmp("\xe9\xde\xad\xbe\xef", 5);
-        compiled_code.append(fake_jmp);
-
-        if (!elf->extend_segment(compiled_code, i_desc->change_x_only, nva, file_off))
-            return ErrorCode::SegmentExtensionFailed;
-
-        // set up dummy values
-
-        // 4 jmp to init
-        if (!elf->set_relative_address(file_off + compiled_code.size() - 4,
-                                       section_data.second - (nva + compiled_code.size() - fake_jmp.size()) - 5))
-            return ErrorCode::SetRelativeAddressFailed;
-
-        // 4 string copy destinationaddress
-        if (!elf->set_relative_address(file_off + offset_to_get_init_section_code_addr_copy + (elf->is_x86() ? 2 : 3),
-                                       section_data.second - (nva + offset_to_get_init_section_code_addr_copy - 1)))
-            return ErrorCode::SetRelativeAddressFailed;
-
-        // 4 mprotect page vaddr
-        if (!elf->set_relative_address(file_off + offset_to_get_init_section_code_addr_mprotect + (elf->is_x86() ? 2 : 3),
-                                       section_data.second - (nva + offset_to_get_init_section_code_addr_mprotect - 1)))
-            return ErrorCode::SetRelativeAddressFailed;
-
-        // set redirection from init sectin to our code
-        Elf32_Addr redirect_off = nva - section_data.second - 5;
-        QByteArray compiled_jmp((QByteArray(1, '\xe9') + QByteArray(reinterpret_cast<const char*>(&redirect_off), sizeof(Elf32_Addr))));
+        emitter.jmp(back);
+        back_jmp_addr = section_data.second;
+        break;
+    }
+    case DAddingMethods<RegistersType>::CallingMethod::Trampoline: {
+        // look for jmp's and call's in code
+        // get virtual address in code of such instruction and calculate address
+        // case 'call': add code that performs debug check + call to previous code using push : ret
+        // case 'jmp' : add code that performs debug check + call to previous code
 
+        // every trampoline is a copy of the same code ended with a jump back to its call site
+        emitter.jmp(back);
+        if (!emitter.finish())
+            return ErrorCode::WrapperGenCodeFailed;
 
-        if (!elf->set_section_content(ELF::SectionType::INIT, compiled_jmp, '\x90'))
-            return ErrorCode::SetSectionContentFailed;
+        const QByteArray &tramp_code = emitter.getCode();
 
-        if (dyn_magic) {
-            QPair<QByteArray, Elf64_Addr> text_data;
-            if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
-                return ErrorCode::GetSectionContentFailed;
-
-            int j = 0;
-            while ((j = compiled_code.indexOf("\xba\xda\xda\xba", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-                    return ErrorCode::SetRelativeAddressFailed;
-
-            static uint32_t code_cheksum_magic = 0x1ee74b1d;
-            j = 0;
-            uint32_t checksum = 0;
-            foreach (unsigned char b, text_data.first)
-                checksum += b;
-            while ((j = compiled_code.indexOf("\x1d\x4b\xe7\x1e", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, checksum))
-                    return ErrorCode::SetRelativeAddressFailed;
+        // sites were selected before code generation
+        // profiling build: counters mapping routine goes first, each trampoline counts its executions
+        bool profile_build = !DAddingMethods<RegistersType>::profile_build.isEmpty();
+        QString dump_path;
+        QByteArray full_compiled_code;
+        uint32_t slot_off = 0;
+
+        if (profile_build) {
+            dump_path = profile_dump_path("trampolines");
+            full_compiled_code = CodeDefines<RegistersType>::profileRuntime(dump_path,
+                                                                            CallSiteProfile::dumpMapSize(tramp_file_off.size()),
+                                                                            &slot_off);
+            pm.patch_slots.push_back({ "dyn_magic!counters", slot_off });
+
+            // pointer to the mapped counters
+            pm.counters_id = elf->queue_data(sizeof(Elf64_Addr), sizeof(Elf64_Addr));
+            if (pm.counters_id < 0)
+                return ErrorCode::SegmentExtensionFailed;
         }
 
+        // trampolines are placed in order of their call sites
+        uint32_t counter_size = profile_build ? CodeDefines<RegistersType>::profileCounter(0, 0).size() : 0;
+        uint32_t tramp_size = counter_size + tramp_code.size();
+        uint32_t back_jmp_off = counter_size + emitter.getFixups(back).first();
+        QList<uint64_t> sites;
 
-        LOG_MSG(QString("Data added at: 0x%1").arg(nva, 0, 16));
-
-        break;
-    }
-    case DAddingMethods<RegistersType>::CallingMethod::INIT_ARRAY: {
-        QPair<QByteArray, Elf64_Addr> section_data;
-        if (!elf->get_section_content(ELF::SectionType::INIT_ARRAY, section_data))
-            return ErrorCode::GetSectionContentFailed;
-
-        QList<Elf64_Addr> addresses;
-        uint8_t addr_size = elf->is_x86() ? sizeof(Elf32_Addr) : sizeof(Elf64_Addr);
-        ec = get_addresses(section_data.first, addr_size, addresses, { 0 });
-        if (ec != ErrorCode::Success)
-            return ec;
-
-        // no place to store our pointer
-        if (!addresses.size())
-            return ErrorCode::TrampolineAddressAbsence;
-
-        // TODO: address should be randomized, not always 0
-        int idx = 0;
+        foreach (auto fo_addr, tramp_file_off) {
+            sites.push_back(text_data.second + fo_addr.first - base_off - 1);
+            pm.layout.add(sites.last(), tramp_size);
+        }
 
-        compiled_code.append(fake_jmp);
+        pm.layout.arrange(full_compiled_code.size());
+        full_compiled_code.reserve(pm.layout.size());
+
+        foreach (int i, pm.layout.order()) {
+            full_compiled_code.append(CodeDefines<RegistersType>::nops(pm.layout.offset(i) - full_compiled_code.size()));
+            if (profile_build) {
+                uint32_t counter_off = full_compiled_code.size();
+                full_compiled_code.append(CodeDefines<RegistersType>::profileCounter(-full_compiled_code.size(),
+                                                                                     CallSiteProfile::dumpCounterOffset(i),
+                                                                                     &slot_off));
+                pm.patch_slots.push_back({ "dyn_magic!counters", counter_off + slot_off });
+            }
+
+            foreach (DCodeObject::Slot slot, compiled_object.getPatchSlots()) {
+                slot.offset += full_compiled_code.size();
+                pm.patch_slots.push_back(slot);
+            }
+
+            full_compiled_code.append(tramp_code);
+        }
 
-        if (!elf->extend_segment(compiled_code, i_desc->change_x_only, nva, file_off))
+        pm.code = full_compiled_code;
+        pm.payload_id = elf->queue_payload(pm.code, i_desc->change_x_only, pm.layout.alignment());
+        if (pm.payload_id < 0)
             return ErrorCode::SegmentExtensionFailed;
 
-        // set new relative address for jmp
-        if (!elf->set_relative_address(file_off + compiled_code.size() - 4,
-                                       addresses[idx] - (nva + (compiled_code.size() - fake_jmp.size())) - 5))
-            return ErrorCode::SetRelativeAddressFailed;
+        for (int i = 0; i < tramp_file_off.size(); ++i) {
+            const QPair<Elf64_Addr, Elf64_Addr> &fo_addr = tramp_file_off[i];
+            Elf64_Off tramp_off = pm.layout.offset(i);
 
-        // set section content, set filler for elf function
-        section_data.first.replace(idx * addr_size, addr_size, QByteArray(reinterpret_cast<const char *>(&nva), addr_size));
+            // 5 - size of call instruction (minus 1 byte for call byte)
+            if (!elf->queue_relative_patch(fo_addr.first, text_data.second + fo_addr.first - base_off,
+                                           pm.payload_id, tramp_off))
+                return ErrorCode::SetRelativeAddressFailed;
 
-        if (!elf->set_section_content(ELF::SectionType::INIT_ARRAY, section_data.first))
-            return ErrorCode::SetSectionContentFailed;
+            // set new relative address for jmp
+            if (!elf->queue_relative_patch(pm.payload_id, tramp_off + back_jmp_off, fo_addr.second))
+                return ErrorCode::SetRelativeAddressFailed;
 
-        if (dyn_magic) {
-            QPair<QByteArray, Elf64_Addr> text_data;
-            if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
-                return ErrorCode::GetSectionContentFailed;
-
-            int j = 0;
-            while ((j = compiled_code.indexOf("\xba\xda\xda\xba", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-                    return ErrorCode::SetRelativeAddressFailed;
-
-            static uint32_t code_cheksum_magic = 0x1ee74b1d;
-            j = 0;
-            uint32_t checksum = 0;
-            foreach (unsigned char b, text_data.first)
-                checksum += b;
-            while ((j = compiled_code.indexOf("\x1d\x4b\xe7\x1e", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, checksum))
-                    return ErrorCode::SetRelativeAddressFailed;
+            pm.jumps.push_back(QPair<Elf64_Addr, Elf64_Off>(sites[i], tramp_off));
         }
 
-        LOG_MSG(QString("Data added at: 0x%1").arg(nva, 0, 16));
+        // stub instructions and jump back, the detection method itself is not counted
+        DAddingMethods<RegistersType>::profile.report("Trampolines", sites,
+                                                      LengthDecoder(elf->is_x64()).count(compiled_object.getCode()) + 1);
 
-        break;
+        if (profile_build && !CallSiteProfile::createDump(dump_path, sites))
+            return ErrorCode::ProfileDumpFailed;
+
+        return ErrorCode::Success;
+    }
+    default:
+        return ErrorCode::InvalidAddingMethodType;
     }
-    case DAddingMethods<RegistersType>::CallingMethod::Trampoline: {
-        // look for jmp's and call's in code
-        // get virtual address in code of such instruction and calculate address
-        // case 'call': add code that performs debug check + call to previous code using push : ret
-        // case 'jmp' : add code that performs debug check + call to previous code
 
-        QList<Elf64_Addr> __file_off;
-        Elf64_Addr base_off;
-        QPair<QByteArray, Elf64_Addr> text_data;
-        QList<QPair<Elf64_Addr, Elf64_Addr> > tramp_file_off;
+    if (!emitter.finish())
+        return ErrorCode::WrapperGenCodeFailed;
 
-        ec = get_address_offsets_from_text_section(__file_off, base_off, text_data);
-        if (ec != ErrorCode::Success)
-            return ec;
+    // detection code is at the beginning of the payload, values filled during commit follow it
+    pm.code = emitter.getCode();
+    pm.patch_slots = compiled_object.getPatchSlots();
+    if (i_desc->cm == DAddingMethods<RegistersType>::CallingMethod::INIT) {
+        pm.copy_off = emitter.getOffset(copy_add);
+        pm.mprotect_off = emitter.getOffset(mprotect_add);
+    }
 
-        QByteArray full_compiled_code;
-        // TODO: choose randomy few addresses
-        int32_t rva;
-        Elf64_Addr inst_addr;
+    pm.payload_id = elf->queue_payload(pm.code, i_desc->change_x_only);
+    if (pm.payload_id < 0)
+        return ErrorCode::SegmentExtensionFailed;
 
-        // TODO: should be changed
-        std::uniform_int_distribution<int> prob(0, 99);
+    if (!elf->queue_relative_patch(pm.payload_id, emitter.getFixups(back).first(), back_jmp_addr))
+        return ErrorCode::SetRelativeAddressFailed;
 
-        foreach (Elf64_Addr off, __file_off) {
-            if(prob(DAddingMethods<RegistersType>::r_gen) >= tramp_code_cover)
-                continue;
+    return ErrorCode::Success;
+}
 
-            if (!elf->get_relative_address(off, rva))
-                return ErrorCode::GetRelativeAddressFailed;
+template <typename RegistersType>
+typename ELFAddingMethods<RegistersType>::ErrorCode
+ELFAddingMethods<RegistersType>::finish_one(const pending_method &pm, Elf64_Addr nva, Elf64_Off file_off,
+                                            Elf64_Addr data_va, Elf64_Addr counters_va) {
+    ELF *elf = dynamic_cast<ELF*>(DAddingMethods<RegistersType>::file);
+    if(!elf)
+        return ErrorCode::BinaryFileNoElf;
 
-            inst_addr = text_data.second + off - base_off;
-            tramp_file_off.push_back(QPair<Elf64_Addr, Elf64_Addr>(off, inst_addr + rva + 4));
-            full_compiled_code.append(compiled_code);
-            full_compiled_code.append(fake_jmp);
-        }
+    switch(pm.cm) {
+    case DAddingMethods<RegistersType>::CallingMethod::Thread:
+    case DAddingMethods<RegistersType>::CallingMethod::OEP: {
+        if (!elf->set_entry_point(nva))
+            return ErrorCode::SetEntryPointFailed;
 
-        Elf64_Addr nva;
-        if (!elf->extend_segment(full_compiled_code, i_desc->change_x_only, nva, file_off))
-            return ErrorCode::SegmentExtensionFailed;
+        LOG_MSG(QString("New entry point: 0x%1").arg(nva, 0, 16));
+        break;
+    }
+    case DAddingMethods<RegistersType>::CallingMethod::INIT_ARRAY:
+    case DAddingMethods<RegistersType>::CallingMethod::CTORS: {
+        ELF::SectionType sec_type = pm.cm == DAddingMethods<RegistersType>::CallingMethod::CTORS ?
+                    ELF::SectionType::CTORS : ELF::SectionType::INIT_ARRAY;
+        QByteArray section_data(pm.section_data.first);
+        uint8_t addr_size = elf->is_x86() ? sizeof(Elf32_Addr) : sizeof(Elf64_Addr);
+        int idx = 0;
 
-        if (!tramp_file_off.size())
-            return ErrorCode::TrampolineAddressAbsence;
+        // set section content, set filler for elf function
+        section_data.replace(idx * addr_size, addr_size, QByteArray(reinterpret_cast<const char *>(&nva), addr_size));
 
-        Elf32_Addr tramp_size = full_compiled_code.size() / tramp_file_off.size();
-        int i = 0;
+        if (!elf->set_section_content(sec_type, section_data))
+            return ErrorCode::SetSectionContentFailed;
 
-        foreach (auto fo_addr, tramp_file_off) {
-            // 5 - size of call instruction (minus 1 byte for call byte)
-            if (!elf->set_relative_address(fo_addr.first, nva + (tramp_size * i) - (text_data.second + fo_addr.first - base_off) - 4))
-                return ErrorCode::SetRelativeAddressFailed;
-            /*
-            qDebug() << "jumping on : " << QString("0x%1 ").arg(text_data.second + fo_addr.first - base_off - 1, 0, 16)
-                     << "to: " << QString("0x%1 ").arg(nva + (tramp_size * i), 0, 16);
-            */
+        LOG_MSG(QString("Data added at: 0x%1").arg(nva, 0, 16));
+        break;
+    }
+    case DAddingMethods<RegistersType>::CallingMethod::INIT: {
+        const QPair<QByteArray, Elf64_Addr> &section_data = pm.section_data;
 
-            LOG_MSG(QString("Jumping on: 0x%1 to: 0x%2").arg(text_data.second + fo_addr.first - base_off - 1, 0, 16).arg(
-                                                             nva + (tramp_size * i), 0, 16));
+        // 4 string copy destinationaddress
+        if (!elf->set_relative_address(file_off + pm.copy_off + (elf->is_x86() ? 2 : 3),
+                                       section_data.second - (nva + pm.copy_off - 1)))
+            return ErrorCode::SetRelativeAddressFailed;
 
-            // set new relative address for jmp
-            if (!elf->set_relative_address(file_off + (tramp_size * (i + 1)) - 4,
-                                           fo_addr.second - (nva + ((tramp_size * (i + 1)) - fake_jmp.size())) - 5))
-                return ErrorCode::SetRelativeAddressFailed;
+        // 4 mprotect page vaddr
+        if (!elf->set_relative_address(file_off + pm.mprotect_off + (elf->is_x86() ? 2 : 3),
+                                       section_data.second - (nva + pm.mprotect_off - 1)))
+            return ErrorCode::SetRelativeAddressFailed;
 
-            ++i;
-        }
+        // set redirection from init sectin to our code
+        Elf32_Addr redirect_off = nva - section_data.second - 5;
+        QByteArray compiled_jmp((QByteArray(1, '\xe9') + QByteArray(reinterpret_cast<const char*>(&redirect_off), sizeof(Elf32_Addr))));
 
-        if (dyn_magic) {
-            QPair<QByteArray, Elf64_Addr> text_data;
-            if (!elf->get_section_content(ELF::SectionType::TEXT, text_data))
-                return ErrorCode::GetSectionContentFailed;
-
-            int j = 0;
-            while ((j = full_compiled_code.indexOf("\xba\xda\xda\xba", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, text_data.second - (nva + j - (elf->is_x86() ? 3 : 4))))
-                    return ErrorCode::SetRelativeAddressFailed;
-
-            // static uint32_t code_cheksum_magic = 0x1ee74b1d;
-            j = 0;
-            uint32_t checksum = 0;
-            foreach (unsigned char b, text_data.first)
-                checksum += b;
-            while ((j = full_compiled_code.indexOf("\x1d\x4b\xe7\x1e", j + 1)) != -1)
-                if (!elf->set_relative_address(file_off + j, checksum))
-                    return ErrorCode::SetRelativeAddressFailed;
-        }
+        if (!elf->set_section_content(ELF::SectionType::INIT, compiled_jmp, '\x90'))
+            return ErrorCode::SetSectionContentFailed;
 
+        LOG_MSG(QString("Data added at: 0x%1").arg(nva, 0, 16));
+        break;
+    }
+    case DAddingMethods<RegistersType>::CallingMethod::Trampoline: {
+        typedef QPair<Elf64_Addr, Elf64_Off> jump_t;
+        foreach (const jump_t &jmp, pm.jumps)
+            LOG_MSG(QString("Jumping on: 0x%1 to: 0x%2").arg(jmp.first, 0, 16).arg(nva + jmp.second, 0, 16));
+        pm.layout.report("Trampolines", nva);
         break;
     }
     default:
         return ErrorCode::InvalidAddingMethodType;
     }
-    return ErrorCode::Success;
+
+    return fill_patch_slots(pm, nva, file_off, data_va, counters_va);
+}
+
+template <typename RegistersType>
+QString ELFAddingMethods<RegistersType>::profile_dump_path(const QString &name) {
+    // the injected code opens the dump with this path, so it can't depend on the working directory
+    return QFileInfo(QString("%1.%2.%3.dprof").arg(DAddingMethods<RegistersType>::profile_build).arg(name)
+                     .arg(profile_dumps++)).absoluteFilePath();
 }
@@ -1,7 +1,13 @@
 #ifndef ELFADDINGMETHODS_H
 #define ELFADDINGMETHODS_H
 
+#include <QVector>
+
 #include <core/adding_methods/wrappers/daddingmethods.h>
+#include <core/adding_methods/wrappers/stublayout.h>
+#include <core/assembler/dcodeobject.h>
+#include <core/assembler/dcodeemitter.h>
+#include <core/disassembler/liveness.h>
 
 /**
  * @brief Klasa odpowiedzialna za dodawanie metod zabezpieczających do plików ELF.
@@ -51,13 +57,9 @@ private:
         GetSegmentProtectFlagsFailed,
         GetSegmentAlignFailed,
         SegmentExtensionFailed,
+        ProfileDumpFailed,
         TrampolineAddressAbsence,
-        FileToCompileOpenFailed,
-        FileToCompileWriteFailed,
-        NasmExecutionFailed,
-        NdisasmExecutionFailed,
-        CompiledFileOpenFailed,
-        TempFileOpenFailed,
+        AssemblingFailed,
         InvalidAddressSizeAlign
     };
 
@@ -69,7 +71,9 @@ private:
     enum class PlaceholderMnemonics {
         DDETECTIONHANDLER,
         DDETECTIONMETHOD,
-        DDRET
+        DDRET,
+        DTIMERS,
+        DRATELIMIT
     };
 
     /**
@@ -108,28 +112,129 @@ private:
      */
     QMap<PlaceholderMnemonics, QString> placeholder_mnm;
 
+    /**
+     * @brief Parametry uzupełniane w skompilowanym kodzie po zatwierdzeniu zmian pliku (sloty).
+     */
+    QStringList patch_slots;
+
     /**
      * @brief Procentowe pokrycie kodu dla metod zamieniających adresy skoków
      */
     uint8_t tramp_code_cover;
 
     /**
-     * @brief Metoda zabezpiecza plik binarny ELF za pomocą wyspecyfikowanej metody.
+     * @brief Liczba utworzonych plików zrzutu liczników (trybu profilującego).
+     */
+    uint32_t profile_dumps;
+
+    /**
+     * @brief Sloty rozmiaru i sumy kontrolnej .text (adres wirtualny, nazwa), uzupełniane po ostatniej zmianie .text.
+     */
+    QList<QPair<Elf64_Addr, QString> > checksum_slots;
+
+    /**
+     * @brief Struktura, przechowująca informacje o metodzie dodanej do sesji edycji pliku.
+     */
+    typedef struct _pending_method {
+        typename DAddingMethods<RegistersType>::CallingMethod cm;
+        QByteArray code;
+        int payload_id;
+        QList<DCodeObject::Slot> patch_slots;
+        int data_id;
+        int counters_id;
+        QPair<QByteArray, Elf64_Addr> section_data;
+        Elf64_Off copy_off;
+        Elf64_Off mprotect_off;
+        QList<QPair<Elf64_Addr, Elf64_Off> > jumps;
+        StubLayout layout;
+
+        _pending_method() :
+            cm(DAddingMethods<RegistersType>::CallingMethod::OEP),
+            payload_id(-1), data_id(-1), counters_id(-1), copy_off(0), mprotect_off(0) {}
+    } pending_method;
+
+    /**
+     * @brief Metoda generuje kod dla wyspecyfikowanej metody i dodaje go do sesji edycji pliku ELF.
      * @param inject_desc opis metody wstrzykiwania kodu.
+     * @param pm informacje potrzebne do dokończenia zabezpieczania po zatwierdzeniu sesji.
+     * @param thread_checks wszystkie metody typu Thread, uruchamiane przez jeden wspólny wątek.
+     * @return Kod błędu.
+     */
+    ErrorCode prepare_one(typename DAddingMethods<RegistersType>::InjectDescription* inject_desc, pending_method &pm,
+                          const QList<typename DAddingMethods<RegistersType>::InjectDescription*> &thread_checks);
+
+    /**
+     * @brief Metoda generuje kod sprawdzeń uruchamianych przez wspólny wątek oraz opis ich zegarów.
+     * @param thread_checks metody typu Thread.
+     * @param code wygenerowany kod sprawdzeń.
+     * @param timers dane zegarów (odstęp bazowy i maksymalny dla każdego sprawdzenia).
+     * @param count liczba wygenerowanych sprawdzeń.
+     * @return Kod błędu.
+     */
+    ErrorCode thread_checks_gen_code(const QList<typename DAddingMethods<RegistersType>::InjectDescription*> &thread_checks,
+                                     QString &code, QString &timers, uint32_t &count);
+
+    /**
+     * @brief Metoda generuje kod ogranicznika częstości sprawdzeń w tramplinie: sprawdzenie jest wykonywane
+     * co rate_calls wywołań lub co rate_cycles cykli, zależnie od tego, który warunek zostanie spełniony
+     * pierwszy. Limity są brane z metody wykrywania, a gdy ta ich nie określa, z opakowania trampoliny.
+     * Stan ogranicznika leży w zapisywalnym bloku danych, poza kodem.
+     * @param trmwrapper opakowanie trampoliny.
+     * @param code wygenerowany kod, pusty gdy sprawdzenie nie jest ograniczane.
+     */
+    void rate_limit_gen_code(TrampolineWrapper<RegistersType> *trmwrapper, QString &code);
+
+    /**
+     * @brief Metoda kończy zabezpieczanie pliku, gdy znane jest już położenie dodanego kodu.
+     * @param pm informacje o metodzie.
+     * @param nva adres wirtualny dodanego kodu.
+     * @param file_off offset w pliku dodanego kodu.
+     * @param data_va adres wirtualny zapisywalnych danych metody (0 - brak danych).
+     * @param counters_va adres wirtualny wskaźnika na liczniki trybu profilującego (0 - brak).
      * @return Kod błędu.
      */
-    ErrorCode secure_one(typename DAddingMethods<RegistersType>::InjectDescription* inject_desc);
+    ErrorCode finish_one(const pending_method &pm, Elf64_Addr nva, Elf64_Off file_off, Elf64_Addr data_va,
+                         Elf64_Addr counters_va);
+
+    /**
+     * @brief Metoda zatwierdza sesję edycji pliku i kończy zabezpieczanie oczekujących metod.
+     * @param pending lista oczekujących metod.
+     * @return Kod błędu.
+     */
+    ErrorCode flush_pending(QList<pending_method> &pending);
+
+    /**
+     * @brief Metoda sprawdza czy dwie metody zmieniają to samo miejsce w pliku.
+     * @param a sposób wywołania pierwszej metody.
+     * @param b sposób wywołania drugiej metody.
+     * @return True jeżeli metody muszą zostać wstawione osobno, False w innych przypadkach.
+     */
+    static bool edit_conflict(typename DAddingMethods<RegistersType>::CallingMethod a,
+                              typename DAddingMethods<RegistersType>::CallingMethod b);
 
     /**
      * @brief Metoda odpowiada za generowanie kodu dla dowolnego opakowania.
      * @param wrap klasa opisująca kawałek kodu do wygenerowania.
      * @param code wygenerowany kod.
+     * @param live rejestry i flagi żywe po wykonaniu kodu (nullptr - wszystkie), tylko one są zachowywane.
      * @return Kod błędu.
      */
-    ErrorCode wrapper_gen_code( Wrapper<RegistersType> *wrap, QString &code);
+    ErrorCode wrapper_gen_code( Wrapper<RegistersType> *wrap, QString &code,
+                                const LivenessAnalyzer::Result *live = nullptr);
 
     /**
-     * @brief Metoda odpowiada za wypełnianie parametrów w podanym kodzie.
+     * @brief Metoda losuje miejsca wstawienia trampolin i wyznacza rejestry żywe w miejscach docelowych skoków.
+     * @param tramp_file_off lista par <offset w pliku, adres docelowy skoku>.
+     * @param base_off offset bazowy sekcji .text.
+     * @param text_data zawartość sekcji .text.
+     * @param live suma rejestrów i flag żywych we wszystkich miejscach docelowych.
+     * @return Kod błędu.
+     */
+    ErrorCode select_trampoline_sites(QList<QPair<Elf64_Addr, Elf64_Addr> > &tramp_file_off, Elf64_Addr &base_off,
+                                      QPair<QByteArray, Elf64_Addr> &text_data, LivenessAnalyzer::Result &live);
+
+    /**
+     * @brief Metoda odpowiada za wypełnianie parametrów w podanym kodzie. Sloty pozostają niewypełnione.
      * @param code kod.
      * @param params parametry.
      * @return ilośc zamienionych parametrów.
@@ -137,21 +242,23 @@ private:
     uint64_t fill_params(QString &code, const QMap<QString, QString> &params);
 
     /**
-     * @brief Metoda odpowiada za wypełnianie parametrów magicznych w podanym kodzie (te które, nie mogą być wyliczone dynamicznie).
-     * @param params parametry.
-     * @param elf instancja klasy pliku ELF.
+     * @brief Metoda uzupełnia sloty skompilowanego kodu, gdy znane jest jego położenie i ostateczna zawartość pliku.
+     * @param pm informacje o metodzie.
+     * @param nva adres wirtualny dodanego kodu.
+     * @param file_off offset w pliku dodanego kodu.
+     * @param data_va adres wirtualny zapisywalnych danych metody (0 - brak danych).
+     * @param counters_va adres wirtualny wskaźnika na liczniki trybu profilującego (0 - brak).
      * @return Kod błędu.
      */
-    ErrorCode fill_magic_params(QMap<QString, QString> &params, const ELF *elf);
+    ErrorCode fill_patch_slots(const pending_method &pm, Elf64_Addr nva, Elf64_Off file_off, Elf64_Addr data_va,
+                               Elf64_Addr counters_va);
 
     /**
-     * @brief Metoda odpowiada za wypełnanie magicznego parametru dla wartośći sumy kontrolnej kodu.
-     * @param vaddr adres wirtualny początku nowych danych.
-     * @param elf instancja klasy pliku ELF.
-     * @param checksum suma kontrolna.
-     * @return True, jeżeli operacja się powiodła, False w innych przypadkach.
+     * @brief Metoda uzupełnia wszystkie dotychczas dodane sloty rozmiaru i sumy kontrolnej sekcji .text.
+     * Wywoływana po ostatnim zatwierdzeniu sesji edycji, które mogło zmienić .text.
+     * @return Kod błędu.
      */
-    // bool fill_magic_checksum(const Elf64_Addr vaddr, ELF *elf, uint32_t &checksum);
+    ErrorCode fill_checksum_slots();
 
     /**
      * @brief Metoda odpowiada za wypełnianie placeholdera w podanym kodzie, za pomocą podanego kodu.
@@ -165,10 +272,10 @@ private:
     /**
      * @brief Metoda odpowiada za kompilację kodu źródłowego assembly.
      * @param code2compile kod, który musi zostać skompilowany.
-     * @param compiled_code skompilowany kod.
+     * @param compiled_code skompilowany kod wraz z offsetami slotów.
      * @return Kod błędu.
      */
-    ErrorCode compile(const QString &code2compile, QByteArray &compiled_code);
+    ErrorCode compile(const QString &code2compile, DCodeObject &compiled_code);
 
     /**
      * @brief Metoda odpowiada za pobieranie adresów z wyspecyfikowanych danych.
@@ -183,11 +290,11 @@ private:
 
     /**
      * @brief Metoda odpowiada za pobieranie offsetów instrukcji w pliku.
-     * @param opcodes lista instrukcji.
+     * @param opcodes offsety pól rel32 instrukcji względem początku sekcji.
      * @param file_off offset w pliku.
      * @param base_off wartość bazowa offsetu.
      */
-    void get_file_offsets_from_opcodes(QStringList &opcodes, QList<Elf64_Addr> &file_off, Elf64_Addr base_off);
+    void get_file_offsets_from_opcodes(const QVector<uint32_t> &opcodes, QList<Elf64_Addr> &file_off, Elf64_Addr base_off);
 
     /**
      * @brief Metoda pobiera offsety wszystkich adresów z sekcji .text.
@@ -207,6 +314,13 @@ private:
      * @return Kod błędu.
      */
     ErrorCode safe_obfuscate(uint8_t code_cover, uint8_t min_len, uint8_t max_len);
+
+    /**
+     * @brief Metoda zwraca ścieżkę kolejnego pliku zrzutu liczników trybu profilującego.
+     * @param name nazwa zmiany (część nazwy pliku).
+     * @return Ścieżka pliku zrzutu.
+     */
+    QString profile_dump_path(const QString &name);
 };
 
 #endif // ELFADDINGMETHODS_H
@@ -1,11 +1,9 @@
 #include "peaddingmethods.h"
 
-#include <QTemporaryFile>
-#include <QTemporaryDir>
-#include <QProcess>
-
+#include <core/assembler/dassembler.h>
+#include <core/disassembler/lengthdecoder.h>
 #include <helper/json_parser/djsonparser.h>
-#include <helper/settings_parser/dsettings.h>
+#include <helper/job_context/djobcontext.h>
 #include <helper/logger/dlogger.h>
 
 template <>
@@ -17,15 +15,11 @@ const QString PEAddingMethods<Registers_x64>::windowsApiLoadingFunction = "win_x
 template <typename Register>
 const QMap<typename PEAddingMethods<Register>::ErrorCode, QString> PEAddingMethods<Register>::errorDescriptions =
 {
+    { PEAddingMethods<Register>::ErrorCode::AssemblingFailed, "Assembling code failed." },
     { PEAddingMethods<Register>::ErrorCode::BinaryFileNoPe, "Given binary file is not valid PE file!" },
-    { PEAddingMethods<Register>::ErrorCode::CannotCreateTempDir, "Cannot create temporary directory." },
-    { PEAddingMethods<Register>::ErrorCode::CannotCreateTempFile, "Cannot create temporary file." },
-    { PEAddingMethods<Register>::ErrorCode::CannotOpenCompiledFile, "Cannot open compiled file" },
     { PEAddingMethods<Register>::ErrorCode::ErrorLoadingFunctions, "Cannot load Windows API loading code from .json file" },
     { PEAddingMethods<Register>::ErrorCode::InvalidInjectDescription, "Invalid inject description." },
     { PEAddingMethods<Register>::ErrorCode::InvalidPeFile, "PE file is invalid!" },
-    { PEAddingMethods<Register>::ErrorCode::NasmFailed, "Executing nasm failed." },
-    { PEAddingMethods<Register>::ErrorCode::NdisasmFailed, "Executing ndisasm failed." },
     { PEAddingMethods<Register>::ErrorCode::NoThreadAction, "Thread actions not defined." },
     { PEAddingMethods<Register>::ErrorCode::NullInjectDescription, "Loading inject description failed." },
     { PEAddingMethods<Register>::ErrorCode::NullWrapper, "Loading method failed." },
@@ -77,25 +71,62 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::safe_ob
     if(ec != ErrorCode::Success)
         return ec;
 
-    std::uniform_int_distribution<int> prob(0, 99);
-
+    QList<uint64_t> sites, selectedSites;
     foreach(uint32_t offset, fileOffsets)
+        sites.append(pe->getCallInstructionAddress(offset));
+
+    QList<int> selected = DAddingMethods<Register>::profile.selectSites(sites, coverage, DAddingMethods<Register>::r_gen);
+
+    if(!DAddingMethods<Register>::profile_build.isEmpty())
+        LOG_WARN("Profiling build is supported only for ELF files, obfuscation stubs are not instrumented.");
+
+    if(!pe->beginInjection())
+        return ErrorCode::PeOperationFailed;
+
+    // Wszystkie stuby trafiają do jednego bloku, ułożone według adresów miejsc wywołań
+    QList<BinaryCode<Register> > stubs;
+    StubLayout layout;
+
+    foreach(int idx, selected)
     {
-        if(prob(DAddingMethods<Register>::r_gen) >= coverage)
-            continue;
+        selectedSites.append(sites[idx]);
+        stubs.append(generateObfuscationCode(pe->getAddressAtCallInstructionOffset(fileOffsets[idx]), min_len, max_len));
+        layout.add(sites[idx], stubs.last().length());
+    }
 
-        BinaryCode<Register> code = generateObfuscationCode(pe->getAddressAtCallInstructionOffset(offset), min_len, max_len);
+    layout.arrange(0);
 
-        uint64_t addr = pe->injectUniqueData(code, codePointers, relocations);
+    BinaryCode<Register> code;
+    foreach(int i, layout.order())
+    {
+        code.append(CodeDefines<Register>::nops(layout.offset(i) - code.length()));
+        code.append(stubs[i]);
+    }
+
+    uint64_t addr = 0;
+    if(!stubs.isEmpty())
+    {
+        addr = pe->injectUniqueData(code, codePointers, relocations, layout.alignment());
         if(addr == 0)
+        {
+            pe->endInjection();
             return ErrorCode::PeOperationFailed;
-
-        pe->setAddressAtCallInstructionOffset(offset, addr);
+        }
     }
 
+    for(int i = 0; i < selected.length(); ++i)
+        pe->setAddressAtCallInstructionOffset(fileOffsets[selected[i]], addr + layout.offset(i));
+
+    if(!pe->endInjection())
+        return ErrorCode::PeOperationFailed;
+
     if(!pe->addRelocations(relocations))
         return ErrorCode::PeOperationFailed;
 
+    // Wykonywana część kodu zaciemniającego: skok przez śmieci i skok do celu
+    DAddingMethods<Register>::profile.report("Obfuscation", selectedSites, 2);
+    layout.report("Obfuscation", addr);
+
     return ErrorCode::Success;
 }
 
@@ -117,6 +148,7 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::safe_se
         const QList<typename DAddingMethods<Register>::InjectDescription*> &descs)
 {
     QList<uint64_t> epMethods, tlsMethods, tramMethods;
+    QList<QPair<uint32_t, uint64_t> > tramRates;
     ErrorCode ec;
 
     codePointers.clear();
@@ -157,6 +189,8 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::safe_se
             if(ec != ErrorCode::Success)
                 return ec;
             tramMethods.append(addr);
+            tramRates.append(QPair<uint32_t, uint64_t>(desc->adding_method->rate_calls,
+                                                       desc->adding_method->rate_cycles));
             break;
 
         default:
@@ -166,7 +200,7 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::safe_se
 
     if(!tramMethods.empty())
     {
-        ec = injectTrampolineCode(tramMethods);
+        ec = injectTrampolineCode(tramMethods, tramRates);
         if(ec != ErrorCode::Success)
             return ec;
     }
@@ -268,7 +302,7 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::generat
     // Ładowanie parametrów
     if(!w->dynamic_params.empty())
     {
-        DJsonParser parser(DSettings::getSettings().getDescriptionsPath<Register>());
+        DJsonParser parser(DJobContext::current().getDescriptionsPath<Register>());
         Wrapper<Register> *func_wrap =
                 parser.loadInjectDescription<Register>(windowsApiLoadingFunction);
         if(!func_wrap)
@@ -476,7 +510,8 @@ template PEAddingMethods<Registers_x64>::ErrorCode PEAddingMethods<Registers_x64
 
 
 template <typename Register>
-typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::injectTrampolineCode(QList<uint64_t> &tramMethods)
+typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::injectTrampolineCode(QList<uint64_t> &tramMethods,
+                                                                                                const QList<QPair<uint32_t, uint64_t> > &tramRates)
 {
     PEFile *pe = dynamic_cast<PEFile*>(DAddingMethods<Register>::file);
     if(!pe)
@@ -487,26 +522,100 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::injectT
     if(ec != ErrorCode::Success)
         return ec;
 
-    std::uniform_int_distribution<int> prob(0, 99);
-
     int method_idx = 0;
 
+    LivenessAnalyzer liveness(pe->is_x64());
+    LengthDecoder decoder(pe->is_x64());
+
+    // Kontekst zapisywany przez trampolinę bez analizy żywotności
+    QByteArray full_context = CodeDefines<Register>::saveAll();
+    full_context.append(CodeDefines<Register>::restoreAll());
+    int full_instructions = countInstructions(decoder, full_context);
+
+    int sites = 0;
+    int64_t saved_bytes = 0;
+    int64_t saved_instructions = 0;
+
+    // Stan ogranicznika częstości (16 bajtów na metodę) leży w osobnej sekcji danych, kod pozostaje niezapisywalny
+    QList<uint64_t> rateStates;
+    typedef QPair<uint32_t, uint64_t> rate_t;
+    foreach(const rate_t &rate, tramRates)
+        rateStates.append(rate.first != 1 && (rate.first || rate.second) ? 1 : 0);
+
+    unsigned int limited = rateStates.count(1);
+    uint64_t stateAddr = limited ? pe->addDataSection(limited * 16) : 0;
+
+    if(limited && !stateAddr)
+        LOG_WARN("No room for the rate limiter state section, trampolines are not rate-limited.");
+
+    for(int i = 0, n = 0; i < rateStates.length(); ++i)
+        rateStates[i] = rateStates[i] && stateAddr ? stateAddr + 16 * n++ : 0;
+
+    QList<uint64_t> callSites, selectedSites;
     foreach(uint32_t offset, fileOffsets)
-    {
-        if(prob(DAddingMethods<Register>::r_gen) >= codeCoverage)
-            continue;
+        callSites.append(pe->getCallInstructionAddress(offset));
+
+    QList<int> selected = DAddingMethods<Register>::profile.selectSites(callSites, codeCoverage,
+                                                                        DAddingMethods<Register>::r_gen);
+
+    if(!DAddingMethods<Register>::profile_build.isEmpty())
+        LOG_WARN("Profiling build is supported only for ELF files, trampolines are not instrumented.");
+    int64_t stub_instructions = 0;
 
-        BinaryCode<Register> code = generateTrampolineCode(pe->getAddressAtCallInstructionOffset(offset), tramMethods[method_idx]);
+    if(!pe->beginInjection())
+        return ErrorCode::PeOperationFailed;
+
+    foreach(int idx, selected)
+    {
+        uint32_t offset = fileOffsets[idx];
+        selectedSites.append(callSites[idx]);
+
+        // Cel skoku jest analizowany tylko jeżeli leży w sekcji .text
+        LivenessAnalyzer::Result live = LivenessAnalyzer::allLive();
+        uint32_t rel_off = offset - text_section_offset;
+        int64_t target = static_cast<int64_t>(rel_off) + 4 +
+                *reinterpret_cast<const int32_t*>(&text_section.constData()[rel_off]);
+
+        if(target >= 0 && target < text_section.size())
+            live = liveness.analyze(reinterpret_cast<const uint8_t*>(&text_section.constData()[target]),
+                                    text_section.size() - target);
+
+        QByteArray context;
+        BinaryCode<Register> code = generateTrampolineCode(pe->getAddressAtCallInstructionOffset(offset),
+                                                           tramMethods[method_idx], live, tramRates[method_idx].first,
+                                                           tramRates[method_idx].second, rateStates[method_idx], &context);
+
+        int instructions = countInstructions(decoder, context);
+        LOG_DBG(QString("Trampoline at 0x%1: context %2 bytes, %3 instructions (full: %4 bytes, %5 instructions), flags %6")
+                .arg(pe->getAddressAtCallInstructionOffset(offset), 0, 16).arg(context.size()).arg(instructions)
+                .arg(full_context.size()).arg(full_instructions).arg(live.flags ? "saved" : "dead"));
+
+        ++sites;
+        saved_bytes += full_context.size() - context.size();
+        saved_instructions += full_instructions - instructions;
+        stub_instructions += countInstructions(decoder, code.getBytes());
 
         uint64_t addr = pe->injectUniqueData(code, codePointers, relocations);
         if(addr == 0)
+        {
+            pe->endInjection();
             return ErrorCode::PeOperationFailed;
+        }
 
         pe->setAddressAtCallInstructionOffset(offset, addr);
 
         method_idx = (method_idx + 1) % tramMethods.length();
     }
 
+    if(!pe->endInjection())
+        return ErrorCode::PeOperationFailed;
+
+    LOG_MSG(QString("Trampolines: %1, context bytes saved: %2, instructions saved: %3")
+            .arg(sites).arg(saved_bytes).arg(saved_instructions));
+
+    // Średnia liczba instrukcji trampoliny, bez kodu wywoływanej metody
+    DAddingMethods<Register>::profile.report("Trampolines", selectedSites, sites ? stub_instructions / sites : 0);
+
     return ErrorCode::Success;
 }
 
@@ -529,7 +638,7 @@ PEAddingMethods<Registers_x86>::ErrorCode PEAddingMethods<Registers_x86>::genera
 
     if(sleepTime)
     {
-        DJsonParser parser(DSettings::getSettings().getDescriptionsPath<Register>());
+        DJsonParser parser(DJobContext::current().getDescriptionsPath<Register>());
         Wrapper<Register> *func_wrap =
                 parser.loadInjectDescription<Register>(windowsApiLoadingFunction);
         if(!func_wrap)
@@ -625,7 +734,7 @@ PEAddingMethods<Registers_x64>::ErrorCode PEAddingMethods<Registers_x64>::genera
 
     if(sleepTime)
     {
-        DJsonParser parser(DSettings::getSettings().getDescriptionsPath<Register>());
+        DJsonParser parser(DJobContext::current().getDescriptionsPath<Register>());
         Wrapper<Register> *func_wrap =
                 parser.loadInjectDescription<Register>(windowsApiLoadingFunction);
         if(!func_wrap)
@@ -912,53 +1021,20 @@ template PEAddingMethods<Registers_x86>::ErrorCode PEAddingMethods<Registers_x86
 template PEAddingMethods<Registers_x64>::ErrorCode PEAddingMethods<Registers_x64>::generateActionConditionCode(BinaryCode<Registers_x64> &code, uint64_t action, Registers_x64 cond, Registers_x64 act);
 
 template <typename Register>
-void PEAddingMethods<Register>::getFileOffsetsFromOpcodes(QStringList &opcodes, QList<uint32_t> &fileOffsets, uint32_t baseOffset)
+void PEAddingMethods<Register>::getFileOffsetsFromOpcodes(const QVector<uint32_t> &opcodes, QList<uint32_t> &fileOffsets, uint32_t baseOffset)
 {
-    foreach(QString op, opcodes)
-        fileOffsets.append(op.mid(0, 8).toUInt(NULL, 16) + baseOffset + 1);
+    foreach(uint32_t op, opcodes)
+        fileOffsets.append(op + baseOffset);
 }
 
 template <typename Register>
 typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::compileCode(QByteArray code, QByteArray &compiled)
 {
-    QByteArray bin;
-
-    QTemporaryFile temp_file;
-    if(!temp_file.open())
-        return ErrorCode::CannotCreateTempFile;
-
-    temp_file.write(code);
-    temp_file.flush();
-
-    QTemporaryDir compile_dir;
-    if(!compile_dir.isValid())
-        return ErrorCode::CannotCreateTempDir;
-
-    QString data_file = QFileInfo(compile_dir.path(), "data.bin").absoluteFilePath();
-
-    QProcess nasm;
-
     LOG_MSG("Compiling code...");
 
-    nasm.setProcessChannelMode(QProcess::MergedChannels);
-    QString nasmPath = DSettings::getSettings().getNasmPath();
-    nasm.start(nasmPath, {"-f", "bin", "-o", data_file, QFileInfo(temp_file).absoluteFilePath()});
+    if(!DAssembler::compile(QString::fromUtf8(code), pe->is_x64() ? 64 : 32, compiled))
+        return ErrorCode::AssemblingFailed;
 
-    if(!nasm.waitForFinished())
-        return ErrorCode::NasmFailed;
-
-    temp_file.close();
-
-    QFile f(data_file);
-
-    if(!f.open(QFile::ReadOnly))
-        return ErrorCode::CannotOpenCompiledFile;
-
-    bin = f.readAll();
-
-    f.close();
-
-    compiled = bin;
     return ErrorCode::Success;
 }
 
@@ -985,8 +1061,39 @@ Registers_x64 PEAddingMethods<Registers_x64>::getRandomRegister()
     return r[idx(r_gen)];
 }
 
+template <typename Register>
+int PEAddingMethods<Register>::countInstructions(const LengthDecoder &decoder, const QByteArray &code)
+{
+    return decoder.count(code);
+}
+template int PEAddingMethods<Registers_x86>::countInstructions(const LengthDecoder &decoder, const QByteArray &code);
+template int PEAddingMethods<Registers_x64>::countInstructions(const LengthDecoder &decoder, const QByteArray &code);
+
+template <typename Register>
+QList<Register> PEAddingMethods<Register>::getTrampolineSavedRegisters(const LivenessAnalyzer::Result &live, Register callReg)
+{
+    // Metoda wywoływana przez trampolinę zachowuje rejestry nieulotne (zewnętrzne)
+    QList<Register> regs;
+
+    foreach(Register r, CodeDefines<Register>::internalRegs)
+    {
+        if(LivenessAnalyzer::isLive(live, r))
+            regs.append(r);
+    }
+
+    if(!regs.contains(callReg) && LivenessAnalyzer::isLive(live, callReg))
+        regs.append(callReg);
+
+    return regs;
+}
+template QList<Registers_x86> PEAddingMethods<Registers_x86>::getTrampolineSavedRegisters(const LivenessAnalyzer::Result &live, Registers_x86 callReg);
+template QList<Registers_x64> PEAddingMethods<Registers_x64>::getTrampolineSavedRegisters(const LivenessAnalyzer::Result &live, Registers_x64 callReg);
+
 template <>
-BinaryCode<Registers_x86> PEAddingMethods<Registers_x86>::generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr)
+BinaryCode<Registers_x86> PEAddingMethods<Registers_x86>::generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr,
+                                                                                  const LivenessAnalyzer::Result &live, uint32_t rateCalls,
+                                                                                  uint64_t rateCycles, uint64_t rateState,
+                                                                                  QByteArray *context)
 {
     typedef Registers_x86 Register;
 
@@ -994,19 +1101,48 @@ BinaryCode<Registers_x86> PEAddingMethods<Registers_x86>::generateTrampolineCode
 
     code.append(CodeDefines<Register>::storeValue(static_cast<uint32_t>(realAddr)), true);
 
-    code.append(CodeDefines<Register>::saveAll());
     Register r = getRandomRegister();
+    QList<Register> regs = getTrampolineSavedRegisters(live, r);
+    QByteArray save, restore;
+
+    if(live.flags)
+        save.append(CodeDefines<Register>::saveFlags);
+
+    for(int i = 0; i < regs.length(); ++i)
+    {
+        save.append(CodeDefines<Register>::saveRegister(regs[i]));
+        restore.prepend(CodeDefines<Register>::restoreRegister(regs[i]));
+    }
+
+    if(live.flags)
+        restore.append(CodeDefines<Register>::restoreFlags);
+
+    QByteArray call = CodeDefines<Register>::movValueToReg(wrapperAddr, r);
+    call.append(CodeDefines<Register>::callReg(r));
+
+    code.append(save);
+    if(rateState)
+    {
+        code.append(CodeDefines<Register>::movValueToReg(rateState, Register::ECX), true);
+        code.append(CodeDefines<Register>::rateLimit(rateCalls, rateCycles, call.length()));
+    }
     code.append(CodeDefines<Register>::movValueToReg(wrapperAddr, r), true);
     code.append(CodeDefines<Register>::callReg(r));
-    code.append(CodeDefines<Register>::restoreAll());
+    code.append(restore);
 
     code.append(CodeDefines<Register>::ret);
 
+    if(context)
+        *context = save + restore;
+
     return code;
 }
 
 template <>
-BinaryCode<Registers_x64> PEAddingMethods<Registers_x64>::generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr)
+BinaryCode<Registers_x64> PEAddingMethods<Registers_x64>::generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr,
+                                                                                  const LivenessAnalyzer::Result &live, uint32_t rateCalls,
+                                                                                  uint64_t rateCycles, uint64_t rateState,
+                                                                                  QByteArray *context)
 {
     typedef Registers_x64 Register;
 
@@ -1019,16 +1155,51 @@ BinaryCode<Registers_x64> PEAddingMethods<Registers_x64>::generateTrampolineCode
     code.append(CodeDefines<Register>::readFromRegToEspMem(r, CodeDefines<Register>::stackCellSize));
     code.append(CodeDefines<Register>::restoreRegister(r));
 
-    code.append(CodeDefines<Register>::saveAll());
-    code.append(CodeDefines<Register>::reserveStackSpace(CodeDefines<Register>::shadowSize));
     r = getRandomRegister();
+    QList<Register> regs = getTrampolineSavedRegisters(live, r);
+    QByteArray save, restore;
+
+    if(live.flags)
+        save.append(CodeDefines<Register>::saveFlags);
+
+    for(int i = 0; i < regs.length(); ++i)
+    {
+        save.append(CodeDefines<Register>::saveRegister(regs[i]));
+        restore.prepend(CodeDefines<Register>::restoreRegister(regs[i]));
+    }
+
+    if(live.flags)
+        restore.append(CodeDefines<Register>::restoreFlags);
+
+    // Nieparzysta liczba zapisanych komórek rozwyrównałaby stos
+    if((regs.length() + (live.flags ? 1 : 0)) % 2)
+    {
+        save.append(CodeDefines<Register>::reserveStackSpace(CodeDefines<Register>::align16Size));
+        restore.prepend(CodeDefines<Register>::clearStackSpace(CodeDefines<Register>::align16Size));
+    }
+
+    QByteArray call = CodeDefines<Register>::reserveStackSpace(CodeDefines<Register>::shadowSize);
+    call.append(CodeDefines<Register>::movValueToReg(wrapperAddr, r));
+    call.append(CodeDefines<Register>::callReg(r));
+    call.append(CodeDefines<Register>::clearStackSpace(CodeDefines<Register>::shadowSize));
+
+    code.append(save);
+    if(rateState)
+    {
+        code.append(CodeDefines<Register>::movValueToReg(rateState, Register::RCX), true);
+        code.append(CodeDefines<Register>::rateLimit(rateCalls, rateCycles, call.length()));
+    }
+    code.append(CodeDefines<Register>::reserveStackSpace(CodeDefines<Register>::shadowSize));
     code.append(CodeDefines<Register>::movValueToReg(wrapperAddr, r), true);
     code.append(CodeDefines<Register>::callReg(r));
     code.append(CodeDefines<Register>::clearStackSpace(CodeDefines<Register>::shadowSize));
-    code.append(CodeDefines<Register>::restoreAll());
+    code.append(restore);
 
     code.append(CodeDefines<Register>::ret);
 
+    if(context)
+        *context = save + restore;
+
     return code;
 }
 
@@ -1075,35 +1246,15 @@ typename PEAddingMethods<Register>::ErrorCode PEAddingMethods<Register>::getAddr
     if(!pe)
         return ErrorCode::BinaryFileNoPe;
 
-    QTemporaryFile temp_file;
-    if(!temp_file.open())
-        return ErrorCode::CannotCreateTempFile;
-
-    temp_file.write(text_section);
-    temp_file.flush();
-
-    QProcess ndisasm;
-
-    LOG_MSG("Starting dissassembly of code. This may take a while...");
-
-    ndisasm.setProcessChannelMode(QProcess::MergedChannels);
-    QString ndisasm_path = DSettings::getSettings().getNdisasmPath();
-    ndisasm.start(ndisasm_path, {"-a", "-b", pe->is_x64() ? "64" : "32", QFileInfo(temp_file).absoluteFilePath()});
-
-    if(!ndisasm.waitForStarted())
-        return ErrorCode::NdisasmFailed;
-
-    QByteArray assembly;
-
-    while(ndisasm.waitForReadyRead(-1))
-        assembly.append(ndisasm.readAll());
+    LOG_MSG("Searching for call and jmp instructions...");
 
-    QStringList asm_lines = QString(assembly).split(CodeDefines<Register>::newLineRegExp, QString::SkipEmptyParts);
-    QStringList call_lines = asm_lines.filter(CodeDefines<Register>::callRegExp);
-    QStringList jmp_lines = asm_lines.filter(CodeDefines<Register>::jmpRegExp);
+    QVector<uint32_t> calls, jmps;
+    LengthDecoder(pe->is_x64()).findRelativeBranches(text_section, calls, jmps,
+                                                     DJobContext::current().getDisassemblerThreads());
 
-    getFileOffsetsFromOpcodes(call_lines, offsets, text_section_offset);
-    getFileOffsetsFromOpcodes(jmp_lines, offsets, text_section_offset);
+    offsets.reserve(offsets.size() + calls.size() + jmps.size());
+    getFileOffsetsFromOpcodes(calls, offsets, text_section_offset);
+    getFileOffsetsFromOpcodes(jmps, offsets, text_section_offset);
 
     LOG_MSG("Done.");
 
@@ -1,7 +1,11 @@
 #ifndef PEADDINGMETHODS_H
 #define PEADDINGMETHODS_H
 
+#include <QVector>
+
 #include <core/adding_methods/wrappers/daddingmethods.h>
+#include <core/adding_methods/wrappers/stublayout.h>
+#include <core/disassembler/liveness.h>
 #include <core/file_types/pefile.h>
 
 /**
@@ -25,11 +29,7 @@ private:
         ErrorLoadingFunctions,
         ToManyBytesForRelativeJump,
         InvalidParametersFormat,
-        CannotCreateTempFile,
-        CannotCreateTempDir,
-        NasmFailed,
-        NdisasmFailed,
-        CannotOpenCompiledFile
+        AssemblingFailed
     };
 
     static const QMap<ErrorCode, QString> errorDescriptions;
@@ -103,9 +103,10 @@ private:
     /**
      * @brief Metoda dodająca kod jako trampolinę
      * @param tramMethods Wybrane metody zabezpieczania
+     * @param tramRates Ograniczenia częstości sprawdzeń kolejnych metod (liczba wywołań, liczba cykli)
      * @return Kod błędu
      */
-    ErrorCode injectTrampolineCode(QList<uint64_t> &tramMethods);
+    ErrorCode injectTrampolineCode(QList<uint64_t> &tramMethods, const QList<QPair<uint32_t, uint64_t> > &tramRates);
 
     /**
      * @brief Metoda generująca kod wątku
@@ -126,20 +127,45 @@ private:
     ErrorCode generateCode(Wrapper<Register> *w, uint64_t &codePtr, bool isTlsCallback = false);
 
     /**
-     * @brief Metoda tworząca listę offsetów instrukcji na podstawie zdekompilowanego kodu
-     * @param opcodes Linie zdekompilowanego kodu
+     * @brief Metoda tworząca listę offsetów instrukcji w pliku
+     * @param opcodes Offsety pól rel32 instrukcji względem początku fragmentu
      * @param fileOffsets Offsety
-     * @param baseOffset Adres bazowy zdekompilownego fragmentu
+     * @param baseOffset Adres bazowy fragmentu
      */
-    void getFileOffsetsFromOpcodes(QStringList &opcodes, QList<uint32_t> &fileOffsets, uint32_t baseOffset);
+    void getFileOffsetsFromOpcodes(const QVector<uint32_t> &opcodes, QList<uint32_t> &fileOffsets, uint32_t baseOffset);
 
     /**
-     * @brief Metoda generująca kod trampoliny
+     * @brief Metoda generująca kod trampoliny. Zapisywane są tylko rejestry ulotne (oraz rejestr wywołania)
+     * żywe w miejscu docelowym skoku, a flagi tylko jeżeli są żywe.
      * @param realAddr Pierwotny adres skoku
      * @param wrapperAddr Adres metody do wywołania
+     * @param live Rejestry i flagi żywe pod adresem realAddr
+     * @param rateCalls Metoda jest wywoływana co rateCalls przejść przez trampolinę (0 - bez limitu wywołań)
+     * @param rateCycles Metoda jest wywoływana po upływie rateCycles cykli procesora od ostatniego wywołania,
+     * jeżeli wcześniej nie nastąpiło to z powodu rateCalls (0 - bez limitu czasu)
+     * @param rateState Adres stanu ogranicznika w zapisywalnej sekcji danych (0 - trampolina bez ogranicznika)
+     * @param context Kod zapisu i odczytu kontekstu (opcjonalnie, do raportu)
      * @return Wygenerowany kod
      */
-    BinaryCode<Register> generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr);
+    BinaryCode<Register> generateTrampolineCode(uint64_t realAddr, uint64_t wrapperAddr,
+                                                const LivenessAnalyzer::Result &live, uint32_t rateCalls,
+                                                uint64_t rateCycles, uint64_t rateState, QByteArray *context = nullptr);
+
+    /**
+     * @brief Metoda wybierająca rejestry zapisywane przez trampolinę
+     * @param live Rejestry żywe w miejscu docelowym skoku
+     * @param callReg Rejestr używany do wywołania metody
+     * @return Lista rejestrów
+     */
+    QList<Register> getTrampolineSavedRegisters(const LivenessAnalyzer::Result &live, Register callReg);
+
+    /**
+     * @brief Metoda zliczająca instrukcje w kodzie
+     * @param decoder Dekoder długości instrukcji
+     * @param code Kod
+     * @return Liczba instrukcji
+     */
+    static int countInstructions(const LengthDecoder &decoder, const QByteArray &code);
 
     /**
      * @brief Metoda losująca rejestr
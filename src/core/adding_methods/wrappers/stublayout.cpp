@@ -0,0 +1,137 @@
+#include <core/adding_methods/wrappers/stublayout.h>
+
+#include <QSet>
+#include <algorithm>
+
+#include <helper/logger/dlogger.h>
+
+const uint32_t StubLayout::entryAlign = 16;
+const uint32_t StubLayout::lineSize = 64;
+const uint32_t StubLayout::pageSize = 4096;
+
+StubLayout::StubLayout() :
+    start(0),
+    end(0),
+    padding(0)
+{
+}
+
+int StubLayout::add(uint64_t caller, uint32_t size)
+{
+    stubs.append(Stub(caller, size));
+    return stubs.length() - 1;
+}
+
+void StubLayout::arrange(uint32_t start)
+{
+    this->start = start;
+    padding = 0;
+    sorted.clear();
+
+    for(int i = 0; i < stubs.length(); ++i)
+        sorted.append(i);
+
+    std::stable_sort(sorted.begin(), sorted.end(), [this](int a, int b) -> bool {
+        return stubs[a].caller < stubs[b].caller;
+    });
+
+    uint32_t pos = start;
+    uint64_t callerPage = 0;
+
+    for(int i = 0; i < sorted.length(); ++i)
+    {
+        Stub &s = stubs[sorted[i]];
+        uint32_t prev = pos;
+        pos = alignUp(pos, entryAlign);
+
+        // Nowa strona miejsc wywołań: jej stuby zaczynają się na nowej stronie, jeżeli nie zmieszczą się na bieżącej
+        if(!i || s.caller / pageSize != callerPage)
+        {
+            callerPage = s.caller / pageSize;
+
+            uint32_t cluster = 0;
+            for(int j = i; j < sorted.length() && stubs[sorted[j]].caller / pageSize == callerPage; ++j)
+                cluster += alignUp(stubs[sorted[j]].size, entryAlign);
+
+            if(cluster <= pageSize && pos % pageSize + cluster > pageSize)
+                pos = alignUp(pos, pageSize);
+        }
+
+        if(s.size && s.size <= lineSize && pos / lineSize != (pos + s.size - 1) / lineSize)
+            pos = alignUp(pos, lineSize);
+        else if(s.size && s.size <= pageSize && pos / pageSize != (pos + s.size - 1) / pageSize)
+            pos = alignUp(pos, pageSize);
+
+        padding += pos - prev;
+        s.offset = pos;
+        pos += s.size;
+    }
+
+    end = pos;
+}
+
+uint32_t StubLayout::offset(int index) const
+{
+    return stubs[index].offset;
+}
+
+const QList<int> &StubLayout::order() const
+{
+    return sorted;
+}
+
+uint32_t StubLayout::size() const
+{
+    return end;
+}
+
+uint32_t StubLayout::alignment() const
+{
+    // Blok mniejszy niż strona, wyrównany do potęgi dwójki nie mniejszej niż jego rozmiar, nie przecina granicy strony
+    uint32_t align = lineSize;
+    while(align < end && align < pageSize)
+        align <<= 1;
+
+    return align;
+}
+
+void StubLayout::report(const QString &name, uint64_t base) const
+{
+    if(stubs.isEmpty())
+        return;
+
+    static const uint64_t limits[] = { 0x1000, 0x10000, 0x100000, 0x1000000 };
+    static const int bucketsCount = sizeof(limits) / sizeof(limits[0]) + 1;
+    int buckets[bucketsCount] = { 0 };
+
+    QList<uint64_t> distances;
+    QSet<uint64_t> pages;
+
+    foreach(const Stub &s, stubs)
+    {
+        uint64_t addr = base + s.offset;
+        uint64_t d = addr > s.caller ? addr - s.caller : s.caller - addr;
+        distances.append(d);
+
+        int b = 0;
+        while(b < bucketsCount - 1 && d >= limits[b])
+            ++b;
+        ++buckets[b];
+
+        for(uint64_t p = addr / pageSize; s.size && p <= (addr + s.size - 1) / pageSize; ++p)
+            pages.insert(p);
+    }
+
+    std::sort(distances.begin(), distances.end());
+
+    LOG_MSG(QString("%1 layout: %2 stubs, %3 bytes (%4 padding), %5 pages, alignment %6")
+            .arg(name).arg(stubs.length()).arg(end - start).arg(padding).arg(pages.size()).arg(alignment()));
+    LOG_MSG(QString("%1 stub distance: <4K %2, <64K %3, <1M %4, <16M %5, >=16M %6, min 0x%7, median 0x%8, max 0x%9")
+            .arg(name).arg(buckets[0]).arg(buckets[1]).arg(buckets[2]).arg(buckets[3]).arg(buckets[4])
+            .arg(distances.first(), 0, 16).arg(distances[distances.length() / 2], 0, 16).arg(distances.last(), 0, 16));
+}
+
+uint32_t StubLayout::alignUp(uint32_t value, uint32_t align)
+{
+    return (value + align - 1) / align * align;
+}
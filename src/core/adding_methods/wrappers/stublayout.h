@@ -0,0 +1,133 @@
+#ifndef STUBLAYOUT_H
+#define STUBLAYOUT_H
+
+#include <QString>
+#include <QList>
+
+/**
+ * @brief Rozmieszczenie dodawanych fragmentów kodu (stubów) w bloku wstrzykiwanych danych.
+ *
+ * Stuby są układane w kolejności adresów miejsc wywołań, które do nich skaczą, więc stuby wywoływane
+ * z tej samej strony kodu trafiają na tę samą stronę bloku. Początek każdego stubu jest wyrównany
+ * do 16 bajtów, stub nie większy niż linia pamięci podręcznej nie przecina granicy linii, a grupa
+ * stubów jednej strony kodu, mieszcząca się w stronie, nie przecina granicy strony. Luki wypełniane
+ * są wielobajtowymi instrukcjami nop.
+ */
+class StubLayout
+{
+public:
+    /**
+     * @brief Konstruktor pustego rozmieszczenia.
+     */
+    StubLayout();
+
+    /**
+     * @brief Dodaje stub do rozmieszczenia.
+     * @param caller adres wirtualny miejsca wywołania, które skacze do stubu.
+     * @param size rozmiar stubu.
+     * @return Indeks stubu.
+     */
+    int add(uint64_t caller, uint32_t size);
+
+    /**
+     * @brief Wyznacza położenie stubów.
+     * @param start offset w bloku, od którego zaczynają się stuby (np. za wspólnym kodem).
+     */
+    void arrange(uint32_t start);
+
+    /**
+     * @brief Offset stubu w bloku.
+     * @param index indeks stubu.
+     * @return Offset w bajtach.
+     */
+    uint32_t offset(int index) const;
+
+    /**
+     * @brief Indeksy stubów w kolejności ich położenia w bloku.
+     * @return Lista indeksów.
+     */
+    const QList<int> &order() const;
+
+    /**
+     * @brief Rozmiar bloku, razem z dopełnieniem.
+     * @return Rozmiar w bajtach.
+     */
+    uint32_t size() const;
+
+    /**
+     * @brief Wymagane wyrównanie adresu wirtualnego bloku, przy którym rozmieszczenie jest zachowane.
+     * @return Wyrównanie w bajtach.
+     */
+    uint32_t alignment() const;
+
+    /**
+     * @brief Wypisuje rozkład odległości stubów od miejsc wywołań.
+     * @param name nazwa zmiany (do raportu).
+     * @param base adres wirtualny bloku.
+     */
+    void report(const QString &name, uint64_t base) const;
+
+    /**
+     * @brief Wyrównanie początku stubu.
+     */
+    static const uint32_t entryAlign;
+
+    /**
+     * @brief Rozmiar linii pamięci podręcznej.
+     */
+    static const uint32_t lineSize;
+
+    /**
+     * @brief Rozmiar strony pamięci.
+     */
+    static const uint32_t pageSize;
+
+private:
+    /**
+     * @brief Wyrównuje wartość w górę.
+     * @param value wartość.
+     * @param align wyrównanie.
+     * @return Wyrównana wartość.
+     */
+    static uint32_t alignUp(uint32_t value, uint32_t align);
+
+    /**
+     * @brief Opis stubu.
+     */
+    typedef struct _Stub
+    {
+        uint64_t caller;
+        uint32_t size;
+        uint32_t offset;
+
+        _Stub() : caller(0), size(0), offset(0) {}
+        _Stub(uint64_t _caller, uint32_t _size) : caller(_caller), size(_size), offset(0) {}
+    } Stub;
+
+    /**
+     * @brief Stuby, w kolejności dodawania.
+     */
+    QList<Stub> stubs;
+
+    /**
+     * @brief Indeksy stubów w kolejności położenia.
+     */
+    QList<int> sorted;
+
+    /**
+     * @brief Offset pierwszego stubu.
+     */
+    uint32_t start;
+
+    /**
+     * @brief Offset końca ostatniego stubu.
+     */
+    uint32_t end;
+
+    /**
+     * @brief Liczba bajtów dopełnienia między stubami.
+     */
+    uint32_t padding;
+};
+
+#endif // STUBLAYOUT_H
@@ -0,0 +1,46 @@
+#include <core/assembler/dassembler.h>
+#include <core/assembler/dassemblercache.h>
+#include <core/assembler/nasmassembler.h>
+#include <core/assembler/nativeassembler.h>
+
+#include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
+
+const QString DAssembler::version = "1";
+
+const QString &DAssembler::getLastError() const
+{
+    return last_error;
+}
+
+bool DAssembler::compile(const QString &code, uint8_t bits, QByteArray &compiled)
+{
+    DAssemblerCache &cache = DAssemblerCache::getCache();
+
+    if(cache.lookup(code, bits, compiled))
+        return true;
+
+    bool assembled = false;
+
+    if(DJobContext::current().getAssembler() != "nasm")
+    {
+        NativeAssembler native;
+        assembled = native.assemble(code, compiled);
+
+        if(!assembled)
+            LOG_WARN(QString("Native assembler failed (%1), falling back to nasm.").arg(native.getLastError()));
+    }
+
+    if(!assembled)
+    {
+        NasmAssembler nasm;
+        if(!nasm.assemble(code, compiled))
+        {
+            LOG_ERROR(nasm.getLastError());
+            return false;
+        }
+    }
+
+    cache.store(code, bits, compiled);
+    return true;
+}
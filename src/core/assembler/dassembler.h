@@ -0,0 +1,52 @@
+#ifndef DASSEMBLER_H
+#define DASSEMBLER_H
+
+#include <QString>
+#include <QByteArray>
+
+/**
+ * @brief Klasa bazowa dla asemblerów kodu źródłowego assembly (składnia NASM, format bin).
+ */
+class DAssembler
+{
+public:
+    virtual ~DAssembler() {}
+
+    /**
+     * @brief Metoda kompilująca kod źródłowy assembly do postaci binarnej.
+     * @param code kod źródłowy.
+     * @param compiled skompilowany kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    virtual bool assemble(const QString &code, QByteArray &compiled) = 0;
+
+    /**
+     * @brief Metoda zwracająca opis ostatniego błędu.
+     * @return Opis błędu.
+     */
+    const QString &getLastError() const;
+
+    /**
+     * @brief Metoda kompilująca kod za pomocą asemblera wybranego w ustawieniach.
+     * Wynik jest pobierany z pamięci podręcznej, jeżeli ten sam kod był już kompilowany.
+     * W przypadku niepowodzenia asemblera wbudowanego kod jest kompilowany przez nasm.
+     * @param code kod źródłowy.
+     * @param bits architektura (32 lub 64).
+     * @param compiled skompilowany kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool compile(const QString &code, uint8_t bits, QByteArray &compiled);
+
+    /**
+     * @brief Wersja asemblera, zmiana unieważnia wpisy pamięci podręcznej.
+     */
+    static const QString version;
+
+protected:
+    /**
+     * @brief Opis ostatniego błędu.
+     */
+    QString last_error;
+};
+
+#endif // DASSEMBLER_H
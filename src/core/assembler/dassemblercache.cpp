@@ -0,0 +1,141 @@
+#include <core/assembler/dassemblercache.h>
+#include <core/assembler/dassembler.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+#include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
+
+const QString DAssemblerCache::file_suffix = ".bin";
+
+DAssemblerCache::DAssemblerCache() :
+    cachePath(DJobContext::current().getAssemblerCachePath()),
+    maxSize(static_cast<qint64>(DJobContext::current().getAssemblerCacheSize()) * 1024 * 1024),
+    enabled(false),
+    hits(0),
+    misses(0)
+{
+    init();
+}
+
+DAssemblerCache::DAssemblerCache(const QString &path, qint64 limit) :
+    cachePath(path),
+    maxSize(limit),
+    enabled(false),
+    hits(0),
+    misses(0)
+{
+    init();
+}
+
+void DAssemblerCache::init()
+{
+    if(cachePath.isEmpty() || maxSize <= 0)
+        return;
+
+    if(!QDir().mkpath(cachePath))
+    {
+        LOG_WARN(QString("Cannot create assembler cache directory %1, cache disabled.").arg(cachePath));
+        return;
+    }
+
+    enabled = true;
+}
+
+QString DAssemblerCache::makeKey(const QString &code, uint8_t bits) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    hash.addData(DAssembler::version.toUtf8());
+    hash.addData(DJobContext::current().getAssembler().toUtf8());
+    hash.addData(QByteArray::number(bits));
+    hash.addData(code.toUtf8());
+
+    return QString(hash.result().toHex());
+}
+
+bool DAssemblerCache::lookup(const QString &code, uint8_t bits, QByteArray &compiled)
+{
+    if(!enabled)
+        return false;
+
+    QFile f(QDir(cachePath).filePath(makeKey(code, bits) + file_suffix));
+
+    if(!f.open(QFile::ReadOnly))
+    {
+        misses.ref();
+        return false;
+    }
+
+    compiled = f.readAll();
+
+    // Odświeżenie czasu użycia na potrzeby LRU
+    f.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+    f.close();
+
+    hits.ref();
+    return true;
+}
+
+bool DAssemblerCache::store(const QString &code, uint8_t bits, const QByteArray &compiled)
+{
+    if(!enabled)
+        return false;
+
+    // QSaveFile zapisuje do pliku tymczasowego i podmienia go atomowo
+    QSaveFile f(QDir(cachePath).filePath(makeKey(code, bits) + file_suffix));
+
+    if(!f.open(QFile::WriteOnly) || f.write(compiled) != compiled.size() || !f.commit())
+    {
+        LOG_WARN("Cannot write assembler cache entry.");
+        return false;
+    }
+
+    evict();
+    return true;
+}
+
+void DAssemblerCache::evict()
+{
+    QFileInfoList entries = QDir(cachePath).entryInfoList({ "*" + file_suffix }, QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 size = 0;
+
+    foreach(const QFileInfo &fi, entries)
+        size += fi.size();
+
+    // Najstarsze wpisy są na początku listy, wpisy usunięte przez inny proces są pomijane
+    for(int i = 0; i < entries.length() && size > maxSize; ++i)
+    {
+        if(QFile::remove(entries[i].absoluteFilePath()))
+            size -= entries[i].size();
+    }
+}
+
+void DAssemblerCache::clear()
+{
+    if(!enabled)
+        return;
+
+    foreach(const QFileInfo &fi, QDir(cachePath).entryInfoList({ "*" + file_suffix }, QDir::Files))
+        QFile::remove(fi.absoluteFilePath());
+}
+
+bool DAssemblerCache::isEnabled() const
+{
+    return enabled;
+}
+
+int DAssemblerCache::getHits() const
+{
+    return hits.load();
+}
+
+int DAssemblerCache::getMisses() const
+{
+    return misses.load();
+}
@@ -0,0 +1,90 @@
+#ifndef DASSEMBLERCACHE_H
+#define DASSEMBLERCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QAtomicInt>
+
+/**
+ * @brief Dyskowa pamięć podręczna skompilowanego kodu adresowana skrótem kodu źródłowego.
+ *
+ * Wpisy są zapisywane atomowo (plik tymczasowy + zmiana nazwy), dzięki czemu katalog
+ * może być współdzielony przez kilka procesów. Po przekroczeniu limitu rozmiaru usuwane
+ * są najdawniej używane wpisy (czas modyfikacji pliku jest odświeżany przy każdym trafieniu).
+ */
+class DAssemblerCache
+{
+private:
+    DAssemblerCache();
+    DAssemblerCache(const DAssemblerCache &) = delete;
+
+    const static QString file_suffix;
+
+    QString cachePath;
+    qint64 maxSize;
+    bool enabled;
+
+    QAtomicInt hits;
+    QAtomicInt misses;
+
+    /**
+     * @brief Metoda przygotowująca katalog pamięci podręcznej.
+     */
+    void init();
+
+    /**
+     * @brief Metoda wyliczająca klucz wpisu.
+     * @param code kod źródłowy.
+     * @param bits architektura (32 lub 64).
+     * @return Klucz w postaci szesnastkowej.
+     */
+    QString makeKey(const QString &code, uint8_t bits) const;
+
+    /**
+     * @brief Metoda usuwająca najdawniej używane wpisy, dopóki rozmiar przekracza limit.
+     */
+    void evict();
+
+public:
+    /**
+     * @brief Konstruktor pamięci podręcznej w podanym katalogu (niezależnej od ustawień).
+     * @param path katalog wpisów.
+     * @param limit limit rozmiaru w bajtach.
+     */
+    DAssemblerCache(const QString &path, qint64 limit);
+
+    static DAssemblerCache &getCache()
+    {
+        static DAssemblerCache c;
+        return c;
+    }
+
+    /**
+     * @brief Metoda wyszukująca skompilowany kod w pamięci podręcznej.
+     * @param code kod źródłowy.
+     * @param bits architektura (32 lub 64).
+     * @param compiled skompilowany kod.
+     * @return True jeżeli wpis został znaleziony, False w innych przypadkach.
+     */
+    bool lookup(const QString &code, uint8_t bits, QByteArray &compiled);
+
+    /**
+     * @brief Metoda zapisująca skompilowany kod w pamięci podręcznej.
+     * @param code kod źródłowy.
+     * @param bits architektura (32 lub 64).
+     * @param compiled skompilowany kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool store(const QString &code, uint8_t bits, const QByteArray &compiled);
+
+    /**
+     * @brief Metoda usuwająca wszystkie wpisy.
+     */
+    void clear();
+
+    bool isEnabled() const;
+    int getHits() const;
+    int getMisses() const;
+};
+
+#endif // DASSEMBLERCACHE_H
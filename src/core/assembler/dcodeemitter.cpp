@@ -0,0 +1,459 @@
+#include <core/assembler/dcodeemitter.h>
+
+#include <cstdint>
+
+#include <helper/logger/dlogger.h>
+
+template <>
+const bool DCodeEmitter<Registers_x86>::x64 = false;
+
+template <>
+const bool DCodeEmitter<Registers_x64>::x64 = true;
+
+// Kolejność rejestrów w Registers_x86 i Registers_x64 jest inna niż w kodowaniu instrukcji
+template <typename Register>
+const uint8_t DCodeEmitter<Register>::numbers[16] = { 0, 3, 1, 2, 6, 7, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15 };
+template const uint8_t DCodeEmitter<Registers_x86>::numbers[16];
+template const uint8_t DCodeEmitter<Registers_x64>::numbers[16];
+
+template <typename Register>
+DCodeEmitter<Register>::DCodeEmitter() :
+    failed(false)
+{
+}
+template DCodeEmitter<Registers_x86>::DCodeEmitter();
+template DCodeEmitter<Registers_x64>::DCodeEmitter();
+
+template <typename Register>
+uint8_t DCodeEmitter<Register>::number(Register reg)
+{
+    return numbers[static_cast<int>(reg) & 0xf];
+}
+
+template <typename Register>
+void DCodeEmitter<Register>::rex(bool w, uint8_t r, uint8_t b)
+{
+    if(!x64)
+        return;
+
+    uint8_t prefix = 0x40 | (w ? 0x08 : 0) | ((r & 8) >> 1) | ((b & 8) >> 3);
+    if(prefix != 0x40)
+        buffer.append(static_cast<char>(prefix));
+}
+
+template <typename Register>
+void DCodeEmitter<Register>::modrm(uint8_t opcode, uint8_t reg, uint8_t rm, bool wide)
+{
+    rex(wide, reg, rm);
+    buffer.append(static_cast<char>(opcode));
+    buffer.append(static_cast<char>(0xc0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+template <typename Register>
+typename DCodeEmitter<Register>::Label DCodeEmitter<Register>::newLabel()
+{
+    Bound b;
+    b.pos = -1;
+    b.branches = 0;
+
+    labels.append(b);
+
+    return labels.size() - 1;
+}
+template DCodeEmitter<Registers_x86>::Label DCodeEmitter<Registers_x86>::newLabel();
+template DCodeEmitter<Registers_x64>::Label DCodeEmitter<Registers_x64>::newLabel();
+
+template <typename Register>
+void DCodeEmitter<Register>::bind(Label label)
+{
+    if(label < 0 || label >= labels.size() || labels[label].pos >= 0)
+    {
+        failed = true;
+        return;
+    }
+
+    labels[label].pos = buffer.size();
+    labels[label].branches = branches.size();
+}
+template void DCodeEmitter<Registers_x86>::bind(Label label);
+template void DCodeEmitter<Registers_x64>::bind(Label label);
+
+template <typename Register>
+void DCodeEmitter<Register>::append(const QByteArray &bytes)
+{
+    buffer.append(bytes);
+}
+template void DCodeEmitter<Registers_x86>::append(const QByteArray &bytes);
+template void DCodeEmitter<Registers_x64>::append(const QByteArray &bytes);
+
+template <typename Register>
+void DCodeEmitter<Register>::push(Register reg)
+{
+    uint8_t n = number(reg);
+    rex(false, 0, n);
+    buffer.append(static_cast<char>(0x50 + (n & 7)));
+}
+template void DCodeEmitter<Registers_x86>::push(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::push(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::pop(Register reg)
+{
+    uint8_t n = number(reg);
+    rex(false, 0, n);
+    buffer.append(static_cast<char>(0x58 + (n & 7)));
+}
+template void DCodeEmitter<Registers_x86>::pop(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::pop(Registers_x64 reg);
+
+template <>
+void DCodeEmitter<Registers_x86>::pushRegs(const QList<Registers_x86> &regs)
+{
+    foreach(Registers_x86 r, regs)
+    {
+        if(r == Registers_x86::All)
+            buffer.append('\x60'); // pushad
+        else if(r != Registers_x86::None)
+            push(r);
+    }
+}
+
+template <>
+void DCodeEmitter<Registers_x64>::pushRegs(const QList<Registers_x64> &regs)
+{
+    foreach(Registers_x64 r, regs)
+    {
+        if(r == Registers_x64::None)
+            continue;
+
+        if(r != Registers_x64::All)
+        {
+            push(r);
+            continue;
+        }
+
+        // x64 nie ma pushad, zapisywane są wszystkie rejestry poza wskaźnikiem stosu
+        for(int i = static_cast<int>(Registers_x64::RAX); i < static_cast<int>(Registers_x64::None); ++i)
+            if(static_cast<Registers_x64>(i) != Registers_x64::RSP)
+                push(static_cast<Registers_x64>(i));
+    }
+}
+
+template <>
+void DCodeEmitter<Registers_x86>::popRegs(const QList<Registers_x86> &regs)
+{
+    foreach(Registers_x86 r, regs)
+    {
+        if(r == Registers_x86::All)
+            buffer.append('\x61'); // popad
+        else if(r != Registers_x86::None)
+            pop(r);
+    }
+}
+
+template <>
+void DCodeEmitter<Registers_x64>::popRegs(const QList<Registers_x64> &regs)
+{
+    foreach(Registers_x64 r, regs)
+    {
+        if(r == Registers_x64::None)
+            continue;
+
+        if(r != Registers_x64::All)
+        {
+            pop(r);
+            continue;
+        }
+
+        // odwrotna kolejność niż w pushRegs
+        for(int i = static_cast<int>(Registers_x64::None) - 1; i >= static_cast<int>(Registers_x64::RAX); --i)
+            if(static_cast<Registers_x64>(i) != Registers_x64::RSP)
+                pop(static_cast<Registers_x64>(i));
+    }
+}
+
+template <typename Register>
+void DCodeEmitter<Register>::pushFlags()
+{
+    buffer.append(CodeDefines<Register>::saveFlags);
+}
+template void DCodeEmitter<Registers_x86>::pushFlags();
+template void DCodeEmitter<Registers_x64>::pushFlags();
+
+template <typename Register>
+void DCodeEmitter<Register>::popFlags()
+{
+    buffer.append(CodeDefines<Register>::restoreFlags);
+}
+template void DCodeEmitter<Registers_x86>::popFlags();
+template void DCodeEmitter<Registers_x64>::popFlags();
+
+template <typename Register>
+void DCodeEmitter<Register>::movRegImm(Register reg, uint64_t value)
+{
+    uint8_t n = number(reg);
+    int64_t svalue = static_cast<int64_t>(value);
+
+    if(!x64 || value <= 0xffffffffULL)
+    {
+        // zapis do 32-bitowego rejestru zeruje jego starszą połowę
+        uint32_t imm = static_cast<uint32_t>(value);
+        rex(false, 0, n);
+        buffer.append(static_cast<char>(0xb8 + (n & 7)));
+        buffer.append(reinterpret_cast<const char*>(&imm), sizeof(imm));
+    }
+    else if(svalue >= INT32_MIN && svalue <= INT32_MAX)
+    {
+        int32_t imm = static_cast<int32_t>(svalue);
+        modrm(0xc7, 0, n, true);
+        buffer.append(reinterpret_cast<const char*>(&imm), sizeof(imm));
+    }
+    else
+    {
+        rex(true, 0, n);
+        buffer.append(static_cast<char>(0xb8 + (n & 7)));
+        buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+}
+template void DCodeEmitter<Registers_x86>::movRegImm(Registers_x86 reg, uint64_t value);
+template void DCodeEmitter<Registers_x64>::movRegImm(Registers_x64 reg, uint64_t value);
+
+template <typename Register>
+void DCodeEmitter<Register>::opRegReg(Operation op, Register dst, Register src)
+{
+    modrm(static_cast<uint8_t>(op), number(src), number(dst), true);
+}
+template void DCodeEmitter<Registers_x86>::opRegReg(Operation op, Registers_x86 dst, Registers_x86 src);
+template void DCodeEmitter<Registers_x64>::opRegReg(Operation op, Registers_x64 dst, Registers_x64 src);
+
+template <typename Register>
+void DCodeEmitter<Register>::addRegImm32(Register reg, uint32_t value)
+{
+    modrm(0x81, 0, number(reg), true);
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+template void DCodeEmitter<Registers_x86>::addRegImm32(Registers_x86 reg, uint32_t value);
+template void DCodeEmitter<Registers_x64>::addRegImm32(Registers_x64 reg, uint32_t value);
+
+template <typename Register>
+void DCodeEmitter<Register>::zeroReg(Register reg)
+{
+    uint8_t n = number(reg);
+    modrm(static_cast<uint8_t>(Operation::Xor), n, n, false);
+}
+template void DCodeEmitter<Registers_x86>::zeroReg(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::zeroReg(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::decReg(Register reg)
+{
+    modrm(0xff, 1, number(reg), true);
+}
+template void DCodeEmitter<Registers_x86>::decReg(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::decReg(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::notReg(Register reg)
+{
+    modrm(0xf7, 2, number(reg), true);
+}
+template void DCodeEmitter<Registers_x86>::notReg(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::notReg(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::callReg(Register reg)
+{
+    // na x64 call i jmp mają domyślnie 64-bitowy operand
+    modrm(0xff, 2, number(reg), false);
+}
+template void DCodeEmitter<Registers_x86>::callReg(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::callReg(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::jmpReg(Register reg)
+{
+    modrm(0xff, 4, number(reg), false);
+}
+template void DCodeEmitter<Registers_x86>::jmpReg(Registers_x86 reg);
+template void DCodeEmitter<Registers_x64>::jmpReg(Registers_x64 reg);
+
+template <typename Register>
+void DCodeEmitter<Register>::syscall()
+{
+    buffer.append(x64 ? QByteArray("\x0f\x05", 2) : QByteArray("\xcd\x80", 2));
+}
+template void DCodeEmitter<Registers_x86>::syscall();
+template void DCodeEmitter<Registers_x64>::syscall();
+
+template <typename Register>
+void DCodeEmitter<Register>::repMovsb()
+{
+    buffer.append("\xf3\xa4", 2);
+}
+template void DCodeEmitter<Registers_x86>::repMovsb();
+template void DCodeEmitter<Registers_x64>::repMovsb();
+
+template <typename Register>
+void DCodeEmitter<Register>::branch(uint8_t opcode, Label label)
+{
+    if(label < 0 || label >= labels.size())
+    {
+        failed = true;
+        return;
+    }
+
+    Branch b;
+    b.pos = buffer.size();
+    b.opcode = opcode;
+    b.target = label;
+
+    branches.append(b);
+}
+
+template <typename Register>
+void DCodeEmitter<Register>::jmp(Label label)
+{
+    branch(0xeb, label);
+}
+template void DCodeEmitter<Registers_x86>::jmp(Label label);
+template void DCodeEmitter<Registers_x64>::jmp(Label label);
+
+template <typename Register>
+void DCodeEmitter<Register>::jcc(Condition cond, Label label)
+{
+    branch(0x70 + static_cast<uint8_t>(cond), label);
+}
+template void DCodeEmitter<Registers_x86>::jcc(Condition cond, Label label);
+template void DCodeEmitter<Registers_x64>::jcc(Condition cond, Label label);
+
+template <typename Register>
+void DCodeEmitter<Register>::call(Label label)
+{
+    branch(0xe8, label);
+}
+template void DCodeEmitter<Registers_x86>::call(Label label);
+template void DCodeEmitter<Registers_x64>::call(Label label);
+
+template <typename Register>
+uint8_t DCodeEmitter<Register>::nearSize(uint8_t opcode)
+{
+    // jcc rel32 ma dwubajtowy opcode 0x0f 0x80 + cc
+    return opcode == 0xe8 || opcode == 0xeb ? 5 : 6;
+}
+
+template <typename Register>
+bool DCodeEmitter<Register>::finish()
+{
+    code.clear();
+    offsets.clear();
+    fixups.clear();
+
+    if(failed)
+    {
+        LOG_ERROR("Invalid label used in generated code.");
+        return false;
+    }
+
+    int count = branches.size();
+    QVector<uint8_t> sizes(count);
+    QVector<uint32_t> before(count + 1);
+
+    // skoki zaczynają w formie krótkiej i są wydłużane, dopóki któryś nie mieści się w rel8;
+    // wydłużenie skoku tylko oddala od siebie etykiety, więc pętla kończy się po co najwyżej count przebiegach
+    for(int i = 0; i < count; ++i)
+        sizes[i] = branches[i].opcode == 0xe8 || labels[branches[i].target].pos < 0 ?
+                    nearSize(branches[i].opcode) : 2;
+
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+
+        before[0] = 0;
+        for(int i = 0; i < count; ++i)
+            before[i + 1] = before[i] + sizes[i];
+
+        for(int i = 0; i < count; ++i)
+        {
+            if(sizes[i] != 2)
+                continue;
+
+            const Bound &t = labels[branches[i].target];
+            int64_t disp = static_cast<int64_t>(t.pos + before[t.branches]) -
+                    (branches[i].pos + before[i] + 2);
+
+            if(disp < INT8_MIN || disp > INT8_MAX)
+            {
+                sizes[i] = nearSize(branches[i].opcode);
+                changed = true;
+            }
+        }
+    }
+
+    offsets.resize(labels.size());
+    fixups.resize(labels.size());
+
+    for(int l = 0; l < labels.size(); ++l)
+        offsets[l] = labels[l].pos < 0 ? 0 : labels[l].pos + before[labels[l].branches];
+
+    code.reserve(buffer.size() + before[count]);
+
+    uint32_t copied = 0;
+    for(int i = 0; i < count; ++i)
+    {
+        const Branch &b = branches[i];
+
+        code.append(buffer.constData() + copied, b.pos - copied);
+        copied = b.pos;
+
+        uint32_t end = code.size() + sizes[i];
+        int32_t disp = labels[b.target].pos < 0 ? 0 : static_cast<int32_t>(offsets[b.target] - end);
+
+        if(sizes[i] == 2)
+        {
+            code.append(static_cast<char>(b.opcode));
+            code.append(static_cast<char>(disp));
+            continue;
+        }
+
+        if(b.opcode == 0xe8 || b.opcode == 0xeb)
+            code.append(static_cast<char>(b.opcode == 0xeb ? 0xe9 : 0xe8));
+        else
+            code.append('\x0f').append(static_cast<char>(b.opcode + 0x10));
+
+        if(labels[b.target].pos < 0)
+            fixups[b.target].append(code.size());
+
+        code.append(reinterpret_cast<const char*>(&disp), sizeof(disp));
+    }
+
+    code.append(buffer.constData() + copied, buffer.size() - copied);
+
+    return true;
+}
+template bool DCodeEmitter<Registers_x86>::finish();
+template bool DCodeEmitter<Registers_x64>::finish();
+
+template <typename Register>
+const QByteArray &DCodeEmitter<Register>::getCode() const
+{
+    return code;
+}
+template const QByteArray &DCodeEmitter<Registers_x86>::getCode() const;
+template const QByteArray &DCodeEmitter<Registers_x64>::getCode() const;
+
+template <typename Register>
+uint32_t DCodeEmitter<Register>::getOffset(Label label) const
+{
+    return label >= 0 && label < offsets.size() ? offsets[label] : 0;
+}
+template uint32_t DCodeEmitter<Registers_x86>::getOffset(Label label) const;
+template uint32_t DCodeEmitter<Registers_x64>::getOffset(Label label) const;
+
+template <typename Register>
+QList<uint32_t> DCodeEmitter<Register>::getFixups(Label label) const
+{
+    return label >= 0 && label < fixups.size() ? fixups[label] : QList<uint32_t>();
+}
+template QList<uint32_t> DCodeEmitter<Registers_x86>::getFixups(Label label) const;
+template QList<uint32_t> DCodeEmitter<Registers_x64>::getFixups(Label label) const;
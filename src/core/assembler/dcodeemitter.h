@@ -0,0 +1,259 @@
+#ifndef DCODEEMITTER_H
+#define DCODEEMITTER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+#include <core/file_types/codedefines.h>
+
+/**
+ * @brief Generator kodu maszynowego x86/x64 zapisujący instrukcje bezpośrednio do bufora bajtów.
+ *
+ * Zastępuje składanie tekstu assembly (AsmCodeGenerator) i jego kompilację tam, gdzie kod jest
+ * budowany z pojedynczych instrukcji. Skoki odwołują się do etykiet; przy finish() każdy skok
+ * jmp/jcc dostaje najkrótszą formę (rel8 lub rel32), a offsety etykiet są przeliczane.
+ * Etykiety, które nie zostały związane z miejscem w kodzie, są zewnętrzne - skoki do nich mają
+ * formę rel32 z zerowym przesunięciem, a offsety tych pól zwraca getFixups().
+ */
+template <typename Register>
+class DCodeEmitter
+{
+public:
+    /**
+     * @brief Identyfikator etykiety.
+     */
+    typedef int Label;
+
+    /**
+     * @brief Warunki skoków (kodowanie zgodne z opcode 0x70 + cc).
+     */
+    enum class Condition : uint8_t
+    {
+        O = 0,
+        NO,
+        B,
+        AE,
+        E,
+        NE,
+        BE,
+        A,
+        S,
+        NS,
+        P,
+        NP,
+        L,
+        GE,
+        LE,
+        G
+    };
+
+    /**
+     * @brief Operacje arytmetyczno-logiczne reg, reg (opcode formy r/m, reg).
+     */
+    enum class Operation : uint8_t
+    {
+        Add = 0x01,
+        Or  = 0x09,
+        And = 0x21,
+        Sub = 0x29,
+        Xor = 0x31,
+        Mov = 0x89
+    };
+
+    DCodeEmitter();
+
+    /**
+     * @brief Tworzy nową, niezwiązaną etykietę.
+     * @return Etykieta.
+     */
+    Label newLabel();
+
+    /**
+     * @brief Wiąże etykietę z bieżącym miejscem w kodzie.
+     * @param label etykieta.
+     */
+    void bind(Label label);
+
+    /**
+     * @brief Dopisuje gotowy kod.
+     * @param bytes kod.
+     */
+    void append(const QByteArray &bytes);
+
+    void push(Register reg);
+    void pop(Register reg);
+
+    /**
+     * @brief Odkłada rejestry na stos w podanej kolejności (None jest pomijany, All zapisuje wszystkie).
+     * @param regs lista rejestrów.
+     */
+    void pushRegs(const QList<Register> &regs);
+
+    /**
+     * @brief Pobiera rejestry ze stosu w podanej kolejności (None jest pomijany, All odczytuje wszystkie).
+     * @param regs lista rejestrów.
+     */
+    void popRegs(const QList<Register> &regs);
+
+    void pushFlags();
+    void popFlags();
+
+    /**
+     * @brief Instrukcja mov reg, value w najkrótszej formie (na x64 mov r32 dla wartości 32-bitowych
+     * bez znaku, mov r64, imm32 dla wartości ze znakiem, w innym przypadku mov r64, imm64).
+     * @param reg rejestr.
+     * @param value wartość.
+     */
+    void movRegImm(Register reg, uint64_t value);
+
+    /**
+     * @brief Instrukcja op dst, src na rejestrach pełnej szerokości.
+     * @param op operacja.
+     * @param dst rejestr docelowy.
+     * @param src rejestr źródłowy.
+     */
+    void opRegReg(Operation op, Register dst, Register src);
+
+    /**
+     * @brief Instrukcja add reg, imm32 zawsze z 32-bitową wartością, więc można ją później nadpisać.
+     * @param reg rejestr.
+     * @param value wartość.
+     */
+    void addRegImm32(Register reg, uint32_t value);
+
+    /**
+     * @brief Zerowanie rejestru (xor r32, r32).
+     * @param reg rejestr.
+     */
+    void zeroReg(Register reg);
+
+    void decReg(Register reg);
+    void notReg(Register reg);
+    void callReg(Register reg);
+    void jmpReg(Register reg);
+
+    /**
+     * @brief Wywołanie systemowe: int 0x80 na x86, syscall na x64.
+     */
+    void syscall();
+
+    /**
+     * @brief Instrukcja rep movsb.
+     */
+    void repMovsb();
+
+    /**
+     * @brief Skok do etykiety (jmp rel8 lub jmp rel32).
+     * @param label etykieta.
+     */
+    void jmp(Label label);
+
+    /**
+     * @brief Skok warunkowy do etykiety (jcc rel8 lub jcc rel32).
+     * @param cond warunek.
+     * @param label etykieta.
+     */
+    void jcc(Condition cond, Label label);
+
+    /**
+     * @brief Wywołanie etykiety (zawsze call rel32).
+     * @param label etykieta.
+     */
+    void call(Label label);
+
+    /**
+     * @brief Rozmieszcza skoki i składa kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool finish();
+
+    /**
+     * @brief Kod wygenerowany przez finish().
+     * @return Kod.
+     */
+    const QByteArray &getCode() const;
+
+    /**
+     * @brief Offset związanej etykiety w kodzie wygenerowanym przez finish().
+     * @param label etykieta.
+     * @return Offset.
+     */
+    uint32_t getOffset(Label label) const;
+
+    /**
+     * @brief Offsety 32-bitowych przesunięć skoków do etykiety zewnętrznej, w kodzie wygenerowanym przez finish().
+     * Przesunięcie jest liczone względem końca instrukcji, czyli offsetu pola + 4.
+     * @param label etykieta.
+     * @return Lista offsetów.
+     */
+    QList<uint32_t> getFixups(Label label) const;
+
+private:
+    /**
+     * @brief Skok do etykiety, wstawiany między bajty bufora przy finish().
+     */
+    typedef struct _Branch
+    {
+        uint32_t pos;
+        uint8_t opcode;
+        Label target;
+    } Branch;
+
+    /**
+     * @brief Położenie etykiety: miejsce w buforze oraz liczba skoków przed nią.
+     */
+    typedef struct _Bound
+    {
+        int32_t pos;
+        int branches;
+    } Bound;
+
+    /**
+     * @brief Numer rejestru w kodowaniu instrukcji (0-15).
+     * @param reg rejestr.
+     * @return Numer rejestru.
+     */
+    static uint8_t number(Register reg);
+
+    /**
+     * @brief Dopisuje prefiks REX, jeżeli jest potrzebny.
+     * @param w 64-bitowy rozmiar operandu.
+     * @param r rozszerzenie pola reg.
+     * @param b rozszerzenie pola r/m.
+     */
+    void rex(bool w, uint8_t r, uint8_t b);
+
+    /**
+     * @brief Dopisuje instrukcję z bajtem ModRM w trybie rejestrowym.
+     * @param opcode opcode.
+     * @param reg pole reg (rejestr lub rozszerzenie opcode).
+     * @param rm rejestr w polu r/m.
+     * @param wide 64-bitowy rozmiar operandu na x64.
+     */
+    void modrm(uint8_t opcode, uint8_t reg, uint8_t rm, bool wide);
+
+    void branch(uint8_t opcode, Label label);
+
+    /**
+     * @brief Rozmiar skoku w formie rel32.
+     * @param opcode opcode formy rel8 (dla call - formy rel32).
+     * @return Rozmiar instrukcji.
+     */
+    static uint8_t nearSize(uint8_t opcode);
+
+    static const bool x64;
+    static const uint8_t numbers[16];
+
+    bool failed;
+
+    QByteArray buffer;
+    QList<Branch> branches;
+    QVector<Bound> labels;
+
+    QByteArray code;
+    QVector<uint32_t> offsets;
+    QVector<QList<uint32_t> > fixups;
+};
+
+#endif // DCODEEMITTER_H
@@ -0,0 +1,112 @@
+#include <core/assembler/dcodeobject.h>
+#include <core/assembler/dassembler.h>
+
+#include <QStringList>
+
+#include <helper/logger/dlogger.h>
+
+uint32_t DCodeObject::probe(int idx, bool second)
+{
+    uint32_t value = 0x41424300 | (idx & 0xff);
+    return second ? value ^ 0x1f1f1f1f : value;
+}
+
+bool DCodeObject::assemble(const QString &code, uint8_t bits, const QMap<QString, QString> &placeholders, DCodeObject &obj)
+{
+    obj.code.clear();
+    obj.patchSlots.clear();
+
+    QStringList names;
+    foreach(const QString &name, placeholders.keys())
+        if(code.contains(placeholders[name]))
+            names.append(name);
+
+    if(names.size() > 0xff)
+        return false;
+
+    QString first(code), second(code);
+    for(int i = 0; i < names.size(); ++i)
+    {
+        first.replace(placeholders[names[i]], QString::number(probe(i, false)));
+        second.replace(placeholders[names[i]], QString::number(probe(i, true)));
+    }
+
+    if(!DAssembler::compile(first, bits, obj.code))
+        return false;
+
+    if(names.isEmpty())
+        return true;
+
+    QByteArray other;
+    if(!DAssembler::compile(second, bits, other))
+        return false;
+
+    if(other.size() != obj.code.size())
+    {
+        LOG_ERROR("Patch slot values changed the size of assembled code.");
+        return false;
+    }
+
+    // Różnią się tylko bajty slotów, a wartość pierwszej próby wskazuje, który to slot
+    const uchar *a = reinterpret_cast<const uchar*>(obj.code.constData());
+    const uchar *b = reinterpret_cast<const uchar*>(other.constData());
+    int size = obj.code.size();
+
+    for(int off = 0; off < size; )
+    {
+        if(a[off] == b[off])
+        {
+            ++off;
+            continue;
+        }
+
+        if(off + 4 > size)
+            return false;
+
+        uint32_t va = a[off] | (a[off + 1] << 8) | (a[off + 2] << 16) | (static_cast<uint32_t>(a[off + 3]) << 24);
+        uint32_t vb = b[off] | (b[off + 1] << 8) | (b[off + 2] << 16) | (static_cast<uint32_t>(b[off + 3]) << 24);
+        int idx = va & 0xff;
+
+        if(idx >= names.size() || va != probe(idx, false) || vb != probe(idx, true))
+        {
+            LOG_ERROR(QString("Patch slot at offset %1 is not a 32-bit immediate.").arg(off));
+            return false;
+        }
+
+        Slot s;
+        s.name = names[idx];
+        s.offset = off;
+        obj.patchSlots.append(s);
+
+        off += 4;
+    }
+
+    return true;
+}
+
+int DCodeObject::patch(const QString &name, uint32_t value)
+{
+    int cnt = 0;
+
+    foreach(const Slot &s, patchSlots)
+    {
+        if(s.name != name)
+            continue;
+
+        for(int i = 0; i < 4; ++i)
+            code[s.offset + i] = static_cast<char>((value >> (8 * i)) & 0xff);
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+const QByteArray &DCodeObject::getCode() const
+{
+    return code;
+}
+
+const QList<DCodeObject::Slot> &DCodeObject::getPatchSlots() const
+{
+    return patchSlots;
+}
@@ -0,0 +1,65 @@
+#ifndef DCODEOBJECT_H
+#define DCODEOBJECT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+
+/**
+ * @brief Skompilowany kod z nazwanymi miejscami do uzupełnienia (slotami).
+ *
+ * Wartości znane dopiero po zmianie pliku (rozmiar i suma kontrolna sekcji, offset do sekcji)
+ * nie są wstawiane do kodu źródłowego. Zamiast nich kod jest kompilowany z dwoma różnymi
+ * wartościami próbnymi każdego slotu i położenie slotu wynika z porównania obu wyników.
+ * Kod źródłowy nie zależy więc od pliku (trafia do pamięci podręcznej asemblera), a wartości
+ * są zapisywane pod znanymi offsetami bez przeszukiwania kodu w poszukiwaniu stałych.
+ */
+class DCodeObject
+{
+public:
+    /**
+     * @brief Slot: 4 bajty wartości natychmiastowej (little endian) pod danym offsetem kodu.
+     */
+    typedef struct _Slot
+    {
+        QString name;
+        uint32_t offset;
+    } Slot;
+
+    /**
+     * @brief Metoda kompilująca kod, w którym parametry z listy slotów pozostały niewypełnione.
+     * @param code kod źródłowy.
+     * @param bits architektura (32 lub 64).
+     * @param placeholders teksty parametrów w kodzie źródłowym, według nazw slotów.
+     * @param obj skompilowany kod wraz z offsetami slotów.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool assemble(const QString &code, uint8_t bits, const QMap<QString, QString> &placeholders, DCodeObject &obj);
+
+    /**
+     * @brief Metoda wpisująca wartość do wszystkich wystąpień slotu.
+     * @param name nazwa slotu.
+     * @param value wartość (zapisywane są 4 młodsze bajty).
+     * @return Liczba uzupełnionych wystąpień.
+     */
+    int patch(const QString &name, uint32_t value);
+
+    const QByteArray &getCode() const;
+    const QList<Slot> &getPatchSlots() const;
+
+private:
+    /**
+     * @brief Wartości próbne slotu. Obie są z przedziału, w którym asembler wybiera 32-bitową
+     * wartość natychmiastową, i różnią się każdym bajtem.
+     * @param idx numer slotu.
+     * @param second True dla drugiej wartości.
+     * @return Wartość próbna.
+     */
+    static uint32_t probe(int idx, bool second);
+
+    QByteArray code;
+    QList<Slot> patchSlots;
+};
+
+#endif // DCODEOBJECT_H
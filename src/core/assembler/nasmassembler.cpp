@@ -0,0 +1,64 @@
+#include <core/assembler/nasmassembler.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QProcess>
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+
+#include <helper/job_context/djobcontext.h>
+
+bool NasmAssembler::assemble(const QString &code, QByteArray &compiled)
+{
+    // Pliki tymczasowe w katalogu zadania, równoległe zadania nie współdzielą ścieżek
+    DJobContext &job = DJobContext::current();
+    QString scratch = job.getScratchPath();
+    if(scratch.isEmpty())
+    {
+        last_error = "Cannot create job scratch directory.";
+        return false;
+    }
+
+    QTemporaryFile temp_file(QDir(scratch).filePath("code-XXXXXX.asm"));
+    if(!temp_file.open())
+    {
+        last_error = "Cannot create temporary file.";
+        return false;
+    }
+
+    temp_file.write(code.toUtf8());
+    temp_file.flush();
+
+    QTemporaryDir compile_dir(QDir(scratch).filePath("nasm-XXXXXX"));
+    if(!compile_dir.isValid())
+    {
+        last_error = "Cannot create temporary directory.";
+        return false;
+    }
+
+    QString data_file = QFileInfo(compile_dir.path(), "data.bin").absoluteFilePath();
+
+    QProcess nasm;
+    nasm.setProcessChannelMode(QProcess::MergedChannels);
+    nasm.start(job.getNasmPath(),
+               {"-f", "bin", "-o", data_file, QFileInfo(temp_file).absoluteFilePath()});
+
+    if(!nasm.waitForFinished() || nasm.exitStatus() != QProcess::NormalExit || nasm.exitCode() != 0)
+    {
+        last_error = QString("Executing nasm failed: %1").arg(QString(nasm.readAll()).trimmed());
+        return false;
+    }
+
+    QFile f(data_file);
+    if(!f.open(QFile::ReadOnly))
+    {
+        last_error = "Cannot open compiled file.";
+        return false;
+    }
+
+    compiled = f.readAll();
+    f.close();
+
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef NASMASSEMBLER_H
+#define NASMASSEMBLER_H
+
+#include <core/assembler/dassembler.h>
+
+/**
+ * @brief Asembler uruchamiający zewnętrzny program nasm.
+ */
+class NasmAssembler : public DAssembler
+{
+public:
+    /**
+     * @brief Metoda kompilująca kod źródłowy assembly za pomocą programu nasm.
+     * @param code kod źródłowy.
+     * @param compiled skompilowany kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    virtual bool assemble(const QString &code, QByteArray &compiled) override;
+};
+
+#endif // NASMASSEMBLER_H
@@ -0,0 +1,1660 @@
+#include <core/assembler/nativeassembler.h>
+
+const int NativeAssembler::max_passes = 32;
+
+const QMap<QString, NativeAssembler::RegisterInfo> NativeAssembler::registers = {
+    { "al",   { 0,  8,  false, false, false } },
+    { "cl",   { 1,  8,  false, false, false } },
+    { "dl",   { 2,  8,  false, false, false } },
+    { "bl",   { 3,  8,  false, false, false } },
+    { "ah",   { 4,  8,  false, true,  false } },
+    { "ch",   { 5,  8,  false, true,  false } },
+    { "dh",   { 6,  8,  false, true,  false } },
+    { "bh",   { 7,  8,  false, true,  false } },
+    { "spl",  { 4,  8,  true,  false, false } },
+    { "bpl",  { 5,  8,  true,  false, false } },
+    { "sil",  { 6,  8,  true,  false, false } },
+    { "dil",  { 7,  8,  true,  false, false } },
+    { "r8b",  { 8,  8,  true,  false, false } },
+    { "r9b",  { 9,  8,  true,  false, false } },
+    { "r10b", { 10, 8,  true,  false, false } },
+    { "r11b", { 11, 8,  true,  false, false } },
+    { "r12b", { 12, 8,  true,  false, false } },
+    { "r13b", { 13, 8,  true,  false, false } },
+    { "r14b", { 14, 8,  true,  false, false } },
+    { "r15b", { 15, 8,  true,  false, false } },
+    { "ax",   { 0,  16, false, false, false } },
+    { "cx",   { 1,  16, false, false, false } },
+    { "dx",   { 2,  16, false, false, false } },
+    { "bx",   { 3,  16, false, false, false } },
+    { "sp",   { 4,  16, false, false, false } },
+    { "bp",   { 5,  16, false, false, false } },
+    { "si",   { 6,  16, false, false, false } },
+    { "di",   { 7,  16, false, false, false } },
+    { "r8w",  { 8,  16, false, false, false } },
+    { "r9w",  { 9,  16, false, false, false } },
+    { "r10w", { 10, 16, false, false, false } },
+    { "r11w", { 11, 16, false, false, false } },
+    { "r12w", { 12, 16, false, false, false } },
+    { "r13w", { 13, 16, false, false, false } },
+    { "r14w", { 14, 16, false, false, false } },
+    { "r15w", { 15, 16, false, false, false } },
+    { "eax",  { 0,  32, false, false, false } },
+    { "ecx",  { 1,  32, false, false, false } },
+    { "edx",  { 2,  32, false, false, false } },
+    { "ebx",  { 3,  32, false, false, false } },
+    { "esp",  { 4,  32, false, false, false } },
+    { "ebp",  { 5,  32, false, false, false } },
+    { "esi",  { 6,  32, false, false, false } },
+    { "edi",  { 7,  32, false, false, false } },
+    { "r8d",  { 8,  32, false, false, false } },
+    { "r9d",  { 9,  32, false, false, false } },
+    { "r10d", { 10, 32, false, false, false } },
+    { "r11d", { 11, 32, false, false, false } },
+    { "r12d", { 12, 32, false, false, false } },
+    { "r13d", { 13, 32, false, false, false } },
+    { "r14d", { 14, 32, false, false, false } },
+    { "r15d", { 15, 32, false, false, false } },
+    { "rax",  { 0,  64, false, false, false } },
+    { "rcx",  { 1,  64, false, false, false } },
+    { "rdx",  { 2,  64, false, false, false } },
+    { "rbx",  { 3,  64, false, false, false } },
+    { "rsp",  { 4,  64, false, false, false } },
+    { "rbp",  { 5,  64, false, false, false } },
+    { "rsi",  { 6,  64, false, false, false } },
+    { "rdi",  { 7,  64, false, false, false } },
+    { "r8",   { 8,  64, false, false, false } },
+    { "r9",   { 9,  64, false, false, false } },
+    { "r10",  { 10, 64, false, false, false } },
+    { "r11",  { 11, 64, false, false, false } },
+    { "r12",  { 12, 64, false, false, false } },
+    { "r13",  { 13, 64, false, false, false } },
+    { "r14",  { 14, 64, false, false, false } },
+    { "r15",  { 15, 64, false, false, false } },
+    { "st0",  { 0,  0,  false, false, true  } },
+    { "st1",  { 1,  0,  false, false, true  } },
+    { "st2",  { 2,  0,  false, false, true  } },
+    { "st3",  { 3,  0,  false, false, true  } },
+    { "st4",  { 4,  0,  false, false, true  } },
+    { "st5",  { 5,  0,  false, false, true  } },
+    { "st6",  { 6,  0,  false, false, true  } },
+    { "st7",  { 7,  0,  false, false, true  } }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::prefixes = {
+    { "lock",  0xf0 },
+    { "rep",   0xf3 },
+    { "repe",  0xf3 },
+    { "repz",  0xf3 },
+    { "repne", 0xf2 },
+    { "repnz", 0xf2 }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::segments = {
+    { "es", 0x26 },
+    { "cs", 0x2e },
+    { "ss", 0x36 },
+    { "ds", 0x3e },
+    { "fs", 0x64 },
+    { "gs", 0x65 }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::condition_codes = {
+    { "o",   0x0 }, { "no",  0x1 }, { "b",   0x2 }, { "c",   0x2 }, { "nae", 0x2 },
+    { "ae",  0x3 }, { "nb",  0x3 }, { "nc",  0x3 }, { "e",   0x4 }, { "z",   0x4 },
+    { "ne",  0x5 }, { "nz",  0x5 }, { "be",  0x6 }, { "na",  0x6 }, { "a",   0x7 },
+    { "nbe", 0x7 }, { "s",   0x8 }, { "ns",  0x9 }, { "p",   0xa }, { "pe",  0xa },
+    { "np",  0xb }, { "po",  0xb }, { "l",   0xc }, { "nge", 0xc }, { "ge",  0xd },
+    { "nl",  0xd }, { "le",  0xe }, { "ng",  0xe }, { "g",   0xf }, { "nle", 0xf }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::alu_ops = {
+    { "add", 0 },
+    { "or",  1 },
+    { "adc", 2 },
+    { "sbb", 3 },
+    { "and", 4 },
+    { "sub", 5 },
+    { "xor", 6 },
+    { "cmp", 7 }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::unary_ops = {
+    { "not",  2 },
+    { "neg",  3 },
+    { "mul",  4 },
+    { "div",  6 },
+    { "idiv", 7 }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::shift_ops = {
+    { "rol", 0 },
+    { "ror", 1 },
+    { "rcl", 2 },
+    { "rcr", 3 },
+    { "shl", 4 },
+    { "sal", 4 },
+    { "shr", 5 },
+    { "sar", 7 }
+};
+
+const QMap<QString, uint8_t> NativeAssembler::size_keywords = {
+    { "byte",  8  },
+    { "word",  16 },
+    { "dword", 32 },
+    { "qword", 64 },
+    { "tword", 80 }
+};
+
+const QMap<QString, QByteArray> NativeAssembler::simple_ops = {
+    { "nop",     QByteArray("\x90", 1) },
+    { "ret",     QByteArray("\xc3", 1) },
+    { "retn",    QByteArray("\xc3", 1) },
+    { "retf",    QByteArray("\xcb", 1) },
+    { "leave",   QByteArray("\xc9", 1) },
+    { "hlt",     QByteArray("\xf4", 1) },
+    { "int1",    QByteArray("\xf1", 1) },
+    { "int3",    QByteArray("\xcc", 1) },
+    { "pushf",   QByteArray("\x9c", 1) },
+    { "popf",    QByteArray("\x9d", 1) },
+    { "sahf",    QByteArray("\x9e", 1) },
+    { "lahf",    QByteArray("\x9f", 1) },
+    { "cwde",    QByteArray("\x98", 1) },
+    { "cdq",     QByteArray("\x99", 1) },
+    { "clc",     QByteArray("\xf8", 1) },
+    { "stc",     QByteArray("\xf9", 1) },
+    { "cli",     QByteArray("\xfa", 1) },
+    { "sti",     QByteArray("\xfb", 1) },
+    { "cld",     QByteArray("\xfc", 1) },
+    { "std",     QByteArray("\xfd", 1) },
+    { "cmc",     QByteArray("\xf5", 1) },
+    { "pause",   QByteArray("\xf3\x90", 2) },
+    { "syscall", QByteArray("\x0f\x05", 2) },
+    { "sysenter",QByteArray("\x0f\x34", 2) },
+    { "rdtsc",   QByteArray("\x0f\x31", 2) },
+    { "rdtscp",  QByteArray("\x0f\x01\xf9", 3) },
+    { "cpuid",   QByteArray("\x0f\xa2", 2) },
+    { "ud2",     QByteArray("\x0f\x0b", 2) },
+    { "wait",    QByteArray("\x9b", 1) },
+    { "fwait",   QByteArray("\x9b", 1) },
+    { "fnop",    QByteArray("\xd9\xd0", 2) },
+    { "movsb",   QByteArray("\xa4", 1) },
+    { "movsw",   QByteArray("\x66\xa5", 2) },
+    { "movsd",   QByteArray("\xa5", 1) },
+    { "cmpsb",   QByteArray("\xa6", 1) },
+    { "cmpsw",   QByteArray("\x66\xa7", 2) },
+    { "cmpsd",   QByteArray("\xa7", 1) },
+    { "stosb",   QByteArray("\xaa", 1) },
+    { "stosw",   QByteArray("\x66\xab", 2) },
+    { "stosd",   QByteArray("\xab", 1) },
+    { "lodsb",   QByteArray("\xac", 1) },
+    { "lodsw",   QByteArray("\x66\xad", 2) },
+    { "lodsd",   QByteArray("\xad", 1) },
+    { "scasb",   QByteArray("\xae", 1) },
+    { "scasw",   QByteArray("\x66\xaf", 2) },
+    { "scasd",   QByteArray("\xaf", 1) }
+};
+
+const QMap<QString, QByteArray> NativeAssembler::simple_ops_x86 = {
+    { "pushad",  QByteArray("\x60", 1) },
+    { "pusha",   QByteArray("\x60", 1) },
+    { "popad",   QByteArray("\x61", 1) },
+    { "popa",    QByteArray("\x61", 1) },
+    { "pushfd",  QByteArray("\x9c", 1) },
+    { "popfd",   QByteArray("\x9d", 1) }
+};
+
+const QMap<QString, QByteArray> NativeAssembler::simple_ops_x64 = {
+    { "pushfq",  QByteArray("\x9c", 1) },
+    { "popfq",   QByteArray("\x9d", 1) },
+    { "cdqe",    QByteArray("\x48\x98", 2) },
+    { "cqo",     QByteArray("\x48\x99", 2) },
+    { "movsq",   QByteArray("\x48\xa5", 2) },
+    { "cmpsq",   QByteArray("\x48\xa7", 2) },
+    { "stosq",   QByteArray("\x48\xab", 2) },
+    { "lodsq",   QByteArray("\x48\xad", 2) },
+    { "scasq",   QByteArray("\x48\xaf", 2) }
+};
+
+NativeAssembler::Operand::Operand() :
+    type(OperandType::None),
+    size(0),
+    scale(0),
+    segment(0),
+    addr_size(0),
+    value(0),
+    resolved(true),
+    has_label(false),
+    force_short(false),
+    force_near(false)
+{
+    reg = base = index = { -1, 0, false, false, false };
+}
+
+NativeAssembler::Encoding::Encoding() :
+    rep(0),
+    segment(0),
+    osize(false),
+    asize(false),
+    rex_w(false),
+    rex(0),
+    rex_required(false),
+    rex_forbidden(false),
+    has_modrm(false),
+    modrm(0),
+    has_sib(false),
+    sib(0)
+{
+}
+
+NativeAssembler::NativeAssembler() :
+    current_offset(0),
+    final_pass(false),
+    jumps_changed(false)
+{
+}
+
+bool NativeAssembler::assemble(const QString &code, QByteArray &compiled)
+{
+    statements.clear();
+    labels.clear();
+    last_error.clear();
+
+    if(!parse(code))
+        return false;
+
+    // Kolejne przebiegi aż do ustalenia się adresów etykiet i rozmiarów skoków
+    final_pass = false;
+    for(int pass = 0; pass < max_passes; ++pass)
+    {
+        QByteArray out;
+        if(!runPass(out))
+            return false;
+
+        bool stable = !jumps_changed && pass_labels == labels;
+        labels = pass_labels;
+
+        if(final_pass && stable)
+        {
+            compiled = out;
+            return true;
+        }
+
+        final_pass = stable;
+    }
+
+    last_error = "Label addresses did not converge.";
+    return false;
+}
+
+bool NativeAssembler::error(const Statement &s, const QString &msg)
+{
+    last_error = QString("line %1: %2").arg(s.line).arg(msg);
+    return false;
+}
+
+QString NativeAssembler::stripComment(const QString &line)
+{
+    QChar quote;
+
+    for(int i = 0; i < line.length(); ++i)
+    {
+        QChar c = line.at(i);
+
+        if(!quote.isNull())
+        {
+            if(c == quote)
+                quote = QChar();
+        }
+        else if(c == '\'' || c == '"' || c == '`')
+            quote = c;
+        else if(c == ';')
+            return line.left(i);
+    }
+
+    return line;
+}
+
+QStringList NativeAssembler::splitOperands(const QString &ops)
+{
+    QStringList result;
+    QString current;
+    QChar quote;
+    int depth = 0;
+
+    foreach(QChar c, ops)
+    {
+        if(!quote.isNull())
+        {
+            if(c == quote)
+                quote = QChar();
+        }
+        else if(c == '\'' || c == '"' || c == '`')
+            quote = c;
+        else if(c == '[' || c == '(')
+            ++depth;
+        else if(c == ']' || c == ')')
+            --depth;
+        else if(c == ',' && depth == 0)
+        {
+            result.append(current.trimmed());
+            current.clear();
+            continue;
+        }
+
+        current.append(c);
+    }
+
+    if(!current.trimmed().isEmpty() || !result.isEmpty())
+        result.append(current.trimmed());
+
+    return result;
+}
+
+bool NativeAssembler::isIdentifier(const QString &str)
+{
+    if(str.isEmpty())
+        return false;
+
+    QChar first = str.at(0);
+    if(!first.isLetter() && first != '_' && first != '.' && first != '?' && first != '@')
+        return false;
+
+    foreach(QChar c, str)
+    {
+        if(!c.isLetterOrNumber() && c != '_' && c != '.' && c != '?' && c != '@' && c != '$' && c != '#' && c != '~')
+            return false;
+    }
+
+    return true;
+}
+
+bool NativeAssembler::parseNumber(QString str, int64_t &value)
+{
+    bool ok = false;
+    str = str.toLower().remove('_');
+
+    if(str.isEmpty() || !str.at(0).isDigit())
+        return false;
+
+    if(str.startsWith("0x") || str.startsWith("0h"))
+        value = static_cast<int64_t>(str.mid(2).toULongLong(&ok, 16));
+    else if(str.startsWith("0b") || str.startsWith("0y"))
+        value = static_cast<int64_t>(str.mid(2).toULongLong(&ok, 2));
+    else if(str.startsWith("0o") || str.startsWith("0q"))
+        value = static_cast<int64_t>(str.mid(2).toULongLong(&ok, 8));
+    else if(str.startsWith("0d") || str.startsWith("0t"))
+        value = static_cast<int64_t>(str.mid(2).toULongLong(&ok, 10));
+    else if(str.endsWith('h') || str.endsWith('x'))
+        value = static_cast<int64_t>(str.left(str.length() - 1).toULongLong(&ok, 16));
+    else if(str.endsWith('b') || str.endsWith('y'))
+        value = static_cast<int64_t>(str.left(str.length() - 1).toULongLong(&ok, 2));
+    else if(str.endsWith('o') || str.endsWith('q'))
+        value = static_cast<int64_t>(str.left(str.length() - 1).toULongLong(&ok, 8));
+    else if(str.endsWith('d') || str.endsWith('t'))
+        value = static_cast<int64_t>(str.left(str.length() - 1).toULongLong(&ok, 10));
+    else
+        value = static_cast<int64_t>(str.toULongLong(&ok, 10));
+
+    return ok;
+}
+
+bool NativeAssembler::parse(const QString &code)
+{
+    QString source = code;
+    source.replace("\r\n", "\n").replace('\r', '\n');
+
+    QStringList lines = source.split('\n');
+    uint8_t bits = 16;
+
+    for(int i = 0; i < lines.length(); ++i)
+        if(!parseLine(lines[i], i + 1, bits))
+            return false;
+
+    return true;
+}
+
+bool NativeAssembler::parseLine(QString line, int line_no, uint8_t &bits)
+{
+    Statement s;
+    s.line = line_no;
+    s.bits = bits;
+    s.long_jump = false;
+
+    line = stripComment(line).trimmed();
+    if(line.isEmpty())
+        return true;
+
+    // Dyrektywa [bits xx]
+    QString directive = line;
+    if(directive.startsWith('[') && directive.endsWith(']'))
+        directive = directive.mid(1, directive.length() - 2).trimmed();
+
+    QStringList words = directive.split(' ', QString::SkipEmptyParts);
+    if(!words.isEmpty() && words[0].toLower() == "bits")
+    {
+        if(words.length() != 2 || (words[1] != "16" && words[1] != "32" && words[1] != "64"))
+            return error(s, "invalid bits directive");
+
+        bits = words[1].toUInt();
+        return true;
+    }
+
+    if(line.startsWith('['))
+        return error(s, QString("unsupported directive: %1").arg(line));
+
+    // Etykieta
+    int colon = line.indexOf(':');
+    if(colon > 0 && isIdentifier(line.left(colon).trimmed()))
+    {
+        s.label = line.left(colon).trimmed();
+
+        foreach(const Statement &st, statements)
+        {
+            if(st.label == s.label)
+                return error(s, QString("label '%1' redefined").arg(s.label));
+        }
+
+        line = line.mid(colon + 1).trimmed();
+    }
+
+    // Prefiksy instrukcji
+    while(!line.isEmpty())
+    {
+        int end = 0;
+        while(end < line.length() && !line.at(end).isSpace())
+            ++end;
+
+        QString word = line.left(end).toLower();
+
+        if(prefixes.contains(word))
+            s.prefixes.append(prefixes[word]);
+        else if(segments.contains(word))
+            s.prefixes.append(segments[word]);
+        else
+        {
+            s.mnemonic = word;
+            s.operands = splitOperands(line.mid(end).trimmed());
+            break;
+        }
+
+        line = line.mid(end).trimmed();
+    }
+
+    statements.append(s);
+    return true;
+}
+
+bool NativeAssembler::runPass(QByteArray &out)
+{
+    pass_labels.clear();
+    jumps_changed = false;
+    out.clear();
+
+    for(int i = 0; i < statements.length(); ++i)
+    {
+        Statement &s = statements[i];
+        current_offset = out.length();
+
+        if(!s.label.isEmpty())
+            pass_labels[s.label] = current_offset;
+
+        if(!encode(s, out))
+            return false;
+    }
+
+    return true;
+}
+
+bool NativeAssembler::evaluate(const QString &expr, Expression &result, bool allow_regs)
+{
+    result = Expression();
+
+    // Podział na składniki sumy
+    QStringList terms;
+    QList<int> signs;
+    QString current;
+    QChar quote;
+    int depth = 0;
+    int sign = 1;
+
+    foreach(QChar c, expr)
+    {
+        if(!quote.isNull())
+        {
+            if(c == quote)
+                quote = QChar();
+            current.append(c);
+            continue;
+        }
+
+        if(c == '\'' || c == '"')
+            quote = c;
+        else if(c == '(')
+            ++depth;
+        else if(c == ')')
+            --depth;
+        else if((c == '+' || c == '-') && depth == 0)
+        {
+            if(current.trimmed().isEmpty())
+            {
+                if(c == '-')
+                    sign = -sign;
+                continue;
+            }
+
+            terms.append(current.trimmed());
+            signs.append(sign);
+            current.clear();
+            sign = c == '-' ? -1 : 1;
+            continue;
+        }
+
+        current.append(c);
+    }
+
+    if(current.trimmed().isEmpty() || depth != 0 || !quote.isNull())
+        return false;
+
+    terms.append(current.trimmed());
+    signs.append(sign);
+
+    for(int i = 0; i < terms.length(); ++i)
+    {
+        // Iloczyn czynników
+        Expression term;
+        term.value = 1;
+        bool has_value = false;
+
+        foreach(QString factor, terms[i].split('*'))
+        {
+            factor = factor.trimmed();
+            Expression f;
+            int64_t num;
+
+            if(factor.isEmpty())
+                return false;
+
+            if(factor.startsWith('(') && factor.endsWith(')'))
+            {
+                if(!evaluate(factor.mid(1, factor.length() - 2), f, allow_regs))
+                    return false;
+            }
+            else if(factor == "$")
+                f.value = current_offset;
+            else if(factor == "$$")
+                f.value = 0;
+            else if(factor.length() >= 2 && (factor.startsWith('\'') || factor.startsWith('"')) && factor.endsWith(factor.at(0)))
+            {
+                QByteArray chars = factor.mid(1, factor.length() - 2).toUtf8();
+                if(chars.length() > 8)
+                    return false;
+
+                for(int j = chars.length() - 1; j >= 0; --j)
+                    f.value = (f.value << 8) | static_cast<uint8_t>(chars.at(j));
+            }
+            else if(parseNumber(factor, num))
+                f.value = num;
+            else if(registers.contains(factor.toLower()))
+            {
+                if(!allow_regs)
+                    return false;
+
+                f.regs[factor.toLower()] = 1;
+            }
+            else if(isIdentifier(factor))
+            {
+                f.has_label = true;
+
+                if(pass_labels.contains(factor))
+                    f.value = pass_labels[factor];
+                else if(labels.contains(factor))
+                    f.value = labels[factor];
+                else
+                {
+                    f.resolved = false;
+                    if(final_pass)
+                    {
+                        result.resolved = false;
+                        return false;
+                    }
+                }
+            }
+            else
+                return false;
+
+            if(!term.regs.isEmpty() && !f.regs.isEmpty())
+                return false;
+
+            if(f.regs.isEmpty())
+            {
+                foreach(QString r, term.regs.keys())
+                    term.regs[r] *= f.value;
+                term.value *= f.value;
+            }
+            else
+            {
+                if(has_value && term.value == 0)
+                    return false;
+
+                foreach(QString r, f.regs.keys())
+                    term.regs[r] = f.regs[r] * term.value;
+                term.value = f.value * term.value;
+            }
+
+            term.resolved = term.resolved && f.resolved;
+            term.has_label = term.has_label || f.has_label;
+            has_value = true;
+        }
+
+        result.value += signs[i] * term.value;
+        foreach(QString r, term.regs.keys())
+            result.regs[r] += signs[i] * term.regs[r];
+        result.resolved = result.resolved && term.resolved;
+        result.has_label = result.has_label || term.has_label;
+    }
+
+    foreach(QString r, result.regs.keys())
+    {
+        if(result.regs[r] == 0)
+            result.regs.remove(r);
+    }
+
+    return true;
+}
+
+bool NativeAssembler::parseOperand(const Statement &s, QString str, Operand &op)
+{
+    str = str.trimmed();
+
+    // Słowa kluczowe rozmiaru i typu skoku
+    forever
+    {
+        int end = 0;
+        while(end < str.length() && str.at(end).isLetter())
+            ++end;
+
+        if(end == 0 || (end < str.length() && !str.at(end).isSpace() && str.at(end) != '['))
+            break;
+
+        QString word = str.left(end).toLower();
+
+        if(size_keywords.contains(word))
+            op.size = size_keywords[word];
+        else if(word == "short")
+            op.force_short = true;
+        else if(word == "near")
+            op.force_near = true;
+        else if(word != "strict")
+            break;
+
+        str = str.mid(end).trimmed();
+    }
+
+    if(str.isEmpty())
+        return error(s, "missing operand");
+
+    // Adres pamięci
+    if(str.startsWith('['))
+    {
+        if(!str.endsWith(']'))
+            return error(s, QString("invalid memory operand: %1").arg(str));
+
+        QString inner = str.mid(1, str.length() - 2).trimmed();
+
+        int colon = inner.indexOf(':');
+        if(colon > 0 && segments.contains(inner.left(colon).trimmed().toLower()))
+        {
+            op.segment = segments[inner.left(colon).trimmed().toLower()];
+            inner = inner.mid(colon + 1).trimmed();
+        }
+
+        Expression expr;
+        if(!evaluate(inner, expr, true))
+            return error(s, final_pass && !expr.resolved ?
+                             QString("undefined label in: %1").arg(str) :
+                             QString("invalid effective address: %1").arg(str));
+
+        op.type = OperandType::Memory;
+        op.value = expr.value;
+        op.resolved = expr.resolved;
+        op.has_label = expr.has_label;
+
+        // Rejestry w kolejności nazw - pierwszy bez mnożnika jest bazą (tak jak w nasm)
+        int scale = 0;
+        foreach(QString r, expr.regs.keys())
+        {
+            RegisterInfo info = registers[r];
+            int64_t mult = expr.regs[r];
+
+            if(info.fpu || info.size < 32)
+                return error(s, QString("invalid effective address: %1").arg(str));
+
+            if(op.addr_size && op.addr_size != info.size)
+                return error(s, QString("mixed address sizes: %1").arg(str));
+            op.addr_size = info.size;
+
+            if(mult == 1 && op.base.num == -1)
+                op.base = info;
+            else if(op.index.num == -1)
+            {
+                op.index = info;
+                scale = mult;
+            }
+            else
+                return error(s, QString("invalid effective address: %1").arg(str));
+        }
+
+        if(op.base.num == -1 && op.index.num != -1 && scale == 1)
+        {
+            op.base = op.index;
+            op.index.num = -1;
+            scale = 0;
+        }
+
+        if(op.base.num == -1 && op.index.num != -1 && op.index.num != 4 &&
+                (scale == 2 || scale == 3 || scale == 5 || scale == 9))
+        {
+            op.base = op.index;
+            --scale;
+        }
+
+        if(op.index.num == 4 && scale == 1)
+            std::swap(op.base, op.index);
+
+        if(op.index.num != -1 && (op.index.num == 4 || (scale != 1 && scale != 2 && scale != 4 && scale != 8)))
+            return error(s, QString("invalid effective address: %1").arg(str));
+
+        op.scale = op.index.num == -1 ? 0 : scale;
+        return true;
+    }
+
+    // Rejestr
+    QString lower = str.toLower().remove(' ');
+    if(lower.length() == 5 && lower.startsWith("st(") && lower.endsWith(')'))
+        lower = QString("st%1").arg(lower.at(3));
+
+    if(registers.contains(lower))
+    {
+        op.type = OperandType::Register;
+        op.reg = registers[lower];
+
+        if(op.size && op.size != op.reg.size)
+            return error(s, QString("mismatch in operand sizes: %1").arg(str));
+
+        op.size = op.reg.size;
+        return true;
+    }
+
+    // Wartość natychmiastowa
+    Expression expr;
+    if(!evaluate(str, expr, false))
+        return error(s, final_pass && !expr.resolved ?
+                         QString("undefined label in: %1").arg(str) :
+                         QString("invalid operand: %1").arg(str));
+
+    op.type = OperandType::Immediate;
+    op.value = expr.value;
+    op.resolved = expr.resolved;
+    op.has_label = expr.has_label;
+
+    return true;
+}
+
+bool NativeAssembler::parseOperands(const Statement &s, QList<Operand> &ops)
+{
+    foreach(QString str, s.operands)
+    {
+        Operand op;
+        if(!parseOperand(s, str, op))
+            return false;
+
+        ops.append(op);
+    }
+
+    return true;
+}
+
+bool NativeAssembler::isSignedByte(int64_t value, uint8_t size)
+{
+    switch(size)
+    {
+    case 16:
+        return static_cast<int16_t>(value) == static_cast<int8_t>(value);
+    case 32:
+        return static_cast<int32_t>(value) == static_cast<int8_t>(value);
+    default:
+        return value == static_cast<int8_t>(value);
+    }
+}
+
+void NativeAssembler::appendValue(QByteArray &out, int64_t value, int bytes)
+{
+    for(int i = 0; i < bytes; ++i)
+        out.append(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xff));
+}
+
+bool NativeAssembler::setOperandSize(const Statement &s, Encoding &e, uint8_t size, bool default64)
+{
+    switch(size)
+    {
+    case 8:
+        return true;
+    case 16:
+        e.osize = true;
+        return true;
+    case 32:
+        if(default64 && s.bits == 64)
+            return error(s, "instruction not supported in 64-bit mode");
+        return true;
+    case 64:
+        if(s.bits != 64)
+            return error(s, "64-bit operand in 32-bit mode");
+        if(!default64)
+            e.rex_w = true;
+        return true;
+    case 0:
+        return error(s, "operation size not specified");
+    default:
+        return error(s, "invalid operand size");
+    }
+}
+
+bool NativeAssembler::setReg(Encoding &e, const RegisterInfo &reg)
+{
+    e.has_modrm = true;
+    e.modrm |= (reg.num & 7) << 3;
+
+    if(reg.num >= 8)
+        e.rex |= 0x04;
+    if(reg.rex_only)
+        e.rex_required = true;
+    if(reg.high_byte)
+        e.rex_forbidden = true;
+
+    return true;
+}
+
+bool NativeAssembler::setRm(const Statement &s, Encoding &e, const Operand &rm, int reg_field)
+{
+    e.has_modrm = true;
+
+    if(reg_field >= 0)
+        e.modrm |= reg_field << 3;
+
+    if(rm.type == OperandType::Register)
+    {
+        if(rm.reg.fpu)
+            return error(s, "invalid use of FPU register");
+
+        e.modrm |= 0xc0 | (rm.reg.num & 7);
+
+        if(rm.reg.num >= 8)
+            e.rex |= 0x01;
+        if(rm.reg.rex_only)
+            e.rex_required = true;
+        if(rm.reg.high_byte)
+            e.rex_forbidden = true;
+
+        return true;
+    }
+
+    if(rm.type != OperandType::Memory)
+        return error(s, "invalid combination of opcode and operands");
+
+    if(rm.segment)
+        e.segment = rm.segment;
+
+    // Adres bezwzględny
+    if(rm.base.num == -1 && rm.index.num == -1)
+    {
+        if(s.bits == 64)
+        {
+            e.modrm |= 0x04;
+            e.has_sib = true;
+            e.sib = 0x25;
+        }
+        else
+            e.modrm |= 0x05;
+
+        appendValue(e.disp, rm.value, 4);
+        return true;
+    }
+
+    if(s.bits == 64 && rm.addr_size == 32)
+        e.asize = true;
+    else if(rm.addr_size != s.bits)
+        return error(s, "unsupported address size");
+
+    int64_t disp = rm.value;
+    bool disp8 = rm.resolved && !rm.has_label && isSignedByte(disp, rm.addr_size);
+    uint8_t mod = disp8 ? 1 : 2;
+
+    if(disp == 0 && !rm.has_label && (rm.base.num == -1 || (rm.base.num & 7) != 5))
+        mod = 0;
+
+    if(rm.index.num == -1 && (rm.base.num & 7) != 4)
+        e.modrm |= (mod << 6) | (rm.base.num & 7);
+    else
+    {
+        static const QMap<uint8_t, uint8_t> scale_bits = { { 0, 0 }, { 1, 0 }, { 2, 1 }, { 4, 2 }, { 8, 3 } };
+
+        e.has_sib = true;
+        e.sib = (scale_bits[rm.scale] << 6) | ((rm.index.num == -1 ? 4 : rm.index.num & 7) << 3);
+
+        if(rm.base.num == -1)
+        {
+            mod = 0;
+            e.sib |= 5;
+        }
+        else
+            e.sib |= rm.base.num & 7;
+
+        e.modrm |= (mod << 6) | 4;
+    }
+
+    if(rm.index.num >= 8)
+        e.rex |= 0x02;
+    if(rm.base.num >= 8)
+        e.rex |= 0x01;
+
+    if(rm.base.num == -1 || mod == 2)
+        appendValue(e.disp, disp, 4);
+    else if(mod == 1)
+        appendValue(e.disp, disp, 1);
+
+    return true;
+}
+
+bool NativeAssembler::build(const Statement &s, const Encoding &e, QByteArray &out)
+{
+    uint8_t rex = e.rex | (e.rex_w ? 0x08 : 0x00);
+    bool use_rex = rex || e.rex_required;
+
+    if(use_rex && s.bits != 64)
+        return error(s, "64-bit register in 32-bit mode");
+
+    if(use_rex && e.rex_forbidden)
+        return error(s, "cannot use high byte register in instruction requiring REX prefix");
+
+    if(e.rep)
+        out.append(static_cast<char>(e.rep));
+    if(e.segment)
+        out.append(static_cast<char>(e.segment));
+    if(e.osize)
+        out.append('\x66');
+    if(e.asize)
+        out.append('\x67');
+    if(use_rex)
+        out.append(static_cast<char>(0x40 | rex));
+
+    out.append(e.opcode);
+
+    if(e.has_modrm)
+        out.append(static_cast<char>(e.modrm));
+    if(e.has_sib)
+        out.append(static_cast<char>(e.sib));
+
+    out.append(e.disp);
+    out.append(e.imm);
+
+    return true;
+}
+
+bool NativeAssembler::encode(Statement &s, QByteArray &out)
+{
+    const QString &mn = s.mnemonic;
+
+    if(mn.isEmpty())
+    {
+        foreach(uint8_t p, s.prefixes)
+            out.append(static_cast<char>(p));
+        return true;
+    }
+
+    if(mn == "db" || mn == "dw" || mn == "dd" || mn == "dq")
+        return encodeData(s, out);
+
+    if(s.bits == 16)
+        return error(s, "16-bit code is not supported");
+
+    Encoding e;
+    foreach(uint8_t p, s.prefixes)
+    {
+        if(segments.values().contains(p))
+            e.segment = p;
+        else if(e.rep)
+            return error(s, "instruction has conflicting prefixes");
+        else
+            e.rep = p;
+    }
+
+    QList<Operand> ops;
+    if(!parseOperands(s, ops))
+        return false;
+
+    bool ok = false;
+    uint8_t cc = 0xff;
+
+    if(mn.startsWith("set") && condition_codes.contains(mn.mid(3)))
+        cc = condition_codes[mn.mid(3)];
+    else if(mn.startsWith("cmov") && condition_codes.contains(mn.mid(4)))
+        cc = condition_codes[mn.mid(4)];
+
+    if(ops.isEmpty() && (simple_ops.contains(mn) ||
+                         (s.bits == 32 && simple_ops_x86.contains(mn)) ||
+                         (s.bits == 64 && simple_ops_x64.contains(mn))))
+    {
+        e.opcode = simple_ops.contains(mn) ? simple_ops[mn] :
+                   s.bits == 32 ? simple_ops_x86[mn] : simple_ops_x64[mn];
+        ok = true;
+    }
+    else if(mn == "mov")
+        ok = encodeMov(s, ops, e);
+    else if(alu_ops.contains(mn))
+        ok = encodeAlu(s, alu_ops[mn], ops, e);
+    else if(mn == "test")
+        ok = encodeTest(s, ops, e);
+    else if(mn == "push" || mn == "pop")
+        ok = encodePushPop(s, mn == "push", ops, e);
+    else if(mn == "inc" || mn == "dec")
+        ok = encodeIncDec(s, mn == "dec", ops, e);
+    else if(shift_ops.contains(mn))
+        ok = encodeShift(s, shift_ops[mn], ops, e);
+    else if(mn == "imul")
+        ok = encodeImul(s, ops, e);
+    else if(mn == "movzx" || mn == "movsx")
+        ok = encodeMovExtend(s, mn == "movsx", ops, e);
+    else if(mn == "jmp" || mn == "call" || (mn.startsWith('j') && condition_codes.contains(mn.mid(1))))
+        ok = encodeBranch(s, ops, e);
+    else if(mn == "fld" || mn == "fst" || mn == "fstp")
+        ok = encodeFpu(s, ops, e);
+    else if(unary_ops.contains(mn))
+    {
+        if(ops.length() != 1 || ops[0].type == OperandType::Immediate)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append(ops[0].size == 8 ? '\xf6' : '\xf7');
+        ok = setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[0], unary_ops[mn]);
+    }
+    else if(mn == "lea")
+    {
+        if(ops.length() != 2 || ops[0].type != OperandType::Register || ops[1].type != OperandType::Memory ||
+                ops[0].size < 16)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\x8d');
+        ok = setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+    }
+    else if(mn.startsWith("set") && cc != 0xff)
+    {
+        if(ops.length() != 1 || ops[0].type == OperandType::Immediate || (ops[0].size && ops[0].size != 8))
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\x0f');
+        e.opcode.append(static_cast<char>(0x90 + cc));
+        ok = setRm(s, e, ops[0], 0);
+    }
+    else if(mn.startsWith("cmov") && cc != 0xff)
+    {
+        if(ops.length() != 2 || ops[0].type != OperandType::Register || ops[1].type == OperandType::Immediate ||
+                ops[0].size < 16 || (ops[1].size && ops[1].size != ops[0].size))
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\x0f');
+        e.opcode.append(static_cast<char>(0x40 + cc));
+        ok = setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+    }
+    else if(mn == "bswap")
+    {
+        if(ops.length() != 1 || ops[0].type != OperandType::Register || ops[0].size < 32)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\x0f');
+        e.opcode.append(static_cast<char>(0xc8 + (ops[0].reg.num & 7)));
+        if(ops[0].reg.num >= 8)
+            e.rex |= 0x01;
+        ok = setOperandSize(s, e, ops[0].size);
+    }
+    else if(mn == "crc32")
+    {
+        // F2 0F 38 F0 (źródło 8-bitowe) lub F1 (źródło o rozmiarze celu), bez wersji 16-bitowej
+        if(ops.length() != 2 || ops[0].type != OperandType::Register || ops[1].type == OperandType::Immediate ||
+                ops[0].size < 32)
+            return error(s, "invalid combination of opcode and operands");
+
+        uint8_t src_size = ops[1].size ? ops[1].size : ops[0].size;
+        if(src_size != 8 && src_size != ops[0].size)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.rep = 0xf2;
+        e.opcode.append("\x0f\x38", 2);
+        e.opcode.append(src_size == 8 ? '\xf0' : '\xf1');
+        ok = setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+    }
+    else if(mn == "int")
+    {
+        if(ops.length() != 1 || ops[0].type != OperandType::Immediate)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\xcd');
+        appendValue(e.imm, ops[0].value, 1);
+        ok = true;
+    }
+    else if((mn == "ret" || mn == "retn" || mn == "retf") && ops.length() == 1)
+    {
+        if(ops[0].type != OperandType::Immediate)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append(mn == "retf" ? '\xca' : '\xc2');
+        appendValue(e.imm, ops[0].value, 2);
+        ok = true;
+    }
+    else
+        return error(s, QString("unsupported instruction: %1").arg(mn));
+
+    return ok && build(s, e, out);
+}
+
+bool NativeAssembler::encodeData(const Statement &s, QByteArray &out)
+{
+    static const QMap<QString, int> units = { { "db", 1 }, { "dw", 2 }, { "dd", 4 }, { "dq", 8 } };
+    int unit = units[s.mnemonic];
+
+    if(s.operands.isEmpty())
+        return error(s, "no operand for data declaration");
+
+    foreach(QString op, s.operands)
+    {
+        if(op.length() >= 2 && (op.startsWith('\'') || op.startsWith('"')) && op.endsWith(op.at(0)) &&
+                (unit == 1 || op.length() > unit + 2))
+        {
+            QByteArray str = op.mid(1, op.length() - 2).toUtf8();
+            out.append(str);
+
+            if(str.length() % unit)
+                out.append(QByteArray(unit - str.length() % unit, '\0'));
+
+            continue;
+        }
+
+        Expression expr;
+        if(!evaluate(op, expr, false))
+            return error(s, QString("invalid data value: %1").arg(op));
+
+        appendValue(out, expr.value, unit);
+    }
+
+    return true;
+}
+
+bool NativeAssembler::encodeMov(const Statement &s, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 2)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &dst = ops[0];
+    Operand &src = ops[1];
+
+    // mov reg, reg / mov mem, reg
+    if(src.type == OperandType::Register && dst.type != OperandType::Immediate)
+    {
+        if(dst.size && dst.size != src.size)
+            return error(s, "mismatch in operand sizes");
+
+        if(s.bits == 32 && dst.type == OperandType::Memory && src.reg.num == 0 &&
+                dst.base.num == -1 && dst.index.num == -1)
+        {
+            e.opcode.append(src.size == 8 ? '\xa2' : '\xa3');
+            if(dst.segment)
+                e.segment = dst.segment;
+            appendValue(e.disp, dst.value, 4);
+            return setOperandSize(s, e, src.size);
+        }
+
+        e.opcode.append(src.size == 8 ? '\x88' : '\x89');
+        return setOperandSize(s, e, src.size) && setRm(s, e, dst, -1) && setReg(e, src.reg);
+    }
+
+    // mov reg, mem
+    if(dst.type == OperandType::Register && src.type == OperandType::Memory)
+    {
+        if(src.size && dst.size != src.size)
+            return error(s, "mismatch in operand sizes");
+
+        if(s.bits == 32 && dst.reg.num == 0 && src.base.num == -1 && src.index.num == -1)
+        {
+            e.opcode.append(dst.size == 8 ? '\xa0' : '\xa1');
+            if(src.segment)
+                e.segment = src.segment;
+            appendValue(e.disp, src.value, 4);
+            return setOperandSize(s, e, dst.size);
+        }
+
+        e.opcode.append(dst.size == 8 ? '\x8a' : '\x8b');
+        return setOperandSize(s, e, dst.size) && setRm(s, e, src, -1) && setReg(e, dst.reg);
+    }
+
+    if(src.type != OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    // mov reg, imm
+    if(dst.type == OperandType::Register)
+    {
+        if(dst.reg.fpu)
+            return error(s, "invalid combination of opcode and operands");
+
+        int imm_size = dst.size / 8;
+        uint64_t value = static_cast<uint64_t>(src.value);
+
+        if(dst.size == 64)
+        {
+            // nasm -Ox: mov r64, imm32 bez znaku kodowany jako mov r32, imm32
+            if(value <= 0xffffffffULL)
+                imm_size = 4;
+            else if(src.value == static_cast<int32_t>(src.value))
+            {
+                e.rex_w = true;
+                e.opcode.append('\xc7');
+                appendValue(e.imm, src.value, 4);
+                return setRm(s, e, dst, 0);
+            }
+            else
+                e.rex_w = true;
+        }
+        else if(!setOperandSize(s, e, dst.size))
+            return false;
+
+        e.opcode.append(static_cast<char>((dst.size == 8 ? 0xb0 : 0xb8) + (dst.reg.num & 7)));
+        if(dst.reg.num >= 8)
+            e.rex |= 0x01;
+        if(dst.reg.rex_only)
+            e.rex_required = true;
+        if(dst.reg.high_byte)
+            e.rex_forbidden = true;
+
+        appendValue(e.imm, src.value, imm_size);
+        return true;
+    }
+
+    // mov mem, imm
+    if(dst.size == 0)
+        return error(s, "operation size not specified");
+
+    e.opcode.append(dst.size == 8 ? '\xc6' : '\xc7');
+    appendValue(e.imm, src.value, dst.size == 8 ? 1 : dst.size == 16 ? 2 : 4);
+
+    return setOperandSize(s, e, dst.size) && setRm(s, e, dst, 0);
+}
+
+bool NativeAssembler::encodeAlu(const Statement &s, uint8_t op, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 2 || ops[0].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &dst = ops[0];
+    Operand &src = ops[1];
+
+    // op r/m, reg
+    if(src.type == OperandType::Register)
+    {
+        if(dst.size && dst.size != src.size)
+            return error(s, "mismatch in operand sizes");
+
+        e.opcode.append(static_cast<char>(op * 8 + (src.size == 8 ? 0 : 1)));
+        return setOperandSize(s, e, src.size) && setRm(s, e, dst, -1) && setReg(e, src.reg);
+    }
+
+    // op reg, mem
+    if(src.type == OperandType::Memory)
+    {
+        if(dst.type != OperandType::Register || (src.size && src.size != dst.size))
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append(static_cast<char>(op * 8 + (dst.size == 8 ? 2 : 3)));
+        return setOperandSize(s, e, dst.size) && setRm(s, e, src, -1) && setReg(e, dst.reg);
+    }
+
+    // op r/m, imm
+    if(!setOperandSize(s, e, dst.size))
+        return false;
+
+    bool accumulator = dst.type == OperandType::Register && dst.reg.num == 0;
+
+    if(dst.size == 8)
+    {
+        appendValue(e.imm, src.value, 1);
+
+        if(accumulator)
+        {
+            e.opcode.append(static_cast<char>(op * 8 + 4));
+            return true;
+        }
+
+        e.opcode.append('\x80');
+        return setRm(s, e, dst, op);
+    }
+
+    if(src.resolved && !src.has_label && isSignedByte(src.value, dst.size))
+    {
+        e.opcode.append('\x83');
+        appendValue(e.imm, src.value, 1);
+        return setRm(s, e, dst, op);
+    }
+
+    appendValue(e.imm, src.value, dst.size == 16 ? 2 : 4);
+
+    if(accumulator)
+    {
+        e.opcode.append(static_cast<char>(op * 8 + 5));
+        return true;
+    }
+
+    e.opcode.append('\x81');
+    return setRm(s, e, dst, op);
+}
+
+bool NativeAssembler::encodeTest(const Statement &s, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 2 || ops[0].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &dst = ops[0];
+    Operand &src = ops[1];
+
+    if(src.type == OperandType::Register || (src.type == OperandType::Memory && dst.type == OperandType::Register))
+    {
+        Operand &rm = src.type == OperandType::Register ? dst : src;
+        Operand &reg = src.type == OperandType::Register ? src : dst;
+
+        if(rm.size && rm.size != reg.size)
+            return error(s, "mismatch in operand sizes");
+
+        e.opcode.append(reg.size == 8 ? '\x84' : '\x85');
+        return setOperandSize(s, e, reg.size) && setRm(s, e, rm, -1) && setReg(e, reg.reg);
+    }
+
+    if(src.type != OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    if(!setOperandSize(s, e, dst.size))
+        return false;
+
+    appendValue(e.imm, src.value, dst.size == 8 ? 1 : dst.size == 16 ? 2 : 4);
+
+    if(dst.type == OperandType::Register && dst.reg.num == 0)
+    {
+        e.opcode.append(dst.size == 8 ? '\xa8' : '\xa9');
+        return true;
+    }
+
+    e.opcode.append(dst.size == 8 ? '\xf6' : '\xf7');
+    return setRm(s, e, dst, 0);
+}
+
+bool NativeAssembler::encodePushPop(const Statement &s, bool push, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 1)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &op = ops[0];
+
+    if(op.type == OperandType::Register)
+    {
+        if(op.size == 8 || op.reg.fpu)
+            return error(s, "invalid combination of opcode and operands");
+
+        if(op.size == 64 && s.bits != 64)
+            return error(s, "64-bit register in 32-bit mode");
+
+        e.opcode.append(static_cast<char>((push ? 0x50 : 0x58) + (op.reg.num & 7)));
+        if(op.reg.num >= 8)
+            e.rex |= 0x01;
+
+        return setOperandSize(s, e, op.size, true);
+    }
+
+    if(op.type == OperandType::Memory)
+    {
+        e.opcode.append(push ? '\xff' : '\x8f');
+        return setOperandSize(s, e, op.size ? op.size : s.bits, true) && setRm(s, e, op, push ? 6 : 0);
+    }
+
+    if(!push)
+        return error(s, "invalid combination of opcode and operands");
+
+    if(op.size == 8 || (op.size == 0 && op.resolved && !op.has_label && isSignedByte(op.value, s.bits)))
+    {
+        e.opcode.append('\x6a');
+        appendValue(e.imm, op.value, 1);
+        return true;
+    }
+
+    if(op.size == 16)
+        e.osize = true;
+
+    e.opcode.append('\x68');
+    appendValue(e.imm, op.value, op.size == 16 ? 2 : 4);
+
+    return true;
+}
+
+bool NativeAssembler::encodeIncDec(const Statement &s, bool dec, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 1 || ops[0].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &op = ops[0];
+
+    if(s.bits == 32 && op.type == OperandType::Register && op.size != 8)
+    {
+        e.opcode.append(static_cast<char>((dec ? 0x48 : 0x40) + op.reg.num));
+        return setOperandSize(s, e, op.size);
+    }
+
+    e.opcode.append(op.size == 8 ? '\xfe' : '\xff');
+    return setOperandSize(s, e, op.size) && setRm(s, e, op, dec ? 1 : 0);
+}
+
+bool NativeAssembler::encodeShift(const Statement &s, uint8_t op, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 2 || ops[0].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &dst = ops[0];
+    Operand &cnt = ops[1];
+    bool byte = dst.size == 8;
+
+    if(cnt.type == OperandType::Register)
+    {
+        if(cnt.size != 8 || cnt.reg.num != 1)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append(byte ? '\xd2' : '\xd3');
+    }
+    else if(cnt.type == OperandType::Immediate && cnt.resolved && !cnt.has_label && cnt.value == 1)
+        e.opcode.append(byte ? '\xd0' : '\xd1');
+    else if(cnt.type == OperandType::Immediate)
+    {
+        e.opcode.append(byte ? '\xc0' : '\xc1');
+        appendValue(e.imm, cnt.value, 1);
+    }
+    else
+        return error(s, "invalid combination of opcode and operands");
+
+    return setOperandSize(s, e, dst.size) && setRm(s, e, dst, op);
+}
+
+bool NativeAssembler::encodeImul(const Statement &s, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() == 1)
+    {
+        if(ops[0].type == OperandType::Immediate)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append(ops[0].size == 8 ? '\xf6' : '\xf7');
+        return setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[0], 5);
+    }
+
+    // imul reg, imm == imul reg, reg, imm
+    if(ops.length() == 2 && ops[1].type == OperandType::Immediate)
+        ops.insert(1, ops[0]);
+
+    if(ops[0].type != OperandType::Register || ops[0].size < 16 || ops[1].type == OperandType::Immediate ||
+            (ops[1].size && ops[1].size != ops[0].size))
+        return error(s, "invalid combination of opcode and operands");
+
+    if(ops.length() == 2)
+    {
+        e.opcode.append("\x0f\xaf", 2);
+        return setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+    }
+
+    if(ops.length() != 3 || ops[2].type != OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    if(ops[2].resolved && !ops[2].has_label && isSignedByte(ops[2].value, ops[0].size))
+    {
+        e.opcode.append('\x6b');
+        appendValue(e.imm, ops[2].value, 1);
+    }
+    else
+    {
+        e.opcode.append('\x69');
+        appendValue(e.imm, ops[2].value, ops[0].size == 16 ? 2 : 4);
+    }
+
+    return setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+}
+
+bool NativeAssembler::encodeMovExtend(const Statement &s, bool sign, QList<Operand> &ops, Encoding &e)
+{
+    if(ops.length() != 2 || ops[0].type != OperandType::Register || ops[0].size < 16 ||
+            ops[1].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    if(ops[1].size != 8 && ops[1].size != 16)
+        return error(s, ops[1].size ? "invalid source operand size" : "operation size not specified");
+
+    e.opcode.append('\x0f');
+    e.opcode.append(static_cast<char>((sign ? 0xbe : 0xb6) + (ops[1].size == 16 ? 1 : 0)));
+
+    return setOperandSize(s, e, ops[0].size) && setRm(s, e, ops[1], -1) && setReg(e, ops[0].reg);
+}
+
+bool NativeAssembler::encodeBranch(Statement &s, QList<Operand> &ops, Encoding &e)
+{
+    const QString &mn = s.mnemonic;
+
+    if(ops.length() != 1)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &target = ops[0];
+
+    // Skok pośredni: jmp/call r/m
+    if(target.type != OperandType::Immediate)
+    {
+        if(mn != "jmp" && mn != "call")
+            return error(s, "invalid combination of opcode and operands");
+
+        if(target.type == OperandType::Register && target.size != s.bits)
+            return error(s, "invalid combination of opcode and operands");
+
+        e.opcode.append('\xff');
+        return setOperandSize(s, e, target.size ? target.size : s.bits, true) &&
+               setRm(s, e, target, mn == "jmp" ? 4 : 2);
+    }
+
+    if(mn == "call")
+    {
+        e.opcode.append('\xe8');
+        appendValue(e.imm, target.value - (current_offset + 5), 4);
+        return true;
+    }
+
+    bool jcc = mn != "jmp";
+    uint8_t cc = jcc ? condition_codes[mn.mid(1)] : 0;
+    int short_len = 2;
+    int near_len = jcc ? 6 : 5;
+
+    if(target.force_near && !s.long_jump)
+    {
+        s.long_jump = true;
+        jumps_changed = true;
+    }
+
+    int64_t rel8 = target.value - (current_offset + short_len);
+
+    if(!s.long_jump && target.resolved && (rel8 < -128 || rel8 > 127))
+    {
+        if(target.force_short)
+        {
+            if(final_pass)
+                return error(s, "short jump is out of range");
+        }
+        else
+        {
+            s.long_jump = true;
+            jumps_changed = true;
+        }
+    }
+
+    if(s.long_jump)
+    {
+        if(jcc)
+        {
+            e.opcode.append('\x0f');
+            e.opcode.append(static_cast<char>(0x80 + cc));
+        }
+        else
+            e.opcode.append('\xe9');
+
+        appendValue(e.imm, target.value - (current_offset + near_len), 4);
+        return true;
+    }
+
+    e.opcode.append(static_cast<char>(jcc ? 0x70 + cc : 0xeb));
+    appendValue(e.imm, rel8, 1);
+
+    return true;
+}
+
+bool NativeAssembler::encodeFpu(const Statement &s, QList<Operand> &ops, Encoding &e)
+{
+    const QString &mn = s.mnemonic;
+
+    if(ops.length() != 1 || ops[0].type == OperandType::Immediate)
+        return error(s, "invalid combination of opcode and operands");
+
+    Operand &op = ops[0];
+
+    if(op.type == OperandType::Register)
+    {
+        if(!op.reg.fpu)
+            return error(s, "invalid combination of opcode and operands");
+
+        uint8_t base = mn == "fld" ? 0xc0 : mn == "fst" ? 0xd0 : 0xd8;
+        e.opcode.append(mn == "fld" ? '\xd9' : '\xdd');
+        e.opcode.append(static_cast<char>(base + op.reg.num));
+        return true;
+    }
+
+    switch(op.size)
+    {
+    case 32:
+        e.opcode.append('\xd9');
+        return setRm(s, e, op, mn == "fld" ? 0 : mn == "fst" ? 2 : 3);
+    case 64:
+        e.opcode.append('\xdd');
+        return setRm(s, e, op, mn == "fld" ? 0 : mn == "fst" ? 2 : 3);
+    case 80:
+        if(mn == "fst")
+            break;
+        e.opcode.append('\xdb');
+        return setRm(s, e, op, mn == "fld" ? 5 : 7);
+    case 0:
+        return error(s, "operation size not specified");
+    }
+
+    return error(s, "invalid combination of opcode and operands");
+}
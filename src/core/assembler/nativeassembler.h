@@ -0,0 +1,193 @@
+#ifndef NATIVEASSEMBLER_H
+#define NATIVEASSEMBLER_H
+
+#include <QMap>
+#include <QList>
+#include <QStringList>
+
+#include <core/assembler/dassembler.h>
+
+/**
+ * @brief Wbudowany asembler x86/x64 obsługujący podzbiór składni NASM używany w opisach metod.
+ *
+ * Generuje kod identyczny z wynikiem polecenia nasm -f bin (domyślna optymalizacja -Ox):
+ * najkrótsze formy natychmiastowe, relaksacja skoków oraz zamiana mov r64, imm32 na mov r32, imm32.
+ */
+class NativeAssembler : public DAssembler
+{
+public:
+    NativeAssembler();
+
+    /**
+     * @brief Metoda kompilująca kod źródłowy assembly do postaci binarnej.
+     * @param code kod źródłowy.
+     * @param compiled skompilowany kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    virtual bool assemble(const QString &code, QByteArray &compiled) override;
+
+private:
+    /**
+     * @brief Opis rejestru.
+     */
+    struct RegisterInfo {
+        int num;
+        uint8_t size;
+        bool rex_only;
+        bool high_byte;
+        bool fpu;
+    };
+
+    /**
+     * @brief Typy operandów.
+     */
+    enum class OperandType {
+        None,
+        Register,
+        Memory,
+        Immediate
+    };
+
+    /**
+     * @brief Wartość wyrażenia: stała oraz rejestry z mnożnikami.
+     */
+    struct Expression {
+        int64_t value;
+        QMap<QString, int64_t> regs;
+        bool resolved;
+        bool has_label;
+
+        Expression() : value(0), resolved(true), has_label(false) {}
+    };
+
+    /**
+     * @brief Sparsowany operand instrukcji.
+     */
+    struct Operand {
+        OperandType type;
+        uint8_t size;
+        RegisterInfo reg;
+        RegisterInfo base;
+        RegisterInfo index;
+        uint8_t scale;
+        uint8_t segment;
+        uint8_t addr_size;
+        int64_t value;
+        bool resolved;
+        bool has_label;
+        bool force_short;
+        bool force_near;
+
+        Operand();
+    };
+
+    /**
+     * @brief Zakodowana instrukcja przed złożeniem bajtów.
+     */
+    struct Encoding {
+        uint8_t rep;
+        uint8_t segment;
+        bool osize;
+        bool asize;
+        bool rex_w;
+        uint8_t rex;
+        bool rex_required;
+        bool rex_forbidden;
+        QByteArray opcode;
+        bool has_modrm;
+        uint8_t modrm;
+        bool has_sib;
+        uint8_t sib;
+        QByteArray disp;
+        QByteArray imm;
+
+        Encoding();
+    };
+
+    /**
+     * @brief Pojedyncza linia kodu źródłowego.
+     */
+    struct Statement {
+        int line;
+        uint8_t bits;
+        QString label;
+        QString mnemonic;
+        QList<uint8_t> prefixes;
+        QStringList operands;
+        bool long_jump;
+    };
+
+    /**
+     * @brief Maksymalna liczba przebiegów.
+     */
+    static const int max_passes;
+
+    static const QMap<QString, RegisterInfo> registers;
+    static const QMap<QString, uint8_t> prefixes;
+    static const QMap<QString, uint8_t> segments;
+    static const QMap<QString, uint8_t> condition_codes;
+    static const QMap<QString, uint8_t> alu_ops;
+    static const QMap<QString, uint8_t> unary_ops;
+    static const QMap<QString, uint8_t> shift_ops;
+    static const QMap<QString, uint8_t> size_keywords;
+    static const QMap<QString, QByteArray> simple_ops;
+    static const QMap<QString, QByteArray> simple_ops_x86;
+    static const QMap<QString, QByteArray> simple_ops_x64;
+
+    QList<Statement> statements;
+    QMap<QString, int64_t> labels;
+    QMap<QString, int64_t> pass_labels;
+
+    /**
+     * @brief Adres aktualnie kodowanej instrukcji ($).
+     */
+    int64_t current_offset;
+
+    /**
+     * @brief Flaga ostatniego przebiegu (zgłaszanie błędów zakresu i niezdefiniowanych etykiet).
+     */
+    bool final_pass;
+
+    /**
+     * @brief Flaga zmiany rozmiaru dowolnego skoku w bieżącym przebiegu.
+     */
+    bool jumps_changed;
+
+    bool parse(const QString &code);
+    bool parseLine(QString line, int line_no, uint8_t &bits);
+    bool runPass(QByteArray &out);
+
+    bool error(const Statement &s, const QString &msg);
+
+    static QString stripComment(const QString &line);
+    static QStringList splitOperands(const QString &ops);
+    static bool isIdentifier(const QString &str);
+    static bool parseNumber(QString str, int64_t &value);
+
+    bool evaluate(const QString &expr, Expression &result, bool allow_regs);
+    bool parseOperand(const Statement &s, QString str, Operand &op);
+    bool parseOperands(const Statement &s, QList<Operand> &ops);
+
+    bool encode(Statement &s, QByteArray &out);
+    bool encodeData(const Statement &s, QByteArray &out);
+    bool encodeMov(const Statement &s, QList<Operand> &ops, Encoding &e);
+    bool encodeAlu(const Statement &s, uint8_t op, QList<Operand> &ops, Encoding &e);
+    bool encodeTest(const Statement &s, QList<Operand> &ops, Encoding &e);
+    bool encodePushPop(const Statement &s, bool push, QList<Operand> &ops, Encoding &e);
+    bool encodeIncDec(const Statement &s, bool dec, QList<Operand> &ops, Encoding &e);
+    bool encodeShift(const Statement &s, uint8_t op, QList<Operand> &ops, Encoding &e);
+    bool encodeImul(const Statement &s, QList<Operand> &ops, Encoding &e);
+    bool encodeMovExtend(const Statement &s, bool sign, QList<Operand> &ops, Encoding &e);
+    bool encodeBranch(Statement &s, QList<Operand> &ops, Encoding &e);
+    bool encodeFpu(const Statement &s, QList<Operand> &ops, Encoding &e);
+
+    bool setOperandSize(const Statement &s, Encoding &e, uint8_t size, bool default64 = false);
+    bool setReg(Encoding &e, const RegisterInfo &reg);
+    bool setRm(const Statement &s, Encoding &e, const Operand &rm, int reg_field);
+    bool build(const Statement &s, const Encoding &e, QByteArray &out);
+
+    static bool isSignedByte(int64_t value, uint8_t size);
+    static void appendValue(QByteArray &out, int64_t value, int bytes);
+};
+
+#endif // NATIVEASSEMBLER_H
@@ -1,27 +1,63 @@
+; CRC32C of the text section, instruction crc32 if SSE4.2 is available (CPUID.1:ECX[20])
+xor eax, eax
+inc eax
+cpuid
+mov edx, ecx
+
 mov rcx, (?^_^magic!sec_size^_^?)
 call $+5
 pop rdi
-add rdi, 0xbadadaba ; calculate here an offset to text section begin
+add rdi, (?^_^dyn_magic!offset^_^?) ; offset to text section begin, patched after the file is changed
 
-xor rax, rax
-xor rsi, rsi
-xor rdx, rdx
+xor esi, esi
+not esi
+xor eax, eax
+
+test edx, 0x100000
+jz crc_bytes
+
+crc_qwords:
+lea rbx, [rax + 8]
+cmp rbx, rcx
+ja crc_tail
+crc32 rsi, qword [rdi + rax]
+mov rax, rbx
+jmp crc_qwords
+
+crc_tail:
+cmp rax, rcx
+jae test_checksum
+crc32 esi, byte [rdi + rax]
+inc rax
+jmp crc_tail
 
-start:
+; no SSE4.2: bit by bit
+crc_bytes:
 cmp rax, rcx
 jae test_checksum
-mov dl, byte [rdi + rax]
-add rsi, rdx
+movzx ebx, byte [rdi + rax]
+xor esi, ebx
+mov edx, 8
+
+crc_bit:
+shr esi, 1
+jnc crc_next_bit
+xor esi, 0x82f63b78
+
+crc_next_bit:
+dec edx
+jnz crc_bit
 inc rax
-jmp start
+jmp crc_bytes
 
 test_checksum:
+not esi
 
-mov rdi, (?^_^magic!sec_checksum^_^?)
+mov edi, (?^_^magic!sec_checksum^_^?)
 xor rax, rax
 xor rbx, rbx
 dec rbx
 
-cmp rsi, rdi
+cmp esi, edi
 
 cmovne rax, rbx
@@ -1,21 +1,57 @@
+; CRC32C of the text section, instruction crc32 if SSE4.2 is available (CPUID.1:ECX[20])
+xor eax, eax
+inc eax
+cpuid
+mov edx, ecx
+
 mov ecx, (?^_^magic!sec_size^_^?)
 call $+5
 pop edi
-add edi, 0xbadadaba ; calculate here an offset to text section begin
+add edi, (?^_^dyn_magic!offset^_^?) ; offset to text section begin, patched after the file is changed
 
-xor eax, eax
 xor esi, esi
-xor edx, edx
+not esi
+xor eax, eax
+
+test edx, 0x100000
+jz crc_bytes
+
+crc_dwords:
+lea ebx, [eax + 4]
+cmp ebx, ecx
+ja crc_tail
+crc32 esi, dword [edi + eax]
+mov eax, ebx
+jmp crc_dwords
 
-start:
+crc_tail:
 cmp eax, ecx
 jae test_checksum
-mov dl, byte [edi + eax]
-add esi, edx
+crc32 esi, byte [edi + eax]
+inc eax
+jmp crc_tail
+
+; no SSE4.2: bit by bit
+crc_bytes:
+cmp eax, ecx
+jae test_checksum
+movzx ebx, byte [edi + eax]
+xor esi, ebx
+mov edx, 8
+
+crc_bit:
+shr esi, 1
+jnc crc_next_bit
+xor esi, 0x82f63b78
+
+crc_next_bit:
+dec edx
+jnz crc_bit
 inc eax
-jmp start
+jmp crc_bytes
 
 test_checksum:
+not esi
 
 mov edi, (?^_^magic!sec_checksum^_^?)
 xor eax, eax
@@ -0,0 +1,392 @@
+#include <core/disassembler/lengthdecoder.h>
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include <algorithm>
+
+#define M   LengthDecoder::ModRM
+#define I8  LengthDecoder::Imm8
+#define I16 LengthDecoder::Imm16
+#define IZ  LengthDecoder::ImmZ
+#define IV  LengthDecoder::ImmV
+#define MO  LengthDecoder::MemOffs
+#define G3  LengthDecoder::Group3
+#define X   LengthDecoder::Invalid64
+#define U   LengthDecoder::Undefined
+#define _   LengthDecoder::None
+
+/**
+ * @brief Opis jednobajtowych kodów operacji. Prefiksy oraz bajt 0x0f są obsługiwane osobno.
+ */
+const uint8_t LengthDecoder::one_byte[256] = {
+    /*        0       1       2       3       4       5       6       7       8       9       a       b       c       d       e       f */
+    /* 0 */   M,      M,      M,      M,      I8,     IZ,     X,      X,      M,      M,      M,      M,      I8,     IZ,     X,      _,
+    /* 1 */   M,      M,      M,      M,      I8,     IZ,     X,      X,      M,      M,      M,      M,      I8,     IZ,     X,      X,
+    /* 2 */   M,      M,      M,      M,      I8,     IZ,     _,      X,      M,      M,      M,      M,      I8,     IZ,     _,      X,
+    /* 3 */   M,      M,      M,      M,      I8,     IZ,     _,      X,      M,      M,      M,      M,      I8,     IZ,     _,      X,
+    /* 4 */   _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,
+    /* 5 */   _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      _,
+    /* 6 */   X,      X,      M|X,    M,      _,      _,      _,      _,      IZ,     M|IZ,   I8,     M|I8,   _,      _,      _,      _,
+    /* 7 */   I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,
+    /* 8 */   M|I8,   M|IZ,   M|I8|X, M|I8,   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 9 */   _,      _,      _,      _,      _,      _,      _,      _,      _,      _,      IZ|I16|X, _,    _,      _,      _,      _,
+    /* a */   MO,     MO,     MO,     MO,     _,      _,      _,      _,      I8,     IZ,     _,      _,      _,      _,      _,      _,
+    /* b */   I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     IV,     IV,     IV,     IV,     IV,     IV,     IV,     IV,
+    /* c */   M|I8,   M|I8,   I16,    _,      M|X,    M|X,    M|I8,   M|IZ,   I16|I8, _,      I16,    _,      _,      I8,     X,      _,
+    /* d */   M,      M,      M,      M,      I8|X,   I8|X,   X,      _,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* e */   I8,     I8,     I8,     I8,     I8,     I8,     I8,     I8,     IZ,     IZ,     IZ|I16|X, I8,   _,      _,      _,      _,
+    /* f */   _,      _,      _,      _,      _,      _,      M|G3,   M|G3,   _,      _,      _,      _,      _,      _,      M,      M
+};
+
+/**
+ * @brief Opis dwubajtowych kodów operacji (0x0f xx). Mapy 0x0f 0x38 i 0x0f 0x3a są obsługiwane osobno.
+ */
+const uint8_t LengthDecoder::two_byte[256] = {
+    /*        0       1       2       3       4       5       6       7       8       9       a       b       c       d       e       f */
+    /* 0 */   M,      M,      M,      M,      U,      _,      _,      _,      _,      _,      U,      _,      U,      M,      _,      M|I8,
+    /* 1 */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 2 */   M,      M,      M,      M,      U,      U,      U,      U,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 3 */   _,      _,      _,      _,      _,      _,      U,      _,      U,      U,      U,      U,      U,      U,      U,      U,
+    /* 4 */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 5 */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 6 */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 7 */   M|I8,   M|I8,   M|I8,   M|I8,   M,      M,      M,      _,      M,      M,      U,      U,      M,      M,      M,      M,
+    /* 8 */   IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,     IZ,
+    /* 9 */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* a */   _,      _,      _,      M,      M|I8,   M,      U,      U,      _,      _,      _,      M,      M|I8,   M,      M,      M,
+    /* b */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M|I8,   M,      M,      M,      M,      M,
+    /* c */   M,      M,      M|I8,   M,      M|I8,   M|I8,   M|I8,   M,      _,      _,      _,      _,      _,      _,      _,      _,
+    /* d */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* e */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* f */   M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M
+};
+
+#undef M
+#undef I8
+#undef I16
+#undef IZ
+#undef IV
+#undef MO
+#undef G3
+#undef X
+#undef U
+#undef _
+
+const uint8_t LengthDecoder::max_length = 15;
+
+const uint32_t LengthDecoder::min_chunk_size = 1024 * 1024;
+
+const uint32_t LengthDecoder::sync_window = 4096;
+
+LengthDecoder::LengthDecoder(bool x64, uint32_t min_chunk) :
+    x64(x64),
+    min_chunk(std::max<uint32_t>(min_chunk, 1))
+{
+}
+
+uint8_t LengthDecoder::modrmLength(const uint8_t *code, uint32_t size, bool addr16) const
+{
+    uint8_t modrm = code[0];
+    uint8_t mod = modrm >> 6;
+    uint8_t rm = modrm & 7;
+    uint8_t len = 1;
+
+    if(mod == 3)
+        return len;
+
+    if(addr16)
+    {
+        if(mod == 1)
+            return len + 1;
+        if(mod == 2 || rm == 6)
+            return len + 2;
+        return len;
+    }
+
+    if(rm == 4)
+    {
+        if(size < 2)
+            return 0;
+
+        ++len;
+        rm = code[1] & 7;
+    }
+
+    if(mod == 1)
+        return len + 1;
+    if(mod == 2 || rm == 5)
+        return len + 4;
+
+    return len;
+}
+
+int LengthDecoder::count(const QByteArray &code) const
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(code.constData());
+    int n = 0;
+
+    for(int off = 0; off < code.size(); ++n)
+    {
+        uint8_t len = decode(data + off, code.size() - off);
+        if(!len)
+            break;
+
+        off += len;
+    }
+
+    return n;
+}
+
+uint8_t LengthDecoder::decode(const uint8_t *code, uint32_t size) const
+{
+    uint32_t pos = 0;
+    bool opsize = false;
+    bool addr = false;
+    bool rex_w = false;
+
+    size = std::min<uint32_t>(size, max_length);
+
+    // Prefiksy
+    for(; pos < size; ++pos)
+    {
+        uint8_t b = code[pos];
+
+        if(x64 && (b & 0xf0) == 0x40)
+        {
+            rex_w = b & 0x08;
+            continue;
+        }
+
+        if(b == 0x66)
+            opsize = true;
+        else if(b == 0x67)
+            addr = true;
+        else if(b != 0xf0 && b != 0xf2 && b != 0xf3 && b != 0x26 && b != 0x2e &&
+                b != 0x36 && b != 0x3e && b != 0x64 && b != 0x65)
+            break;
+
+        // REX przed prefiksem klasycznym jest ignorowany
+        rex_w = false;
+    }
+
+    if(pos >= size)
+        return 0;
+
+    uint8_t op = code[pos++];
+    uint8_t flags;
+    bool branch = false;
+    bool primary = false;
+
+    if(op == 0x0f)
+    {
+        if(pos >= size)
+            return 0;
+
+        uint8_t op2 = code[pos++];
+
+        if(op2 == 0x38 || op2 == 0x3a)
+        {
+            ++pos;
+            flags = op2 == 0x38 ? ModRM : ModRM | Imm8;
+        }
+        else
+        {
+            flags = two_byte[op2];
+            branch = (op2 & 0xf0) == 0x80;
+        }
+    }
+    else if((op == 0xc4 || op == 0xc5 || op == 0x62) && pos < size && (x64 || code[pos] >= 0xc0))
+    {
+        // Prefiksy VEX i EVEX
+        uint8_t map = op == 0xc5 ? 1 : code[pos] & (op == 0xc4 ? 0x1f : 0x07);
+        pos += op == 0xc5 ? 1 : op == 0xc4 ? 2 : 3;
+
+        if(pos >= size)
+            return 0;
+
+        uint8_t vop = code[pos++];
+
+        switch(map)
+        {
+        case 1:
+            if(two_byte[vop] == Undefined)
+                return 0;
+            flags = vop == 0x77 ? None : ModRM | (two_byte[vop] & Imm8);
+            break;
+        case 2:
+        case 5:
+        case 6:
+            flags = ModRM;
+            break;
+        case 3:
+            flags = ModRM | Imm8;
+            break;
+        default:
+            return 0;
+        }
+    }
+    else
+    {
+        flags = one_byte[op];
+        branch = op == 0xe8 || op == 0xe9;
+        primary = true;
+
+        if(x64 && (flags & Invalid64))
+            return 0;
+    }
+
+    if(flags == Undefined)
+        return 0;
+
+    if(flags & ModRM)
+    {
+        if(pos >= size)
+            return 0;
+
+        uint8_t reg = (code[pos] >> 3) & 7;
+        bool reg_form = (code[pos] >> 6) == 3;
+
+        if((flags & Group3) && reg < 2)
+            flags |= op == 0xf6 ? Imm8 : ImmZ;
+
+        // Niezdefiniowane rozszerzenia kodów operacji w grupach
+        if(primary &&
+                ((op == 0xfe && reg > 1) || (op == 0xff && (reg == 7 || (reg_form && (reg == 3 || reg == 5)))) ||
+                 (op == 0x8f && reg != 0) || ((op == 0xc6 || op == 0xc7) && reg != 0 && code[pos] != 0xf8)))
+            return 0;
+
+        uint8_t len = modrmLength(code + pos, size - pos, !x64 && addr);
+        if(!len)
+            return 0;
+
+        pos += len;
+    }
+
+    if(flags & Imm8)
+        pos += 1;
+    if(flags & Imm16)
+        pos += 2;
+    if(flags & ImmZ)
+        pos += opsize && !(x64 && branch) ? 2 : 4;
+    if(flags & ImmV)
+        pos += rex_w ? 8 : opsize ? 2 : 4;
+    if(flags & MemOffs)
+        pos += x64 ? (addr ? 4 : 8) : (addr ? 2 : 4);
+
+    if(pos > size)
+        return 0;
+
+    return pos;
+}
+
+uint32_t LengthDecoder::step(const uint8_t *data, uint32_t size, uint32_t off, QVector<uint32_t> &calls,
+                             QVector<uint32_t> &jmps) const
+{
+    uint8_t len = decode(data + off, size - off);
+
+    // Niepoprawna instrukcja jest pomijana bajt po bajcie (jak db w ndisasm)
+    if(!len)
+        len = 1;
+    else if(len == 5 && (data[off] == 0xe8 || data[off] == 0xe9) && (data[off + 4] == 0x00 || data[off + 4] == 0xff))
+        (data[off] == 0xe8 ? calls : jmps).append(off + 1);
+
+    return off + len;
+}
+
+void LengthDecoder::sweep(const uint8_t *data, uint32_t size, Chunk &chunk) const
+{
+    uint32_t off = chunk.begin;
+
+    while(off < chunk.end)
+    {
+        if(off < chunk.begin + sync_window)
+            chunk.boundaries.append(off);
+
+        off = step(data, size, off, chunk.calls, chunk.jmps);
+    }
+
+    chunk.next = off;
+}
+
+/**
+ * @brief Zadanie dekodujące pojedynczy fragment kodu w puli wątków.
+ */
+class LengthDecoder::ChunkTask : public QRunnable
+{
+public:
+    ChunkTask(const LengthDecoder &decoder, const uint8_t *data, uint32_t size, Chunk &chunk) :
+        decoder(decoder), data(data), size(size), chunk(chunk)
+    {
+        setAutoDelete(true);
+    }
+
+    virtual void run() override
+    {
+        decoder.sweep(data, size, chunk);
+    }
+
+private:
+    const LengthDecoder &decoder;
+    const uint8_t *data;
+    uint32_t size;
+    Chunk &chunk;
+};
+
+void LengthDecoder::findRelativeBranches(const QByteArray &code, QVector<uint32_t> &calls, QVector<uint32_t> &jmps,
+                                         int threads) const
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(code.constData());
+    uint32_t size = code.size();
+
+    if(threads <= 0)
+        threads = QThread::idealThreadCount();
+
+    uint32_t chunk_count = std::max<uint32_t>(1, std::min<uint32_t>(threads, size / min_chunk));
+    uint32_t chunk_size = size / chunk_count;
+
+    if(chunk_count == 1)
+    {
+        uint32_t off = 0;
+        while(off < size)
+            off = step(data, size, off, calls, jmps);
+
+        return;
+    }
+
+    QVector<Chunk> chunks(chunk_count);
+    QThreadPool pool;
+    pool.setMaxThreadCount(chunk_count);
+
+    for(uint32_t i = 0; i < chunk_count; ++i)
+    {
+        chunks[i].begin = i * chunk_size;
+        chunks[i].end = i == chunk_count - 1 ? size : (i + 1) * chunk_size;
+        pool.start(new ChunkTask(*this, data, size, chunks[i]));
+    }
+
+    pool.waitForDone();
+
+    // Scalanie: fragment jest zgodny z dekodowaniem sekwencyjnym od pierwszej wspólnej granicy instrukcji
+    uint32_t off = 0;
+
+    foreach(const Chunk &chunk, chunks)
+    {
+        while(off < chunk.end && !std::binary_search(chunk.boundaries.begin(), chunk.boundaries.end(), off))
+            off = step(data, size, off, calls, jmps);
+
+        if(off >= chunk.end)
+            continue;
+
+        calls.reserve(calls.size() + chunk.calls.size());
+        jmps.reserve(jmps.size() + chunk.jmps.size());
+
+        for(auto it = std::lower_bound(chunk.calls.begin(), chunk.calls.end(), off); it != chunk.calls.end(); ++it)
+            calls.append(*it);
+        for(auto it = std::lower_bound(chunk.jmps.begin(), chunk.jmps.end(), off); it != chunk.jmps.end(); ++it)
+            jmps.append(*it);
+
+        off = chunk.next;
+    }
+}
@@ -0,0 +1,123 @@
+#ifndef LENGTHDECODER_H
+#define LENGTHDECODER_H
+
+#include <QByteArray>
+#include <QVector>
+
+/**
+ * @brief Dekoder długości instrukcji x86/x64.
+ *
+ * Przechodzi liniowo przez kod (tak jak ndisasm) i wyznacza jedynie długości instrukcji,
+ * bez generowania tekstowej postaci kodu.
+ */
+class LengthDecoder
+{
+public:
+    /**
+     * @brief Domyślny minimalny rozmiar fragmentu dekodowanego przez osobny wątek.
+     */
+    static const uint32_t min_chunk_size;
+
+    /**
+     * @brief Konstruktor.
+     * @param x64 flaga kodu 64-bitowego.
+     * @param min_chunk minimalny rozmiar fragmentu dekodowanego przez osobny wątek.
+     */
+    LengthDecoder(bool x64, uint32_t min_chunk = min_chunk_size);
+
+    /**
+     * @brief Metoda wyznaczająca długość instrukcji.
+     * @param code wskaźnik na początek instrukcji.
+     * @param size liczba dostępnych bajtów.
+     * @return Długość instrukcji lub 0, jeżeli instrukcja jest niepoprawna albo niekompletna.
+     */
+    uint8_t decode(const uint8_t *code, uint32_t size) const;
+
+    /**
+     * @brief Metoda zliczająca instrukcje w kodzie (do pierwszej niepoprawnej instrukcji).
+     * @param code kod.
+     * @return Liczba instrukcji.
+     */
+    int count(const QByteArray &code) const;
+
+    /**
+     * @brief Metoda wyszukująca instrukcje call rel32 i jmp rel32 (bez prefiksów),
+     * których przesunięcie mieści się w zakresie +/- 16 MB (najstarszy bajt równy 0x00 lub 0xff).
+     *
+     * Duży kod jest dzielony na fragmenty dekodowane równolegle. Początek każdego fragmentu
+     * jest synchronizowany z dekodowaniem poprzedniego, więc wynik jest identyczny z przejściem sekwencyjnym.
+     * @param code kod do przeszukania.
+     * @param calls posortowane offsety pól rel32 instrukcji call.
+     * @param jmps posortowane offsety pól rel32 instrukcji jmp.
+     * @param threads liczba wątków (0 - liczba rdzeni procesora).
+     */
+    void findRelativeBranches(const QByteArray &code, QVector<uint32_t> &calls, QVector<uint32_t> &jmps,
+                              int threads = 1) const;
+
+private:
+    /**
+     * @brief Flagi opisu kodu operacji.
+     */
+    enum OpcodeFlags : uint8_t {
+        None = 0x00,
+        ModRM = 0x01,
+        Imm8 = 0x02,
+        Imm16 = 0x04,
+        ImmZ = 0x08,
+        ImmV = 0x10,
+        MemOffs = 0x20,
+        Group3 = 0x40,
+        Invalid64 = 0x80,
+        Undefined = 0xff
+    };
+
+    /**
+     * @brief Fragment kodu dekodowany przez jeden wątek.
+     */
+    struct Chunk {
+        uint32_t begin;
+        uint32_t end;
+        uint32_t next;
+        QVector<uint32_t> calls;
+        QVector<uint32_t> jmps;
+
+        /**
+         * @brief Granice instrukcji z początku fragmentu (do synchronizacji z poprzednim fragmentem).
+         */
+        QVector<uint32_t> boundaries;
+    };
+
+    class ChunkTask;
+
+    static const uint8_t one_byte[256];
+    static const uint8_t two_byte[256];
+
+    /**
+     * @brief Maksymalna długość instrukcji.
+     */
+    static const uint8_t max_length;
+
+    /**
+     * @brief Rozmiar obszaru na początku fragmentu, w którym zapamiętywane są granice instrukcji.
+     */
+    static const uint32_t sync_window;
+
+    bool x64;
+    uint32_t min_chunk;
+
+    uint8_t modrmLength(const uint8_t *code, uint32_t size, bool addr16) const;
+
+    /**
+     * @brief Metoda dekodująca jedną instrukcję i zapamiętująca ją, jeżeli jest szukanym skokiem.
+     * @return Offset kolejnej instrukcji.
+     */
+    uint32_t step(const uint8_t *data, uint32_t size, uint32_t off, QVector<uint32_t> &calls,
+                  QVector<uint32_t> &jmps) const;
+
+    /**
+     * @brief Metoda dekodująca fragment kodu.
+     */
+    void sweep(const uint8_t *data, uint32_t size, Chunk &chunk) const;
+};
+
+#endif // LENGTHDECODER_H
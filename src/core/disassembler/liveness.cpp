@@ -0,0 +1,592 @@
+#include <core/disassembler/liveness.h>
+
+const int LivenessAnalyzer::max_instructions = 32;
+
+namespace {
+
+/**
+ * @brief Rozkodowany bajt ModRM (wraz z bajtem SIB).
+ */
+struct ModRM {
+    uint8_t mod;
+    uint8_t reg;
+    uint8_t rm;
+
+    /**
+     * @brief Rejestry używane do wyznaczenia adresu operandu w pamięci.
+     */
+    uint16_t mem;
+};
+
+inline uint16_t bit(uint8_t reg)
+{
+    return static_cast<uint16_t>(1 << reg);
+}
+
+/**
+ * @brief Numer rejestru 8-bitowego - bez prefiksu REX numery 4-7 oznaczają ah, ch, dh, bh.
+ */
+inline uint8_t reg8(uint8_t reg, uint8_t rex)
+{
+    return !rex && reg >= 4 && reg < 8 ? reg - 4 : reg;
+}
+
+ModRM decodeModRM(const uint8_t *p, uint8_t rex, bool byte)
+{
+    ModRM m;
+    m.mod = p[0] >> 6;
+    m.reg = ((p[0] >> 3) & 7) | ((rex & 4) << 1);
+    m.rm = (p[0] & 7) | ((rex & 1) << 3);
+    m.mem = 0;
+
+    if(byte)
+    {
+        m.reg = reg8(m.reg, rex);
+        if(m.mod == 3)
+            m.rm = reg8(m.rm, rex);
+    }
+
+    if(m.mod == 3)
+        return m;
+
+    if((p[0] & 7) == 4)
+    {
+        uint8_t base = (p[1] & 7) | ((rex & 1) << 3);
+        uint8_t index = ((p[1] >> 3) & 7) | ((rex & 2) << 2);
+
+        if(index != 4)
+            m.mem |= bit(index);
+        if(!((p[1] & 7) == 5 && m.mod == 0))
+            m.mem |= bit(base);
+    }
+    // disp32 lub adresowanie względem rip
+    else if(!((p[0] & 7) == 5 && m.mod == 0))
+        m.mem |= bit(m.rm);
+
+    return m;
+}
+
+/**
+ * @brief Rejestry odczytywane przez operand r/m.
+ */
+inline uint16_t rmReads(const ModRM &m)
+{
+    return m.mod == 3 ? bit(m.rm) : m.mem;
+}
+
+}
+
+LivenessAnalyzer::LivenessAnalyzer(bool x64) :
+    x64(x64),
+    decoder(x64)
+{
+
+}
+
+LivenessAnalyzer::Result LivenessAnalyzer::analyze(const uint8_t *code, uint32_t size) const
+{
+    Result live = { 0, false };
+    uint16_t decided = 0;
+    bool flags_decided = false;
+    uint32_t off = 0;
+
+    for(int n = 0; n < max_instructions && off < size; ++n)
+    {
+        uint8_t length = decoder.decode(code + off, size - off);
+        Effects e;
+
+        if(!length || !effects(code + off, length, e))
+            break;
+
+        // Odczyt przed zapisem w tej samej instrukcji (np. add eax, ecx)
+        live.regs |= e.reads & ~decided;
+        decided |= e.reads | e.kills;
+
+        if(!flags_decided && (e.flags_read || e.flags_written))
+        {
+            live.flags = e.flags_read;
+            flags_decided = true;
+        }
+
+        if(e.stop)
+            break;
+
+        off += length;
+    }
+
+    // Nierozstrzygnięte rejestry i flagi są uznawane za żywe
+    live.regs |= ~decided & (x64 ? 0xffff : 0x00ff);
+    if(!flags_decided)
+        live.flags = true;
+
+    return live;
+}
+
+LivenessAnalyzer::Result LivenessAnalyzer::allLive()
+{
+    Result live = { 0xffff, true };
+    return live;
+}
+
+int LivenessAnalyzer::registerNumber(Registers_x86 reg)
+{
+    switch(reg)
+    {
+    case Registers_x86::EAX: return 0;
+    case Registers_x86::ECX: return 1;
+    case Registers_x86::EDX: return 2;
+    case Registers_x86::EBX: return 3;
+    case Registers_x86::ESP: return 4;
+    case Registers_x86::EBP: return 5;
+    case Registers_x86::ESI: return 6;
+    case Registers_x86::EDI: return 7;
+    default: return -1;
+    }
+}
+
+int LivenessAnalyzer::registerNumber(Registers_x64 reg)
+{
+    switch(reg)
+    {
+    case Registers_x64::RAX: return 0;
+    case Registers_x64::RCX: return 1;
+    case Registers_x64::RDX: return 2;
+    case Registers_x64::RBX: return 3;
+    case Registers_x64::RSP: return 4;
+    case Registers_x64::RBP: return 5;
+    case Registers_x64::RSI: return 6;
+    case Registers_x64::RDI: return 7;
+    case Registers_x64::R8: return 8;
+    case Registers_x64::R9: return 9;
+    case Registers_x64::R10: return 10;
+    case Registers_x64::R11: return 11;
+    case Registers_x64::R12: return 12;
+    case Registers_x64::R13: return 13;
+    case Registers_x64::R14: return 14;
+    case Registers_x64::R15: return 15;
+    default: return -1;
+    }
+}
+
+bool LivenessAnalyzer::effects(const uint8_t *code, uint8_t length, Effects &e) const
+{
+    e.reads = 0;
+    e.kills = 0;
+    e.flags_read = false;
+    e.flags_written = false;
+    e.stop = false;
+
+    uint8_t i = 0;
+    uint8_t rex = 0;
+    uint8_t rep = 0;
+    bool opsize16 = false;
+
+    for(; i < length; ++i)
+    {
+        uint8_t b = code[i];
+
+        if(b == 0x66)
+            opsize16 = true;
+        else if(b == 0xf2 || b == 0xf3)
+            rep = b;
+        // 16-bitowe adresowanie nie jest obsługiwane
+        else if(b == 0x67)
+            return false;
+        else if(b != 0xf0 && b != 0x26 && b != 0x2e && b != 0x36 && b != 0x3e && b != 0x64 && b != 0x65)
+            break;
+    }
+
+    if(x64 && i < length && (code[i] & 0xf0) == 0x40)
+        rex = code[i++];
+
+    if(i >= length)
+        return false;
+
+    const uint8_t op = code[i++];
+    const uint8_t *modrm = code + i;
+    const bool has_modrm = i < length;
+
+    // Zapis 32- lub 64-bitowy nadpisuje cały rejestr, 8- i 16-bitowy tylko jego część
+    const bool full = (rex & 8) || !opsize16;
+    const uint8_t rax = 0, rcx = 1, rdx = 2;
+
+    // add, or, adc, sbb, and, sub, xor, cmp
+    if(op < 0x40 && (op & 7) <= 5)
+    {
+        uint8_t kind = op >> 3;
+        uint8_t form = op & 7;
+        bool writes = kind != 7;
+        bool zero_idiom = false;
+
+        e.flags_read = kind == 2 || kind == 3;
+        e.flags_written = true;
+
+        if(form == 4 || form == 5)
+        {
+            e.reads = bit(rax);
+            return true;
+        }
+
+        if(!has_modrm)
+            return false;
+
+        ModRM m = decodeModRM(modrm, rex, (form & 1) == 0);
+
+        // xor r, r i sub r, r nie zależą od poprzedniej wartości rejestru
+        zero_idiom = (kind == 5 || kind == 6) && m.mod == 3 && m.reg == m.rm;
+
+        if(!zero_idiom)
+            e.reads = bit(m.reg) | rmReads(m);
+
+        if(writes && (form == 1 || form == 3) && full && (form == 3 || m.mod == 3))
+            e.kills = bit(form == 3 ? m.reg : m.rm);
+
+        return true;
+    }
+
+    // inc, dec (x86) - flaga CF nie jest zmieniana
+    if(!x64 && op >= 0x40 && op <= 0x4f)
+    {
+        e.reads = bit(op & 7);
+        return true;
+    }
+
+    // push r
+    if(op >= 0x50 && op <= 0x57)
+    {
+        e.reads = bit((op & 7) | ((rex & 1) << 3));
+        return true;
+    }
+
+    // pop r
+    if(op >= 0x58 && op <= 0x5f)
+    {
+        if(!opsize16)
+            e.kills = bit((op & 7) | ((rex & 1) << 3));
+        return true;
+    }
+
+    // jcc rel8
+    if(op >= 0x70 && op <= 0x7f)
+    {
+        e.flags_read = true;
+        e.stop = true;
+        return true;
+    }
+
+    // xchg rax, r
+    if(op >= 0x91 && op <= 0x97)
+    {
+        e.reads = bit(rax) | bit((op & 7) | ((rex & 1) << 3));
+        return true;
+    }
+
+    // mov r8, imm8
+    if(op >= 0xb0 && op <= 0xb7)
+        return true;
+
+    // mov r, imm
+    if(op >= 0xb8 && op <= 0xbf)
+    {
+        if(full)
+            e.kills = bit((op & 7) | ((rex & 1) << 3));
+        return true;
+    }
+
+    switch(op)
+    {
+    // push imm, nop
+    case 0x68:
+    case 0x6a:
+        return true;
+
+    case 0x90:
+        // xchg r8, rax
+        if(rex & 1)
+            e.reads = bit(rax) | bit(8);
+        return true;
+
+    // cwde, cdqe
+    case 0x98:
+        e.reads = bit(rax);
+        return true;
+
+    // cdq, cqo
+    case 0x99:
+        e.reads = bit(rax);
+        if(full)
+            e.kills = bit(rdx);
+        return true;
+
+    // test al, imm8; test eax, imm32
+    case 0xa8:
+    case 0xa9:
+        e.reads = bit(rax);
+        e.flags_written = true;
+        return true;
+
+    // ret, int3, call, jmp
+    case 0xc2:
+    case 0xc3:
+    case 0xcc:
+    case 0xe8:
+    case 0xe9:
+    case 0xeb:
+        e.stop = true;
+        return true;
+    }
+
+    if(op == 0x0f)
+    {
+        if(i >= length)
+            return false;
+
+        const uint8_t op2 = code[i++];
+        modrm = code + i;
+
+        if(i >= length && !(op2 >= 0x80 && op2 <= 0x8f) && op2 != 0x05 && op2 != 0x0b)
+            return false;
+
+        // endbr32, endbr64
+        if(rep == 0xf3 && op2 == 0x1e)
+            return true;
+
+        // nop r/m
+        if(op2 == 0x1f)
+            return true;
+
+        // syscall, ud2
+        if(op2 == 0x05 || op2 == 0x0b)
+        {
+            e.stop = true;
+            return true;
+        }
+
+        // jcc rel32
+        if(op2 >= 0x80 && op2 <= 0x8f)
+        {
+            e.flags_read = true;
+            e.stop = true;
+            return true;
+        }
+
+        // cmovcc - przy niespełnionym warunku rejestr docelowy zachowuje wartość
+        if(op2 >= 0x40 && op2 <= 0x4f)
+        {
+            ModRM m = decodeModRM(modrm, rex, false);
+            e.reads = bit(m.reg) | rmReads(m);
+            e.flags_read = true;
+            return true;
+        }
+
+        // setcc
+        if(op2 >= 0x90 && op2 <= 0x9f)
+        {
+            ModRM m = decodeModRM(modrm, rex, true);
+            e.reads = m.mod == 3 ? 0 : m.mem;
+            e.flags_read = true;
+            return true;
+        }
+
+        // imul r, r/m
+        if(op2 == 0xaf)
+        {
+            ModRM m = decodeModRM(modrm, rex, false);
+            e.reads = bit(m.reg) | rmReads(m);
+            e.flags_written = true;
+            return true;
+        }
+
+        // movzx, movsx
+        if(op2 == 0xb6 || op2 == 0xb7 || op2 == 0xbe || op2 == 0xbf)
+        {
+            ModRM m = decodeModRM(modrm, rex, op2 == 0xb6 || op2 == 0xbe);
+            m.reg = ((modrm[0] >> 3) & 7) | ((rex & 4) << 1);
+            e.reads = rmReads(m);
+            if(full)
+                e.kills = bit(m.reg);
+            return true;
+        }
+
+        return false;
+    }
+
+    if(!has_modrm)
+        return false;
+
+    switch(op)
+    {
+    // movsxd
+    case 0x63:
+    {
+        if(!x64)
+            return false;
+
+        ModRM m = decodeModRM(modrm, rex, false);
+        e.reads = rmReads(m);
+        if(full)
+            e.kills = bit(m.reg);
+        return true;
+    }
+
+    // imul r, r/m, imm
+    case 0x69:
+    case 0x6b:
+    {
+        ModRM m = decodeModRM(modrm, rex, false);
+        e.reads = rmReads(m);
+        if(full)
+            e.kills = bit(m.reg);
+        e.flags_written = true;
+        return true;
+    }
+
+    // grupa 1: op r/m, imm
+    case 0x80:
+    case 0x81:
+    case 0x83:
+    {
+        ModRM m = decodeModRM(modrm, rex, op == 0x80);
+        uint8_t kind = (modrm[0] >> 3) & 7;
+
+        e.reads = rmReads(m);
+        e.flags_read = kind == 2 || kind == 3;
+        e.flags_written = true;
+        return true;
+    }
+
+    // test r/m, r; xchg r/m, r
+    case 0x84:
+    case 0x85:
+    case 0x86:
+    case 0x87:
+    {
+        ModRM m = decodeModRM(modrm, rex, (op & 1) == 0);
+        e.reads = bit(m.reg) | rmReads(m);
+        e.flags_written = op < 0x86;
+        return true;
+    }
+
+    // mov r/m, r
+    case 0x88:
+    case 0x89:
+    {
+        ModRM m = decodeModRM(modrm, rex, op == 0x88);
+        e.reads = bit(m.reg) | (m.mod == 3 ? 0 : m.mem);
+        if(op == 0x89 && m.mod == 3 && full)
+            e.kills = bit(m.rm);
+        return true;
+    }
+
+    // mov r, r/m
+    case 0x8a:
+    case 0x8b:
+    {
+        ModRM m = decodeModRM(modrm, rex, op == 0x8a);
+        e.reads = rmReads(m);
+        if(op == 0x8b && full)
+            e.kills = bit(m.reg);
+        return true;
+    }
+
+    // lea
+    case 0x8d:
+    {
+        ModRM m = decodeModRM(modrm, rex, false);
+        if(m.mod == 3)
+            return false;
+
+        e.reads = m.mem;
+        if(full)
+            e.kills = bit(m.reg);
+        return true;
+    }
+
+    // przesunięcia i rotacje - przy zerowej liczbie przesunięć flagi nie są zmieniane
+    case 0xc0:
+    case 0xc1:
+    case 0xd0:
+    case 0xd1:
+    case 0xd2:
+    case 0xd3:
+    {
+        ModRM m = decodeModRM(modrm, rex, (op & 1) == 0);
+        uint8_t kind = (modrm[0] >> 3) & 7;
+
+        e.reads = rmReads(m);
+        if(op == 0xd2 || op == 0xd3)
+            e.reads |= bit(rcx);
+
+        // rcl, rcr
+        e.flags_read = kind == 2 || kind == 3;
+        return true;
+    }
+
+    // mov r/m, imm
+    case 0xc6:
+    case 0xc7:
+    {
+        if(((modrm[0] >> 3) & 7) != 0)
+            return false;
+
+        ModRM m = decodeModRM(modrm, rex, op == 0xc6);
+        e.reads = m.mod == 3 ? 0 : m.mem;
+        if(op == 0xc7 && m.mod == 3 && full)
+            e.kills = bit(m.rm);
+        return true;
+    }
+
+    // grupa 3: test, not, neg, mul, imul, div, idiv
+    case 0xf6:
+    case 0xf7:
+    {
+        ModRM m = decodeModRM(modrm, rex, op == 0xf6);
+        uint8_t kind = (modrm[0] >> 3) & 7;
+
+        e.reads = rmReads(m);
+        e.flags_written = kind != 2;
+
+        if(kind >= 4)
+        {
+            e.reads |= bit(rax);
+            if(kind >= 6)
+                e.reads |= bit(rdx);
+            else if(op == 0xf7 && full)
+                e.kills = bit(rdx);
+        }
+        return true;
+    }
+
+    // grupa 4 i 5: inc, dec, call, jmp, push
+    case 0xfe:
+    case 0xff:
+    {
+        ModRM m = decodeModRM(modrm, rex, op == 0xfe);
+        uint8_t kind = (modrm[0] >> 3) & 7;
+
+        if(kind <= 1)
+        {
+            e.reads = rmReads(m);
+            return true;
+        }
+
+        if(op == 0xfe)
+            return false;
+
+        if(kind == 6)
+        {
+            e.reads = rmReads(m);
+            return true;
+        }
+
+        if(kind == 7)
+            return false;
+
+        e.reads = rmReads(m);
+        e.stop = true;
+        return true;
+    }
+    }
+
+    return false;
+}
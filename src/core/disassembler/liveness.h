@@ -0,0 +1,109 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <core/disassembler/lengthdecoder.h>
+#include <core/file_types/codedefines.h>
+
+/**
+ * @brief Analiza żywotności rejestrów ogólnego przeznaczenia i flag w danym miejscu kodu.
+ *
+ * Kod jest przeglądany liniowo od podanego adresu. Rejestr jest martwy, jeżeli zostaje w całości
+ * nadpisany, zanim zostanie odczytany. Analiza kończy się na pierwszym skoku, wywołaniu, powrocie
+ * lub nieobsługiwanej instrukcji - wszystkie nierozstrzygnięte rejestry i flagi są wtedy uznawane za żywe.
+ */
+class LivenessAnalyzer
+{
+public:
+    /**
+     * @brief Rejestry i flagi żywe w danym miejscu kodu.
+     */
+    struct Result {
+        /**
+         * @brief Maska żywych rejestrów. Bit n odpowiada rejestrowi o numerze n w kodowaniu instrukcji
+         * (0 - (e|r)ax, 1 - (e|r)cx, 2 - (e|r)dx, 3 - (e|r)bx, 4 - (e|r)sp, 5 - (e|r)bp, 6 - (e|r)si, 7 - (e|r)di, 8-15 - r8-r15).
+         */
+        uint16_t regs;
+
+        /**
+         * @brief Flaga informująca czy flagi procesora są żywe.
+         */
+        bool flags;
+    };
+
+    /**
+     * @brief Konstruktor.
+     * @param x64 flaga kodu 64-bitowego.
+     */
+    LivenessAnalyzer(bool x64);
+
+    /**
+     * @brief Metoda wyznaczająca rejestry i flagi żywe na początku kodu.
+     * @param code wskaźnik na pierwszą instrukcję.
+     * @param size liczba dostępnych bajtów.
+     * @return Żywe rejestry i flagi.
+     */
+    Result analyze(const uint8_t *code, uint32_t size) const;
+
+    /**
+     * @brief Wynik, w którym wszystkie rejestry i flagi są żywe (gdy kod nie jest znany).
+     * @return Żywe rejestry i flagi.
+     */
+    static Result allLive();
+
+    /**
+     * @brief Metoda sprawdzająca czy rejestr jest żywy.
+     * @param live wynik analizy.
+     * @param reg rejestr.
+     * @return True jeżeli rejestr jest żywy, False w innych przypadkach.
+     */
+    template <typename Register>
+    static bool isLive(const Result &live, Register reg)
+    {
+        int n = registerNumber(reg);
+        return n < 0 || (live.regs & (1 << n));
+    }
+
+    /**
+     * @brief Metoda zwracająca numer rejestru w kodowaniu instrukcji.
+     * @param reg rejestr.
+     * @return Numer rejestru lub -1.
+     */
+    static int registerNumber(Registers_x86 reg);
+    static int registerNumber(Registers_x64 reg);
+
+private:
+    /**
+     * @brief Wpływ jednej instrukcji na rejestry i flagi.
+     */
+    struct Effects {
+        uint16_t reads;
+
+        /**
+         * @brief Rejestry nadpisane w całości.
+         */
+        uint16_t kills;
+        bool flags_read;
+        bool flags_written;
+
+        /**
+         * @brief Flaga instrukcji kończącej analizę (skok, wywołanie, powrót).
+         */
+        bool stop;
+    };
+
+    /**
+     * @brief Maksymalna liczba analizowanych instrukcji.
+     */
+    static const int max_instructions;
+
+    bool x64;
+    LengthDecoder decoder;
+
+    /**
+     * @brief Metoda wyznaczająca wpływ instrukcji na rejestry i flagi.
+     * @return True jeżeli instrukcja jest obsługiwana, False w innych przypadkach.
+     */
+    bool effects(const uint8_t *code, uint8_t length, Effects &e) const;
+};
+
+#endif // LIVENESS_H
@@ -1,11 +1,17 @@
 #include "binaryfile.h"
 
-#include <chrono>
+#include "outputwriter.h"
+
+#include <limits>
+#include <algorithm>
+
+#include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
 
 BinaryFile::BinaryFile(QByteArray _data) :
     parsed(false),
     b_data(_data),
-    gen(std::chrono::system_clock::now().time_since_epoch().count())
+    gen(DJobContext::current().nextSeed())
 {
 
 }
@@ -20,3 +26,85 @@ QByteArray BinaryFile::getData()
     return b_data;
 }
 
+bool BinaryFile::writeToFile(const QString &fileName, const QString &sourceName)
+{
+    OutputWriter writer;
+    if(!writer.write(fileName, b_data, getDirtyRanges(), sourceName))
+    {
+        LOG_ERROR(QString("Cannot write file: %1").arg(fileName));
+        return false;
+    }
+
+    LOG_MSG(QString("File saved: %1 (%2 bytes written, %3 bytes cloned)")
+            .arg(fileName).arg(writer.getWrittenBytes()).arg(writer.getClonedBytes()));
+
+    return true;
+}
+
+QMap<qint64, qint64> BinaryFile::getDirtyRanges()
+{
+    return dirty;
+}
+
+void BinaryFile::markDirty(qint64 offset, qint64 length)
+{
+    if(length <= 0)
+        return;
+
+    qint64 begin = offset;
+    qint64 end = length > std::numeric_limits<qint64>::max() - offset ? std::numeric_limits<qint64>::max() : offset + length;
+
+    // Łączenie z zakresami nachodzącymi na nowy lub z nim sąsiadującymi
+    QMap<qint64, qint64>::iterator it = dirty.upperBound(begin);
+    if(it != dirty.begin() && (it - 1).value() >= begin)
+    {
+        --it;
+        begin = it.key();
+        end = std::max(end, it.value());
+        it = dirty.erase(it);
+    }
+
+    while(it != dirty.end() && it.key() <= end)
+    {
+        end = std::max(end, it.value());
+        it = dirty.erase(it);
+    }
+
+    dirty.insert(begin, end);
+}
+
+void BinaryFile::markDirtyFrom(qint64 offset)
+{
+    markDirty(offset, std::numeric_limits<qint64>::max() - offset);
+}
+
+BinaryFile::Format BinaryFile::detectFormat(const QByteArray &data, bool *x64)
+{
+    const unsigned char *d = reinterpret_cast<const unsigned char*>(data.constData());
+    const int size = data.size();
+
+    // e_ident: 0x7f 'E' 'L' 'F', EI_CLASS (1 - 32 bity, 2 - 64 bity)
+    if(size >= 16 && d[0] == 0x7f && d[1] == 'E' && d[2] == 'L' && d[3] == 'F' && (d[4] == 1 || d[4] == 2))
+    {
+        if(x64)
+            *x64 = d[4] == 2;
+        return Format::ELF;
+    }
+
+    // 'MZ', e_lfanew pod offsetem 0x3c wskazuje na 'PE\0\0' i pole Machine
+    if(size >= 0x40 && d[0] == 'M' && d[1] == 'Z')
+    {
+        uint32_t pe_offset = d[0x3c] | (d[0x3d] << 8) | (d[0x3e] << 16) | (static_cast<uint32_t>(d[0x3f]) << 24);
+
+        if(pe_offset <= static_cast<uint32_t>(size) - 6 && d[pe_offset] == 'P' && d[pe_offset + 1] == 'E' &&
+                d[pe_offset + 2] == 0 && d[pe_offset + 3] == 0)
+        {
+            // IMAGE_FILE_MACHINE_I386
+            if(x64)
+                *x64 = (d[pe_offset + 4] | (d[pe_offset + 5] << 8)) != 0x014c;
+            return Format::PE;
+        }
+    }
+
+    return Format::Unknown;
+}
@@ -2,10 +2,22 @@
 #define BINARYFILE_H
 
 #include <QByteArray>
+#include <QString>
+#include <QMap>
+#include <random>
 
 class BinaryFile
 {
 public:
+    /**
+     * @brief Formaty plików binarnych.
+     */
+    enum class Format {
+        Unknown,
+        ELF,
+        PE
+    };
+
     BinaryFile(QByteArray _data);
     virtual ~BinaryFile();
 
@@ -15,6 +27,21 @@ public:
      */
     virtual QByteArray getData();
 
+    /**
+     * @brief Zapisuje plik. Gdy podany jest plik źródłowy, z którego wczytano dane, niezmienione
+     * zakresy są z niego klonowane, a zapisywane są tylko zakresy zmienione.
+     * @param fileName ścieżka pliku wynikowego.
+     * @param sourceName ścieżka pliku źródłowego, pusta jeżeli ma zostać zapisany cały plik.
+     * @return True jeżeli zapis się powiódł.
+     */
+    bool writeToFile(const QString &fileName, const QString &sourceName = QString());
+
+    /**
+     * @brief Pobiera zakresy danych zmienione od wczytania pliku.
+     * @return Rozłączne zakresy (początek -> koniec), koniec może przekraczać rozmiar danych.
+     */
+    virtual QMap<qint64, qint64> getDirtyRanges();
+
     /**
      * @brief Sprawdza czy w pamięci przechowywany jest poprawny plik.
      * @return True jeżeli plik jest poprawny.
@@ -33,8 +60,34 @@ public:
      */
     virtual bool is_x86() const = 0;
 
+    /**
+     * @brief Rozpoznaje format pliku na podstawie samych nagłówków, bez parsowania całego pliku.
+     * @param data zawartość pliku.
+     * @param x64 jeżeli różny od nullptr, zapisywana jest informacja czy plik jest 64-bitowy.
+     * @return Format pliku.
+     */
+    static Format detectFormat(const QByteArray &data, bool *x64 = nullptr);
+
 protected:
 
+    /**
+     * @brief Oznacza zakres danych jako zmieniony.
+     * @param offset początek zakresu.
+     * @param length długość zakresu.
+     */
+    void markDirty(qint64 offset, qint64 length);
+
+    /**
+     * @brief Oznacza dane od podanego offsetu do końca pliku jako zmienione (np. po przesunięciu danych).
+     * @param offset początek zakresu.
+     */
+    void markDirtyFrom(qint64 offset);
+
+    /**
+     * @brief Zakresy danych zmienione od wczytania pliku.
+     */
+    QMap<qint64, qint64> dirty;
+
     /**
      * @brief Flaga zawierająca informację czy plik został poprawnie sparsowany.
      */
@@ -1,25 +1,8 @@
 #include "codedefines.h"
 
-#include <chrono>
 #include <QDebug>
 
-template <typename Register>
-QStack<uint64_t> CodeDefines<Register>::seed;
-
-template <typename Register>
-const QRegExp CodeDefines<Register>::newLineRegExp = QRegExp("[\r\n]");
-template const QRegExp CodeDefines<Registers_x86>::newLineRegExp;
-template const QRegExp CodeDefines<Registers_x64>::newLineRegExp;
-
-template <typename Register>
-const QRegExp CodeDefines<Register>::callRegExp = QRegExp("^[0-9a-f]{8}  E8[0-9a-f]{6}(00|ff) ", Qt::CaseInsensitive);
-template const QRegExp CodeDefines<Registers_x86>::callRegExp;
-template const QRegExp CodeDefines<Registers_x64>::callRegExp;
-
-template <typename Register>
-const QRegExp CodeDefines<Register>::jmpRegExp = QRegExp("^^[0-9a-f]{8}  E9[0-9a-f]{6}(00|ff) ", Qt::CaseInsensitive);
-template const QRegExp CodeDefines<Registers_x86>::jmpRegExp;
-template const QRegExp CodeDefines<Registers_x64>::jmpRegExp;
+#include <helper/job_context/djobcontext.h>
 
 template <>
 const uint8_t CodeDefines<Registers_x64>::shadowSize = 4;
@@ -91,6 +74,16 @@ const QByteArray CodeDefines<Register>::ret = QByteArray("\xC3");
 template const QByteArray CodeDefines<Registers_x86>::ret;
 template const QByteArray CodeDefines<Registers_x64>::ret;
 
+template <typename Register>
+const QByteArray CodeDefines<Register>::saveFlags = QByteArray("\x9C");
+template const QByteArray CodeDefines<Registers_x86>::saveFlags;
+template const QByteArray CodeDefines<Registers_x64>::saveFlags;
+
+template <typename Register>
+const QByteArray CodeDefines<Register>::restoreFlags = QByteArray("\x9D");
+template const QByteArray CodeDefines<Registers_x86>::restoreFlags;
+template const QByteArray CodeDefines<Registers_x64>::restoreFlags;
+
 template <>
 const QList<Registers_x86> CodeDefines<Registers_x86>::internalRegs =
 {
@@ -666,7 +659,8 @@ QByteArray CodeDefines<Registers_x64>::saveAll()
     QList<Reg> regs = {Reg::RAX, Reg::RCX, Reg::RDX, Reg::RBX, Reg::RSI, Reg::RDI,
                        Reg::R8, Reg::R9, Reg::R10, Reg::R11, Reg::R12, Reg::R13, Reg::R14, Reg::R15};
 
-    seed.push(std::chrono::system_clock::now().time_since_epoch().count());
+    QStack<uint64_t> &seed = DJobContext::current().getRegisterSeeds();
+    seed.push(DJobContext::current().nextSeed());
     std::default_random_engine gen(seed.top());
     std::uniform_int_distribution<int> idx(0, 99);
 
@@ -696,6 +690,7 @@ QByteArray CodeDefines<Registers_x64>::restoreAll()
     QList<Reg> regs = {Reg::RAX, Reg::RCX, Reg::RDX, Reg::RBX, Reg::RSI, Reg::RDI,
                        Reg::R8, Reg::R9, Reg::R10, Reg::R11, Reg::R12, Reg::R13, Reg::R14, Reg::R15};
 
+    QStack<uint64_t> &seed = DJobContext::current().getRegisterSeeds();
     if(seed.isEmpty())
         return QByteArray();
 
@@ -714,6 +709,182 @@ QByteArray CodeDefines<Registers_x64>::restoreAll()
     return code;
 }
 
+template <>
+QByteArray CodeDefines<Registers_x86>::rateLimit(uint32_t calls, uint64_t cycles, uint32_t skip)
+{
+    uint32_t lo = static_cast<uint32_t>(cycles);
+    uint32_t hi = static_cast<uint32_t>(cycles >> 32);
+    QByteArray check, run, code;
+
+    if(cycles)
+    {
+        // rdtsc; sub eax, [ecx + 8]; sbb edx, [ecx + 12]; cmp edx, hi
+        check.append(QByteArray("\x0f\x31\x2b\x41\x08\x1b\x51\x0c\x81\xfa", 10));
+        check.append(reinterpret_cast<const char*>(&hi), sizeof(uint32_t));
+        // ja run; jb skip; cmp eax, lo
+        check.append(QByteArray("\x77\x0e\x72\x07\x3d", 5));
+        check.append(reinterpret_cast<const char*>(&lo), sizeof(uint32_t));
+        // jae run
+        check.append(QByteArray("\x73\x05", 2));
+        // run: rdtsc; mov [ecx + 8], eax; mov [ecx + 12], edx
+        run.append(QByteArray("\x0f\x31\x89\x41\x08\x89\x51\x0c", 8));
+    }
+
+    if(calls)
+    {
+        // dec dword [ecx]; jle run
+        code.append(QByteArray("\xff\x09\x7e", 3));
+        code.append(static_cast<char>(check.size() + 5));
+        // run: mov dword [ecx], calls
+        run.append(QByteArray("\xc7\x01", 2));
+        run.append(reinterpret_cast<const char*>(&calls), sizeof(uint32_t));
+    }
+
+    skip += run.size();
+
+    // skip: jmp $+skip
+    code.append(check);
+    code.append(QByteArray("\xe9", 1));
+    code.append(reinterpret_cast<const char*>(&skip), sizeof(uint32_t));
+    code.append(run);
+
+    return code;
+}
+
+template <>
+QByteArray CodeDefines<Registers_x64>::rateLimit(uint32_t calls, uint64_t cycles, uint32_t skip)
+{
+    QByteArray check, run, code;
+
+    if(cycles)
+    {
+        // rdtsc; shl rdx, 32; or rax, rdx; sub rax, [rcx + 8]; mov rdx, cycles
+        check.append(QByteArray("\x0f\x31\x48\xc1\xe2\x20\x48\x09\xd0\x48\x2b\x41\x08\x48\xba", 15));
+        check.append(reinterpret_cast<const char*>(&cycles), sizeof(uint64_t));
+        // cmp rax, rdx; jae run
+        check.append(QByteArray("\x48\x39\xd0\x73\x05", 5));
+        // run: rdtsc; shl rdx, 32; or rax, rdx; mov [rcx + 8], rax
+        run.append(QByteArray("\x0f\x31\x48\xc1\xe2\x20\x48\x09\xd0\x48\x89\x41\x08", 13));
+    }
+
+    if(calls)
+    {
+        // dec dword [rcx]; jle run
+        code.append(QByteArray("\xff\x09\x7e", 3));
+        code.append(static_cast<char>(check.size() + 5));
+        // run: mov dword [rcx], calls
+        run.append(QByteArray("\xc7\x01", 2));
+        run.append(reinterpret_cast<const char*>(&calls), sizeof(uint32_t));
+    }
+
+    skip += run.size();
+
+    // skip: jmp $+skip
+    code.append(check);
+    code.append(QByteArray("\xe9", 1));
+    code.append(reinterpret_cast<const char*>(&skip), sizeof(uint32_t));
+    code.append(run);
+
+    return code;
+}
+
+template <>
+QByteArray CodeDefines<Registers_x86>::profileCounter(int64_t runtimeRel, uint32_t counterOff, uint32_t *slotOff)
+{
+    int32_t runtime = static_cast<int32_t>(runtimeRel - 0x18);
+    uint32_t counterHigh = counterOff + 4;
+    QByteArray code;
+
+    // pushfd; push eax; push ecx; call $+5; pop ecx; mov eax, [ecx + slot]
+    code.append(QByteArray("\x9c\x50\x51\xe8\x00\x00\x00\x00\x59\x8b\x81\x00\x00\x00\x00", 15));
+    // test eax, eax; jnz inc; call runtime
+    code.append(QByteArray("\x85\xc0\x75\x09\xe8", 5));
+    code.append(reinterpret_cast<const char*>(&runtime), sizeof(int32_t));
+    // test eax, eax; jz end
+    code.append(QByteArray("\x85\xc0\x74\x10", 4));
+    // inc: lock add dword [eax + counterOff], 1; lock adc dword [eax + counterOff + 4], 0
+    code.append(QByteArray("\xf0\x83\x80", 3));
+    code.append(reinterpret_cast<const char*>(&counterOff), sizeof(uint32_t));
+    code.append(QByteArray("\x01\xf0\x83\x90", 4));
+    code.append(reinterpret_cast<const char*>(&counterHigh), sizeof(uint32_t));
+    // end: pop ecx; pop eax; popfd
+    code.append(QByteArray("\x00\x59\x58\x9d", 4));
+
+    if(slotOff)
+        *slotOff = 0x0b;
+
+    return code;
+}
+
+template <>
+QByteArray CodeDefines<Registers_x64>::profileCounter(int64_t runtimeRel, uint32_t counterOff, uint32_t *slotOff)
+{
+    int32_t runtime = static_cast<int32_t>(runtimeRel - 0x18);
+    QByteArray code;
+
+    // lea rsp, [rsp - 128] (red zone); pushfq; push rax; mov rax, [rip + slot]
+    code.append(QByteArray("\x48\x8d\x64\x24\x80\x9c\x50\x48\x8b\x05\x00\x00\x00\x00", 14));
+    // test rax, rax; jnz inc; call runtime
+    code.append(QByteArray("\x48\x85\xc0\x75\x0a\xe8", 6));
+    code.append(reinterpret_cast<const char*>(&runtime), sizeof(int32_t));
+    // test rax, rax; jz end
+    code.append(QByteArray("\x48\x85\xc0\x74\x08", 5));
+    // inc: lock inc qword [rax + counterOff]
+    code.append(QByteArray("\xf0\x48\xff\x80", 4));
+    code.append(reinterpret_cast<const char*>(&counterOff), sizeof(uint32_t));
+    // end: pop rax; popfq; lea rsp, [rsp + 128]
+    code.append(QByteArray("\x58\x9d\x48\x8d\xa4\x24\x80\x00\x00\x00", 10));
+
+    if(slotOff)
+        *slotOff = 0x0a;
+
+    return code;
+}
+
+template <>
+QByteArray CodeDefines<Registers_x86>::profileRuntime(const QString &path, uint32_t size, uint32_t *slotOff)
+{
+    // open(path, O_RDWR); mmap2(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); close(fd), w razie błędu
+    // MAP_PRIVATE | MAP_ANONYMOUS; gdy i to się nie uda, zwraca 0, w przeciwnym razie zapisuje wskaźnik w slocie
+    QByteArray code(
+        "\x53\x51\x52\x56\x57\x55\xe8\x00\x00\x00\x00\x5d\x8d\x9d\x73\x00\x00\x00\xb9\x02\x00\x00\x00\x31"
+        "\xd2\xb8\x05\x00\x00\x00\xcd\x80\x89\xc7\xbe\x01\x00\x00\x00\x85\xc0\x79\x08\xbe\x22\x00\x00\x00"
+        "\x83\xcf\xff\x55\x31\xdb\xb9\x44\x33\x22\x11\xba\x03\x00\x00\x00\x31\xed\xb8\xc0\x00\x00\x00\xcd"
+        "\x80\x5d\x85\xff\x78\x0b\x50\x89\xfb\xb8\x06\x00\x00\x00\xcd\x80\x58\x3d\x00\xf0\xff\xff\x76\x09"
+        "\x83\xfe\x01\x74\xc6\x31\xc0\xeb\x0e\xe8\x00\x00\x00\x00\x59\x81\xc1\x00\x00\x00\x00\x89\x01\x5d"
+        "\x5f\x5e\x5a\x59\x5b\xc3", 126);
+
+    code.replace(0x37, sizeof(uint32_t), reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+    code.append(path.toLocal8Bit()).append('\0');
+
+    if(slotOff)
+        *slotOff = 0x71;
+
+    return code;
+}
+
+template <>
+QByteArray CodeDefines<Registers_x64>::profileRuntime(const QString &path, uint32_t size, uint32_t *slotOff)
+{
+    // open(path, O_RDWR); mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0); close(fd), w razie błędu
+    // MAP_PRIVATE | MAP_ANONYMOUS; gdy i to się nie uda, zwraca 0, w przeciwnym razie zapisuje wskaźnik w slocie
+    QByteArray code(
+        "\x57\x56\x52\x51\x41\x50\x41\x51\x41\x52\x41\x53\x48\x8d\x3d\x73\x00\x00\x00\xbe\x02\x00\x00\x00"
+        "\x31\xd2\xb8\x02\x00\x00\x00\x0f\x05\x49\x89\xc0\x41\xba\x01\x00\x00\x00\x48\x85\xc0\x79\x0a\x41"
+        "\xba\x22\x00\x00\x00\x49\x83\xc8\xff\x31\xff\xbe\x44\x33\x22\x11\xba\x03\x00\x00\x00\x45\x31\xc9"
+        "\xb8\x09\x00\x00\x00\x0f\x05\x4d\x85\xc0\x78\x0c\x50\x4c\x89\xc7\xb8\x03\x00\x00\x00\x0f\x05\x58"
+        "\x48\x3d\x00\xf0\xff\xff\x76\x0a\x41\x83\xfa\x01\x74\xc1\x31\xc0\xeb\x07\x48\x89\x05\x00\x00\x00"
+        "\x00\x41\x5b\x41\x5a\x41\x59\x41\x58\x59\x5a\x5e\x5f\xc3", 134);
+
+    code.replace(0x3c, sizeof(uint32_t), reinterpret_cast<const char*>(&size), sizeof(uint32_t));
+    code.append(path.toLocal8Bit()).append('\0');
+
+    if(slotOff)
+        *slotOff = 0x75;
+
+    return code;
+}
+
 template <typename Register>
 QByteArray BinaryCode<Register>::getBytes()
 {
@@ -735,6 +906,18 @@ template void BinaryCode<Registers_x86>::append(QByteArray _code, bool relocatio
 template void BinaryCode<Registers_x64>::append(QByteArray _code, bool relocation);
 
 
+template <typename Register>
+void BinaryCode<Register>::append(BinaryCode<Register> _code)
+{
+    foreach(uint64_t val, _code.relocations)
+        relocations.append(val + code.length());
+
+    code.append(_code.code);
+}
+template void BinaryCode<Registers_x86>::append(BinaryCode<Registers_x86> _code);
+template void BinaryCode<Registers_x64>::append(BinaryCode<Registers_x64> _code);
+
+
 template <typename Register>
 QList<uint64_t> BinaryCode<Register>::getRelocations(uint64_t codeBase)
 {
@@ -765,6 +948,34 @@ const uint8_t BinaryCode<Registers_x86>::addrSize = 4;
 template <>
 const uint8_t BinaryCode<Registers_x64>::addrSize = 8;
 
+template <typename Register>
+QByteArray CodeDefines<Register>::nops(uint32_t size)
+{
+    static const QByteArray nop[] = {
+        QByteArray(),
+        QByteArray("\x90", 1),
+        QByteArray("\x66\x90", 2),
+        QByteArray("\x0f\x1f\x00", 3),
+        QByteArray("\x0f\x1f\x40\x00", 4),
+        QByteArray("\x0f\x1f\x44\x00\x00", 5),
+        QByteArray("\x66\x0f\x1f\x44\x00\x00", 6),
+        QByteArray("\x0f\x1f\x80\x00\x00\x00\x00", 7),
+        QByteArray("\x0f\x1f\x84\x00\x00\x00\x00\x00", 8),
+        QByteArray("\x66\x0f\x1f\x84\x00\x00\x00\x00\x00", 9)
+    };
+
+    QByteArray code;
+    code.reserve(size);
+
+    for(; size > 9; size -= 9)
+        code.append(nop[9]);
+    code.append(nop[size]);
+
+    return code;
+}
+template QByteArray CodeDefines<Registers_x86>::nops(uint32_t size);
+template QByteArray CodeDefines<Registers_x64>::nops(uint32_t size);
+
 template <typename Register>
 QByteArray CodeDefines<Register>::obfuscate(std::default_random_engine &gen, uint8_t min_len, uint8_t max_len)
 {
@@ -83,6 +83,12 @@ public:
      */
     void append(QByteArray _code, bool relocation = false);
 
+    /**
+     * @brief Dodaje kod razem z jego relokacjami
+     * @param _code Kod binarny z relokacjami
+     */
+    void append(BinaryCode<Register> _code);
+
     /**
      * @brief Pobiera kod
      * @return Kod binarny
@@ -198,11 +204,6 @@ private:
      */
     static const QByteArray _store_high_bytes;
 
-    /**
-     * @brief Stos seedów generatora liczb losowych
-     */
-    static QStack<uint64_t> seed;
-
 public:
 
     /**
@@ -220,6 +221,16 @@ public:
      */
     static const QByteArray ret;
 
+    /**
+     * @brief Kod odpowiadający instrukcji: pushf
+     */
+    static const QByteArray saveFlags;
+
+    /**
+     * @brief Kod odpowiadający instrukcji: popf
+     */
+    static const QByteArray restoreFlags;
+
     /**
      * @brief Lista wewnętrznych rejestów
      */
@@ -245,21 +256,6 @@ public:
      */
     static const uint8_t stackCellSize;
 
-    /**
-     * @brief Wyrażenie regularne znajdujące znak nowej linii
-     */
-    static const QRegExp newLineRegExp;
-
-    /**
-     * @brief Wyrażenie regularne znajdujące instrukcję call offset w zdekompilowanym kodzie
-     */
-    static const QRegExp callRegExp;
-
-    /**
-     * @brief Wyrażenie regularne znajdujące instrukcję jmp offset w zdekompilowanym kodzie
-     */
-    static const QRegExp jmpRegExp;
-
     /**
      * @brief Metoda odpowiadająca instrukcji: push reg
      * @param reg Rejestr do zapisania
@@ -383,7 +379,8 @@ public:
     static QByteArray retN(uint16_t n);
 
     /**
-     * @brief Zapisanie wszystkich rejestów na stosie
+     * @brief Zapisanie wszystkich rejestów na stosie. Kolejność jest losowana generatorem bieżącego
+     * zadania (DJobContext), a jej seed trafia na stos zadania do odczytu przez restoreAll().
      * @return Kod
      */
     static QByteArray saveAll();
@@ -394,6 +391,48 @@ public:
      */
     static QByteArray restoreAll();
 
+    /**
+     * @brief Ogranicznik częstości: kod za nim wykonuje się co calls wywołań lub po upływie cycles cykli
+     * procesora (rdtsc) od ostatniego wykonania, w zależności od tego, co nastąpi wcześniej. W przeciwnym
+     * razie pomijanych jest skip bajtów. Adres 16-bajtowego, wyzerowanego stanu w zapisywalnych danych
+     * musi być w rejestrze ecx (rcx). Niszczy rejestry eax, ecx, edx i flagi.
+     * @param calls Liczba wywołań na jedno sprawdzenie (0 - bez limitu wywołań)
+     * @param cycles Liczba cykli między sprawdzeniami (0 - bez limitu czasu)
+     * @param skip Liczba pomijanych bajtów
+     * @return Kod
+     */
+    static QByteArray rateLimit(uint32_t calls, uint64_t cycles, uint32_t skip);
+
+    /**
+     * @brief Licznik wywołań miejsca (tryb profilujący): zwiększa licznik w odwzorowanym pliku zrzutu,
+     * przy pierwszym użyciu odwzorowując go procedurą z profileRuntime(). Gdy odwzorowanie się nie powiedzie,
+     * licznik nie jest zwiększany. Zachowuje rejestry i flagi.
+     * @param runtimeRel Przesunięcie początku profileRuntime() względem początku tego kodu
+     * @param counterOff Przesunięcie 64-bitowego licznika w pliku zrzutu
+     * @param slotOff Zwracany offset 4-bajtowego pola z adresem wskaźnika na odwzorowanie (w zapisywalnych
+     * danych): na x86 względem adresu zdjętego ze stosu po call $+5 (pole - 3), na x64 względem końca pola
+     * @return Kod
+     */
+    static QByteArray profileCounter(int64_t runtimeRel, uint32_t counterOff, uint32_t *slotOff = nullptr);
+
+    /**
+     * @brief Procedura odwzorowująca plik zrzutu liczników (MAP_SHARED, a gdy pliku brak - pamięć anonimowa),
+     * po której następuje ścieżka do pliku. Wskaźnik na odwzorowanie jest zapisywany w zapisywalnych danych
+     * i zwracany w eax (rax), a 0 oznacza błąd odwzorowania. Tylko Linux.
+     * @param path Ścieżka do pliku zrzutu
+     * @param size Rozmiar odwzorowania
+     * @param slotOff Zwracany offset pola z adresem wskaźnika, liczonego tak jak w profileCounter()
+     * @return Kod
+     */
+    static QByteArray profileRuntime(const QString &path, uint32_t size, uint32_t *slotOff = nullptr);
+
+    /**
+     * @brief Wielobajtowe instrukcje nop (zalecane przez Intel, do 9 bajtów każda), używane jako dopełnienie
+     * @param size Rozmiar dopełnienia
+     * @return Kod
+     */
+    static QByteArray nops(uint32_t size);
+
     /**
      * @brief Kod zaciemniający działanie
      * @param gen Generator liczb losowych
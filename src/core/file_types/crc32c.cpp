@@ -0,0 +1,108 @@
+#include <core/file_types/crc32c.h>
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define CRC32C_HARDWARE
+#endif
+
+const uint32_t Crc32c::polynomial = 0x82f63b78;
+
+uint32_t Crc32c::compute(const QByteArray &data)
+{
+    return compute(reinterpret_cast<const uint8_t*>(data.constData()), data.size());
+}
+
+uint32_t Crc32c::compute(const uint8_t *data, size_t size, uint32_t crc)
+{
+    static bool hardware = hasHardware();
+
+    crc = ~crc;
+    crc = hardware ? computeHardware(data, size, crc) : computeTable(data, size, crc);
+
+    return ~crc;
+}
+
+bool Crc32c::hasHardware()
+{
+#ifdef CRC32C_HARDWARE
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+#else
+    return false;
+#endif
+}
+
+#ifdef CRC32C_HARDWARE
+__attribute__((target("sse4.2")))
+#endif
+uint32_t Crc32c::computeHardware(const uint8_t *data, size_t size, uint32_t crc)
+{
+#ifdef CRC32C_HARDWARE
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for(; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t))
+    {
+        uint64_t v;
+        memcpy(&v, data, sizeof(uint64_t));
+        crc64 = _mm_crc32_u64(crc64, v);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#else
+    for(; size >= sizeof(uint32_t); size -= sizeof(uint32_t), data += sizeof(uint32_t))
+    {
+        uint32_t v;
+        memcpy(&v, data, sizeof(uint32_t));
+        crc = _mm_crc32_u32(crc, v);
+    }
+#endif
+
+    for(; size; --size, ++data)
+        crc = _mm_crc32_u8(crc, *data);
+
+    return crc;
+#else
+    return computeTable(data, size, crc);
+#endif
+}
+
+uint32_t Crc32c::computeTable(const uint8_t *data, size_t size, uint32_t crc)
+{
+    // slicing-by-8: tablica k przesuwa bajt o k pozycji dalej
+    struct Tables
+    {
+        uint32_t t[8][256];
+
+        Tables()
+        {
+            for(uint32_t i = 0; i < 256; ++i)
+            {
+                uint32_t c = i;
+                for(int j = 0; j < 8; ++j)
+                    c = (c >> 1) ^ (polynomial & (0 - (c & 1)));
+                t[0][i] = c;
+            }
+
+            for(uint32_t i = 0; i < 256; ++i)
+                for(int k = 1; k < 8; ++k)
+                    t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+        }
+    };
+
+    // inicjalizacja zmiennej statycznej jest bezpieczna wątkowo
+    static const Tables tables;
+    const uint32_t (&table)[8][256] = tables.t;
+
+    for(; size >= 8; size -= 8, data += 8)
+    {
+        uint32_t lo = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24);
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+    }
+
+    for(; size; --size, ++data)
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xff];
+
+    return crc;
+}
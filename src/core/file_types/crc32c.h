@@ -0,0 +1,42 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <QByteArray>
+
+/**
+ * @brief Suma kontrolna CRC32C (wielomian Castagnoli), liczona tak samo jak instrukcja crc32 z SSE4.2.
+ *
+ * Na procesorach z SSE4.2 używana jest instrukcja crc32 (8 bajtów na instrukcję), w innych przypadkach
+ * tablicowa wersja slicing-by-8. Obie dają ten sam wynik co kod sprawdzający wstrzykiwany do pliku.
+ */
+class Crc32c
+{
+public:
+    /**
+     * @brief Liczy sumę kontrolną danych.
+     * @param data dane.
+     * @return Suma kontrolna.
+     */
+    static uint32_t compute(const QByteArray &data);
+
+    /**
+     * @brief Liczy sumę kontrolną danych.
+     * @param data wskaźnik na dane.
+     * @param size rozmiar danych.
+     * @param crc suma kontrolna poprzedniej części danych (0 dla pierwszej).
+     * @return Suma kontrolna.
+     */
+    static uint32_t compute(const uint8_t *data, size_t size, uint32_t crc = 0);
+
+private:
+    static uint32_t computeHardware(const uint8_t *data, size_t size, uint32_t crc);
+    static uint32_t computeTable(const uint8_t *data, size_t size, uint32_t crc);
+    static bool hasHardware();
+
+    /**
+     * @brief Wielomian CRC32C w postaci odwróconej.
+     */
+    static const uint32_t polynomial;
+};
+
+#endif // CRC32C_H
@@ -1,5 +1,6 @@
 #include <core/file_types/elffile.h>
 #include <utility>
+#include <algorithm>
 #include <cstring>
 #include <QFile>
 
@@ -7,7 +8,11 @@
     QString(".%1").arg(QString((std::string(#sec_type).substr(std::string(#sec_type).find_last_of(':') != std::string::npos ? \
     std::string(#sec_type).find_last_of(':') + 1 : 0)).c_str()).toLower())
 
-QMap<ELF::SectionType, ELF::section_info> ELF::section_type = {
+const Elf64_Xword ELF::huge_page_size = 0x200000;
+
+const Elf64_Xword ELF::data_headroom = 0x100000;
+
+const QMap<ELF::SectionType, ELF::section_info> ELF::section_type = {
     { ELF::SectionType::CTORS,      ELF::section_info(section_type_stringify(ELF::SectionType::CTORS),      SHT_PROGBITS)   },
     { ELF::SectionType::INIT,       ELF::section_info(section_type_stringify(ELF::SectionType::INIT),       SHT_PROGBITS)   },
     { ELF::SectionType::INIT_ARRAY, ELF::section_info(section_type_stringify(ELF::SectionType::INIT_ARRAY), SHT_INIT_ARRAY) },
@@ -17,12 +22,12 @@ QMap<ELF::SectionType, ELF::section_info> ELF::section_type = {
 void*
 ELF::get_ph_seg_offset(uint32_t idx) {
     try {
-        void *ph = __get_ph_header(idx);
+        const void *ph = __get_ph_header(idx);
         if (!ph || cls == classes::NONE)
             return nullptr;
         return cls == classes::ELF32 ?
-                    reinterpret_cast<void*>(reinterpret_cast<Elf32_Phdr*>(ph)->p_offset) :
-                    reinterpret_cast<void*>(reinterpret_cast<Elf64_Phdr*>(ph)->p_offset);
+                    reinterpret_cast<void*>(reinterpret_cast<const Elf32_Phdr*>(ph)->p_offset) :
+                    reinterpret_cast<void*>(reinterpret_cast<const Elf64_Phdr*>(ph)->p_offset);
     }
     catch(const std::exception &) {
         return nullptr;
@@ -30,15 +35,24 @@ ELF::get_ph_seg_offset(uint32_t idx) {
 }
 
 bool
-ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off) {
+ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off, Elf64_Xword align) {
+    Elf64_Off insert_off;
+    uint32_t insert_space;
+
+    return __extend_segment(_data, only_x, va, file_off, insert_off, insert_space, align);
+}
+
+bool
+ELF::__extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off,
+                      Elf64_Off &insert_off, uint32_t &insert_space, Elf64_Xword align) {
     if (!parsed)
         return false;
 
     QByteArray data(_data);
     // go through all executable segments and find the best one to extend
-    QList<std::pair<esize_t, void*> > load_seg; // all LOAD segments
-    Elf32_Phdr *ph = nullptr;
-    void *ph_without_meta = nullptr;
+    QList<std::pair<esize_t, const void*> > load_seg; // all LOAD segments
+    const Elf32_Phdr *ph = nullptr;
+    const void *ph_without_meta = nullptr;
     best_segment bs; // best segment
     int dsize = data.size(), i;
 
@@ -48,10 +62,44 @@ ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_
     for (i = 0; i < dsize; ++i)
         data.append('\x00');
 
+    // dedicated segment at the end of file, nothing is shifted
+    if (placement != Placement::ExtendSegment) {
+        bool huge = placement == Placement::HugePageSegment;
+        bool ok = false;
+
+        // only the end of file and the program header table change, no copy of the whole file is kept
+        int old_size = b_data.size(), old_added = added_segment;
+        ex_offset_t ph_off = ph_idx.at(0);
+        QByteArray old_table = b_data.mid(ph_off, ph_num * ph_size);
+
+        insert_off = b_data.size();
+        insert_space = 0;
+        align = std::max<Elf64_Xword>(align, 4);
+
+        if (cls == classes::ELF32)
+            ok = __add_load_segment<Elf32_Ehdr, Elf32_Phdr>(data, align, huge ? huge_page_size : 0,
+                                                            huge ? huge_page_size : 1, va, file_off);
+        else if (cls == classes::ELF64)
+            ok = __add_load_segment<Elf64_Ehdr, Elf64_Phdr>(data, align, huge ? huge_page_size : 0,
+                                                            huge ? huge_page_size : 1, va, file_off);
+
+        if (!ok || !__parse()) {
+            b_data.truncate(old_size);
+            b_data.replace(ph_off, old_table.size(), old_table);
+            added_segment = old_added;
+            parsed = __parse();
+            return false;
+        }
+
+        markDirty(ph_off, old_table.size());
+        markDirtyFrom(old_size);
+        return true;
+    }
+
     for (esize_t i = 0; i < ph_num; ++i) {
         // doesn't matter which arch app is compiled for :)
         ph_without_meta = __get_ph_header(i);
-        ph = reinterpret_cast<Elf32_Phdr*>(ph_without_meta);
+        ph = reinterpret_cast<const Elf32_Phdr*>(ph_without_meta);
         if (!ph)
             return false;
         if (ph->p_type == PT_LOAD)
@@ -72,11 +120,13 @@ ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_
         // figure out size of space we need after end of the segment to align virtual address
         // check if it's eligible to extend a segment
         if (cls == classes::ELF32) {
-            if (!__extend_segment_eligible<Elf32_Phdr, Elf32_Off>(bs, only_x, load_seg, i, data.size()))
+            if (!__extend_segment_eligible<Elf32_Phdr, Elf32_Off>(bs, only_x, load_seg, i, data.size(),
+                                                                  std::max<Elf64_Xword>(align, sizeof(Elf32_Off))))
                 continue;
         }
         else {
-            if (!__extend_segment_eligible<Elf64_Phdr, Elf64_Off>(bs, only_x, load_seg, i, data.size()))
+            if (!__extend_segment_eligible<Elf64_Phdr, Elf64_Off>(bs, only_x, load_seg, i, data.size(),
+                                                                  std::max<Elf64_Xword>(align, sizeof(Elf64_Off))))
                 continue;
         }
     } while(++i < size);
@@ -88,6 +138,8 @@ ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_
     // construct a new QByteArray
     QPair<QByteArray, Elf64_Addr> d = __construct_data(data, bs, file_off);
     va = d.second;
+    insert_off = file_off - bs.pre_pad;
+    insert_space = d.first.size() - b_data.size();
 
     QByteArray old_b_data = b_data;
     b_data = d.first;
@@ -97,9 +149,225 @@ ELF::extend_segment(const QByteArray &_data, bool only_x, Elf64_Addr &va, Elf64_
         return false;
     }
 
+    // everything after insertion point is shifted, addresses before it (headers, dynamic
+    // section, symbols, relocations) were fixed in place
+    __mark_changed(old_b_data, insert_off);
+    markDirtyFrom(insert_off);
+
+    return true;
+}
+
+bool
+ELF::__reserve_data(Elf64_Xword size, Elf64_Xword align, Elf64_Addr &va) {
+    if (cls == classes::ELF32)
+        return __reserve_data<Elf32_Phdr>(size, align, va);
+    if (cls == classes::ELF64)
+        return __reserve_data<Elf64_Phdr>(size, align, va);
+
+    return false;
+}
+
+bool
+ELF::begin_edit() {
+    if (!parsed || editing)
+        return false;
+
+    // implicit sharing: no copy is made until the buffer is modified
+    edit_backup = b_data;
+    edit_added_segment = added_segment;
+    edit_payloads.clear();
+    edit_patches.clear();
+    editing = true;
+
+    return true;
+}
+
+int
+ELF::queue_payload(const QByteArray &data, bool only_x, Elf64_Xword align) {
+    if (!editing || data.isEmpty())
+        return -1;
+
+    edit_payloads.push_back(edit_payload(data, only_x, align));
+    return edit_payloads.size() - 1;
+}
+
+int
+ELF::queue_data(Elf64_Xword size, Elf64_Xword align) {
+    if (!editing || !size)
+        return -1;
+
+    edit_payloads.push_back(edit_payload(QByteArray(size, '\x00'), false, align, true));
+    return edit_payloads.size() - 1;
+}
+
+bool
+ELF::queue_relative_patch(int payload_id, Elf64_Off payload_off, Elf64_Addr target) {
+    if (!editing || payload_id < 0 || payload_id >= edit_payloads.size() || edit_payloads[payload_id].writable ||
+            payload_off + sizeof(Elf32_Addr) > static_cast<Elf64_Off>(edit_payloads[payload_id].data.size()))
+        return false;
+
+    edit_patches.push_back(edit_patch(payload_id, payload_off, 0, -1, target));
+    return true;
+}
+
+bool
+ELF::queue_relative_patch(Elf64_Off file_off, Elf64_Addr va, int payload_id, Elf64_Off payload_off) {
+    if (!editing || payload_id < 0 || payload_id >= edit_payloads.size() ||
+            file_off + sizeof(Elf32_Addr) > static_cast<Elf64_Off>(b_data.size()))
+        return false;
+
+    edit_patches.push_back(edit_patch(-1, file_off, va, payload_id, payload_off));
+    return true;
+}
+
+bool
+ELF::commit_edit(QList<QPair<Elf64_Addr, Elf64_Off> > &placement) {
+    if (!editing)
+        return false;
+
+    placement.clear();
+    if (edit_payloads.isEmpty()) {
+        edit_patches.clear();
+        return true;
+    }
+
+    // glue all payloads together, every one starting on 4-byte (or requested) boundary,
+    // so the file is rebuilt and reparsed only once; writable data is glued into a separate block
+    QByteArray block;
+    QList<Elf64_Off> payload_off;
+    bool only_x = false;
+    Elf64_Xword block_align = 4, data_size = 0, data_align = 4;
+
+    foreach (const edit_payload &p, edit_payloads) {
+        Elf64_Xword align = std::max<Elf64_Xword>(p.align, 4);
+        if (p.writable) {
+            data_size += (align - data_size % align) % align;
+            data_align = std::max(data_align, align);
+            payload_off.push_back(data_size);
+            data_size += p.data.size();
+            continue;
+        }
+
+        block.append(QByteArray((align - block.size() % align) % align, '\x00'));
+        block_align = std::max(block_align, align);
+        payload_off.push_back(block.size());
+        block.append(p.data);
+        // executable only segment suits also payloads without such requirement
+        only_x |= p.only_x;
+    }
+
+    // appended segment doesn't shift the file: to roll back it's enough to truncate the file,
+    // restore program headers and the patched fields, so the whole file is not copied
+    bool append = this->placement != Placement::ExtendSegment;
+    QByteArray old_b_data, old_table;
+    QList<QPair<Elf64_Off, int32_t> > old_fields;
+    int old_size = b_data.size(), old_added = added_segment;
+    ex_offset_t ph_off = ph_idx.at(0);
+
+    if (append)
+        old_table = b_data.mid(ph_off, ph_num * ph_size);
+    else
+        old_b_data = b_data;
+
+    Elf64_Addr va = 0, data_va = 0;
+    Elf64_Off file_off = 0, insert_off = 0;
+    uint32_t insert_space = 0;
+    bool ok = true;
+
+    // data goes past the end of program image: an appended segment is placed after it, while
+    // extending a segment may move the addresses of the following ones, so the data is reserved last
+    if (data_size && append)
+        ok = __reserve_data(data_size, data_align, data_va);
+
+    if (ok && !block.isEmpty())
+        ok = __extend_segment(block, only_x, va, file_off, insert_off, insert_space, block_align);
+
+    if (ok && data_size && !append)
+        ok = __reserve_data(data_size, data_align, data_va);
+
+    if (ok && data_size) {
+        ok = __parse();
+        markDirty(ph_idx.at(0), ph_num * ph_size);
+    }
+
+    for (int i = 0; ok && i < payload_off.size(); ++i) {
+        if (edit_payloads[i].writable)
+            placement.push_back(QPair<Elf64_Addr, Elf64_Off>(data_va + payload_off[i], 0));
+        else
+            placement.push_back(QPair<Elf64_Addr, Elf64_Off>(va + payload_off[i], file_off + payload_off[i]));
+    }
+
+    foreach (const edit_patch &p, edit_patches) {
+        if (!ok)
+            break;
+
+        Elf64_Off fo;
+        Elf64_Addr field_va, target_va;
+
+        if (p.payload_id < 0) {
+            // file offsets were given before insertion
+            fo = p.off >= insert_off ? p.off + insert_space : p.off;
+            field_va = p.va;
+        }
+        else {
+            fo = placement[p.payload_id].second + p.off;
+            field_va = placement[p.payload_id].first + p.off;
+        }
+
+        target_va = p.target_id < 0 ? p.target : placement[p.target_id].first + p.target;
+
+        int32_t old_field;
+        if (append && fo < static_cast<Elf64_Off>(old_size) && get_relative_address(fo, old_field))
+            old_fields.push_front(QPair<Elf64_Off, int32_t>(fo, old_field));
+
+        // relative address is counted from the end of 4-byte field
+        ok = set_relative_address(fo, target_va - (field_va + sizeof(Elf32_Addr)));
+    }
+
+    edit_payloads.clear();
+    edit_patches.clear();
+
+    if (!ok) {
+        placement.clear();
+
+        if (append) {
+            typedef QPair<Elf64_Off, int32_t> field_t;
+            foreach (const field_t &f, old_fields)
+                set_relative_address(f.first, f.second);
+
+            b_data.truncate(old_size);
+            b_data.replace(ph_off, old_table.size(), old_table);
+        }
+        else
+            b_data = old_b_data;
+
+        added_segment = old_added;
+        parsed = __parse();
+        return false;
+    }
+
     return true;
 }
 
+void
+ELF::rollback_edit() {
+    if (!editing)
+        return;
+
+    b_data = edit_backup;
+    added_segment = edit_added_segment;
+    parsed = __parse();
+    end_edit();
+}
+
+void
+ELF::end_edit() {
+    edit_backup.clear();
+    edit_payloads.clear();
+    edit_patches.clear();
+    editing = false;
+}
+
 bool
 ELF::__write_to_file(const QString &fname, const QByteArray &data) const {
     QFile of(fname);
@@ -121,6 +389,11 @@ ELF::write_to_file(const QString &fname) const {
     return __write_to_file(fname, b_data);
 }
 
+bool
+ELF::write_to_file(const QString &fname, const QString &source_fname) {
+    return writeToFile(fname, source_fname);
+}
+
 bool
 ELF::__set_entry_point(const Elf64_Addr &entry_point, QByteArray &data, Elf64_Addr *old_ep) {
     Elf32_Ehdr *eh_86 = nullptr;
@@ -158,6 +431,8 @@ bool
 ELF::set_entry_point(const Elf64_Addr &entry_point, Elf64_Addr *old_ep) {
     if (!parsed)
         return false;
+
+    markDirty(0, cls == classes::ELF32 ? sizeof(Elf32_Ehdr) : sizeof(Elf64_Ehdr));
     return __set_entry_point(entry_point, b_data, old_ep);
 }
 
@@ -272,7 +547,7 @@ ELF::get_section_file_off(SectionType sec_type, Elf64_Addr &file_off) {
 template <typename ElfHeaderType, typename ElfSectionHeaderType>
 bool
 ELF::__get_section_file_off(ELF::SectionType sec_type, Elf64_Addr &file_off) {
-    const ElfHeaderType *eh = reinterpret_cast<const ElfHeaderType*>(b_data.data());
+    const ElfHeaderType *eh = reinterpret_cast<const ElfHeaderType*>(b_data.constData());
     // if section header table exists
     if (!eh->e_shoff)
         return false;
@@ -281,7 +556,7 @@ ELF::__get_section_file_off(ELF::SectionType sec_type, Elf64_Addr &file_off) {
         return false;
 
     const ElfSectionHeaderType *sh =
-            reinterpret_cast<const ElfSectionHeaderType*>(b_data.data() + eh->e_shoff);
+            reinterpret_cast<const ElfSectionHeaderType*>(b_data.constData() + eh->e_shoff);
 
     if (!sh)
         return false;
@@ -292,7 +567,7 @@ ELF::__get_section_file_off(ELF::SectionType sec_type, Elf64_Addr &file_off) {
     if (!shstrtab)
         return false;
 
-    const char *pshstrtab = reinterpret_cast<const char*>(b_data.data() + shstrtab->sh_offset);
+    const char *pshstrtab = reinterpret_cast<const char*>(b_data.constData() + shstrtab->sh_offset);
 
     if (!pshstrtab)
         return false;
@@ -337,6 +612,7 @@ ELF::set_relative_address(Elf64_Off file_off, Elf32_Addr rva) {
     if (!parsed || b_data.size() < file_off + sizeof(rva))
         return false;
     std::memcpy(b_data.data() + file_off, &rva, sizeof(rva));
+    markDirty(file_off, sizeof(rva));
     return true;
 }
 
@@ -344,7 +620,7 @@ ELF::set_relative_address(Elf64_Off file_off, Elf32_Addr rva) {
 template <typename ElfHeaderType, typename ElfSectionHeaderType>
 bool
 ELF::__set_section_content(ELF::SectionType sec_type, const QByteArray &section_data, const char filler) {
-    const ElfHeaderType *eh = reinterpret_cast<const ElfHeaderType*>(b_data.data());
+    const ElfHeaderType *eh = reinterpret_cast<const ElfHeaderType*>(b_data.constData());
     // if section header table exists
     if (!eh->e_shoff)
         return false;
@@ -353,7 +629,7 @@ ELF::__set_section_content(ELF::SectionType sec_type, const QByteArray &section_
         return false;
 
     const ElfSectionHeaderType *sh =
-            reinterpret_cast<const ElfSectionHeaderType*>(b_data.data() + eh->e_shoff);
+            reinterpret_cast<const ElfSectionHeaderType*>(b_data.constData() + eh->e_shoff);
 
     if (!sh)
         return false;
@@ -364,7 +640,7 @@ ELF::__set_section_content(ELF::SectionType sec_type, const QByteArray &section_
     if (!shstrtab)
         return false;
 
-    const char *pshstrtab = reinterpret_cast<const char*>(b_data.data() + shstrtab->sh_offset);
+    const char *pshstrtab = reinterpret_cast<const char*>(b_data.constData() + shstrtab->sh_offset);
 
     if (!pshstrtab)
         return false;
@@ -381,25 +657,19 @@ ELF::__set_section_content(ELF::SectionType sec_type, const QByteArray &section_
             if (sh->sh_size < section_data.size())
                 return false;
 
-            // TODO: do with replace??? :)
-
-            // fill with new data
-            // pad section data. with nops, idk why, just with nops :)
-            QByteArray new_section_data(b_data.data(), sh->sh_offset);
-            new_section_data.append(section_data);
-            // fill rest with nops
-            new_section_data.append(QByteArray(sh->sh_size - section_data.size(), filler));
-            new_section_data.append(b_data.data() + sh->sh_offset + sh->sh_size,
-                                    b_data.size() - sh->sh_offset - sh->sh_size);
-
-            QByteArray old_b_data = b_data;
+            if (sh->sh_offset + sh->sh_size > static_cast<uint64_t>(b_data.size()))
+                return false;
 
-            b_data = new_section_data;
+            // section size doesn't change, so data is overwritten in place
+            // and there is no need to copy and parse whole file again
+            Elf64_Off sec_off = sh->sh_offset;
+            Elf64_Xword sec_size = sh->sh_size;
+            char *sec = b_data.data() + sec_off;
 
-            if (!__parse()) {
-                b_data = old_b_data;
-                return false;
-            }
+            std::memcpy(sec, section_data.data(), section_data.size());
+            // pad section data. with nops, idk why, just with nops :)
+            std::memset(sec + section_data.size(), filler, sec_size - section_data.size());
+            markDirty(sec_off, sec_size);
 
             return true;
         }
@@ -410,6 +680,18 @@ ELF::__set_section_content(ELF::SectionType sec_type, const QByteArray &section_
     return false;
 }
 
+void
+ELF::__mark_changed(const QByteArray &old_data, Elf64_Off end) {
+    const Elf64_Off block = 0x1000;
+    end = std::min<Elf64_Off>(end, std::min(old_data.size(), b_data.size()));
+
+    for (Elf64_Off off = 0; off < end; off += block) {
+        Elf64_Off len = std::min(block, end - off);
+        if (std::memcmp(old_data.constData() + off, b_data.constData() + off, len))
+            markDirty(off, len);
+    }
+}
+
 bool
 ELF::__get_ph_addresses() {
     try {
@@ -427,11 +709,11 @@ ELF::__get_ph_addresses() {
     return true;
 }
 
-void*
-ELF::__get_elf_header() {
+const void*
+ELF::__get_elf_header() const {
     try {
         return is_valid() ?
-                    reinterpret_cast<void*>(&(b_data.data()[elf_header_idx])) :
+                    reinterpret_cast<const void*>(&(b_data.constData()[elf_header_idx])) :
                     nullptr;
     }
     catch(const std::exception &) {
@@ -439,15 +721,15 @@ ELF::__get_elf_header() {
     }
 }
 
-void*
-ELF::__get_ph_header(uint32_t idx) {
+const void*
+ELF::__get_ph_header(uint32_t idx) const {
     try {
         // TODO: check wtf will happen if idx is out of range :)
         if (idx >= ph_idx.size())
             return nullptr;
 
         return is_valid() ?
-                    reinterpret_cast<void*>(&(b_data.data())[ph_idx.at(idx)]) :
+                    reinterpret_cast<const void*>(&(b_data.constData())[ph_idx.at(idx)]) :
             nullptr;
         }
         catch(const std::exception &) {
@@ -510,7 +792,7 @@ ELF::__is_supported(const Elf32_Ehdr *elf_hdr) {
 
 template <typename ElfProgramHeader>
 void
-ELF::__best_segment_choose(best_segment &bs, bool only_x, ElfProgramHeader *ph,
+ELF::__best_segment_choose(best_segment &bs, bool only_x, const ElfProgramHeader *ph,
                          uint32_t pad_post, uint32_t pad_pre, bool change_va) {
     if (!bs.ph || ((bs.post_pad + bs.pre_pad) >= (pad_post + pad_pre))) {
         if (!only_x || (only_x && (ph->p_flags & PF_X))) {
@@ -524,18 +806,18 @@ ELF::__best_segment_choose(best_segment &bs, bool only_x, ElfProgramHeader *ph,
 
 template <typename ElfProgramHeaderType, typename ElfOffsetType>
 bool
-ELF::__extend_segment_eligible(best_segment &bs, bool only_x, const QList<std::pair<esize_t, void *> > &load_seg,
-                               int i, const int data_size) {
+ELF::__extend_segment_eligible(best_segment &bs, bool only_x, const QList<std::pair<esize_t, const void *> > &load_seg,
+                               int i, const int data_size, Elf64_Xword align) {
 
     bool change_va = false;
     uint32_t pad_pre, pad_post;
 
-    ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(load_seg.at(i).second),
+    const ElfProgramHeaderType *ph = reinterpret_cast<const ElfProgramHeaderType*>(load_seg.at(i).second),
             *phn = ((i + 1) < load_seg.size()) ?
-                reinterpret_cast<ElfProgramHeaderType*>(load_seg.at(i + 1).second) :
+                reinterpret_cast<const ElfProgramHeaderType*>(load_seg.at(i + 1).second) :
                 nullptr;
 
-    if (!__find_pre_pad<ElfProgramHeaderType, ElfOffsetType>(ph, phn, data_size, &pad_pre))
+    if (!__find_pre_pad<ElfProgramHeaderType, ElfOffsetType>(ph, phn, data_size, align, &pad_pre))
         return false;
 
     if (!__find_post_pad<ElfProgramHeaderType, ElfOffsetType>(ph, phn, data_size,
@@ -553,6 +835,8 @@ ELF::__get_ph_address(const void *elf_hdr) {
         const ElfHeaderType *e_hdr = reinterpret_cast<const ElfHeaderType*>(elf_hdr);
         ph_size = e_hdr->e_phentsize;
         ph_num = e_hdr->e_phnum;
+        // file may be parsed again after modification
+        ph_idx.clear();
         ph_idx.push_back(e_hdr->e_phoff);
         return true;
     }
@@ -584,7 +868,8 @@ ELF::__get_ph_info(const void *elf_hdr) {
 
 bool
 ELF::__parse() {
-    const char *data = b_data.data();
+    // read only access, mapped file is not copied
+    const char *data = b_data.constData();
 
     try {
         // get ELF_header
@@ -613,9 +898,7 @@ ELF::__round_address_down(ex_offset_t addr, ex_offset_t align) const {
 template <typename ElfProgramHeaderType, typename ElfOffsetType>
 bool
 ELF::__find_pre_pad(const ElfProgramHeaderType *ph, const ElfProgramHeaderType *phn,
-                    const int dsize, uint32_t *pre_pad) {
-
-    uint8_t align = sizeof(ElfOffsetType);
+                    const int dsize, Elf64_Xword align, uint32_t *pre_pad) {
 
     if (!ph)
         return false;
@@ -673,7 +956,7 @@ template <typename ElfProgramHeaderType>
 QPair<ex_offset_t, ex_offset_t>
 ELF::__get_new_data_va_fo(ELF::best_segment &bs) {
 
-    ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(bs.ph);
+    const ElfProgramHeaderType *ph = reinterpret_cast<const ElfProgramHeaderType*>(bs.ph);
     // offset for new data in file
     // virtual address of new data
     return QPair<ex_offset_t, ex_offset_t>(ph->p_offset + ph->p_filesz, ph->p_vaddr + ph->p_filesz + bs.pre_pad);
@@ -703,16 +986,16 @@ ELF::__construct_data(const QByteArray &data, ELF::best_segment &bs, Elf64_Off &
     file_off = fo_va.first;
     va = fo_va.second;
 
-    // 1. copy data from part of file, till new offset part
-    // 2. copy pre_pad size, data, post_pad size
-    // 3. copy rest of data from file
-    QByteArray new_b_data(b_data.data(), file_off);
-    for (uint32_t i = 0; i < bs.pre_pad; ++i)
-        new_b_data.append('\0');
-    new_b_data.append(data);
-    for (uint32_t i = 0; i < bs.post_pad; ++i)
-        new_b_data.append('\0');
-    new_b_data.append(b_data.data() + file_off, b_data.size() - file_off);
+    // insert pre_pad size, data, post_pad size at new offset,
+    // the file is copied only once, to a zeroed buffer of final size
+    if (file_off > static_cast<Elf64_Off>(b_data.size()))
+        return failed;
+
+    QByteArray new_b_data(b_data.size() + total_space, '\0');
+    char *dst = new_b_data.data();
+    memcpy(dst, b_data.constData(), file_off);
+    memcpy(dst + file_off + bs.pre_pad, data.constData(), data.size());
+    memcpy(dst + file_off + total_space, b_data.constData() + file_off, b_data.size() - file_off);
 
     fo = file_off + bs.pre_pad;
 
@@ -798,6 +1081,206 @@ ELF::__fix_segment_table(QByteArray &data, const ex_offset_t file_off,
     return va;
 }
 
+template <typename ElfHeaderType, typename ElfProgramHeaderType>
+bool
+ELF::__add_load_segment(const QByteArray &data, Elf64_Xword align, Elf64_Xword seg_align,
+                        Elf64_Xword file_align, Elf64_Addr &va, Elf64_Off &file_off) {
+    const ElfHeaderType *eh = reinterpret_cast<const ElfHeaderType*>(b_data.constData());
+    if (static_cast<Elf64_Off>(b_data.size()) < eh->e_phoff + static_cast<Elf64_Off>(ph_num) * ph_size)
+        return false;
+
+    int last_load = -1;
+    Elf64_Addr max_end = 0;
+    Elf64_Xword load_align = 0x1000;
+
+    for (int i = 0; i < ph_num; ++i) {
+        const ElfProgramHeaderType *ph =
+                reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(i));
+
+        if (ph->p_type == PT_LOAD) {
+            last_load = i;
+            max_end = std::max<Elf64_Addr>(max_end, ph->p_vaddr + ph->p_memsz);
+            load_align = std::max<Elf64_Xword>(load_align, ph->p_align);
+        }
+    }
+
+    if (last_load < 0)
+        return false;
+
+    // the same page size as the rest of the program
+    if (!seg_align)
+        seg_align = load_align;
+
+    const ElfProgramHeaderType *last = added_segment >= 0 && added_segment < ph_num ?
+            reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(added_segment)) : nullptr;
+
+    // segment added before still ends the file and the program image - just grow it
+    if (last && last->p_type == PT_LOAD && last->p_align == seg_align && !(last->p_offset % file_align) &&
+            last->p_filesz == last->p_memsz && last->p_offset + last->p_filesz == static_cast<Elf64_Off>(b_data.size()) &&
+            last->p_vaddr + last->p_memsz == max_end) {
+        Elf64_Addr end = last->p_vaddr + last->p_memsz;
+        Elf64_Xword pad = (align - end % align) % align;
+
+        va = end + pad;
+        file_off = b_data.size() + pad;
+
+        b_data.append(QByteArray(pad, '\x00'));
+        b_data.append(data);
+
+        ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(b_data.data() + ph_idx.at(added_segment));
+        ph->p_filesz += pad + data.size();
+        ph->p_memsz = ph->p_filesz;
+
+        return true;
+    }
+
+    int slot = __free_ph_slot<ElfProgramHeaderType>(last_load);
+    if (slot < 0)
+        return false;
+
+    // offset and address have to be congruent modulo page size, the offset is aligned at least as the data;
+    // the data segment below keeps room to grow, so later edits need no segment above this one
+    file_align = std::max(file_align, align);
+    file_off = b_data.size() + (file_align - b_data.size() % file_align) % file_align;
+    Elf64_Addr start = max_end + data_headroom;
+    va = start + (seg_align - start % seg_align) % seg_align + file_off % seg_align;
+
+    b_data.append(QByteArray(file_off - b_data.size(), '\x00'));
+    b_data.append(data);
+
+    ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(b_data.data() + ph_idx.at(slot));
+    memset(ph, 0, sizeof(ElfProgramHeaderType));
+    ph->p_type = PT_LOAD;
+    ph->p_flags = PF_R | PF_X;
+    ph->p_offset = file_off;
+    ph->p_vaddr = va;
+    ph->p_paddr = va;
+    ph->p_filesz = data.size();
+    ph->p_memsz = data.size();
+    ph->p_align = seg_align;
+
+    added_segment = slot;
+
+    return true;
+}
+
+template <typename ElfProgramHeaderType>
+int
+ELF::__free_ph_slot(int last_load) {
+    int slot = -1;
+    Elf64_Off property_off = 0;
+    bool has_property = false;
+
+    for (int i = 0; i < ph_num; ++i) {
+        const ElfProgramHeaderType *ph =
+                reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(i));
+
+        if (ph->p_type == PT_NULL && slot < 0)
+            slot = i;
+        else if (ph->p_type == PT_GNU_PROPERTY) {
+            has_property = true;
+            property_off = ph->p_offset;
+        }
+    }
+
+    // note describing program properties (e.g. CET) stays, any other one is not needed to run the program
+    for (int i = ph_num - 1; slot < 0 && i >= 0; --i) {
+        const ElfProgramHeaderType *ph =
+                reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(i));
+        if (ph->p_type == PT_NOTE && (!has_property || ph->p_offset != property_off))
+            slot = i;
+    }
+
+    if (slot < 0)
+        return -1;
+
+    // LOAD entries have to stay sorted by virtual address
+    char *table = b_data.data() + ph_idx.at(0);
+    if (slot < last_load) {
+        std::rotate(table + slot * ph_size, table + (slot + 1) * ph_size, table + (last_load + 1) * ph_size);
+        // entries after the slot moved one place back
+        if (added_segment > slot && added_segment <= last_load)
+            --added_segment;
+        slot = last_load;
+    }
+
+    return slot;
+}
+
+template <typename ElfProgramHeaderType>
+bool
+ELF::__reserve_data(Elf64_Xword size, Elf64_Xword align, Elf64_Addr &va) {
+    int last_load = -1, data_seg = -1;
+    Elf64_Addr max_end = 0, data_end = 0;
+    Elf64_Xword load_align = 0x1000;
+
+    for (int i = 0; i < ph_num; ++i) {
+        const ElfProgramHeaderType *ph =
+                reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(i));
+
+        if (ph->p_type != PT_LOAD)
+            continue;
+
+        last_load = i;
+        load_align = std::max<Elf64_Xword>(load_align, ph->p_align);
+        max_end = std::max<Elf64_Addr>(max_end, ph->p_vaddr + ph->p_memsz);
+        if ((ph->p_flags & PF_W) && !(ph->p_flags & PF_X) && ph->p_vaddr + ph->p_memsz >= data_end) {
+            data_end = ph->p_vaddr + ph->p_memsz;
+            data_seg = i;
+        }
+    }
+
+    if (last_load < 0)
+        return false;
+
+    // the highest data segment grows its bss, zero pages are mapped by the loader;
+    // the grown part must not share a page with any other segment
+    if (data_seg >= 0) {
+        Elf64_Xword pad = (align - data_end % align) % align;
+        Elf64_Addr new_end = data_end + pad + size;
+        Elf64_Addr page_end = new_end + (load_align - new_end % load_align) % load_align;
+        bool room = true;
+
+        for (int i = 0; room && i < ph_num; ++i) {
+            const ElfProgramHeaderType *other =
+                    reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + ph_idx.at(i));
+
+            if (i != data_seg && other->p_type == PT_LOAD && other->p_vaddr + other->p_memsz > data_end &&
+                    __round_address_down(other->p_vaddr, load_align) < page_end)
+                room = false;
+        }
+
+        if (room) {
+            ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(b_data.data() + ph_idx.at(data_seg));
+
+            va = data_end + pad;
+            ph->p_memsz += pad + size;
+
+            return true;
+        }
+    }
+
+    int slot = __free_ph_slot<ElfProgramHeaderType>(last_load);
+    if (slot < 0)
+        return false;
+
+    // segment without file content, offset only has to be congruent with the address
+    va = max_end + (load_align - max_end % load_align) % load_align;
+
+    ElfProgramHeaderType *ph = reinterpret_cast<ElfProgramHeaderType*>(b_data.data() + ph_idx.at(slot));
+    memset(ph, 0, sizeof(ElfProgramHeaderType));
+    ph->p_type = PT_LOAD;
+    ph->p_flags = PF_R | PF_W;
+    ph->p_offset = b_data.size() - b_data.size() % load_align;
+    ph->p_vaddr = va;
+    ph->p_paddr = va;
+    ph->p_filesz = 0;
+    ph->p_memsz = size;
+    ph->p_align = load_align;
+
+    return true;
+}
+
 bool
 ELF::get_segment_prot_flags(const Elf64_Addr vaddr, unsigned int &prot_flags) const {
     if (!parsed)
@@ -870,6 +1353,37 @@ ELF::__get_segment_align(const Elf64_Addr vaddr, Elf64_Addr &align) const {
     return false;
 }
 
+bool
+ELF::get_file_offset(const Elf64_Addr vaddr, Elf64_Off &file_off) const {
+    if (!parsed)
+        return false;
+
+    switch (cls) {
+    case classes::ELF32:
+        return __get_file_offset<Elf32_Phdr>(vaddr, file_off);
+    case classes::ELF64:
+        return __get_file_offset<Elf64_Phdr>(vaddr, file_off);
+    default:
+        return false;
+    }
+}
+
+template <typename ElfProgramHeaderType>
+bool
+ELF::__get_file_offset(const Elf64_Addr vaddr, Elf64_Off &file_off) const {
+    const ElfProgramHeaderType *ph = nullptr;
+    foreach (ex_offset_t fo, ph_idx) {
+        ph = reinterpret_cast<const ElfProgramHeaderType*>(b_data.constData() + fo);
+
+        if (ph->p_type == PT_LOAD && ph->p_vaddr <= vaddr && ph->p_vaddr + ph->p_filesz > vaddr) {
+            file_off = ph->p_offset + (vaddr - ph->p_vaddr);
+            return true;
+        }
+    }
+
+    return false;
+}
+
 bool
 ELF::get_load_segment_info(int prot_flags, QPair<QByteArray, Elf64_Addr> &segment_data) const {
     if (!parsed)
@@ -982,7 +1496,11 @@ ELF::__fix_vma(QByteArray &data, const best_segment &bs,
 
 ELF::ELF(QByteArray _data) :
     BinaryFile(_data),
-    cls(classes::NONE) {
+    editing(false),
+    edit_added_segment(-1),
+    cls(classes::NONE),
+    placement(Placement::ExtendSegment),
+    added_segment(-1) {
     parsed = __parse();
 }
 
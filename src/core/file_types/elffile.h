@@ -7,6 +7,11 @@
 #include <core/sys_headers/elf.h>
 #endif
 
+// older system headers don't define it
+#ifndef PT_GNU_PROPERTY
+#define PT_GNU_PROPERTY 0x6474e553
+#endif
+
 #include <QPair>
 #include <QString>
 #include <QMap>
@@ -31,6 +36,26 @@ public:
         TEXT
     };
 
+    /**
+     * @brief Sposoby umieszczania dodawanego kodu w pliku.
+     */
+    enum class Placement {
+        ExtendSegment,   // rozszerzenie istniejącego segmentu LOAD, z przesunięciem dalszej części pliku
+        NewSegment,      // osobny segment LOAD dopisany na końcu pliku, bez przesuwania istniejących bajtów
+        HugePageSegment  // jak NewSegment, ale segment jest wyrównany do huge_page_size
+    };
+
+    /**
+     * @brief Wielkość dużej strony (i wyrównanie segmentu w trybie HugePageSegment).
+     */
+    static const Elf64_Xword huge_page_size;
+
+    /**
+     * @brief Przerwa w przestrzeni adresowej przed dodanym segmentem kodu, w której rośnie bss segmentu danych.
+     * Dzięki niej kolejne sesje edycji dodają dane bez nowego segmentu, a segment kodu wciąż kończy obraz programu.
+     */
+    static const Elf64_Xword data_headroom;
+
     /**
      * @brief Konstruktor.
      * @param _data zawartość pliku.
@@ -66,6 +91,21 @@ public:
      */
     int get_number_of_segments() const { return is_valid() ? ph_num : -1; }
 
+    /**
+     * @brief Ustawia sposób umieszczania dodawanego kodu.
+     * W trybie NewSegment cały dodawany kod trafia do jednego segmentu LOAD na końcu pliku, więc koszt
+     * wstawienia nie zależy od wielkości pliku. W trybie HugePageSegment offset w pliku, adres wirtualny
+     * i p_align tego segmentu są wyrównane do dużej strony, co pozwala obsłużyć go stronami THP.
+     * @param p sposób umieszczania kodu.
+     */
+    void set_placement(Placement p) { placement = p; }
+
+    /**
+     * @brief Pobiera sposób umieszczania dodawanego kodu.
+     * @return Sposób umieszczania kodu.
+     */
+    Placement get_placement() const { return placement; }
+
     /**
      * @brief Pobiera offset w pliku dla podanego segmentu.
      * @param idx indeks segmentu.
@@ -79,9 +119,76 @@ public:
      * @param only_x flaga, która odpowiada za rozszerzanie tylko wykonywalnych sekcji.
      * @param va nowy adres wirtualny w rozszerzonym segmencie.
      * @param file_off offset w pliku, na którym zostanie napisany pierwszy bajt danych.
+     * @param align wyrównanie adresu wirtualnego danych (0 - rozmiar wskaźnika).
      * @return True jeżeli rozszerzenie się powiodło, False w pozostałych przypadkach.
      */
-    bool extend_segment(const QByteArray &data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off);
+    bool extend_segment(const QByteArray &data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off,
+                        Elf64_Xword align = 0);
+
+    /**
+     * @brief Rozpoczyna sesję edycji, w której wiele wstawień danych jest wykonywanych jedną przebudową pliku.
+     * Stan pliku jest zapamiętywany do czasu wywołania end_edit() lub rollback_edit().
+     * @return True jeżeli sesja została rozpoczęta, False w innych przypadkach.
+     */
+    bool begin_edit();
+
+    /**
+     * @brief Dodaje dane do wstawienia przy najbliższym zatwierdzeniu sesji.
+     * @param data dane, które chcemy skopiować w miejsce rozszerzonego segmentu.
+     * @param only_x flaga, która odpowiada za rozszerzanie tylko wykonywalnych sekcji.
+     * @param align wyrównanie adresu wirtualnego danych (0 - 4 bajty).
+     * @return Identyfikator danych (indeks na liście wynikowej commit_edit()), -1 w razie błędu.
+     */
+    int queue_payload(const QByteArray &data, bool only_x, Elf64_Xword align = 0);
+
+    /**
+     * @brief Dodaje wyzerowany, zapisywalny blok danych (np. stan kodu), rezerwowany przy najbliższym
+     * zatwierdzeniu sesji. Blok nie zajmuje miejsca w pliku: powiększa obraz w pamięci (bss) zapisywalnego
+     * segmentu LOAD kończącego się najdalej, a gdy takiego nie ma, trafia do nowego segmentu RW.
+     * Segmenty z kodem pozostają niezapisywalne.
+     * @param size rozmiar bloku.
+     * @param align wyrównanie adresu wirtualnego bloku (0 - 4 bajty).
+     * @return Identyfikator bloku (indeks na liście wynikowej commit_edit(), offset w pliku jest równy 0),
+     * -1 w razie błędu.
+     */
+    int queue_data(Elf64_Xword size, Elf64_Xword align = 0);
+
+    /**
+     * @brief Dodaje poprawkę adresu relatywnego wewnątrz wstawianych danych.
+     * @param payload_id identyfikator danych, w których znajduje się adres.
+     * @param payload_off offset adresu względem początku danych.
+     * @param target adres wirtualny celu skoku.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool queue_relative_patch(int payload_id, Elf64_Off payload_off, Elf64_Addr target);
+
+    /**
+     * @brief Dodaje poprawkę adresu relatywnego w istniejącym kodzie, wskazującego na wstawiane dane.
+     * @param file_off offset adresu w pliku przed zatwierdzeniem sesji.
+     * @param va adres wirtualny adresu relatywnego.
+     * @param payload_id identyfikator danych, na które ma wskazywać skok.
+     * @param payload_off offset celu skoku względem początku danych.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool queue_relative_patch(Elf64_Off file_off, Elf64_Addr va, int payload_id, Elf64_Off payload_off);
+
+    /**
+     * @brief Wstawia wszystkie dodane dane jedną przebudową pliku i nanosi poprawki adresów.
+     * W razie błędu przywracany jest stan sprzed zatwierdzenia, a sesja pozostaje otwarta.
+     * @param placement adres wirtualny oraz offset w pliku kolejnych danych.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool commit_edit(QList<QPair<Elf64_Addr, Elf64_Off> > &placement);
+
+    /**
+     * @brief Przywraca stan pliku sprzed begin_edit() i kończy sesję edycji.
+     */
+    void rollback_edit();
+
+    /**
+     * @brief Kończy sesję edycji, zachowując wprowadzone zmiany.
+     */
+    void end_edit();
 
     /**
      * @brief Zapisuje wewnętrzne dane do pliku.
@@ -90,6 +197,14 @@ public:
      */
     bool write_to_file(const QString &fname) const;
 
+    /**
+     * @brief Zapisuje wewnętrzne dane do pliku, zapisując tylko zakresy zmienione względem pliku źródłowego.
+     * @param fname nazwa pliku.
+     * @param source_fname nazwa pliku, z którego wczytano dane.
+     * @return True, jeżeli operacja zapisu się powiodła, False w innych przypadkach.
+     */
+    bool write_to_file(const QString &fname, const QString &source_fname);
+
     /**
      * @brief Ustawia punkt wejściowy dla pliku wykonywalnego.
      * @param entry_point wartość punktu wejściowego.
@@ -153,6 +268,14 @@ public:
      */
     bool get_segment_align(const Elf64_Addr vaddr, Elf64_Addr &align) const;
 
+    /**
+     * @brief Pobiera offset w pliku dla adresu wirtualnego należącego do danych segmentu LOAD.
+     * @param vaddr adres wirtualny.
+     * @param file_off offset w pliku.
+     * @return True jeżeli adres leży w danych segmentu LOAD w pliku, False w innych przypadkach.
+     */
+    bool get_file_offset(const Elf64_Addr vaddr, Elf64_Off &file_off) const;
+
     /**
      * @brief Pobiera zawartość pierwszego segmenu LOAD, do którego pasują podane flagi ochrony pamięci.
      * @param prot_flags flagi ochrony pamięci.
@@ -183,7 +306,7 @@ private:
     /**
      * @brief Rezprezentacja strukturalna dla każdego typu sekcji.
      */
-    static QMap<SectionType, section_info> section_type;
+    static const QMap<SectionType, section_info> section_type;
 
     /**
      * @brief Struktura, przechowująca metadane segmentu.
@@ -191,7 +314,7 @@ private:
     typedef struct _best_segment {
         uint32_t post_pad,
                  pre_pad;
-        void *ph;
+        const void *ph;
         bool change_vma;
 
     public:
@@ -200,6 +323,62 @@ private:
             ph(nullptr), change_vma(false) {}
     } best_segment;
 
+    /**
+     * @brief Struktura, przechowująca dane oczekujące na wstawienie w sesji edycji.
+     */
+    typedef struct _edit_payload {
+        QByteArray data;
+        bool only_x;
+        Elf64_Xword align;
+        bool writable;
+
+        _edit_payload() : only_x(false), align(0), writable(false) {}
+        _edit_payload(const QByteArray &_data, bool _only_x, Elf64_Xword _align, bool _writable = false) :
+            data(_data), only_x(_only_x), align(_align), writable(_writable) {}
+    } edit_payload;
+
+    /**
+     * @brief Struktura, przechowująca poprawkę adresu relatywnego w sesji edycji.
+     * Ujemny identyfikator danych oznacza odpowiednio offset w pliku oraz bezwzględny adres wirtualny.
+     */
+    typedef struct _edit_patch {
+        int payload_id;
+        Elf64_Off off;
+        Elf64_Addr va;
+        int target_id;
+        Elf64_Addr target;
+
+        _edit_patch() :
+            payload_id(-1), off(0), va(0), target_id(-1), target(0) {}
+        _edit_patch(int _payload_id, Elf64_Off _off, Elf64_Addr _va, int _target_id, Elf64_Addr _target) :
+            payload_id(_payload_id), off(_off), va(_va), target_id(_target_id), target(_target) {}
+    } edit_patch;
+
+    /**
+     * @brief Informacja czy trwa sesja edycji.
+     */
+    bool editing;
+
+    /**
+     * @brief Zawartość pliku z chwili rozpoczęcia sesji edycji.
+     */
+    QByteArray edit_backup;
+
+    /**
+     * @brief Indeks dodanego segmentu z chwili rozpoczęcia sesji edycji.
+     */
+    int edit_added_segment;
+
+    /**
+     * @brief Dane oczekujące na wstawienie.
+     */
+    QList<edit_payload> edit_payloads;
+
+    /**
+     * @brief Poprawki adresów oczekujące na naniesienie.
+     */
+    QList<edit_patch> edit_patches;
+
     /**
      * @brief Typy plików ELF.
      */
@@ -214,6 +393,17 @@ private:
      */
     classes cls;
 
+    /**
+     * @brief Sposób umieszczania dodawanego kodu.
+     */
+    Placement placement;
+
+    /**
+     * @brief Indeks nagłówka programu segmentu z kodem dodanego na końcu pliku (-1 - brak),
+     * tylko ten segment może być później powiększany.
+     */
+    int added_segment;
+
     /**
      * @brief Indeks nagłówku ELF.
      */
@@ -245,7 +435,7 @@ private:
      * @param change_va informacja czy musi zostać zmieniony adres wirtualy.
      */
     template <typename ElfProgramHeader>
-    void __best_segment_choose(best_segment &bs, bool only_x, ElfProgramHeader *ph,
+    void __best_segment_choose(best_segment &bs, bool only_x, const ElfProgramHeader *ph,
                                uint32_t pad_post, uint32_t pad_pre, bool change_va);
 
     /**
@@ -255,11 +445,73 @@ private:
      * @param load_seg referencja na listę ładowalnych (LOAD) segmentów pliku.
      * @param i aktualnie przetwarzany segment.
      * @param data_size wielkość wstawianych danych.
+     * @param align wyrównanie adresu wirtualnego danych.
      * @return True jeżeli rozszerzenie jest możliwe, False w innych przypadkach.
      */
     template <typename ElfProgramHeaderType, typename ElfOffsetType>
-    bool __extend_segment_eligible(best_segment &bs, bool only_x, const QList<std::pair<esize_t, void*> > &load_seg,
-                                   int i, const int data_size);
+    bool __extend_segment_eligible(best_segment &bs, bool only_x, const QList<std::pair<esize_t, const void*> > &load_seg,
+                                   int i, const int data_size, Elf64_Xword align);
+    /**
+     * @brief Rozszerza najbardziej pasujący segment LOAD i kopiuje do niego podany kod.
+     * @param data dane, które chcemy skopiować w miejsce rozszerzonego segmentu.
+     * @param only_x flaga, która odpowiada za rozszerzanie tylko wykonywalnych sekcji.
+     * @param va nowy adres wirtualny w rozszerzonym segmencie.
+     * @param file_off offset w pliku, na którym zostanie napisany pierwszy bajt danych.
+     * @param insert_off offset w pliku, od którego wstawiono nowe bajty.
+     * @param insert_space liczba wstawionych bajtów (razem z dopełnieniem).
+     * @param align wyrównanie adresu wirtualnego danych (0 - rozmiar wskaźnika).
+     * @return True jeżeli rozszerzenie się powiodło, False w pozostałych przypadkach.
+     */
+    bool __extend_segment(const QByteArray &data, bool only_x, Elf64_Addr &va, Elf64_Off &file_off,
+                          Elf64_Off &insert_off, uint32_t &insert_space, Elf64_Xword align = 0);
+
+    /**
+     * @brief Dodaje dane do osobnego segmentu LOAD na końcu pliku.
+     * Segment jest tworzony przy pierwszym wywołaniu w miejscu nagłówka PT_NULL lub PT_NOTE (notatki zostają
+     * w pliku jako sekcje), a kolejne dane rozszerzają go bez przesuwania istniejących bajtów.
+     * @param data dodawane dane.
+     * @param align wyrównanie adresu wirtualnego danych.
+     * @param seg_align wyrównanie (p_align) nowego segmentu, 0 - takie jak pozostałych segmentów LOAD.
+     * @param file_align wyrównanie offsetu w pliku nowego segmentu.
+     * @param va adres wirtualny dodanych danych.
+     * @param file_off offset w pliku dodanych danych.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    template <typename ElfHeaderType, typename ElfProgramHeaderType>
+    bool __add_load_segment(const QByteArray &data, Elf64_Xword align, Elf64_Xword seg_align,
+                            Elf64_Xword file_align, Elf64_Addr &va, Elf64_Off &file_off);
+
+    /**
+     * @brief Zwalnia nagłówek Program Header na nowy segment LOAD: pierwszy PT_NULL, a gdy go brak,
+     * zbędny PT_NOTE (notatki zostają w pliku jako sekcje). Nagłówek jest przesuwany za ostatni
+     * segment LOAD, żeby segmenty LOAD pozostały posortowane według adresów.
+     * @param last_load indeks ostatniego segmentu LOAD.
+     * @return Indeks zwolnionego nagłówka, -1 jeżeli żaden nie może zostać użyty.
+     */
+    template <typename ElfProgramHeaderType>
+    int __free_ph_slot(int last_load);
+
+    /**
+     * @brief Rezerwuje wyzerowaną, zapisywalną pamięć bez zmiany zawartości pliku.
+     * Powiększany jest obraz w pamięci najwyżej położonego segmentu LOAD zapisywalnego i niewykonywalnego,
+     * jeżeli nie zachodzi on wtedy na strony innego segmentu (np. w przerwie data_headroom przed dodanym
+     * segmentem kodu), w przeciwnym razie za końcem obrazu programu dodawany jest segment RW bez danych w pliku.
+     * @param size rozmiar pamięci.
+     * @param align wyrównanie adresu wirtualnego.
+     * @param va adres wirtualny zarezerwowanej pamięci.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    template <typename ElfProgramHeaderType>
+    bool __reserve_data(Elf64_Xword size, Elf64_Xword align, Elf64_Addr &va);
+    bool __reserve_data(Elf64_Xword size, Elf64_Xword align, Elf64_Addr &va);
+
+    /**
+     * @brief Oznacza jako zmienione bloki danych różniące się od poprzedniej zawartości pliku.
+     * @param old_data poprzednia zawartość pliku.
+     * @param end offset, do którego dane są porównywane.
+     */
+    void __mark_changed(const QByteArray &old_data, Elf64_Off end);
+
     /**
      * @brief Wypełnia listę z indeksami struktur Program Header.
      * @return True jeżeli wielkość tablicy się zgadza z zadeklarowaną, False w innych przypadkach.
@@ -270,14 +522,14 @@ private:
      * @brief Pobiera zawartość struktury Elf32_Ehdr.
      * @return Wskaźnik na strukturę Elf32_Ehdr jeżeli dane są poprawne, nullptr w innych przypadkach.
      */
-    void* __get_elf_header();
+    const void* __get_elf_header() const;
 
     /**
      * @brief Pobiera zawartość struktury Elf32_Phdr.
      * @param idx Indeks.
      * @return Wskaźnik na strukturę Elf32_Phdr jeżeli dane są poprawne, nullptr w innych przypadkach.
      */
-    void* __get_ph_header(uint32_t idx = 0);
+    const void* __get_ph_header(uint32_t idx = 0) const;
 
     /**
      * @brief Sprawdza czy wartości magiczne w podanej strukturze zgadzają się z ELF.
@@ -327,12 +579,13 @@ private:
      * @param ph wskaźnik na strukture 32/64-bitowego nagłówka ELF.
      * @param phn wskaźnik na strukture 32/64-bitowego nagłówka ELF.
      * @param dsize wielkość danych.
+     * @param align wyrównanie adresu wirtualnego danych.
      * @param pre_pad adres komórki pamięci, pod którą zapiszemy wartość.
      * @return True jeżeli operacja się powidła, False w innych przypadkach.
      */
     template <typename ElfProgramHeaderType, typename ElfOffsetType>
     bool __find_pre_pad(const ElfProgramHeaderType *ph, const ElfProgramHeaderType *phn,
-                        const int dsize, uint32_t *pre_pad);
+                        const int dsize, Elf64_Xword align, uint32_t *pre_pad);
 
     /**
      * @brief Znajduje ilość bajtów, którymi musimy dopełnić nasze dane z tyłu.
@@ -466,6 +719,15 @@ private:
     template <typename ElfProgramHeaderType>
     bool __get_segment_align(const Elf64_Addr vaddr, Elf64_Addr &align) const;
 
+    /**
+     * @brief Pobiera offset w pliku dla adresu wirtualnego należącego do danych segmentu LOAD.
+     * @param vaddr adres wirtualny.
+     * @param file_off offset w pliku.
+     * @return True jeżeli adres leży w danych segmentu LOAD w pliku, False w innych przypadkach.
+     */
+    template <typename ElfProgramHeaderType>
+    bool __get_file_offset(const Elf64_Addr vaddr, Elf64_Off &file_off) const;
+
     /**
      * @brief Pobiera zawartość pierwszego segmenu LOAD, do którego pasują podane flagi ochrony pamięci.
      * @param prot_flags flagi ochrony pamięci.
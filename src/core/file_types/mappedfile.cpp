@@ -0,0 +1,50 @@
+#include "mappedfile.h"
+
+#include <limits>
+
+MappedFile::MappedFile(const QString &fileName) :
+    file(fileName),
+    map(nullptr)
+{
+    if(!file.open(QFile::ReadOnly))
+        return;
+
+    // QByteArray nie obsłuży większych plików
+    if(file.size() > std::numeric_limits<int>::max())
+    {
+        file.close();
+        return;
+    }
+
+    if(file.size() > 0)
+        map = file.map(0, file.size());
+
+    // Mapowanie może się nie udać (np. dla plików specjalnych), wtedy plik jest wczytywany
+    if(map)
+        data = QByteArray::fromRawData(reinterpret_cast<const char*>(map), static_cast<int>(file.size()));
+    else
+        data = file.readAll();
+}
+
+MappedFile::~MappedFile()
+{
+    data.clear();
+
+    if(map)
+        file.unmap(map);
+}
+
+bool MappedFile::isOpen() const
+{
+    return file.isOpen();
+}
+
+bool MappedFile::isMapped() const
+{
+    return map != nullptr;
+}
+
+QByteArray MappedFile::getData() const
+{
+    return data;
+}
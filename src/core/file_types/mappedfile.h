@@ -0,0 +1,51 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+/**
+ * @brief Klasa udostępniająca zawartość pliku wejściowego bez kopiowania jej do pamięci.
+ *
+ * Plik jest mapowany tylko do odczytu, a getData() zwraca QByteArray wskazujący bezpośrednio
+ * na zmapowaną pamięć. Kopia danych powstaje dopiero przy pierwszej modyfikacji (implicit sharing),
+ * więc parsowanie i odczyt nie zwiększają zużycia pamięci. Obiekt musi istnieć dłużej niż
+ * wszystkie niezmodyfikowane kopie zwróconych danych.
+ */
+class MappedFile
+{
+public:
+    /**
+     * @brief Konstruktor.
+     * @param fileName ścieżka do pliku.
+     */
+    MappedFile(const QString &fileName);
+    MappedFile(const MappedFile &) = delete;
+    ~MappedFile();
+
+    /**
+     * @brief Sprawdza czy udało się otworzyć plik.
+     * @return True jeżeli plik jest dostępny, False w innych przypadkach.
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Sprawdza czy zawartość pliku jest zmapowana (a nie wczytana).
+     * @return True jeżeli plik jest zmapowany, False w innych przypadkach.
+     */
+    bool isMapped() const;
+
+    /**
+     * @brief Pobiera zawartość pliku.
+     * @return Zawartość pliku.
+     */
+    QByteArray getData() const;
+
+private:
+    QFile file;
+    uchar *map;
+    QByteArray data;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,179 @@
+#include "outputwriter.h"
+
+#include <QFile>
+#include <algorithm>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
+#include <cerrno>
+#endif
+
+OutputWriter::OutputWriter() :
+    written(0),
+    cloned(0)
+{
+}
+
+qint64 OutputWriter::getWrittenBytes() const
+{
+    return written;
+}
+
+qint64 OutputWriter::getClonedBytes() const
+{
+    return cloned;
+}
+
+bool OutputWriter::writeAll(const QString &fileName, const QByteArray &data)
+{
+    QFile out(fileName);
+    if(!out.open(QFile::WriteOnly) || out.write(data) != data.size())
+        return false;
+
+    written = data.size();
+    return true;
+}
+
+#ifdef __linux__
+
+bool OutputWriter::writeRange(int fd, const QByteArray &data, qint64 begin, qint64 end)
+{
+    while(begin < end)
+    {
+        ssize_t n = pwrite(fd, data.constData() + begin, end - begin, begin);
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+
+        begin += n;
+        written += n;
+    }
+
+    return true;
+}
+
+bool OutputWriter::write(const QString &fileName, const QByteArray &data, const QMap<qint64, qint64> &dirty,
+                         const QString &sourceName)
+{
+    written = 0;
+    cloned = 0;
+
+    if(sourceName.isEmpty())
+        return writeAll(fileName, data);
+
+    int src = open(QFile::encodeName(sourceName).constData(), O_RDONLY | O_CLOEXEC);
+    struct stat srcStat, dstStat;
+
+    if(src < 0 || fstat(src, &srcStat) < 0)
+    {
+        if(src >= 0)
+            close(src);
+        return writeAll(fileName, data);
+    }
+
+    // Zapis w miejscu: plik wynikowy jest plikiem źródłowym
+    QByteArray dstName = QFile::encodeName(fileName);
+    bool inPlace = stat(dstName.constData(), &dstStat) == 0 &&
+            dstStat.st_dev == srcStat.st_dev && dstStat.st_ino == srcStat.st_ino;
+
+    int fd = inPlace ? open(dstName.constData(), O_WRONLY | O_CLOEXEC) :
+                       open(dstName.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, srcStat.st_mode & 0777);
+    if(fd < 0)
+    {
+        close(src);
+        return false;
+    }
+
+    qint64 size = data.size();
+    qint64 common = std::min<qint64>(size, srcStat.st_size);
+
+    // Zakresy zmienione, przycięte do rozmiaru pliku, oraz wszystko za końcem pliku źródłowego
+    QMap<qint64, qint64> ranges;
+    for(QMap<qint64, qint64>::const_iterator it = dirty.begin(); it != dirty.end(); ++it)
+        if(it.key() < common)
+            ranges.insert(it.key(), std::min(it.value(), common));
+    if(size > common)
+        ranges.insert(common, size);
+
+    bool ok = true;
+
+    if(!inPlace)
+    {
+        // Reflink całego pliku: bloki są współdzielone, zmieniane są tylko zapisane zakresy
+        if(ioctl(fd, FICLONE, src) == 0)
+            cloned = common;
+        else
+        {
+            qint64 pos = 0;
+            QMap<qint64, qint64>::const_iterator it = ranges.begin();
+
+            while(ok && pos < common)
+            {
+                qint64 end = it == ranges.end() ? common : std::min(it.key(), common);
+
+                while(ok && pos < end)
+                {
+                    loff_t in = pos, out = pos;
+                    long n = -1;
+#ifdef SYS_copy_file_range
+                    n = syscall(SYS_copy_file_range, src, &in, fd, &out, end - pos, 0);
+#endif
+                    if(n < 0 && errno == EINTR)
+                        continue;
+
+                    // Klonowanie niedostępne (np. inny system plików), dane są takie same jak w pamięci
+                    if(n <= 0)
+                    {
+                        ok = writeRange(fd, data, pos, end);
+                        pos = end;
+                    }
+                    else
+                    {
+                        pos += n;
+                        cloned += n;
+                    }
+                }
+
+                if(it != ranges.end())
+                {
+                    pos = std::max(pos, it.value());
+                    ++it;
+                }
+            }
+        }
+    }
+
+    ok = ok && ftruncate(fd, size) == 0;
+
+    for(QMap<qint64, qint64>::const_iterator it = ranges.begin(); ok && it != ranges.end(); ++it)
+        ok = writeRange(fd, data, it.key(), it.value());
+
+    ok = close(fd) == 0 && ok;
+    close(src);
+
+    return ok;
+}
+
+#else
+
+bool OutputWriter::writeRange(int, const QByteArray &, qint64, qint64)
+{
+    return false;
+}
+
+bool OutputWriter::write(const QString &fileName, const QByteArray &data, const QMap<qint64, qint64> &,
+                         const QString &)
+{
+    written = 0;
+    cloned = 0;
+
+    return writeAll(fileName, data);
+}
+
+#endif
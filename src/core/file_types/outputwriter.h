@@ -0,0 +1,78 @@
+#ifndef OUTPUTWRITER_H
+#define OUTPUTWRITER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QMap>
+
+/**
+ * @brief Klasa zapisująca zmodyfikowany plik binarny na podstawie pliku źródłowego.
+ *
+ * Niezmienione zakresy są klonowane z pliku źródłowego (reflink całego pliku - FICLONE, a gdy system
+ * plików go nie obsługuje - copy_file_range), a zapisywane są tylko zakresy zmienione. Ilość zapisanych
+ * danych zależy więc od wielkości zmian, a nie od wielkości pliku. Gdy plik wynikowy jest plikiem
+ * źródłowym, zapisywane są tylko zmienione zakresy. Bez pliku źródłowego (lub poza Linuksem) zapisywany
+ * jest cały plik.
+ */
+class OutputWriter
+{
+public:
+    /**
+     * @brief Konstruktor.
+     */
+    OutputWriter();
+
+    /**
+     * @brief Zapisuje dane do pliku.
+     * @param fileName ścieżka pliku wynikowego.
+     * @param data pełna zawartość pliku wynikowego.
+     * @param dirty zakresy zmienione względem pliku źródłowego (początek -> koniec).
+     * @param sourceName ścieżka pliku źródłowego, pusta jeżeli cały plik ma zostać zapisany.
+     * @return True jeżeli zapis się powiódł, False w innych przypadkach.
+     */
+    bool write(const QString &fileName, const QByteArray &data, const QMap<qint64, qint64> &dirty,
+               const QString &sourceName = QString());
+
+    /**
+     * @brief Liczba bajtów zapisanych w ostatnim wywołaniu write().
+     * @return Liczba bajtów.
+     */
+    qint64 getWrittenBytes() const;
+
+    /**
+     * @brief Liczba bajtów sklonowanych z pliku źródłowego w ostatnim wywołaniu write().
+     * @return Liczba bajtów.
+     */
+    qint64 getClonedBytes() const;
+
+private:
+    /**
+     * @brief Zapisuje cały plik.
+     * @param fileName ścieżka pliku wynikowego.
+     * @param data zawartość pliku.
+     * @return True jeżeli zapis się powiódł, False w innych przypadkach.
+     */
+    bool writeAll(const QString &fileName, const QByteArray &data);
+
+    /**
+     * @brief Zapisuje zakres danych pod podanym offsetem.
+     * @param fd deskryptor pliku wynikowego.
+     * @param data zawartość pliku.
+     * @param begin początek zakresu.
+     * @param end koniec zakresu.
+     * @return True jeżeli zapis się powiódł, False w innych przypadkach.
+     */
+    bool writeRange(int fd, const QByteArray &data, qint64 begin, qint64 end);
+
+    /**
+     * @brief Liczba zapisanych bajtów.
+     */
+    qint64 written;
+
+    /**
+     * @brief Liczba sklonowanych bajtów.
+     */
+    qint64 cloned;
+};
+
+#endif // OUTPUTWRITER_H
@@ -1,6 +1,7 @@
 #include <core/file_types/pefile.h>
 
 #include <QCryptographicHash>
+#include <algorithm>
 #include <helper/logger/dlogger.h>
 
 unsigned int PEFile::getOptHdrFileAlignment()
@@ -221,6 +222,8 @@ bool PEFile::setTlsAddressOfCallBacks(uint64_t addr)
         }
     }
 
+    markDirty(getTlsDirectoryFileOffset(), getImageTlsDirectorySize());
+
     return true;
 }
 
@@ -260,6 +263,8 @@ bool PEFile::setTlsAddressOfIndex(uint64_t addr)
         }
     }
 
+    markDirty(getTlsDirectoryFileOffset(), getImageTlsDirectorySize());
+
     return true;
 }
 
@@ -272,7 +277,9 @@ PEFile::PEFile(QByteArray d) :
     BinaryFile(d),
     _is_x64(false),
     sectionHeadersIdx(NULL),
-    dataDirectoriesIdx(NULL)
+    dataDirectoriesIdx(NULL),
+    injecting(false),
+    injectionSectionRva(0)
 {
     parsed = parse();
 }
@@ -292,7 +299,7 @@ uint64_t PEFile::generateString(QString str, QMap<QByteArray, uint64_t> &ptrs)
     return injectUniqueData(QByteArray(str.toStdString().c_str(), str.length() + 1), ptrs);
 }
 
-uint64_t PEFile::injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &ptrs, bool *inserted)
+uint64_t PEFile::injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &ptrs, bool *inserted, unsigned int alignment)
 {
     QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha3_512);
 
@@ -306,6 +313,11 @@ uint64_t PEFile::injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &p
     unsigned int memOffset = 0;
     bool is_added = false;
 
+    // W trakcie sesji wstrzykiwania dane trafiają do wolnego miejsca w sekcjach lub do nowej sekcji
+    if(injecting)
+        is_added = addDataToCave(data, fileOffset, memOffset, alignment) ||
+                addDataToInjectionSection(data, fileOffset, memOffset, alignment);
+
     // Próba dodania kodu do każdej z sekcji
     for(unsigned int i = 0; !is_added && i < numberOfSections; ++i)
         is_added = addDataToSection(i, data, fileOffset, memOffset);
@@ -347,19 +359,138 @@ uint64_t PEFile::injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &p
     return offset;
 }
 
+bool PEFile::beginInjection()
+{
+    if(!parsed || injecting)
+        return false;
+
+    injecting = true;
+    caves.clear();
+    injectionSection.clear();
+    injectionSectionName = getRandomSectionName();
+    injectionSectionRva = 0;
+
+    unsigned int lastMem = getLastSectionNumberMem();
+
+    // Adres nowej sekcji jest wyliczany tak samo jak w addNewSection(), dlatego ostatnia sekcja
+    // w pamięci nie może zmieniać rozmiaru
+    if(getFreeSpaceBeforeFirstSectionFile() >= sizeof(IMAGE_SECTION_HEADER) * 2)
+        injectionSectionRva = alignNumber(getSectionHeader(lastMem)->VirtualAddress +
+                                          getSectionHeader(lastMem)->Misc.VirtualSize,
+                                          getOptHdrSectionAlignment());
+
+    for(unsigned int i = 0; i < numberOfSections; ++i)
+    {
+        if(injectionSectionRva && i == lastMem)
+            continue;
+
+        size_t freeSpace = getSectionFreeSpace(i);
+
+        if(freeSpace && !isSectionRawDataEmpty(i))
+            caves.insert(freeSpace, i);
+    }
+
+    return true;
+}
+
+bool PEFile::endInjection()
+{
+    if(!injecting)
+        return false;
+
+    injecting = false;
+    caves.clear();
+
+    if(injectionSection.isEmpty())
+        return true;
+
+    unsigned int fileOffset = 0;
+    unsigned int memOffset = 0;
+
+    bool added = addNewSection(injectionSectionName, injectionSection, fileOffset, memOffset);
+    injectionSection.clear();
+
+    if(!added || memOffset != injectionSectionRva)
+    {
+        LOG_ERROR("Adding injection section failed.");
+        return false;
+    }
+
+    return true;
+}
+
+bool PEFile::addDataToCave(const QByteArray &data, unsigned int &fileOffset, unsigned int &memOffset,
+                           unsigned int alignment)
+{
+    // Z zapasem na dopełnienie do wyrównania, niezależnie od położenia wolnego miejsca
+    size_t needed = data.length() + alignment - 1;
+    QMultiMap<size_t, unsigned int>::iterator it = caves.lowerBound(needed);
+
+    // Wpisy nieaktualne po zmianie rozmiaru sekcji poza sesją są pomijane
+    while(it != caves.end() && getSectionFreeSpace(it.value()) < needed)
+        it = caves.erase(it);
+
+    if(it == caves.end())
+        return false;
+
+    unsigned int section = it.value();
+    caves.erase(it);
+
+    PIMAGE_SECTION_HEADER header = getSectionHeader(section);
+
+    unsigned int pad = alignNumber(header->VirtualAddress + header->Misc.VirtualSize, alignment) -
+            (header->VirtualAddress + header->Misc.VirtualSize);
+
+    fileOffset = header->PointerToRawData + header->Misc.VirtualSize + pad;
+    memOffset = header->VirtualAddress + header->Misc.VirtualSize + pad;
+    header->Misc.VirtualSize += pad + data.length();
+
+    if(!isSectionExecutable(section))
+        makeSectionExecutable(section);
+
+    b_data.replace(fileOffset, data.length(), data);
+    markDirty(fileOffset, data.length());
+
+    size_t freeSpace = getSectionFreeSpace(section);
+    if(freeSpace)
+        caves.insert(freeSpace, section);
+
+    return true;
+}
+
+bool PEFile::addDataToInjectionSection(const QByteArray &data, unsigned int &fileOffset, unsigned int &memOffset,
+                                       unsigned int alignment)
+{
+    if(!injectionSectionRva)
+        return false;
+
+    injectionSection.append(QByteArray(alignNumber(injectionSectionRva + injectionSection.length(), alignment) -
+                                       (injectionSectionRva + injectionSection.length()), '\x00'));
+
+    // Bufor rośnie geometrycznie, sekcja jest dodawana do pliku jednorazowo w endInjection()
+    fileOffset = alignNumber(b_data.length(), getOptHdrFileAlignment()) + injectionSection.length();
+    memOffset = injectionSectionRva + injectionSection.length();
+    injectionSection.append(data);
+
+    return true;
+}
+
 template <typename Register>
-uint64_t PEFile::injectUniqueData(BinaryCode<Register> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations)
+uint64_t PEFile::injectUniqueData(BinaryCode<Register> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations,
+                                  unsigned int alignment)
 {
     bool inserted;
-    uint64_t offset = injectUniqueData(data.getBytes(), ptrs, &inserted);
+    uint64_t offset = injectUniqueData(data.getBytes(), ptrs, &inserted, alignment);
 
     if(inserted)
         relocations.append(data.getRelocations(offset));
 
     return offset;
 }
-template uint64_t PEFile::injectUniqueData(BinaryCode<Registers_x86> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations);
-template uint64_t PEFile::injectUniqueData(BinaryCode<Registers_x64> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations);
+template uint64_t PEFile::injectUniqueData(BinaryCode<Registers_x86> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations,
+                                           unsigned int alignment);
+template uint64_t PEFile::injectUniqueData(BinaryCode<Registers_x64> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations,
+                                           unsigned int alignment);
 
 QString PEFile::getRandomSectionName()
 {
@@ -383,65 +514,52 @@ bool PEFile::addRelocations(QList<uint64_t> relocations)
     if(getRelocationsSize() == 0)
         return true;
 
-    QList<RelocationTable> reloc_table;
+    RelocationTable reloc_table;
     if(!getRelocations(reloc_table))
         return false;
 
     // Dodawanie do tablicy
     foreach(uint64_t abs_addr, relocations)
-    {
-        uint32_t rel_addr = abs_addr - getImageBase();
-        uint32_t va = rel_addr & 0xFFFFF000;
-        uint32_t offset = rel_addr & 0x00000FFF;
+        reloc_table.addRelocation(abs_addr - getImageBase(), getRelocationType());
 
-        QList<RelocationTable> new_reloc_table;
-        bool added = false;
+    QByteArray raw_table = reloc_table.toBytes();
 
-        for(QList<RelocationTable>::iterator it = reloc_table.begin(); it != reloc_table.end(); ++it)
-        {
-            if(it->VirtualAddress < va || (added && it->VirtualAddress > va))
-            {
-                new_reloc_table.append(*it);
-                continue;
-            }
+    PIMAGE_SECTION_HEADER hdr = getSectionHeader(getSectionByVirtualAddress(getRelocationsVirtualAddress()));
+    uint32_t shift = getRelocationsVirtualAddress() - hdr->VirtualAddress;
+    uint32_t oldSize = getRelocationsSize();
 
-            if(it->VirtualAddress == va)
-            {
-                RelocationTable r = *it;
-                r.addOffset(offset, getRelocationType());
-                new_reloc_table.append(r);
+    uint32_t tableSize = raw_table.length();
 
-                added = true;
-            }
+    // Stara tablica kończy dane sekcji, jeżeli za nią są już tylko zera (sekcja .reloc)
+    bool isLast = shift + oldSize >= hdr->Misc.VirtualSize;
+    if(!isLast && shift == 0)
+    {
+        const char *tail = b_data.constData() + hdr->PointerToRawData + oldSize;
+        uint32_t tailSize = qMin<uint32_t>(hdr->Misc.VirtualSize, hdr->SizeOfRawData) - oldSize;
 
-            if(!added && it->VirtualAddress > va)
-            {
-                RelocationTable r;
-                r.VirtualAddress = va;
-                r.SizeOfBlock = IMAGE_SIZEOF_BASE_RELOCATION;
-                r.addOffset(offset, getRelocationType());
-                new_reloc_table.append(r);
-
-                added = true;
-                new_reloc_table.append(*it);
-            }
-        }
+        isLast = std::all_of(tail, tail + tailSize, [](char c) { return c == 0; });
+    }
 
-        if(!added)
-        {
-            RelocationTable r;
-            r.VirtualAddress = va;
-            r.SizeOfBlock = IMAGE_SIZEOF_BASE_RELOCATION;
-            r.addOffset(offset, getRelocationType());
-            new_reloc_table.append(r);
-        }
+    // Nowa tablica zastępuje starą, jeżeli mieści się w jej miejscu lub stara tablica kończy dane sekcji,
+    // a za nią jest wolne miejsce w pliku i w obszarze sekcji zajmowanym w pamięci
+    bool inPlace = tableSize <= oldSize ||
+            (isLast &&
+             shift + tableSize <= qMin<uint32_t>(hdr->SizeOfRawData,
+                                                 alignNumber(hdr->Misc.VirtualSize, getOptHdrSectionAlignment())));
 
-        reloc_table = new_reloc_table;
-    }
+    if(inPlace)
+    {
+        if(tableSize < oldSize)
+            raw_table.append(QByteArray(oldSize - tableSize, 0x00));
 
-    QByteArray raw_table;
-    foreach(RelocationTable rt, reloc_table)
-        raw_table.append(rt.toBytes());
+        b_data.replace(hdr->PointerToRawData + shift, raw_table.length(), raw_table);
+        markDirty(hdr->PointerToRawData + shift, raw_table.length());
+
+        hdr->Misc.VirtualSize = qMax<uint32_t>(hdr->Misc.VirtualSize, shift + tableSize);
+        getDataDirectory(IMAGE_DIRECTORY_ENTRY_BASERELOC)->Size = tableSize;
+
+        return true;
+    }
 
     unsigned int file_offset, mem_offset;
     if(!addNewSection(getRandomSectionName(), raw_table, file_offset, mem_offset))
@@ -524,6 +642,14 @@ uint64_t PEFile::getAddressAtCallInstructionOffset(uint32_t offset)
     return call_addr;
 }
 
+uint64_t PEFile::getCallInstructionAddress(uint32_t offset)
+{
+    if(!parsed)
+        return 0;
+
+    return getImageBase() + fileOffsetToRVA(offset) - 1;
+}
+
 bool PEFile::setAddressAtCallInstructionOffset(uint32_t offset, uint64_t address)
 {
     if(!parsed)
@@ -531,11 +657,12 @@ bool PEFile::setAddressAtCallInstructionOffset(uint32_t offset, uint64_t address
 
     uint32_t new_call_off = (address - getImageBase()) - fileOffsetToRVA(offset + 4);
     *reinterpret_cast<int32_t*>(&b_data.data()[offset]) = new_call_off;
+    markDirty(offset, sizeof(new_call_off));
 
     return true;
 }
 
-bool PEFile::getRelocations(QList<RelocationTable> &rt)
+bool PEFile::getRelocations(RelocationTable &rt)
 {
     if(getRelocationsSize() == 0)
         return true;
@@ -546,37 +673,31 @@ bool PEFile::getRelocations(QList<RelocationTable> &rt)
 
     uint32_t shift = getRelocationsVirtualAddress() - hdr->VirtualAddress;
     uint32_t relocBase = hdr->PointerToRawData + shift;
-    char *raw = b_data.data();
+    const char *raw = b_data.constData();
     uint32_t i = 0;
 
-    while(i < getRelocationsSize())
-    {
-        IMAGE_BASE_RELOCATION reloc_tab = *reinterpret_cast<IMAGE_BASE_RELOCATION*>(&raw[relocBase + i]);
+    if(static_cast<uint64_t>(relocBase) + getRelocationsSize() > static_cast<uint64_t>(b_data.length()))
+        return false;
 
-        RelocationTable t;
-        t.SizeOfBlock = reloc_tab.SizeOfBlock;
-        t.VirtualAddress = reloc_tab.VirtualAddress;
+    while(i + IMAGE_SIZEOF_BASE_RELOCATION <= getRelocationsSize())
+    {
+        const IMAGE_BASE_RELOCATION *reloc_tab = reinterpret_cast<const IMAGE_BASE_RELOCATION*>(&raw[relocBase + i]);
 
-        printf("%x: %d\n", t.VirtualAddress, t.SizeOfBlock);
+        if(reloc_tab->SizeOfBlock < IMAGE_SIZEOF_BASE_RELOCATION || i + reloc_tab->SizeOfBlock > getRelocationsSize())
+            return false;
 
-        uint32_t j = IMAGE_SIZEOF_BASE_RELOCATION;
+        QVector<uint16_t> &entries = rt.Pages[reloc_tab->VirtualAddress];
 
-        while(j < t.SizeOfBlock)
+        for(uint32_t j = IMAGE_SIZEOF_BASE_RELOCATION; j + sizeof(uint16_t) <= reloc_tab->SizeOfBlock; j += sizeof(uint16_t))
         {
-            RelocationTable::TypeOffset typeOffset;
-
-            typeOffset.Type = ((*reinterpret_cast<uint16_t*>(&raw[relocBase + i + j])) & 0xF000) >> 12;
-            typeOffset.Offset = (*reinterpret_cast<uint16_t*>(&raw[relocBase + i + j])) & 0x0FFF;
+            uint16_t typeOffset = *reinterpret_cast<const uint16_t*>(&raw[relocBase + i + j]);
 
-            if(typeOffset.Type == IMAGE_REL_BASED_ABSOLUTE)
-                t.SizeOfBlock -= 2;
-            else
-                t.TypeOffsets.append(typeOffset);
-            j += 2;
+            // Wpisy wyrównujące są dodawane ponownie przy zapisie
+            if(((typeOffset & 0xF000) >> 12) != IMAGE_REL_BASED_ABSOLUTE)
+                entries.append(typeOffset);
         }
 
-        rt.append(t);
-        i += reloc_tab.SizeOfBlock;
+        i += reloc_tab->SizeOfBlock;
     }
 
     return true;
@@ -632,12 +753,21 @@ bool PEFile::is_valid() const
     return parsed;
 }
 
+QMap<qint64, qint64> PEFile::getDirtyRanges()
+{
+    if(parsed)
+        markDirty(0, _is_x64 ? getOptionalHeader64()->SizeOfHeaders : getOptionalHeader32()->SizeOfHeaders);
+
+    return BinaryFile::getDirtyRanges();
+}
+
 bool PEFile::parse()
 {
-    char *data = b_data.data();
+    // Tylko odczyt, dzięki czemu zmapowany plik nie jest kopiowany
+    const char *data = b_data.constData();
     size_t length = b_data.length();
 
-    PIMAGE_DOS_HEADER dosHeader = reinterpret_cast<PIMAGE_DOS_HEADER>(data);
+    const IMAGE_DOS_HEADER *dosHeader = reinterpret_cast<const IMAGE_DOS_HEADER*>(data);
     dosHeaderIdx = 0;
 
     if(length < sizeof(IMAGE_DOS_HEADER) || dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
@@ -645,51 +775,47 @@ bool PEFile::parse()
 
     _is_x64 = isPE_64(dosHeader->e_lfanew);
 
-    PIMAGE_NT_HEADERS32 ntHeaders32 = NULL;
-    PIMAGE_NT_HEADERS64 ntHeaders64 = NULL;
+    const IMAGE_NT_HEADERS32 *ntHeaders32 = NULL;
+    const IMAGE_NT_HEADERS64 *ntHeaders64 = NULL;
 
     if(_is_x64)
     {
-        ntHeaders64 = reinterpret_cast<PIMAGE_NT_HEADERS64>(reinterpret_cast<char*>(dosHeader) +
-                                                            dosHeader->e_lfanew);
-        ntHeadersIdx = reinterpret_cast<char*>(ntHeaders64) - reinterpret_cast<char*>(dosHeader);
+        ntHeaders64 = reinterpret_cast<const IMAGE_NT_HEADERS64*>(data + dosHeader->e_lfanew);
+        ntHeadersIdx = dosHeader->e_lfanew;
 
         if(length < dosHeader->e_lfanew + sizeof(IMAGE_NT_HEADERS64::Signature)
-                || getNtHdrSignature() != IMAGE_NT_SIGNATURE)
+                || ntHeaders64->Signature != IMAGE_NT_SIGNATURE)
             return false;
     }
     else
     {
-        ntHeaders32 = reinterpret_cast<PIMAGE_NT_HEADERS32>(reinterpret_cast<char*>(dosHeader) +
-                                                            dosHeader->e_lfanew);
-        ntHeadersIdx = reinterpret_cast<char*>(ntHeaders32) - reinterpret_cast<char*>(dosHeader);
+        ntHeaders32 = reinterpret_cast<const IMAGE_NT_HEADERS32*>(data + dosHeader->e_lfanew);
+        ntHeadersIdx = dosHeader->e_lfanew;
 
         if(length < dosHeader->e_lfanew + sizeof(IMAGE_NT_HEADERS32::Signature)
-                || getNtHdrSignature() != IMAGE_NT_SIGNATURE)
+                || ntHeaders32->Signature != IMAGE_NT_SIGNATURE)
             return false;
     }
 
-    PIMAGE_FILE_HEADER fileHeader = _is_x64 ?
-                reinterpret_cast<PIMAGE_FILE_HEADER>(&ntHeaders64->FileHeader) :
-                reinterpret_cast<PIMAGE_FILE_HEADER>(&ntHeaders32->FileHeader);
+    const IMAGE_FILE_HEADER *fileHeader = _is_x64 ? &ntHeaders64->FileHeader : &ntHeaders32->FileHeader;
 
-    fileHeaderIdx = reinterpret_cast<char*>(fileHeader) - reinterpret_cast<char*>(dosHeader);
+    fileHeaderIdx = reinterpret_cast<const char*>(fileHeader) - data;
 
     if(length < (fileHeaderIdx + sizeof(IMAGE_FILE_HEADER)))
         return false;
 
-    PIMAGE_OPTIONAL_HEADER32 optionalHeader32 = NULL;
-    PIMAGE_OPTIONAL_HEADER64 optionalHeader64 = NULL;
+    const IMAGE_OPTIONAL_HEADER32 *optionalHeader32 = NULL;
+    const IMAGE_OPTIONAL_HEADER64 *optionalHeader64 = NULL;
 
     if(_is_x64)
-        optionalHeader64 = reinterpret_cast<PIMAGE_OPTIONAL_HEADER64>(&ntHeaders64->OptionalHeader);
+        optionalHeader64 = &ntHeaders64->OptionalHeader;
     else
-        optionalHeader32 = reinterpret_cast<PIMAGE_OPTIONAL_HEADER32>(&ntHeaders32->OptionalHeader);
+        optionalHeader32 = &ntHeaders32->OptionalHeader;
 
     optionalHeaderSize = fileHeader->SizeOfOptionalHeader;
     optionalHeaderIdx = _is_x64 ?
-                (reinterpret_cast<char*>(optionalHeader64) - reinterpret_cast<char*>(dosHeader)) :
-                (reinterpret_cast<char*>(optionalHeader32) - reinterpret_cast<char*>(dosHeader));
+                (reinterpret_cast<const char*>(optionalHeader64) - data) :
+                (reinterpret_cast<const char*>(optionalHeader32) - data);
 
     if(length < optionalHeaderIdx + optionalHeaderSize)
         return false;
@@ -701,7 +827,7 @@ bool PEFile::parse()
         return false;
 
     // Data Directories
-    numberOfDataDirectories = getOptHdrNumberOfRvaAndSizes();
+    numberOfDataDirectories = _is_x64 ? optionalHeader64->NumberOfRvaAndSizes : optionalHeader32->NumberOfRvaAndSizes;
 
     if(dataDirectoriesIdx)
         delete [] dataDirectoriesIdx;
@@ -717,8 +843,8 @@ bool PEFile::parse()
     }
 
     unsigned int firstDataDirIdx = _is_x64 ?
-                reinterpret_cast<char*>(&(optionalHeader64->DataDirectory[0])) - reinterpret_cast<char*>(dosHeader) :
-        reinterpret_cast<char*>(&(optionalHeader32->DataDirectory[0])) - reinterpret_cast<char*>(dosHeader);
+                reinterpret_cast<const char*>(&(optionalHeader64->DataDirectory[0])) - data :
+        reinterpret_cast<const char*>(&(optionalHeader32->DataDirectory[0])) - data;
 
     for(unsigned int i = 0; i < numberOfDataDirectories; ++i)
         dataDirectoriesIdx[i] = firstDataDirIdx + i * sizeof(IMAGE_DATA_DIRECTORY);
@@ -850,6 +976,7 @@ bool PEFile::addDataToSectionExVirtual(unsigned int section, QByteArray data, un
     if(static_cast<size_t>(b_data.length()) < header->PointerToRawData + newSizeOfRawData)
         b_data.resize(header->PointerToRawData + newSizeOfRawData);
     b_data.replace(fileOffset, newSizeOfRawData, data);
+    markDirty(fileOffset, newSizeOfRawData);
 
     return parse();
 }
@@ -1013,6 +1140,7 @@ bool PEFile::resizeLastSection(QByteArray data, unsigned int &fileOffset, unsign
     if(static_cast<size_t>(b_data.length()) < newDataOffset + numBytesToAdd)
         b_data.resize(newDataOffset + numBytesToAdd);
     b_data.replace(newDataOffset, numBytesToAdd, data);
+    markDirty(newDataOffset, numBytesToAdd);
 
     fileOffset = newDataOffset;
 
@@ -1042,6 +1170,7 @@ bool PEFile::addDataToSection(unsigned int section, QByteArray data,
         makeSectionExecutable(section);
 
     b_data.replace(newDataOffset, data.length(), data);
+    markDirty(newDataOffset, data.length());
 
     fileOffset = newDataOffset;
 
@@ -1108,6 +1237,7 @@ bool PEFile::addDataToSectionEx(unsigned int section, QByteArray data, unsigned
     if(static_cast<size_t>(b_data.length()) < newDataOffset + numBytesToPaste)
         b_data.resize(newDataOffset + numBytesToPaste);
     b_data.replace(newDataOffset, numBytesToPaste, data);
+    markDirty(newDataOffset, numBytesToPaste);
 
     fileOffset = newDataOffset;
 
@@ -1213,10 +1343,67 @@ bool PEFile::addNewSection(QString name, QByteArray data, unsigned int &fileOffs
 
     b_data.replace(newHeaderOffset, sizeof(IMAGE_SECTION_HEADER), d_header);
     b_data.replace(newFileOffset, sizeOfNewData, data);
+    markDirty(newHeaderOffset, sizeof(IMAGE_SECTION_HEADER));
+    markDirty(newFileOffset, sizeOfNewData);
 
     return parse();
 }
 
+uint64_t PEFile::addDataSection(unsigned int size)
+{
+    if(!parsed || injecting || !size)
+        return 0;
+
+    unsigned int newHeaderOffset = sectionHeadersIdx[getNumberOfSections() - 1] + sizeof(IMAGE_SECTION_HEADER);
+    unsigned int newFileOffset = alignNumber(b_data.length(), getOptHdrFileAlignment());
+
+    // Header się nie zmieści, jedno miejsce zostaje dla sekcji sesji wstrzykiwania.
+    if(getFreeSpaceBeforeFirstSectionFile() < sizeof(IMAGE_SECTION_HEADER) * 3)
+        return 0;
+
+    QByteArray d_header(sizeof(IMAGE_SECTION_HEADER), 0x00);
+    PIMAGE_SECTION_HEADER header = reinterpret_cast<PIMAGE_SECTION_HEADER>(d_header.data());
+
+    strncpy(reinterpret_cast<char*>(header->Name), getRandomSectionName().toStdString().c_str(), IMAGE_SIZEOF_SHORT_NAME);
+    header->Misc.VirtualSize = size;
+    header->VirtualAddress =
+            alignNumber(getSectionHeader(getLastSectionNumberMem())->VirtualAddress +
+                        getSectionHeader(getLastSectionNumberMem())->Misc.VirtualSize,
+                        getOptHdrSectionAlignment());
+    // Zera są zapisywane w pliku, bo resizeLastSection() może dopisać dane do sekcji bez danych w pliku.
+    header->SizeOfRawData = alignNumber(size, getOptHdrFileAlignment());
+    header->PointerToRawData = newFileOffset;
+    header->Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    setOptHdrSizeOfInitializedData(getOptHdrSizeOfInitializedData() + header->SizeOfRawData);
+    setOptHdrSizeOfImage(alignNumber(header->VirtualAddress + header->Misc.VirtualSize,
+                                     getOptHdrSectionAlignment()));
+    if(_is_x64)
+        setOptHdrSizeOfHeaders(alignNumber(sizeof(IMAGE_DOS_HEADER::e_lfanew) + sizeof(IMAGE_NT_HEADERS64::Signature) +
+                                           sizeof(IMAGE_FILE_HEADER) + sizeof(IMAGE_OPTIONAL_HEADER64) +
+                                           sizeof(IMAGE_SECTION_HEADER) * (getNumberOfSections() + 1),
+                                           getOptHdrFileAlignment()));
+    else
+        setOptHdrSizeOfHeaders(alignNumber(sizeof(IMAGE_DOS_HEADER::e_lfanew) + sizeof(IMAGE_NT_HEADERS32::Signature) +
+                                           sizeof(IMAGE_FILE_HEADER) + sizeof(IMAGE_OPTIONAL_HEADER32) +
+                                           sizeof(IMAGE_SECTION_HEADER) * (getNumberOfSections() + 1),
+                                           getOptHdrFileAlignment()));
+
+    getFileHeader()->NumberOfSections += 1;
+
+    uint64_t address = getImageBase() + header->VirtualAddress;
+    unsigned int sizeOfNewData = header->SizeOfRawData;
+
+    b_data.resize(newFileOffset);
+    b_data.append(QByteArray(sizeOfNewData, 0x00));
+
+    b_data.replace(newHeaderOffset, sizeof(IMAGE_SECTION_HEADER), d_header);
+    markDirty(newHeaderOffset, sizeof(IMAGE_SECTION_HEADER));
+    markDirty(newFileOffset, sizeOfNewData);
+
+    return parse() ? address : 0;
+}
+
 QByteArray PEFile::getTextSection()
 {
     if(!parsed)
@@ -1226,7 +1413,7 @@ QByteArray PEFile::getTextSection()
     if(!text_hdr)
         return QByteArray();
 
-    return QByteArray(&b_data.data()[text_hdr->PointerToRawData], text_hdr->Misc.VirtualSize);
+    return QByteArray(&b_data.constData()[text_hdr->PointerToRawData], text_hdr->Misc.VirtualSize);
 }
 
 uint32_t PEFile::getTextSectionOffset()
@@ -1241,64 +1428,41 @@ uint32_t PEFile::getTextSectionOffset()
     return text_hdr->PointerToRawData;
 }
 
-bool PEFile::RelocationTable::addOffset(uint16_t offset, uint8_t type)
+void PEFile::RelocationTable::addRelocation(uint32_t rva, uint8_t type)
 {
-    bool added = false, ok = false;
-    QList<TypeOffset> new_to;
-
-    TypeOffset to;
-    to.Type = type;
-    to.Offset = offset;
-
-    for(QList<TypeOffset>::iterator it = TypeOffsets.begin(); it != TypeOffsets.end(); ++it)
-    {
-        if(it->Offset == offset)
-            added = true;
-
-        if(it->Offset > offset && !added)
-        {
-            added = ok = true;
-            new_to.append(to);
-        }
-
-        new_to.append(*it);
-    }
-
-    if(!added)
-    {
-        new_to.append(to);
-        ok = true;
-    }
-
-    TypeOffsets = new_to;
-
-    if(ok)
-        SizeOfBlock += sizeof(uint16_t);
-
-    return ok;
+    Pages[rva & 0xFFFFF000].append((type << 12) | (rva & 0x0FFF));
 }
 
 QByteArray PEFile::RelocationTable::toBytes()
 {
     QByteArray bytes;
+    QList<uint32_t> pages = Pages.keys();
+
+    std::sort(pages.begin(), pages.end());
 
-    if(SizeOfBlock % 4 != 0)
+    foreach(uint32_t page, pages)
     {
-        TypeOffset align;
-        align.Type = 0;
-        align.Offset = 0;
+        QVector<uint16_t> &entries = Pages[page];
 
-        SizeOfBlock += sizeof(uint16_t);
-        TypeOffsets.append(align);
-    }
+        if(entries.isEmpty())
+            continue;
 
-    bytes.append(reinterpret_cast<const char*>(&VirtualAddress), sizeof(uint32_t));
-    bytes.append(reinterpret_cast<const char*>(&SizeOfBlock), sizeof(uint32_t));
+        // Sortowanie według offsetu, wpisy o powtórzonym offsecie są pomijane
+        std::stable_sort(entries.begin(), entries.end(),
+                         [](uint16_t a, uint16_t b) { return (a & 0x0FFF) < (b & 0x0FFF); });
+        entries.erase(std::unique(entries.begin(), entries.end(),
+                                  [](uint16_t a, uint16_t b) { return (a & 0x0FFF) == (b & 0x0FFF); }),
+                      entries.end());
 
-    foreach(TypeOffset to, TypeOffsets)
-    {
-        uint16_t bin_to = (to.Type << 12) | to.Offset;
-        bytes.append(reinterpret_cast<const char*>(&bin_to), sizeof(uint16_t));
+        // Wyrównanie bloku do 4 bajtów wpisem IMAGE_REL_BASED_ABSOLUTE
+        if(entries.size() % 2 != 0)
+            entries.append(0);
+
+        uint32_t sizeOfBlock = IMAGE_SIZEOF_BASE_RELOCATION + entries.size() * sizeof(uint16_t);
+
+        bytes.append(reinterpret_cast<const char*>(&page), sizeof(uint32_t));
+        bytes.append(reinterpret_cast<const char*>(&sizeOfBlock), sizeof(uint32_t));
+        bytes.append(reinterpret_cast<const char*>(entries.constData()), entries.size() * sizeof(uint16_t));
     }
 
     return bytes;
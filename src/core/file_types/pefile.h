@@ -10,6 +10,10 @@
 #include <core/file_types/codedefines.h>
 #include <core/file_types/binaryfile.h>
 
+#include <QMap>
+#include <QHash>
+#include <QVector>
+
 /**
  * @brief Klasa odpowiedzialna za parsowanie plików PE
  */
@@ -18,48 +22,24 @@ class PEFile : public BinaryFile
 private:
 
     /**
-     * @brief Struktura odpowiedzialna za przechowywanie wpisu w tablicy relokacji.
+     * @brief Struktura odpowiedzialna za budowanie tablicy relokacji.
+     *
+     * Wpisy są grupowane według stron (4 KB) i dopisywane bez sortowania,
+     * sortowanie i usuwanie duplikatów odbywa się jednorazowo w toBytes().
      */
     struct RelocationTable
     {
         /**
-         * @brief Struktura przechowująca informację o typie i offsecie relokacji.
-         */
-        struct TypeOffset
-        {
-            /**
-             * @brief Typ relokacji
-             */
-            uint8_t Type;
-
-            /**
-             * @brief Offset relokacji
-             */
-            uint16_t Offset;
-        };
-
-        /**
-         * @brief Adres wirtualny relokacji.
-         */
-        uint32_t VirtualAddress;
-
-        /**
-         * @brief Rozmiar tablicy
+         * @brief Wpisy relokacji ((typ << 12) | offset) dla adresów wirtualnych stron.
          */
-        uint32_t SizeOfBlock;
+        QHash<uint32_t, QVector<uint16_t> > Pages;
 
         /**
-         * @brief Tablica typów i offsetów relokacji o danym adresie.
-         */
-        QList<TypeOffset> TypeOffsets;
-
-        /**
-         * @brief Dodawanie nowego offsetu do tablicy
-         * @param offset Offset do dodania
+         * @brief Dodawanie nowego wpisu do tablicy
+         * @param rva Relatywny adres wirtualny relokowanego pola
          * @param type Typ relokacji
-         * @return True w przypadku poprawnego dodania
          */
-        bool addOffset(uint16_t offset, uint8_t type);
+        void addRelocation(uint32_t rva, uint8_t type);
 
         /**
          * @brief Metoda zwracająca relokacjie jako tablicę bajtów, gotową do wklejenia do pliku
@@ -119,6 +99,31 @@ private:
      */
     unsigned int *dataDirectoriesIdx;
 
+    /**
+     * @brief Flaga informująca czy trwa sesja wstrzykiwania danych.
+     */
+    bool injecting;
+
+    /**
+     * @brief Wolne miejsce na końcach sekcji (rozmiar -> numer sekcji), uporządkowane według rozmiaru.
+     */
+    QMultiMap<size_t, unsigned int> caves;
+
+    /**
+     * @brief Zawartość sekcji dodawanej do pliku na zakończenie sesji wstrzykiwania.
+     */
+    QByteArray injectionSection;
+
+    /**
+     * @brief Nazwa sekcji dodawanej na zakończenie sesji wstrzykiwania.
+     */
+    QString injectionSectionName;
+
+    /**
+     * @brief Adres (RVA) sekcji dodawanej na zakończenie sesji, 0 jeżeli nie można dodać nowej sekcji.
+     */
+    unsigned int injectionSectionRva;
+
     /**
      * @brief Metoda odpowiedzialna za parsowanie pliku PE i wypełnianie wszystkich struktur.
      * @return True w przypadku poprawnie sparsowanego pliku.
@@ -330,11 +335,11 @@ private:
     QString getRandomSectionName();
 
     /**
-     * @brief Metoda wypełniająca listę relokacjami adresów
-     * @param rt Lista relokacji
+     * @brief Metoda wypełniająca tablicę relokacjami adresów
+     * @param rt Tablica relokacji
      * @return True w przypadku powodzenia
      */
-    bool getRelocations(QList<RelocationTable> &rt);
+    bool getRelocations(RelocationTable &rt);
 
     /**
      * @brief Metoda pobierająca numer sekcji, w której znajduje się podany adres
@@ -450,6 +455,36 @@ private:
      */
     bool addNewSection(QString name, QByteArray data, unsigned int &fileOffset, unsigned int &memOffset, bool useReserved = false);
 
+    /**
+     * @brief Dodaje nową wyzerowaną sekcję danych do odczytu i zapisu (bez prawa wykonania).
+     * Nie może być wywołana w trakcie sesji wstrzykiwania.
+     * @param size Rozmiar sekcji w pamięci.
+     * @return Adres wirtualny nowej sekcji lub 0 w przypadku błędu.
+     */
+    uint64_t addDataSection(unsigned int size);
+
+    /**
+     * @brief Dodanie danych do najmniejszego wolnego obszaru na końcu sekcji, w którym się zmieszczą.
+     * @param data Dane
+     * @param fileOffset Obliczony offset dodanych danych w pliku.
+     * @param memOffset Obliczony offset dodanych danych w pmięci (RVA).
+     * @param alignment Wyrównanie RVA dodanych danych.
+     * @return True w przypadku poprawnego dodania danych.
+     */
+    bool addDataToCave(const QByteArray &data, unsigned int &fileOffset, unsigned int &memOffset,
+                       unsigned int alignment = 1);
+
+    /**
+     * @brief Dodanie danych do sekcji, która zostanie utworzona na zakończenie sesji wstrzykiwania.
+     * @param data Dane
+     * @param fileOffset Obliczony offset dodanych danych w pliku.
+     * @param memOffset Obliczony offset dodanych danych w pmięci (RVA).
+     * @param alignment Wyrównanie RVA dodanych danych.
+     * @return True w przypadku poprawnego dodania danych.
+     */
+    bool addDataToInjectionSection(const QByteArray &data, unsigned int &fileOffset, unsigned int &memOffset,
+                                   unsigned int alignment = 1);
+
 public:
     /**
      * @brief Konstruktor
@@ -465,6 +500,13 @@ public:
      */
     bool is_valid() const;
 
+    /**
+     * @brief Pobiera zakresy danych zmienione od wczytania pliku, razem z nagłówkami,
+     * które są modyfikowane bezpośrednio przez wskaźniki do struktur.
+     * @return Rozłączne zakresy (początek -> koniec).
+     */
+    QMap<qint64, qint64> getDirtyRanges();
+
     /**
      * @brief Metoda informująca czy wczytany plik jest 64-bitowy.
      * @return True gdy plik x64
@@ -577,19 +619,39 @@ public:
      * @param data Dane do wklejenia
      * @param ptrs Mapa z zapamiętanymi adresami dodanego wcześniej kodu
      * @param relocations Lista adresów do relokacji
+     * @param alignment Wyrównanie adresu kodu, zachowywane w trakcie sesji wstrzykiwania
      * @return Ares wirtualny wklejonego kodu.
      */
     template <typename Register>
-    uint64_t injectUniqueData(BinaryCode<Register> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations);
+    uint64_t injectUniqueData(BinaryCode<Register> data, QMap<QByteArray, uint64_t> &ptrs, QList<uint64_t> &relocations,
+                              unsigned int alignment = 1);
 
     /**
      * @brief Metoda dodająca kod, który nie powinien/nie musi być poddawany relokacji.
      * @param data Dane do dodania
      * @param ptrs Mapa z zapamiętanymi adresami dodanego wcześniej kodu/danych
      * @param inserted Flaga informująca czy kod został dodany czy wcześniej znajdował się na liście pointerów do dodanego kodu
+     * @param alignment Wyrównanie adresu kodu/danych, zachowywane w trakcie sesji wstrzykiwania
      * @return Ares wirtualny wklejonego kodu/danych.
      */
-    uint64_t injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &ptrs, bool *inserted = NULL);
+    uint64_t injectUniqueData(QByteArray data, QMap<QByteArray, uint64_t> &ptrs, bool *inserted = NULL,
+                              unsigned int alignment = 1);
+
+    /**
+     * @brief Metoda rozpoczynająca sesję wstrzykiwania danych.
+     *
+     * Wolne miejsce na końcach sekcji jest wyszukiwane jednorazowo, a dane, które się w nim nie mieszczą,
+     * trafiają do jednej nowej sekcji, dodawanej do pliku w endInjection(). Do zakończenia sesji dane
+     * z tej sekcji nie są dostępne w pliku, więc nie można ich odczytywać (np. jako tablicy TLS).
+     * @return True w przypadku sukcesu.
+     */
+    bool beginInjection();
+
+    /**
+     * @brief Metoda kończąca sesję wstrzykiwania danych i dodająca do pliku zebraną sekcję.
+     * @return True w przypadku sukcesu.
+     */
+    bool endInjection();
 
     /**
      * @brief Metoda wklejająca unikalny string do pliku PE
@@ -606,6 +668,13 @@ public:
      */
     uint64_t getAddressAtCallInstructionOffset(uint32_t offset);
 
+    /**
+     * @brief Metoda pobierająca adres wirtualny instrukcji call lub jmp, której pole rel32 znajduje się pod konkretnym offsetem.
+     * @param offset Miejsce w pliku, w którym znajduje się pole rel32 instrukcji call lub jmp.
+     * @return Adres wirtualny instrukcji
+     */
+    uint64_t getCallInstructionAddress(uint32_t offset);
+
     /**
      * @brief Metoda ustawiająca adres skoku instrukcji call lub jmp znajdującej się w konkretnym miejscu w pliku
      * @param offset Offset w pliku instrukcji call lub jmp
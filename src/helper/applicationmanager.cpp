@@ -3,9 +3,23 @@
 
 // #include <ApplicationManager/DLogger/dlogger.h>
 #include <core/file_types/elffile.h>
+#include <core/file_types/mappedfile.h>
+#include <helper/desc_catalog/ddescriptioncatalog.h>
 #include <QUrl>
 #include <QtWidgets/QMessageBox>
 /*
+// Nazwy plików opisów z katalogu - z katalogu opisów, jeżeli jest skonfigurowany, w innym przypadku z dysku
+static QStringList descriptionFiles(const QString &dir)
+{
+    DDescriptionCatalog &catalog = DDescriptionCatalog::getCatalog();
+
+    if(catalog.isLoaded())
+        return catalog.listDescriptions(dir);
+
+    Q_ASSERT(QDir(dir).exists());
+    return QDir(dir).entryList(QStringList() << "*.json", QDir::Files, QDir::Name);
+}
+
 ApplicationManager::ApplicationManager(QObject *parent) :
     QObject(parent), jsonParser(), sourceParser(), m_targetPath("Choose a C++ source file or an executive file.")
 {
@@ -14,49 +28,35 @@ ApplicationManager::ApplicationManager(QObject *parent) :
     jsonParser.setPath(DSettings::getSettings().getDescriptionsPath<Registers_x86>());
     LOG_MSG(DSettings::getSettings().getDescriptionsPath<Registers_x86>());
     // qDebug()<<DSettings::getSettings().getDescriptionsPath<Registers_x86>();
-    QDir wrappers(DSettings::getSettings().getDescriptionsPath<Registers_x86>());
-    Q_ASSERT(wrappers.exists());
-    QDirIterator it(DSettings::getSettings().getDescriptionsPath<Registers_x86>(), QStringList() << "*.json", QDir::Files);
-
-    QFileInfoList files = wrappers.entryInfoList();
-    foreach(const QFileInfo &fi, files) {
-        QString Path = fi.absoluteFilePath();
-        if(fi.completeSuffix()=="json"){
-            Wrapper<Registers_x86> *w = jsonParser.loadInjectDescription<Registers_x86>(fi.fileName());
-            if(w!=NULL){
-                m_x86methodsList.append(w);
-                Method *m = new Method(w);
-                if(w->wrapper_type==Wrapper<Registers_x86>::WrapperType::Method)
-                    m_methodsx86.append(m);
-                if(w->wrapper_type==Wrapper<Registers_x86>::WrapperType::Handler)
-                    m_handlersx86.append(m);
-            }
-            else
-                // qDebug() << "JSON read failed" << fi.fileName().toStdString().c_str();
-                LOG_ERROR(QString("JSON read failed %1").arg(fi.fileName().toStdString().c_str()));
+    QStringList files = descriptionFiles(DSettings::getSettings().getDescriptionsPath<Registers_x86>());
+    foreach(const QString &fileName, files) {
+        Wrapper<Registers_x86> *w = jsonParser.loadInjectDescription<Registers_x86>(fileName);
+        if(w!=NULL){
+            m_x86methodsList.append(w);
+            Method *m = new Method(w);
+            if(w->wrapper_type==Wrapper<Registers_x86>::WrapperType::Method)
+                m_methodsx86.append(m);
+            if(w->wrapper_type==Wrapper<Registers_x86>::WrapperType::Handler)
+                m_handlersx86.append(m);
         }
+        else
+            // qDebug() << "JSON read failed" << fileName.toStdString().c_str();
+            LOG_ERROR(QString("JSON read failed %1").arg(fileName));
     }
     // Metody 64 bitowe
     jsonParser.setPath(DSettings::getSettings().getDescriptionsPath<Registers_x64>());
     // qDebug()<<DSettings::getSettings().getDescriptionsPath<Registers_x64>();
     LOG_MSG(DSettings::getSettings().getDescriptionsPath<Registers_x64>());
-    QDir wrappers64(DSettings::getSettings().getDescriptionsPath<Registers_x64>());
-    Q_ASSERT(wrappers64.exists());
-    QDirIterator it64(DSettings::getSettings().getDescriptionsPath<Registers_x64>(), QStringList() << "*.json", QDir::Files);
-
-    QFileInfoList files64 = wrappers64.entryInfoList();
-    foreach(const QFileInfo &fi, files64) {
-        QString Path = fi.absoluteFilePath();
-        if(fi.completeSuffix()=="json"){
-            Wrapper<Registers_x64> *w = jsonParser.loadInjectDescription<Registers_x64>(fi.fileName());
-            if(w!=NULL){
-                m_x64methodsList.append(w);
-                Method *m = new Method(w);
-                if(w->wrapper_type==Wrapper<Registers_x64>::WrapperType::Method)
-                    m_methodsx64.append(m);
-                if(w->wrapper_type==Wrapper<Registers_x64>::WrapperType::Handler)
-                    m_handlersx64.append(m);
-            }
+    QStringList files64 = descriptionFiles(DSettings::getSettings().getDescriptionsPath<Registers_x64>());
+    foreach(const QString &fileName, files64) {
+        Wrapper<Registers_x64> *w = jsonParser.loadInjectDescription<Registers_x64>(fileName);
+        if(w!=NULL){
+            m_x64methodsList.append(w);
+            Method *m = new Method(w);
+            if(w->wrapper_type==Wrapper<Registers_x64>::WrapperType::Method)
+                m_methodsx64.append(m);
+            if(w->wrapper_type==Wrapper<Registers_x64>::WrapperType::Handler)
+                m_handlersx64.append(m);
         }
     }
     // TODO: Lista do uzupełnienia o wszystkie rozszerzenia, albo stworzyć plik ze stringami i innymi danymi
@@ -68,24 +68,20 @@ ApplicationManager::ApplicationManager(QObject *parent) :
     QString dsc_src_path = DSettings::getSettings().getDescriptionsSourcePath();
 
     jsonParser.setPath(dsc_src_path);
-    QDir source_dsc(dsc_src_path);
-    Q_ASSERT(source_dsc.exists());
-    QFileInfoList files_dsc_src = source_dsc.entryInfoList();
+    QStringList files_dsc_src = descriptionFiles(dsc_src_path);
 
     SourceCodeDescription scd;
     SourceCodeDescription *pscd;
-    foreach(const QFileInfo &fi, files_dsc_src) {
-        if (fi.completeSuffix() == QString("json")) {
-            if (!jsonParser.loadSourceCodeDescription(fi.fileName(), scd))
-                continue;
+    foreach(const QString &fileName, files_dsc_src) {
+        if (!jsonParser.loadSourceCodeDescription(fileName, scd))
+            continue;
 
-            pscd = new(std::nothrow) SourceCodeDescription;
-            if (!pscd)
-                continue;
-            scd.copy(pscd);
+        pscd = new(std::nothrow) SourceCodeDescription;
+        if (!pscd)
+            continue;
+        scd.copy(pscd);
 
-            m_sourceMethods.push_back(pscd);
-        }
+        m_sourceMethods.push_back(pscd);
     }
 
     connect(this,SIGNAL(archTypeChanged()),this,SLOT(updateCurrMethods()));
@@ -391,13 +387,12 @@ void ApplicationManager::secureClicked()
         }
     }
 
-    QFile f(path);
-    if(!f.open(QFile::ReadOnly)) {
+    MappedFile f(path);
+    if(!f.isOpen()) {
         QMessageBox::critical(nullptr, "Error", "Secure failed! Cannot open file.");
         return;
     }
-    QByteArray data = f.readAll();
-    f.close();
+    QByteArray data = f.getData();
 
     BinaryFile *bin = nullptr;
     QFileInfo in(path);
@@ -406,7 +401,6 @@ void ApplicationManager::secureClicked()
     if(in.completeSuffix().length() > 0)
         out_name.append(".").append(in.completeSuffix());
     QString new_path = QFileInfo(in.absoluteDir(), out_name).absoluteFilePath();
-    QFile out(new_path);
 
     switch(m_state)
     {
@@ -471,16 +465,11 @@ void ApplicationManager::secureClicked()
         break;
     }
 
-    if(bin) {
-        if(!out.open(QFile::WriteOnly))
-        {
-            QMessageBox::critical(nullptr, "Error", "Secure failed! Cannot open out file.");
-            return;
-        }
-
-        out.write(bin->getData());
-
-        out.close();
+    // niezmienione zakresy są klonowane z pliku wejściowego
+    if(bin && !bin->writeToFile(new_path, path))
+    {
+        QMessageBox::critical(nullptr, "Error", "Secure failed! Cannot write out file.");
+        return;
     }
 
     QMessageBox::information(nullptr, "Success!", QString("Methods injected.\nFile saved as: ") + new_path);
@@ -492,13 +481,12 @@ void ApplicationManager::secureClicked()
 void ApplicationManager::obfuscateClicked(int cov, int minl, int maxl)
 {
     QString path = m_targetPath;
-    QFile f(path);
-    if(!f.open(QFile::ReadOnly)) {
+    MappedFile f(path);
+    if(!f.isOpen()) {
         QMessageBox::critical(nullptr, "Error", "Obfuscation failed! Cannot open file.");
         return;
     }
-    QByteArray data = f.readAll();
-    f.close();
+    QByteArray data = f.getData();
 
     BinaryFile *bin = nullptr;
     QFileInfo in(path);
@@ -507,7 +495,6 @@ void ApplicationManager::obfuscateClicked(int cov, int minl, int maxl)
     if(in.completeSuffix().length() > 0)
         out_name.append(".").append(in.completeSuffix());
     QString new_path = QFileInfo(in.absoluteDir(), out_name).absoluteFilePath();
-    QFile out(new_path);
 
     switch(m_state)
     {
@@ -572,16 +559,11 @@ void ApplicationManager::obfuscateClicked(int cov, int minl, int maxl)
         break;
     }
 
-    if(bin) {
-        if(!out.open(QFile::WriteOnly))
-        {
-            QMessageBox::critical(nullptr, "Error", "Obfuscation failed! Cannot open out file.");
-            return;
-        }
-
-        out.write(bin->getData());
-
-        out.close();
+    // niezmienione zakresy są klonowane z pliku wejściowego
+    if(bin && !bin->writeToFile(new_path, path))
+    {
+        QMessageBox::critical(nullptr, "Error", "Obfuscation failed! Cannot write out file.");
+        return;
     }
 
     QMessageBox::information(nullptr, "Success!", QString("Code obfuscated.\nFile saved as: ") + new_path);
@@ -1406,28 +1388,28 @@ void ApplicationManager::clearList()
 ApplicationManager::State ApplicationManager::getFileType(QString path)
 {
     //QString newPath = path.remove("file:///");
-    QFile f(path);
+    MappedFile f(path);
 
-    if(!f.open(QFile::ReadOnly))
+    if(!f.isOpen())
     {
         LOG_ERROR("Cannot open file!");
         return ApplicationManager::IDLE;
     }
 
-    QByteArray data = f.readAll();
-    f.close();
-
-    PEFile pe(data);
-    if(pe.is_valid()){
+    // Wystarczą nagłówki, plik nie jest parsowany ani kopiowany
+    bool x64 = false;
+    switch(BinaryFile::detectFormat(f.getData(), &x64))
+    {
+    case BinaryFile::Format::PE:
         setSys(Windows);
-        setArchType(pe.is_x64() ? X64 : X86);
+        setArchType(x64 ? X64 : X86);
         return ApplicationManager::PE;
-    }
-    ::ELF elf(data);
-    if(elf.is_valid()){
+    case BinaryFile::Format::ELF:
         setSys(Linux);
-        setArchType(elf.is_x64() ? X64 : X86);
+        setArchType(x64 ? X64 : X86);
         return ApplicationManager::ELF;
+    default:
+        break;
     }
     // Source !
     getDeclarations();
@@ -0,0 +1,412 @@
+#include <helper/daemon/ddaemon.h>
+
+#include <QFile>
+#include <QMap>
+#include <QRunnable>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include <QVariant>
+
+#include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
+#include <helper/file_cache/dfilecache.h>
+#include <core/assembler/dassemblercache.h>
+#include <core/file_types/binaryfile.h>
+#include <core/file_types/mappedfile.h>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+#endif
+
+/**
+ * @brief Obsługa jednego połączenia w wątku roboczym.
+ */
+class DDaemon::Connection : public QRunnable
+{
+public:
+    Connection(DDaemon &owner, int fd) :
+        owner(owner),
+        fd(fd)
+    {
+    }
+
+    void run() override
+    {
+        owner.handle(fd);
+#ifdef Q_OS_UNIX
+        ::close(fd);
+#endif
+    }
+
+private:
+    DDaemon &owner;
+    int fd;
+};
+
+DDaemon::DDaemon(DManager &manager, const QString &socketPath, int workers) :
+    manager(manager),
+    socketPath(socketPath),
+    stopping(0),
+    jobs(0),
+    failed(0)
+{
+    if(workers > 0)
+        pool.setMaxThreadCount(workers);
+}
+
+void DDaemon::handle(int fd)
+{
+    QByteArray buffer, line;
+    if(!readLine(fd, buffer, line))
+        return;
+
+    QJsonParseError e;
+    QJsonDocument doc = QJsonDocument::fromJson(line, &e);
+    if(e.error != QJsonParseError::NoError || !doc.isObject())
+    {
+        writeLine(fd, QJsonObject { { "type", "result" }, { "ok", false }, { "error", "Invalid request." } });
+        return;
+    }
+
+    QJsonObject request = doc.object();
+    QString cmd = request.value("cmd").toString("secure");
+
+    if(cmd == "secure")
+        writeLine(fd, secure(fd, request));
+    else if(cmd == "stats")
+        writeLine(fd, stats());
+    else if(cmd == "shutdown")
+    {
+        stopping.store(1);
+        writeLine(fd, QJsonObject { { "type", "result" }, { "ok", true } });
+    }
+    else
+        writeLine(fd, QJsonObject { { "type", "result" }, { "ok", false }, { "error", "Unknown command: " + cmd } });
+}
+
+QJsonObject DDaemon::secure(int fd, const QJsonObject &request)
+{
+    static const QMap<QString, DManager::AddingMethodType> addingMethods = {
+        { "OEP",        DManager::AddingMethodType::OEP },
+        { "Thread",     DManager::AddingMethodType::Thread },
+        { "Trampoline", DManager::AddingMethodType::Trampoline },
+        { "INIT",       DManager::AddingMethodType::INIT },
+        { "INIT_ARRAY", DManager::AddingMethodType::INIT_ARRAY },
+        { "CTORS",      DManager::AddingMethodType::CTORS }
+    };
+
+    static const QMap<QString, DManager::PlacementType> placements = {
+        { "extend",      DManager::PlacementType::ExtendSegment },
+        { "new-segment", DManager::PlacementType::NewSegment },
+        { "huge-pages",  DManager::PlacementType::HugePageSegment }
+    };
+
+    QString addingMethod = request["adding_method"].toString();
+    QString placement = request["placement"].toString("extend");
+
+    if(!addingMethods.contains(addingMethod) || !placements.contains(placement))
+        return QJsonObject { { "type", "result" }, { "ok", false }, { "error", "Unknown adding method or placement." } };
+
+    DManager::secured_file_info sfi;
+    sfi.set_file_name(request["in"].toString());
+    sfi.set_output_file_name(request["out"].toString());
+    sfi.set_adding_method(addingMethods[addingMethod]);
+    sfi.set_dd_method(request["method"].toString());
+    sfi.set_dd_handler(request["handler"].toString());
+    sfi.set_change_x(request["change_x"].toBool(true));
+    sfi.set_obfuscate(request["obfuscate"].toBool(false));
+    sfi.set_profile(request["profile"].toString());
+    sfi.set_profile_build(request["profile_build"].toString());
+    sfi.set_placement(placements[placement]);
+    sfi.set_seed(request["seed"].toVariant().toULongLong());
+
+    // DManager nie zabezpiecza jeszcze plików PE
+    MappedFile in(sfi.get_file_name());
+    if(in.isOpen() && BinaryFile::detectFormat(in.getData()) == BinaryFile::Format::PE)
+        return QJsonObject { { "type", "result" }, { "ok", false }, { "error", "PE files are not supported yet." } };
+
+    // Komunikaty zadania są przesyłane do klienta, który je zlecił
+    DJobContext job(sfi.get_seed());
+    job.setLogSink([fd](DLogger::Type type, QString msg) -> void {
+        static const QMap<DLogger::Type, QString> levels = {
+            { DLogger::Type::Error,   "error" },
+            { DLogger::Type::Warning, "warning" },
+            { DLogger::Type::Message, "message" },
+            { DLogger::Type::Debug,   "debug" }
+        };
+
+        writeLine(fd, QJsonObject { { "type", "log" }, { "level", levels[type] }, { "msg", msg } });
+    });
+
+    DJobContext::Scope scope(job);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = false;
+    try
+    {
+        ok = manager.secure(sfi);
+    }
+    catch(const std::exception &e)
+    {
+        LOG_ERROR(QString("Job failed: %1").arg(e.what()));
+    }
+
+    jobs.ref();
+    if(!ok)
+        failed.ref();
+
+    return QJsonObject { { "type", "result" }, { "ok", ok }, { "ms", timer.elapsed() } };
+}
+
+QJsonObject DDaemon::stats() const
+{
+    DFileCache &files = DFileCache::getCache();
+    DAssemblerCache &assembler = DAssemblerCache::getCache();
+
+    return QJsonObject {
+        { "type", "stats" },
+        { "jobs", jobs.load() },
+        { "failed", failed.load() },
+        { "workers", pool.maxThreadCount() },
+        { "file_cache_hits", files.getHits() },
+        { "file_cache_misses", files.getMisses() },
+        { "assembler_cache_hits", assembler.getHits() },
+        { "assembler_cache_misses", assembler.getMisses() }
+    };
+}
+
+#ifdef Q_OS_UNIX
+
+bool DDaemon::run()
+{
+    QByteArray path = QFile::encodeName(socketPath);
+    sockaddr_un addr;
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(path.size() >= static_cast<int>(sizeof(addr.sun_path)))
+    {
+        LOG_ERROR(QString("Socket path is too long: %1").arg(socketPath));
+        return false;
+    }
+
+    std::memcpy(addr.sun_path, path.constData(), path.size());
+
+    // Gniazdo, na którym nikt nie nasłuchuje, zostało po poprzednim procesie i jest usuwane
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(probe >= 0)
+    {
+        bool running = ::connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        ::close(probe);
+
+        if(running)
+        {
+            LOG_ERROR(QString("Daemon is already running on %1").arg(socketPath));
+            return false;
+        }
+    }
+
+    unlink(path.constData());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 ||
+            bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, 64) < 0)
+    {
+        LOG_ERROR(QString("Cannot listen on %1: %2").arg(socketPath).arg(strerror(errno)));
+        if(fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    DFileCache::getCache().setEnabled(true);
+
+    LOG_MSG(QString("Daemon listening on %1 with %2 workers").arg(socketPath).arg(pool.maxThreadCount()));
+
+    while(!stopping.load())
+    {
+        pollfd p = { fd, POLLIN, 0 };
+        if(poll(&p, 1, 200) <= 0)
+            continue;
+
+        int client = accept(fd, nullptr, nullptr);
+        if(client < 0)
+            continue;
+
+        // Klient, który nie wyśle żądania, nie blokuje wątku roboczego na zawsze
+        timeval timeout = { 30, 0 };
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        fcntl(client, F_SETFD, FD_CLOEXEC);
+
+        pool.start(new Connection(*this, client));
+    }
+
+    ::close(fd);
+    unlink(path.constData());
+
+    pool.waitForDone();
+
+    LOG_MSG(QString("Daemon stopped after %1 jobs (%2 failed)").arg(jobs.load()).arg(failed.load()));
+
+    return true;
+}
+
+bool DDaemon::submit(const QString &socketPath, const QJsonObject &request)
+{
+    QByteArray path = QFile::encodeName(socketPath);
+    sockaddr_un addr;
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+
+    if(path.size() >= static_cast<int>(sizeof(addr.sun_path)))
+    {
+        LOG_ERROR(QString("Socket path is too long: %1").arg(socketPath));
+        return false;
+    }
+
+    std::memcpy(addr.sun_path, path.constData(), path.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        LOG_ERROR(QString("Cannot connect to daemon on %1: %2").arg(socketPath).arg(strerror(errno)));
+        if(fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    bool ok = false;
+    bool finished = false;
+    QByteArray buffer, line;
+
+    if(writeLine(fd, request))
+    {
+        while(!finished && readLine(fd, buffer, line))
+        {
+            QJsonObject response = QJsonDocument::fromJson(line).object();
+            QString type = response["type"].toString();
+
+            if(type == "log")
+            {
+                QString level = response["level"].toString();
+                QString msg = response["msg"].toString();
+
+                if(level == "error")
+                    LOG_ERROR(msg);
+                else if(level == "warning")
+                    LOG_WARN(msg);
+                else if(level == "debug")
+                    LOG_DBG(msg);
+                else
+                    LOG_MSG(msg);
+            }
+            else if(type == "result")
+            {
+                ok = response["ok"].toBool();
+                finished = true;
+
+                if(response.contains("error"))
+                    LOG_ERROR(response["error"].toString());
+                if(response.contains("ms"))
+                    LOG_MSG(QString("Job %1 in %2 ms").arg(ok ? "finished" : "failed").arg(response["ms"].toDouble()));
+            }
+            else
+            {
+                LOG_MSG(QString(QJsonDocument(response).toJson(QJsonDocument::Compact)));
+                ok = finished = true;
+            }
+        }
+    }
+
+    ::close(fd);
+
+    if(!finished)
+        LOG_ERROR("Daemon closed the connection without a result.");
+
+    return ok;
+}
+
+bool DDaemon::readLine(int fd, QByteArray &buffer, QByteArray &line)
+{
+    int nl;
+    while((nl = buffer.indexOf('\n')) < 0)
+    {
+        char chunk[4096];
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+
+        buffer.append(chunk, n);
+    }
+
+    line = buffer.left(nl);
+    buffer.remove(0, nl + 1);
+
+    return true;
+}
+
+bool DDaemon::writeLine(int fd, const QJsonObject &obj)
+{
+    QByteArray data = QJsonDocument(obj).toJson(QJsonDocument::Compact).append('\n');
+    const char *p = data.constData();
+    qint64 left = data.size();
+
+    while(left > 0)
+    {
+        // Klient mógł się rozłączyć, SIGPIPE zakończyłby cały demon
+        ssize_t n = send(fd, p, left, MSG_NOSIGNAL);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+        if(n <= 0)
+            return false;
+
+        p += n;
+        left -= n;
+    }
+
+    return true;
+}
+
+#else
+
+bool DDaemon::run()
+{
+    LOG_ERROR("Daemon mode needs Unix domain sockets.");
+    return false;
+}
+
+bool DDaemon::submit(const QString &, const QJsonObject &)
+{
+    LOG_ERROR("Daemon mode needs Unix domain sockets.");
+    return false;
+}
+
+bool DDaemon::readLine(int, QByteArray &, QByteArray &)
+{
+    return false;
+}
+
+bool DDaemon::writeLine(int, const QJsonObject &)
+{
+    return false;
+}
+
+#endif
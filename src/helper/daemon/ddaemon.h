@@ -0,0 +1,103 @@
+#ifndef DDAEMON_H
+#define DDAEMON_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QThreadPool>
+#include <QAtomicInt>
+
+#include <helper/manager/dmanager.h>
+
+/**
+ * @brief Tryb demona: proces nasłuchuje na gnieździe Unix i wykonuje zlecone zadania zabezpieczania.
+ *
+ * Ustawienia, pamięć podręczna opisów (DFileCache), pamięć podręczna asemblera i wątki robocze
+ * pozostają załadowane między zadaniami, więc zadanie zaczyna się bez ponownego czytania opisów.
+ * Każde połączenie to jedno żądanie - obiekt JSON zakończony znakiem nowej linii:
+ *
+ * - {"cmd": "secure", "in": ..., "out": ..., "adding_method": "Trampoline", "method": ..., "handler": ...,
+ *   "change_x": false, "obfuscate": true, "placement": "extend" | "new-segment" | "huge-pages",
+ *   "profile": ..., "profile_build": ..., "seed": 0}
+ * - {"cmd": "stats"}
+ * - {"cmd": "shutdown"}
+ *
+ * Odpowiedzią są linie JSON: komunikaty zadania {"type": "log", "level": ..., "msg": ...} w trakcie
+ * jego wykonywania, a na końcu {"type": "result", "ok": ..., "ms": ...} lub {"type": "stats", ...}.
+ * Ścieżki plików muszą być bezwzględne - demon ma inny katalog roboczy niż klient.
+ */
+class DDaemon
+{
+public:
+    /**
+     * @brief Konstruktor.
+     * @param manager obiekt wykonujący zadania.
+     * @param socketPath ścieżka gniazda.
+     * @param workers liczba wątków roboczych, 0 oznacza liczbę rdzeni.
+     */
+    DDaemon(DManager &manager, const QString &socketPath, int workers = 0);
+
+    /**
+     * @brief Nasłuchuje i obsługuje połączenia do otrzymania polecenia shutdown.
+     * @return True jeżeli demon zakończył się poprawnie, False jeżeli nie udało się utworzyć gniazda.
+     */
+    bool run();
+
+    /**
+     * @brief Klient: wysyła żądanie do demona i przekazuje jego komunikaty do DLogger.
+     * @param socketPath ścieżka gniazda.
+     * @param request żądanie.
+     * @return Wynik zadania (pole ok odpowiedzi).
+     */
+    static bool submit(const QString &socketPath, const QJsonObject &request);
+
+private:
+    /**
+     * @brief Obsługuje jedno połączenie.
+     * @param fd deskryptor połączenia.
+     */
+    void handle(int fd);
+
+    /**
+     * @brief Wykonuje zadanie zabezpieczania, przesyłając jego komunikaty do klienta.
+     * @param fd deskryptor połączenia.
+     * @param request żądanie.
+     * @return Odpowiedź końcowa.
+     */
+    QJsonObject secure(int fd, const QJsonObject &request);
+
+    /**
+     * @brief Statystyki demona.
+     * @return Odpowiedź.
+     */
+    QJsonObject stats() const;
+
+    /**
+     * @brief Odczytuje jedną linię z gniazda.
+     * @param fd deskryptor.
+     * @param buffer dane odczytane, ale jeszcze nie zwrócone.
+     * @param line odczytana linia bez znaku nowej linii.
+     * @return True jeżeli odczytano linię, False po zamknięciu połączenia lub błędzie.
+     */
+    static bool readLine(int fd, QByteArray &buffer, QByteArray &line);
+
+    /**
+     * @brief Zapisuje obiekt JSON jako jedną linię.
+     * @param fd deskryptor.
+     * @param obj obiekt.
+     * @return True jeżeli zapis się powiódł.
+     */
+    static bool writeLine(int fd, const QJsonObject &obj);
+
+    class Connection;
+
+    DManager &manager;
+    QString socketPath;
+    QThreadPool pool;
+
+    QAtomicInt stopping;
+    QAtomicInt jobs;
+    QAtomicInt failed;
+};
+
+#endif // DDAEMON_H
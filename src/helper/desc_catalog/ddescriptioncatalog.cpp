@@ -0,0 +1,326 @@
+#include <helper/desc_catalog/ddescriptioncatalog.h>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QJsonDocument>
+#include <QCborValue>
+#include <QCborMap>
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QJsonParseError>
+#include <QStringList>
+
+#include <cstring>
+
+#include <helper/logger/dlogger.h>
+#include <helper/file_cache/dfilecache.h>
+#include <helper/settings_parser/dsettings.h>
+#include <core/file_types/codedefines.h>
+
+const char DDescriptionCatalog::magic[8] = { 'D', 'D', 'C', 'A', 'T', 'L', 'G', '\0' };
+
+DDescriptionCatalog::DDescriptionCatalog() :
+    entries(nullptr),
+    names(nullptr),
+    count(0)
+{
+    QString catalogPath = DSettings::getSettings().getDescriptionsCatalogPath();
+
+    if(!catalogPath.isEmpty() && QFile::exists(catalogPath) && !open(catalogPath))
+        LOG_WARN(QString("Descriptions catalog %1 is invalid, description files are used instead.").arg(catalogPath));
+}
+
+bool DDescriptionCatalog::open(const QString &catalogPath)
+{
+    file.reset(new MappedFile(catalogPath));
+    if(!file->isOpen())
+        return false;
+
+    content = file->getData();
+
+    if(static_cast<size_t>(content.size()) < sizeof(Header))
+        return false;
+
+    const Header *h = reinterpret_cast<const Header*>(content.constData());
+
+    if(std::memcmp(h->magic, magic, sizeof(magic)) || h->version != version ||
+            h->size != static_cast<quint32>(content.size()) ||
+            h->entries > h->size || (h->size - h->entries) / sizeof(Entry) < h->count ||
+            h->names > h->size)
+        return false;
+
+    const Entry *e = reinterpret_cast<const Entry*>(content.constData() + h->entries);
+    for(quint32 i = 0; i < h->count; ++i)
+    {
+        // Nazwy muszą być zakończone zerem, a dane mieścić się w pliku
+        if(e[i].name >= h->size - h->names || !std::memchr(content.constData() + h->names + e[i].name, 0, h->size - h->names - e[i].name) ||
+                e[i].offset > h->size || e[i].size > h->size - e[i].offset)
+            return false;
+    }
+
+    entries = e;
+    names = content.constData() + h->names;
+    count = h->count;
+
+    return true;
+}
+
+bool DDescriptionCatalog::isLoaded() const
+{
+    return entries != nullptr;
+}
+
+bool DDescriptionCatalog::find(Kind kind, const QString &path, QByteArray &data) const
+{
+    if(!isLoaded())
+        return false;
+
+    QByteArray key = QDir::cleanPath(path).toUtf8();
+    quint32 k = static_cast<quint32>(kind);
+
+    // Wpisy są posortowane po rodzaju, a następnie po nazwie
+    quint32 lo = 0, hi = count;
+    while(lo < hi)
+    {
+        quint32 mid = lo + (hi - lo) / 2;
+        int cmp = entries[mid].kind != k ? (entries[mid].kind < k ? -1 : 1) :
+                                           qstrcmp(names + entries[mid].name, key.constData());
+
+        if(cmp == 0)
+        {
+            if(!isCurrent(entries[mid]))
+                return false;
+
+            data = QByteArray::fromRawData(content.constData() + entries[mid].offset, entries[mid].size);
+            return true;
+        }
+
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return false;
+}
+
+QStringList DDescriptionCatalog::listDescriptions(const QString &dir) const
+{
+    QStringList files;
+
+    if(!isLoaded())
+        return files;
+
+    QByteArray prefix = QDir::cleanPath(dir).toUtf8().append('/');
+    quint32 k = static_cast<quint32>(Kind::Description);
+
+    // Pierwszy opis, którego nazwa nie jest mniejsza od prefiksu
+    quint32 lo = 0, hi = count;
+    while(lo < hi)
+    {
+        quint32 mid = lo + (hi - lo) / 2;
+
+        if(entries[mid].kind < k || (entries[mid].kind == k && qstrcmp(names + entries[mid].name, prefix.constData()) < 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    // Opisy z tego katalogu leżą obok siebie, pliki z podkatalogów są pomijane
+    for(quint32 i = lo; i < count && entries[i].kind == k; ++i)
+    {
+        const char *name = names + entries[i].name;
+
+        if(qstrncmp(name, prefix.constData(), prefix.size()) != 0)
+            break;
+
+        if(!std::strchr(name + prefix.size(), '/'))
+            files.append(QString::fromUtf8(name + prefix.size()));
+    }
+
+    return files;
+}
+
+bool DDescriptionCatalog::isCurrent(const Entry &e) const
+{
+    // Brak pliku nie unieważnia wpisu - katalog może zastępować pliki opisów
+    QFileInfo fi(QString::fromUtf8(names + e.name));
+    if(!fi.exists() || (static_cast<quint64>(fi.size()) == e.sourceSize &&
+                        fi.lastModified().toMSecsSinceEpoch() == e.sourceModified))
+        return true;
+
+    QMutexLocker locker(&staleMutex);
+    if(!stale.contains(e.name))
+    {
+        stale.insert(e.name);
+        LOG_WARN(QString("Descriptions catalog entry %1 is stale, the file is used instead. Rebuild the catalog with --build-catalog.")
+                 .arg(fi.filePath()));
+    }
+
+    return false;
+}
+
+bool DDescriptionCatalog::readDescription(const QString &path, QJsonObject &obj)
+{
+    QByteArray raw;
+
+    if(getCatalog().find(Kind::Description, path, raw))
+    {
+        QCborValue value = QCborValue::fromCbor(raw);
+        if(value.isMap())
+        {
+            obj = value.toMap().toJsonObject();
+            return true;
+        }
+    }
+
+    if(!DFileCache::getCache().read(path, raw))
+        return false;
+
+    QJsonParseError e;
+    QJsonDocument doc = QJsonDocument::fromJson(raw, &e);
+    if(e.error != QJsonParseError::NoError)
+        return false;
+
+    obj = doc.object();
+    return true;
+}
+
+bool DDescriptionCatalog::readCode(const QString &path, QByteArray &data)
+{
+    if(getCatalog().find(Kind::Code, path, data))
+        return true;
+
+    return DFileCache::getCache().read(path, data, QIODevice::ReadOnly | QIODevice::Text);
+}
+
+bool DDescriptionCatalog::addDirectory(const QString &dir, bool withCode, QMap<QPair<quint32, QByteArray>, Source> &files)
+{
+    static const QStringList codeKeys = { "path", "check_path", "rate_limit_path" };
+
+    QDir d(dir);
+    if(!d.exists())
+    {
+        LOG_ERROR(QString("Descriptions directory %1 does not exist.").arg(dir));
+        return false;
+    }
+
+    foreach(const QFileInfo &fi, d.entryInfoList(QStringList() << "*.json", QDir::Files, QDir::Name))
+    {
+        QFile f(fi.filePath());
+        if(!f.open(QFile::ReadOnly))
+        {
+            LOG_ERROR(QString("Cannot open description %1").arg(fi.filePath()));
+            return false;
+        }
+
+        QJsonParseError e;
+        QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &e);
+        f.close();
+
+        if(e.error != QJsonParseError::NoError || !doc.isObject())
+        {
+            LOG_ERROR(QString("Invalid description %1: %2").arg(fi.filePath()).arg(e.errorString()));
+            return false;
+        }
+
+        files.insert(qMakePair(static_cast<quint32>(Kind::Description), QDir::cleanPath(fi.filePath()).toUtf8()),
+                     Source { QCborValue::fromJsonValue(doc.object()).toCbor(), static_cast<quint64>(fi.size()),
+                              fi.lastModified().toMSecsSinceEpoch() });
+
+        if(!withCode)
+            continue;
+
+        QJsonObject obj = doc.object();
+        foreach(const QString &key, codeKeys)
+        {
+            QString codePath = obj[key].toString();
+            if(codePath.isEmpty())
+                continue;
+
+            QPair<quint32, QByteArray> name = qMakePair(static_cast<quint32>(Kind::Code), QDir::cleanPath(codePath).toUtf8());
+            if(files.contains(name))
+                continue;
+
+            QFile c(codePath);
+            if(!c.open(QFile::ReadOnly | QFile::Text))
+            {
+                LOG_ERROR(QString("Cannot open code %1 of description %2").arg(codePath).arg(fi.filePath()));
+                return false;
+            }
+
+            QFileInfo ci(codePath);
+            files.insert(name, Source { c.readAll(), static_cast<quint64>(ci.size()), ci.lastModified().toMSecsSinceEpoch() });
+            c.close();
+        }
+    }
+
+    return true;
+}
+
+bool DDescriptionCatalog::build(const QString &catalogPath)
+{
+    DSettings &settings = DSettings::getSettings();
+    QMap<QPair<quint32, QByteArray>, Source> files;
+
+    if(!addDirectory(settings.getDescriptionsPath<Registers_x86>(), true, files) ||
+            !addDirectory(settings.getDescriptionsPath<Registers_x64>(), true, files) ||
+            !addDirectory(settings.getDescriptionsSourcePath(), false, files))
+        return false;
+
+    QByteArray nameTable, entryTable, payload;
+    quint32 entriesOffset = sizeof(Header);
+    quint32 namesOffset = entriesOffset + files.size() * sizeof(Entry);
+
+    foreach(const auto &name, files.keys())
+        nameTable.append(name.second).append('\0');
+
+    quint32 dataOffset = namesOffset + nameTable.size();
+    quint32 nameOffset = 0;
+
+    for(auto it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        Entry e;
+        e.name = nameOffset;
+        e.kind = it.key().first;
+        e.offset = dataOffset + payload.size();
+        e.size = it.value().data.size();
+        e.sourceSize = it.value().size;
+        e.sourceModified = it.value().modified;
+
+        entryTable.append(reinterpret_cast<const char*>(&e), sizeof(e));
+        payload.append(it.value().data);
+
+        nameOffset += it.key().second.size() + 1;
+    }
+
+    Header h;
+    std::memcpy(h.magic, magic, sizeof(magic));
+    h.version = version;
+    h.count = files.size();
+    h.entries = entriesOffset;
+    h.names = namesOffset;
+    h.size = dataOffset + payload.size();
+    h.reserved = 0;
+
+    QByteArray out;
+    out.reserve(h.size);
+    out.append(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.append(entryTable);
+    out.append(nameTable);
+    out.append(payload);
+
+    // Zapis przez plik tymczasowy, więc działający proces nie zobaczy niepełnego katalogu
+    QSaveFile f(catalogPath);
+    if(!f.open(QFile::WriteOnly) || f.write(out) != out.size() || !f.commit())
+    {
+        LOG_ERROR(QString("Cannot write descriptions catalog %1").arg(catalogPath));
+        return false;
+    }
+
+    LOG_MSG(QString("Descriptions catalog %1: %2 entries, %3 bytes").arg(catalogPath).arg(h.count).arg(h.size));
+
+    return true;
+}
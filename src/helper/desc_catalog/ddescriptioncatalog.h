@@ -0,0 +1,174 @@
+#ifndef DDESCRIPTIONCATALOG_H
+#define DDESCRIPTIONCATALOG_H
+
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMap>
+#include <QPair>
+#include <QScopedPointer>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+#include <core/file_types/mappedfile.h>
+
+/**
+ * @brief Skompilowany katalog opisów metod: wszystkie pliki JSON opisów i kod .asm, do którego się
+ * odwołują, w jednym pliku wczytywanym przez mmap.
+ *
+ * Opisy są zapisane w formacie CBOR, więc nie jest parsowany tekst JSON, a kod wskazuje
+ * bezpośrednio na zmapowaną pamięć. Format pliku: nagłówek (Header), posortowana tablica wpisów
+ * (Entry), tablica nazw zakończonych zerem i dane wpisów. Liczby są zapisane w kolejności bajtów
+ * maszyny budującej.
+ *
+ * Nazwą wpisu jest ścieżka pliku w postaci, w jakiej odwołują się do niej ustawienia i opisy
+ * (po QDir::cleanPath). Każdy wpis pamięta rozmiar i czas modyfikacji pliku źródłowego - jeżeli
+ * plik istnieje i się zmienił, wpis jest nieaktualny i plik jest czytany z dysku (z ostrzeżeniem,
+ * że katalog trzeba zbudować ponownie przez dDeflect --build-catalog). Jeżeli katalog nie jest
+ * skonfigurowany, nie istnieje lub ma inną wersję, pliki są czytane z dysku jak wcześniej.
+ */
+class DDescriptionCatalog
+{
+public:
+    /**
+     * @brief Rodzaj wpisu.
+     */
+    enum class Kind
+    {
+        Description = 1,
+        Code
+    };
+
+    /**
+     * @brief Wersja formatu, zmieniana przy każdej niezgodnej zmianie pliku.
+     */
+    static const quint32 version = 2;
+
+    /**
+     * @brief Katalog wskazany w ustawieniach (desc_catalog_path), otwierany przy pierwszym użyciu.
+     * @return Katalog.
+     */
+    static DDescriptionCatalog &getCatalog()
+    {
+        static DDescriptionCatalog c;
+        return c;
+    }
+
+    /**
+     * @brief Kompiluje katalog z katalogów opisów wskazanych w ustawieniach.
+     * @param catalogPath ścieżka pliku wynikowego.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool build(const QString &catalogPath);
+
+    /**
+     * @brief Odczytuje opis, z katalogu jeżeli go zawiera, w innym przypadku z pliku.
+     * @param path ścieżka pliku opisu.
+     * @param obj wczytany opis.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool readDescription(const QString &path, QJsonObject &obj);
+
+    /**
+     * @brief Odczytuje kod metody, z katalogu jeżeli go zawiera, w innym przypadku z pliku.
+     * @param path ścieżka pliku z kodem.
+     * @param data kod.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool readCode(const QString &path, QByteArray &data);
+
+    /**
+     * @brief Sprawdza czy katalog został wczytany.
+     * @return True jeżeli katalog jest dostępny, False w innych przypadkach.
+     */
+    bool isLoaded() const;
+
+    /**
+     * @brief Wyszukuje wpis w katalogu.
+     * @param kind rodzaj wpisu.
+     * @param path ścieżka pliku.
+     * @param data dane wpisu wskazujące na zmapowaną pamięć.
+     * @return True jeżeli katalog zawiera aktualny wpis, False w innych przypadkach.
+     */
+    bool find(Kind kind, const QString &path, QByteArray &data) const;
+
+    /**
+     * @brief Zwraca nazwy plików opisów z podanego katalogu, zapisanych w katalogu opisów.
+     * @param dir katalog opisów.
+     * @return Posortowane nazwy plików (bez ścieżki), puste jeżeli katalog nie jest wczytany.
+     */
+    QStringList listDescriptions(const QString &dir) const;
+
+private:
+    DDescriptionCatalog();
+    DDescriptionCatalog(const DDescriptionCatalog &) = delete;
+
+    typedef struct _Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 count;
+        quint32 entries;
+        quint32 names;
+        quint32 size;
+        quint32 reserved;
+    } Header;
+
+    typedef struct _Entry
+    {
+        quint32 name;
+        quint32 kind;
+        quint32 offset;
+        quint32 size;
+        quint64 sourceSize;
+        qint64 sourceModified;
+    } Entry;
+
+    /**
+     * @brief Dane wpisu budowanego katalogu i stan pliku źródłowego.
+     */
+    typedef struct _Source
+    {
+        QByteArray data;
+        quint64 size;
+        qint64 modified;
+    } Source;
+
+    static const char magic[8];
+
+    /**
+     * @brief Otwiera i sprawdza plik katalogu.
+     * @param catalogPath ścieżka katalogu.
+     * @return True jeżeli katalog jest poprawny, False w innych przypadkach.
+     */
+    bool open(const QString &catalogPath);
+
+    /**
+     * @brief Sprawdza czy plik źródłowy wpisu nie zmienił się od zbudowania katalogu.
+     * @param e wpis.
+     * @return True jeżeli wpis jest aktualny lub plik nie istnieje, False w innych przypadkach.
+     */
+    bool isCurrent(const Entry &e) const;
+
+    /**
+     * @brief Dodaje do budowanego katalogu wszystkie opisy z podanego katalogu.
+     * @param dir katalog opisów.
+     * @param withCode True jeżeli mają być dodane również pliki z kodem, do których odwołują się opisy.
+     * @param files wpisy budowanego katalogu.
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    static bool addDirectory(const QString &dir, bool withCode, QMap<QPair<quint32, QByteArray>, Source> &files);
+
+    QScopedPointer<MappedFile> file;
+    QByteArray content;
+
+    const Entry *entries;
+    const char *names;
+    quint32 count;
+
+    mutable QMutex staleMutex;
+    mutable QSet<quint32> stale;
+};
+
+#endif // DDESCRIPTIONCATALOG_H
@@ -0,0 +1,75 @@
+#include <helper/file_cache/dfilecache.h>
+
+#include <QFile>
+#include <QFileInfo>
+
+DFileCache::DFileCache() :
+    enabled(false),
+    hits(0),
+    misses(0)
+{
+}
+
+bool DFileCache::read(const QString &path, QByteArray &data, QIODevice::OpenMode mode)
+{
+    QFileInfo fi(path);
+    QString key = QString::number(static_cast<int>(mode)) + ":" + fi.absoluteFilePath();
+
+    if(enabled)
+    {
+        QMutexLocker lock(&mutex);
+        QHash<QString, Entry>::const_iterator it = entries.constFind(key);
+
+        if(it != entries.constEnd() && it->size == fi.size() && it->modified == fi.lastModified())
+        {
+            data = it->data;
+            hits.ref();
+            return true;
+        }
+    }
+
+    QFile f(path);
+    if(!f.open(mode | QIODevice::ReadOnly))
+        return false;
+
+    data = f.readAll();
+    f.close();
+
+    if(enabled)
+    {
+        Entry e;
+        e.modified = fi.lastModified();
+        e.size = fi.size();
+        e.data = data;
+
+        QMutexLocker lock(&mutex);
+        entries.insert(key, e);
+        misses.ref();
+    }
+
+    return true;
+}
+
+void DFileCache::setEnabled(bool enable)
+{
+    QMutexLocker lock(&mutex);
+
+    enabled = enable;
+    if(!enabled)
+        entries.clear();
+}
+
+bool DFileCache::isEnabled() const
+{
+    return enabled;
+}
+
+int DFileCache::getHits() const
+{
+    return hits.load();
+}
+
+int DFileCache::getMisses() const
+{
+    return misses.load();
+}
@@ -0,0 +1,66 @@
+#ifndef DFILECACHE_H
+#define DFILECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QDateTime>
+#include <QIODevice>
+#include <QAtomicInt>
+
+/**
+ * @brief Pamięć podręczna zawartości plików opisów (JSON, kod .asm) dla procesów obsługujących wiele zadań.
+ *
+ * Wpis jest ważny, dopóki rozmiar i czas modyfikacji pliku się nie zmieniły, więc edycja opisu
+ * jest widoczna w kolejnym zadaniu bez restartu. Domyślnie wyłączona - pojedyncze wywołanie
+ * programu czyta każdy plik raz, a w trybie demona pliki są czytane tylko przy pierwszym zadaniu.
+ */
+class DFileCache
+{
+private:
+    DFileCache();
+    DFileCache(const DFileCache &) = delete;
+
+    typedef struct _Entry
+    {
+        QDateTime modified;
+        qint64 size;
+        QByteArray data;
+    } Entry;
+
+    QHash<QString, Entry> entries;
+    QMutex mutex;
+    bool enabled;
+
+    QAtomicInt hits;
+    QAtomicInt misses;
+
+public:
+    static DFileCache &getCache()
+    {
+        static DFileCache c;
+        return c;
+    }
+
+    /**
+     * @brief Metoda odczytująca zawartość pliku, z pamięci podręcznej jeżeli plik się nie zmienił.
+     * @param path ścieżka pliku.
+     * @param data zawartość pliku.
+     * @param mode tryb otwarcia pliku (np. QIODevice::Text).
+     * @return True jeżeli operacja się powiodła, False w innych przypadkach.
+     */
+    bool read(const QString &path, QByteArray &data, QIODevice::OpenMode mode = QIODevice::ReadOnly);
+
+    /**
+     * @brief Metoda włączająca lub wyłączająca pamięć podręczną. Wyłączenie usuwa wpisy.
+     * @param enable True jeżeli pamięć podręczna ma być używana.
+     */
+    void setEnabled(bool enable);
+
+    bool isEnabled() const;
+    int getHits() const;
+    int getMisses() const;
+};
+
+#endif // DFILECACHE_H
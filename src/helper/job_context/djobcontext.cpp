@@ -0,0 +1,129 @@
+#include <helper/job_context/djobcontext.h>
+
+#include <chrono>
+
+#include <core/file_types/codedefines.h>
+#include <helper/settings_parser/dsettings.h>
+
+thread_local DJobContext *DJobContext::active = nullptr;
+
+DJobContext::DJobContext(uint64_t seed) :
+    seed(seed ? seed : std::chrono::system_clock::now().time_since_epoch().count()),
+    gen(this->seed),
+    assembler(DSettings::getSettings().getAssembler()),
+    nasmPath(DSettings::getSettings().getNasmPath()),
+    assemblerCachePath(DSettings::getSettings().getAssemblerCachePath()),
+    assemblerCacheSize(DSettings::getSettings().getAssemblerCacheSize()),
+    disassemblerThreads(DSettings::getSettings().getDisassemblerThreads()),
+    upxPath(DSettings::getSettings().getUpxPath()),
+    descriptionsPath_x86(DSettings::getSettings().getDescriptionsPath<Registers_x86>()),
+    descriptionsPath_x64(DSettings::getSettings().getDescriptionsPath<Registers_x64>())
+{
+}
+
+uint64_t DJobContext::getSeed() const
+{
+    return seed;
+}
+
+uint64_t DJobContext::nextSeed()
+{
+    std::uniform_int_distribution<uint64_t> dist;
+    return dist(gen);
+}
+
+std::default_random_engine &DJobContext::getGenerator()
+{
+    return gen;
+}
+
+QStack<uint64_t> &DJobContext::getRegisterSeeds()
+{
+    return registerSeeds;
+}
+
+QString DJobContext::getScratchPath()
+{
+    if(!scratch)
+        scratch.reset(new QTemporaryDir());
+
+    return scratch->isValid() ? scratch->path() : QString();
+}
+
+const QString &DJobContext::getAssembler() const
+{
+    return assembler;
+}
+
+const QString &DJobContext::getNasmPath() const
+{
+    return nasmPath;
+}
+
+const QString &DJobContext::getAssemblerCachePath() const
+{
+    return assemblerCachePath;
+}
+
+int DJobContext::getAssemblerCacheSize() const
+{
+    return assemblerCacheSize;
+}
+
+int DJobContext::getDisassemblerThreads() const
+{
+    return disassemblerThreads;
+}
+
+const QString &DJobContext::getUpxPath() const
+{
+    return upxPath;
+}
+
+template <>
+const QString &DJobContext::getDescriptionsPath<Registers_x86>() const
+{
+    return descriptionsPath_x86;
+}
+
+template <>
+const QString &DJobContext::getDescriptionsPath<Registers_x64>() const
+{
+    return descriptionsPath_x64;
+}
+
+void DJobContext::setLogSink(DJobContext::LogSink sink)
+{
+    this->sink = sink;
+}
+
+const DJobContext::LogSink &DJobContext::getLogSink() const
+{
+    return sink;
+}
+
+DJobContext &DJobContext::current()
+{
+    if(active)
+        return *active;
+
+    // Kod wywołany poza zadaniem (GUI, testy) dostaje osobny kontekst dla każdego wątku
+    thread_local DJobContext threadContext;
+    return threadContext;
+}
+
+DJobContext *DJobContext::bound()
+{
+    return active;
+}
+
+DJobContext::Scope::Scope(DJobContext &context) :
+    previous(active)
+{
+    active = &context;
+}
+
+DJobContext::Scope::~Scope()
+{
+    active = previous;
+}
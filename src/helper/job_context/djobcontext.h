@@ -0,0 +1,171 @@
+#ifndef DJOBCONTEXT_H
+#define DJOBCONTEXT_H
+
+#include <QString>
+#include <QStack>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <functional>
+#include <random>
+
+#include <helper/logger/dlogger.h>
+
+/**
+ * @brief Kontekst pojedynczego zadania zabezpieczania pliku.
+ *
+ * Przechowuje stan, który wcześniej był globalny: generator liczb losowych, stos seedów
+ * kolejności zapisu rejestrów, katalog plików tymczasowych, kopię ustawień z chwili utworzenia
+ * zadania oraz odbiorcę komunikatów. Kontekst jest przypinany do wątku na czas zadania
+ * (DJobContext::Scope), dzięki czemu kilka zadań może działać jednocześnie w jednym procesie.
+ * Ten sam seed daje ten sam wynik niezależnie od liczby równoległych zadań.
+ */
+class DJobContext
+{
+public:
+    /**
+     * @brief Odbiorca komunikatów zadania.
+     */
+    typedef std::function<void(DLogger::Type, QString)> LogSink;
+
+    /**
+     * @brief Konstruktor.
+     * @param seed seed generatora liczb losowych, 0 oznacza seed z bieżącego czasu.
+     */
+    explicit DJobContext(uint64_t seed = 0);
+
+    DJobContext(const DJobContext &) = delete;
+
+    /**
+     * @brief Seed, którym zainicjalizowano generator zadania.
+     * @return Seed.
+     */
+    uint64_t getSeed() const;
+
+    /**
+     * @brief Losuje seed dla generatora obiektu tworzonego w ramach zadania.
+     * @return Seed.
+     */
+    uint64_t nextSeed();
+
+    /**
+     * @brief Generator liczb losowych zadania.
+     * @return Generator.
+     */
+    std::default_random_engine &getGenerator();
+
+    /**
+     * @brief Stos seedów kolejności zapisu rejestrów (CodeDefines::saveAll / restoreAll).
+     * @return Stos seedów.
+     */
+    QStack<uint64_t> &getRegisterSeeds();
+
+    /**
+     * @brief Katalog plików tymczasowych zadania, tworzony przy pierwszym użyciu i usuwany razem z kontekstem.
+     * @return Ścieżka katalogu, pusta jeżeli nie udało się go utworzyć.
+     */
+    QString getScratchPath();
+
+    /**
+     * @brief Nazwa asemblera z ustawień w chwili utworzenia zadania.
+     * @return Nazwa asemblera.
+     */
+    const QString &getAssembler() const;
+
+    /**
+     * @brief Ścieżka do nasm z ustawień w chwili utworzenia zadania.
+     * @return Ścieżka.
+     */
+    const QString &getNasmPath() const;
+
+    /**
+     * @brief Katalog pamięci podręcznej asemblera z ustawień w chwili utworzenia zadania.
+     * @return Ścieżka.
+     */
+    const QString &getAssemblerCachePath() const;
+
+    /**
+     * @brief Rozmiar pamięci podręcznej asemblera (w MB) z ustawień w chwili utworzenia zadania.
+     * @return Rozmiar.
+     */
+    int getAssemblerCacheSize() const;
+
+    /**
+     * @brief Liczba wątków dekodera instrukcji z ustawień w chwili utworzenia zadania.
+     * @return Liczba wątków, 0 oznacza liczbę rdzeni.
+     */
+    int getDisassemblerThreads() const;
+
+    /**
+     * @brief Ścieżka do upx z ustawień w chwili utworzenia zadania.
+     * @return Ścieżka.
+     */
+    const QString &getUpxPath() const;
+
+    /**
+     * @brief Katalog opisów metod z ustawień w chwili utworzenia zadania.
+     * @return Ścieżka.
+     */
+    template <typename Register>
+    const QString &getDescriptionsPath() const;
+
+    /**
+     * @brief Ustawia odbiorcę komunikatów zadania. Komunikaty zadania nie trafiają wtedy do DLogger.
+     * @param sink odbiorca komunikatów, pusty przywraca DLogger.
+     */
+    void setLogSink(LogSink sink);
+
+    /**
+     * @brief Odbiorca komunikatów zadania.
+     * @return Odbiorca, pusty jeżeli komunikaty trafiają do DLogger.
+     */
+    const LogSink &getLogSink() const;
+
+    /**
+     * @brief Kontekst przypięty do bieżącego wątku, a gdy go nie ma - domyślny kontekst wątku.
+     * @return Kontekst.
+     */
+    static DJobContext &current();
+
+    /**
+     * @brief Kontekst przypięty do bieżącego wątku.
+     * @return Kontekst lub nullptr, jeżeli żaden kontekst nie jest przypięty.
+     */
+    static DJobContext *bound();
+
+    /**
+     * @brief Przypina kontekst do bieżącego wątku na czas życia obiektu.
+     */
+    class Scope
+    {
+    public:
+        explicit Scope(DJobContext &context);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+
+    private:
+        DJobContext *previous;
+    };
+
+private:
+    uint64_t seed;
+    std::default_random_engine gen;
+    QStack<uint64_t> registerSeeds;
+
+    QScopedPointer<QTemporaryDir> scratch;
+
+    QString assembler;
+    QString nasmPath;
+    QString assemblerCachePath;
+    int assemblerCacheSize;
+    int disassemblerThreads;
+    QString upxPath;
+    QString descriptionsPath_x86;
+    QString descriptionsPath_x64;
+
+    LogSink sink;
+
+    static thread_local DJobContext *active;
+};
+
+#endif // DJOBCONTEXT_H
@@ -1,4 +1,5 @@
 #include <helper/logger/dlogger.h>
+#include <helper/desc_catalog/ddescriptioncatalog.h>
 #include <helper/src_code_desc/sourcecodedescription.h>
 #include <helper/json_parser/djsonparser.h>
 
@@ -29,18 +30,12 @@ DJsonParser::DJsonParser()
 DJsonParser::DJsonParser(QString path) : m_path(path) {}
 
  bool DJsonParser::loadSourceCodeDescription(QString name, SourceCodeDescription &scd) {
-    QFile loadFile(m_path + name);
-
-    if (!loadFile.open(QIODevice::ReadOnly)) {
+    QJsonObject obj;
+    if (!DDescriptionCatalog::readDescription(m_path + name, obj)) {
         LOG_ERROR("Cannot open json file.");
         return false;
     }
 
-    QByteArray saveData = loadFile.readAll();
-
-    QJsonDocument loadDoc(QJsonDocument::fromJson(saveData));
-    QJsonObject obj = loadDoc.object();
-
     return scd.read(obj);
 }
 
@@ -52,18 +47,12 @@ DJsonParser::DJsonParser(QString path) : m_path(path) {}
 template <typename Register>
 Wrapper<Register> *DJsonParser::loadInjectDescription(QString name)
 {
-    QFile loadFile(m_path + name);
-
-    if (!loadFile.open(QIODevice::ReadOnly)) {
+    QJsonObject obj;
+    if (!DDescriptionCatalog::readDescription(m_path + name, obj)) {
         LOG_ERROR("Cannot open json file.");
         return nullptr;
     }
 
-    QByteArray saveData = loadFile.readAll();
-
-    QJsonDocument loadDoc(QJsonDocument::fromJson(saveData));
-    QJsonObject obj = loadDoc.object();
-
     Wrapper<Register> *p = nullptr;
     QString typeStr = obj["type"].toString();
     typename Wrapper<Register>::WrapperType type = Wrapper<Register>::wrapperTypes[typeStr];
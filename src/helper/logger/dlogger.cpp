@@ -1,5 +1,7 @@
 #include "dlogger.h"
 
+#include <helper/job_context/djobcontext.h>
+
 DLogger::DLogger()
 {
 }
@@ -12,18 +14,31 @@ DLogger &DLogger::getLogger()
 
 void DLogger::write(DLogger::Type type, QString msg)
 {
+    // Komunikaty zadania z własnym odbiorcą nie trafiają do wspólnych callbacków
+    DJobContext *job = DJobContext::bound();
+    if(job && job->getLogSink())
+    {
+        job->getLogSink()(type, msg);
+        return;
+    }
+
     DLogger &log = getLogger();
 
-    if(log.callbacks.contains(type))
+    // Kopia listy, callback może sam zapisać komunikat
+    QList<std::function<void(QString)>> cbks;
     {
-        foreach(auto cbk, log.callbacks[type])
-            cbk(msg);
+        QMutexLocker lock(&log.mutex);
+        cbks = log.callbacks.value(type);
     }
+
+    foreach(auto cbk, cbks)
+        cbk(msg);
 }
 
 void DLogger::registerCallback(QList<DLogger::Type> types, std::function<void (QString)> f)
 {
     DLogger &log = getLogger();
+    QMutexLocker lock(&log.mutex);
 
     foreach(auto t, types)
         log.callbacks[t].append(f);
@@ -3,6 +3,8 @@
 
 #include <QString>
 #include <QMap>
+#include <QMutex>
+#include <functional>
 
 class DLogger
 {
@@ -23,6 +25,7 @@ private:
     static DLogger &getLogger();
 
     QMap<Type, QList<std::function<void(QString)>>> callbacks;
+    QMutex mutex;
 };
 
 #define LOG_ERROR(msg) DLogger::write(DLogger::Type::Error, msg)
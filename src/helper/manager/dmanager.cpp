@@ -1,7 +1,10 @@
 #include <helper/manager/dmanager.h>
 #include <helper/logger/dlogger.h>
+#include <helper/job_context/djobcontext.h>
 #include <core/file_types/elffile.h>
 #include <core/file_types/pefile.h>
+#include <core/file_types/mappedfile.h>
+#include <QScopedPointer>
 
 template <typename RegistersType>
 bool DManager::__get_descriptions() {
@@ -17,6 +20,18 @@ template bool DManager::__get_descriptions<Registers_x64>();
 bool DManager::__secure_elf(const QByteArray &data, const DManager::secured_file_info &sfi) {
   ELF elf(data);
 
+  switch (sfi.get_placement()) {
+    case PlacementType::NewSegment:
+      elf.set_placement(ELF::Placement::NewSegment);
+      break;
+    case PlacementType::HugePageSegment:
+      elf.set_placement(ELF::Placement::HugePageSegment);
+      break;
+    default:
+      elf.set_placement(ELF::Placement::ExtendSegment);
+      break;
+  }
+
   if(elf.is_x64()) {
       /*
       ss = test_one_ex<Registers_x64>(&elf, type, method, handler, x, obfuscate);
@@ -26,7 +41,7 @@ bool DManager::__secure_elf(const QByteArray &data, const DManager::secured_file
         return false;
       */
       // TODO: add error codes
-      return __secure_elf<Registers_x64>(&elf, sfi);
+      return __secure_elf<Registers_x64>(&elf, sfi) && __save(elf, sfi);
   }
 
 
@@ -38,7 +53,7 @@ bool DManager::__secure_elf(const QByteArray &data, const DManager::secured_file
       if (ss != SecuredState::SECURED)
         return false;
       */
-      return __secure_elf<Registers_x86>(&elf, sfi);
+      return __secure_elf<Registers_x86>(&elf, sfi) && __save(elf, sfi);
   }
 
 
@@ -47,34 +62,71 @@ bool DManager::__secure_elf(const QByteArray &data, const DManager::secured_file
   return false;
 }
 
+bool DManager::__save(BinaryFile &bin, const DManager::secured_file_info &sfi) {
+  if (sfi.get_output_file_name().isEmpty())
+    return true;
+
+  // only changed ranges are written, the rest is cloned from the input file
+  return bin.writeToFile(sfi.get_output_file_name(), sfi.get_file_name());
+}
+
 template <typename RegistersType>
 bool DManager::__secure_elf(ELF *elf, const DManager::secured_file_info &sfi) {
 
-  json_parser.setPath(settings.getDescriptionsPath<RegistersType>());
+  // parser per call, secure() may run for several files at once
+  DJsonParser json_parser(settings.getDescriptionsPath<RegistersType>());
 
   ELFAddingMethods<RegistersType> adder(elf);
 
+  if (!sfi.get_profile().isEmpty()) {
+    CallSiteProfile profile;
+    if (!profile.load(sfi.get_profile()))
+      return false;
+    adder.setProfile(profile);
+  }
+
+  adder.setProfileBuild(sfi.get_profile_build());
+
+  // every calling method of the same kind uses one wrapper description per architecture
+  static const QMap<AddingMethodType, QString> wrappers = {
+    { AddingMethodType::OEP,        "oepwrapper" },
+    { AddingMethodType::Thread,     "threadwrapper" },
+    { AddingMethodType::Trampoline, "trampolinewrapper" },
+    { AddingMethodType::INIT,       "trampolinewrapper" },
+    { AddingMethodType::INIT_ARRAY, "trampolinewrapper" },
+    { AddingMethodType::CTORS,      "trampolinewrapper" }
+  };
+
+  QString wrapper_name = QString("lin_%1_%2").arg(elf->is_x86() ? "x86" : "x64").arg(wrappers[sfi.get_adding_method()]);
+
   Wrapper<RegistersType> *meth = json_parser.loadInjectDescription<RegistersType>(QString("%1.json").arg(sfi.get_dd_method()));
-  Wrapper<RegistersType> *wrapper = nullptr; //TODO: cahnge // json_parser.loadInjectDescription<RegistersType>(); elf->is_x86() ? wrappers_x86[type] : wrappers_x64[type])
+  Wrapper<RegistersType> *wrapper = json_parser.loadInjectDescription<RegistersType>(QString("%1.json").arg(wrapper_name));
 
   if (!meth) {
-    LOG_ERROR(QString("Specified debugger detection method %s is absent").arg(sfi.get_dd_method()));
+    LOG_ERROR(QString("Specified debugger detection method %1 is absent").arg(sfi.get_dd_method()));
+    delete wrapper;
     return false;
   }
 
   if (!wrapper) {
-    LOG_ERROR(QString("Specified wrapper method %s is absent").arg(""));
+    LOG_ERROR(QString("Specified wrapper method %1 is absent").arg(wrapper_name));
+    delete meth;
     return false;
   }
 
+  // method and wrapper are released on every return
+  QScopedPointer<Wrapper<RegistersType>> meth_guard(meth), wrapper_guard(wrapper);
+
   // set detection handler
   wrapper->detect_handler = json_parser.loadInjectDescription<RegistersType>(QString("%1.json").arg(sfi.get_dd_handler()));
 
   if (!wrapper->detect_handler) {
-    LOG_ERROR(QString("Specified debugger detection handler %s is absent").arg(sfi.get_dd_handler()));
+    LOG_ERROR(QString("Specified debugger detection handler %1 is absent").arg(sfi.get_dd_handler()));
     return false;
   }
 
+  QScopedPointer<Wrapper<RegistersType>> handler_guard(wrapper->detect_handler);
+
   // TODO: wtf???
   wrapper->ret = meth->ret;
 
@@ -107,8 +159,8 @@ bool DManager::__secure_elf(ELF *elf, const DManager::secured_file_info &sfi) {
         LOG_ERROR("Error");
         return false;
       }
-      break;
       tramp_wrapper->tramp_action = meth;
+      break;
     }
     default:
       LOG_ERROR("Error");
@@ -129,21 +181,13 @@ bool DManager::__secure_elf(ELF *elf, const DManager::secured_file_info &sfi) {
 
   QList<typename DAddingMethods<RegistersType>::InjectDescription*> ids = { &id };
 
-  LOG_MSG(QString("Secure using wrapper: %1 \n\tmethod: %2\n\thandler: %3").arg(elf->is_x86() ? "" : "", sfi.get_dd_method(), sfi.get_dd_handler()));
+  LOG_MSG(QString("Secure using wrapper: %1 \n\tmethod: %2\n\thandler: %3").arg(wrapper_name, sfi.get_dd_method(), sfi.get_dd_handler()));
 
   bool s = adder.secure(ids);
   if (sfi.get_obfuscate())
     // TODO: specify params
     s &= adder.obfuscate(5, 10, 20);
 
-  if (!meth->detect_handler) {
-    delete meth->detect_handler;
-    meth->detect_handler = nullptr;
-  }
-
-  delete meth;
-  meth = nullptr;
-
   return s;
 }
 template bool DManager::__secure_elf<Registers_x86>(ELF *elf, const DManager::secured_file_info &sfi);
@@ -151,7 +195,8 @@ template bool DManager::__secure_elf<Registers_x64>(ELF *elf, const DManager::se
 
 bool DManager::__secure_pe(const QByteArray &data, const DManager::secured_file_info &sfi) {
   // TODO: fill
-  return true;
+  LOG_ERROR(QString("Securing PE files is not implemented yet: %1").arg(sfi.get_file_name()));
+  return false;
 }
 
 DManager::DManager():
@@ -188,20 +233,29 @@ template bool DManager::__secure_pe<Registers_x86>(PEFile *pe, const DManager::s
 template bool DManager::__secure_pe<Registers_x64>(PEFile *pe, const DManager::secured_file_info &sfi);
 
 bool DManager::secure(const DManager::secured_file_info &sfi) {
+  // every secured file has its own random generator and scratch directory,
+  // so several files can be secured at once and a seed reproduces the output;
+  // a caller which already runs the file as a job (daemon) keeps its context
+  QScopedPointer<DJobContext> own;
+  if (!DJobContext::bound())
+    own.reset(new DJobContext(sfi.get_seed()));
+  DJobContext::Scope scope(own ? *own : *DJobContext::bound());
+
   // check file type
-  QFile in(sfi.get_file_name());
-  if(!in.open(QFile::ReadOnly)) {
+  MappedFile in(sfi.get_file_name());
+  if(!in.isOpen()) {
       LOG_ERROR(QString("Could not open specified file: %s").arg(sfi.get_file_name()));
       return false;
   }
 
-  // read whole file content
-  QByteArray data = in.readAll(); // is passed as parameter to avoid race condition
+  // file content is not copied until it is modified
+  QByteArray data = in.getData(); // is passed as parameter to avoid race condition
 
   // TODO: change and save file
   bool s;
   // check if ELF / PE type
-  if (ELF(data).is_valid()) {
+  switch (BinaryFile::detectFormat(data)) {
+  case BinaryFile::Format::ELF:
     s = __secure_elf(data, sfi);
     if (!s) {
       LOG_WARN("Secure failed");
@@ -209,9 +263,11 @@ bool DManager::secure(const DManager::secured_file_info &sfi) {
     }
 
     return s;
-  }
-  if (PEFile(data).is_valid())
+  case BinaryFile::Format::PE:
     return __secure_pe(data, sfi);
+  default:
+    break;
+  }
 
   LOG_ERROR(QString("Specified file %s is non-ELF neither non-PE").arg(sfi.get_file_name()));
   return false;
@@ -225,6 +281,14 @@ void DManager::secured_file_info::set_file_name(const QString &value) {
   file_name = value;
 }
 
+QString DManager::secured_file_info::get_output_file_name() const {
+  return output_file_name;
+}
+
+void DManager::secured_file_info::set_output_file_name(const QString &value) {
+  output_file_name = value;
+}
+
 DManager::AddingMethodType DManager::secured_file_info::get_adding_method() const {
   return adding_method;
 }
@@ -273,3 +337,39 @@ void DManager::secured_file_info::set_pack(bool value) {
   pack = value;
 }
 
+QString DManager::secured_file_info::get_profile() const {
+  return profile;
+}
+
+void DManager::secured_file_info::set_profile(const QString &value) {
+  profile = value;
+}
+
+QString DManager::secured_file_info::get_profile_build() const {
+  return profile_build;
+}
+
+void DManager::secured_file_info::set_profile_build(const QString &value) {
+  profile_build = value;
+}
+
+DManager::PlacementType DManager::secured_file_info::get_placement() const {
+  return placement;
+}
+
+void DManager::secured_file_info::set_placement(const PlacementType &value) {
+  placement = value;
+}
+
+quint64 DManager::secured_file_info::get_seed() const {
+  return seed;
+}
+
+void DManager::secured_file_info::set_seed(quint64 value) {
+  seed = value;
+}
+
+bool DManager::heat_report(const QString &dump) const {
+  return CallSiteProfile::heatReport(dump);
+}
+
@@ -20,20 +20,33 @@ public:
       CTORS
   };
 
+  enum class PlacementType {
+      ExtendSegment = 0,
+      NewSegment,
+      HugePageSegment
+  };
+
   class secured_file_info {
     QString file_name;
+    QString output_file_name;
     AddingMethodType adding_method;
     QString dd_method;
     QString dd_handler;
     bool change_x;
     bool obfuscate;
     bool pack;
+    QString profile;
+    QString profile_build;
+    PlacementType placement;
+    quint64 seed;
   public:
     secured_file_info() :
-      change_x(true), obfuscate(false), pack(false) {}
+      change_x(true), obfuscate(false), pack(false), placement(PlacementType::ExtendSegment), seed(0) {}
 
     QString get_file_name() const;
     void set_file_name(const QString &value);
+    QString get_output_file_name() const;
+    void set_output_file_name(const QString &value);
     AddingMethodType get_adding_method() const;
     void set_adding_method(const AddingMethodType &value);
     QString get_dd_method() const;
@@ -46,6 +59,14 @@ public:
     void set_obfuscate(bool value);
     bool get_pack() const;
     void set_pack(bool value);
+    QString get_profile() const;
+    void set_profile(const QString &value);
+    QString get_profile_build() const;
+    void set_profile_build(const QString &value);
+    PlacementType get_placement() const;
+    void set_placement(const PlacementType &value);
+    quint64 get_seed() const;
+    void set_seed(quint64 value);
   };
 
   DManager();
@@ -55,6 +76,8 @@ public:
   void show_ddmethods() const;
   void show_ddhandlers() const;
   void show_adding_methods() const;
+
+  bool heat_report(const QString &dump) const;
 private:
   enum class OS {
     NONE,
@@ -88,6 +111,7 @@ private:
 
   bool __secure_elf(const QByteArray &data, const secured_file_info &sfi);
   bool __secure_pe(const QByteArray &data, const secured_file_info &sfi);
+  bool __save(BinaryFile &bin, const secured_file_info &sfi);
 
   template <typename RegistersType>
   bool __secure_elf(ELF *elf, const secured_file_info &sfi);
@@ -8,7 +8,9 @@
 
 const QString DSettings::file_name = "settings.json";
 
-DSettings::DSettings()
+DSettings::DSettings() :
+    assemblerCacheSize(64),
+    disassemblerThreads(0)
 {
     _loaded = load();
 }
@@ -37,10 +39,15 @@ bool DSettings::load()
     QJsonObject settings = doc.object();
 
     nasmPath = settings["nasm_path"].toString();
+    assembler = settings["assembler"].toString("native");
+    assemblerCachePath = settings["assembler_cache_path"].toString();
+    assemblerCacheSize = settings["assembler_cache_size"].toInt(64);
+    disassemblerThreads = settings["disassembler_threads"].toInt(0);
     ndisasmPath = settings["ndisasm_path"].toString();
     descriptionsPath_x86 = settings["desc_x86_path"].toString();
     descriptionsPath_x64 = settings["desc_x64_path"].toString();
     descriptionsPath_src = settings["desc_src_path"].toString();
+    descriptionsCatalogPath = settings["desc_catalog_path"].toString();
     upxPath = settings["upx_path"].toString();
     functionFinder = settings["function_finder"].toString();
     methodsInserter = settings["methods_inserter"].toString();
@@ -54,6 +61,26 @@ const QString DSettings::getNasmPath() const
     return nasmPath;
 }
 
+const QString DSettings::getAssembler() const
+{
+    return assembler;
+}
+
+const QString DSettings::getAssemblerCachePath() const
+{
+    return assemblerCachePath;
+}
+
+int DSettings::getAssemblerCacheSize() const
+{
+    return assemblerCacheSize;
+}
+
+int DSettings::getDisassemblerThreads() const
+{
+    return disassemblerThreads;
+}
+
 const QString DSettings::getNdisasmPath() const
 {
     return ndisasmPath;
@@ -68,6 +95,11 @@ const QString DSettings::getDescriptionsSourcePath() const {
     return descriptionsPath_src;
 }
 
+const QString DSettings::getDescriptionsCatalogPath() const
+{
+    return descriptionsCatalogPath;
+}
+
 const QString DSettings::getFunctionFinder() const {
     return functionFinder;
 }
@@ -93,9 +125,14 @@ bool DSettings::save()
     QJsonObject settings;
 
     settings["nasm_path"] = nasmPath;
+    settings["assembler"] = assembler;
+    settings["assembler_cache_path"] = assemblerCachePath;
+    settings["assembler_cache_size"] = assemblerCacheSize;
+    settings["disassembler_threads"] = disassemblerThreads;
     settings["ndisasm_path"] = ndisasmPath;
     settings["desc_x86_path"] = descriptionsPath_x86;
     settings["desc_x64_path"] = descriptionsPath_x64;
+    settings["desc_catalog_path"] = descriptionsCatalogPath;
     settings["upx_path"] = upxPath;
     settings["function_finder"] = functionFinder;
     settings["methods_inserter"] = methodsInserter;
@@ -120,6 +157,26 @@ void DSettings::setNasmPath(QString nasm_path)
     nasmPath = nasm_path;
 }
 
+void DSettings::setAssembler(QString assembler_name)
+{
+    assembler = assembler_name;
+}
+
+void DSettings::setAssemblerCachePath(QString cache_path)
+{
+    assemblerCachePath = cache_path;
+}
+
+void DSettings::setAssemblerCacheSize(int cache_size)
+{
+    assemblerCacheSize = cache_size;
+}
+
+void DSettings::setDisassemblerThreads(int threads)
+{
+    disassemblerThreads = threads;
+}
+
 void DSettings::setNdisasmPath(QString ndisasm_path)
 {
     ndisasmPath = ndisasm_path;
@@ -130,6 +187,11 @@ void DSettings::setUpxPath(QString upx_path)
     upxPath = upx_path;
 }
 
+void DSettings::setDescriptionsCatalogPath(QString catalog_path)
+{
+    descriptionsCatalogPath = catalog_path;
+}
+
 bool DSettings::loaded()
 {
     return _loaded;
@@ -14,8 +14,13 @@ private:
     QString descriptionsPath_x64;
     QString descriptionsPath_x86;
     QString descriptionsPath_src;
+    QString descriptionsCatalogPath;
     QString ndisasmPath;
     QString nasmPath;
+    QString assembler;
+    QString assemblerCachePath;
+    int assemblerCacheSize;
+    int disassemblerThreads;
     QString upxPath;
     QString functionFinder;
     QString methodsInserter;
@@ -33,11 +38,16 @@ public:
     }
 
     const QString getNasmPath() const;
+    const QString getAssembler() const;
+    const QString getAssemblerCachePath() const;
+    int getAssemblerCacheSize() const;
+    int getDisassemblerThreads() const;
     const QString getNdisasmPath() const;
     template <typename Register>
     const QString getDescriptionsPath() const;
     const QString getUpxPath() const;
     const QString getDescriptionsSourcePath() const;
+    const QString getDescriptionsCatalogPath() const;
     const QString getFunctionFinder() const;
     const QString getMethodsInserter() const;
     const QString getFunctionsPath() const;
@@ -45,10 +55,15 @@ public:
     bool save();
 
     void setNasmPath(QString nasm_path);
+    void setAssembler(QString assembler_name);
+    void setAssemblerCachePath(QString cache_path);
+    void setAssemblerCacheSize(int cache_size);
+    void setDisassemblerThreads(int threads);
     void setNdisasmPath(QString ndisasm_path);
     template <typename Register>
     void setDescriptionsPath(QString desc_path);
     void setUpxPath(QString upx_path);
+    void setDescriptionsCatalogPath(QString catalog_path);
 
     bool loaded();
 
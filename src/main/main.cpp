@@ -1,6 +1,14 @@
 #include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
 #include <helper/logger/dlogger.h>
 #include <helper/manager/dmanager.h>
+#include <helper/daemon/ddaemon.h>
+#include <helper/desc_catalog/ddescriptioncatalog.h>
 
 /**
  * @brief usage usage function
@@ -16,6 +24,15 @@ void usage();
  */
 bool handle_args(DManager &manager, int argc, char **argv);
 
+/**
+ * @brief secure_file secures one file with options given in command line
+ * @param manager
+ * @param argc
+ * @param argv
+ * @return
+ */
+bool secure_file(DManager &manager, int argc, char **argv);
+
 /**
  * @brief main Program entry point
  * @param argc number of arguments
@@ -50,9 +67,20 @@ void usage() {
   LOG_MSG("\t--change-x-segment:\texecutable segment of code could be changed");
   LOG_MSG("\t--obfuscate:\tobfuscate binary after secure");
   LOG_MSG("\t--pack:\t\tpack input file with UPX");
+  LOG_MSG("\t--profile:\tcall-site profile (perf script -F ip | sort | uniq -c) to keep hot code untouched");
+  LOG_MSG("\t--profile-build:\tcount executions of every changed site into <value>.*.dprof files (ELF only)");
+  LOG_MSG("\t--new-segment:\tappend all added code as a new LOAD segment, existing bytes keep their offsets (ELF only)");
+  LOG_MSG("\t--huge-pages:\tlike --new-segment, but the segment is 2 MB aligned (ELF only)");
+  LOG_MSG("\t--seed:\t\trandom seed, the same seed and input give the same output");
+  LOG_MSG("\t--heat-report:\tprint per-site hit counts from a .dprof file (usable also as --profile)");
   LOG_MSG("\t--show-ddmethods:\tlist all debugger detection methods for specified platform");
   LOG_MSG("\t--show-ddhandlers:\tlist all debugger detection handler for specified platform");
   LOG_MSG("\t--show-adding-methods:\tlist all adding methods for specified platform");
+  LOG_MSG("\t--daemon <socket> [workers]:\tkeep settings, descriptions and caches loaded and run jobs sent to a Unix socket");
+  LOG_MSG("\t--submit <socket> <job.json>:\tsend a job to the daemon and print its progress");
+  LOG_MSG("\t--daemon-stats <socket>:\tprint daemon job and cache statistics");
+  LOG_MSG("\t--daemon-stop <socket>:\tstop the daemon after running jobs finish");
+  LOG_MSG("\t--build-catalog [file]:\tcompile all descriptions and their code into one catalog (default: desc_catalog_path from settings)");
   LOG_MSG("\t--help:\t\thelp");
 }
 
@@ -71,5 +99,131 @@ bool handle_args(DManager &manager, int argc, char **argv) {
         }
     }
 
-  return true;
+  QString cmd(argv[1]);
+
+  if (cmd == "--build-catalog") {
+      QString catalog = argc >= 3 ? QString(argv[2]) : DSettings::getSettings().getDescriptionsCatalogPath();
+      if (catalog.isEmpty()) {
+          LOG_ERROR("Catalog path is not specified.");
+          return false;
+        }
+
+      return DDescriptionCatalog::build(catalog);
+    }
+
+  if (cmd == "--heat-report" && argc >= 3)
+    return manager.heat_report(argv[2]);
+
+  if (cmd == "--daemon" && argc >= 3)
+    return DDaemon(manager, argv[2], argc >= 4 ? QString(argv[3]).toInt() : 0).run();
+
+  if (cmd == "--daemon-stats" && argc >= 3)
+    return DDaemon::submit(argv[2], QJsonObject { { "cmd", "stats" } });
+
+  if (cmd == "--daemon-stop" && argc >= 3)
+    return DDaemon::submit(argv[2], QJsonObject { { "cmd", "shutdown" } });
+
+  if (cmd == "--submit" && argc >= 4) {
+      QFile f(argv[3]);
+      if (!f.open(QFile::ReadOnly)) {
+          LOG_ERROR(QString("Cannot open job file %1").arg(argv[3]));
+          return false;
+        }
+
+      QJsonObject job = QJsonDocument::fromJson(f.readAll()).object();
+      job["cmd"] = QString("secure");
+
+      // the daemon runs in another working directory
+      foreach (QString key, QStringList({ "in", "out", "profile", "profile_build" }))
+        if (job.contains(key) && !job[key].toString().isEmpty())
+          job[key] = QFileInfo(job[key].toString()).absoluteFilePath();
+
+      return DDaemon::submit(argv[2], job);
+    }
+
+  return secure_file(manager, argc, argv);
+}
+
+bool secure_file(DManager &manager, int argc, char **argv) {
+  static const QMap<QString, DManager::AddingMethodType> adding_methods = {
+    { "OEP",        DManager::AddingMethodType::OEP },
+    { "Thread",     DManager::AddingMethodType::Thread },
+    { "Trampoline", DManager::AddingMethodType::Trampoline },
+    { "INIT",       DManager::AddingMethodType::INIT },
+    { "INIT_ARRAY", DManager::AddingMethodType::INIT_ARRAY },
+    { "CTORS",      DManager::AddingMethodType::CTORS }
+  };
+
+  DManager::secured_file_info sfi;
+  sfi.set_change_x(false);
+  bool adding_method_set = false;
+
+  for (int i = 1; i < argc; ++i) {
+      QString opt(argv[i]);
+
+      // switches
+      if (opt == "--change-x-segment") {
+          sfi.set_change_x(true);
+          continue;
+        }
+      if (opt == "--obfuscate") {
+          sfi.set_obfuscate(true);
+          continue;
+        }
+      if (opt == "--pack") {
+          sfi.set_pack(true);
+          continue;
+        }
+      if (opt == "--new-segment") {
+          sfi.set_placement(DManager::PlacementType::NewSegment);
+          continue;
+        }
+      if (opt == "--huge-pages") {
+          sfi.set_placement(DManager::PlacementType::HugePageSegment);
+          continue;
+        }
+
+      // options with value
+      if (i + 1 >= argc) {
+          LOG_ERROR(QString("Option %1 requires a value.").arg(opt));
+          return false;
+        }
+      QString value(argv[++i]);
+
+      if (opt == "--in")
+        sfi.set_file_name(value);
+      else if (opt == "--out")
+        sfi.set_output_file_name(value);
+      else if (opt == "--adding-method") {
+          if (!adding_methods.contains(value)) {
+              LOG_ERROR(QString("Unknown adding method %1.").arg(value));
+              return false;
+            }
+          sfi.set_adding_method(adding_methods[value]);
+          adding_method_set = true;
+        }
+      else if (opt == "--secure-method")
+        sfi.set_dd_method(value);
+      else if (opt == "--ddhandler")
+        sfi.set_dd_handler(value);
+      else if (opt == "--profile")
+        sfi.set_profile(value);
+      else if (opt == "--profile-build")
+        sfi.set_profile_build(value);
+      else if (opt == "--seed")
+        sfi.set_seed(value.toULongLong());
+      else {
+          LOG_ERROR(QString("Unknown option %1.").arg(opt));
+          usage();
+          return false;
+        }
+    }
+
+  if (sfi.get_file_name().isEmpty() || sfi.get_dd_method().isEmpty() || sfi.get_dd_handler().isEmpty() || !adding_method_set) {
+      LOG_ERROR("Options --in, --adding-method, --secure-method and --ddhandler are required.");
+      usage();
+      return false;
+    }
+
+  return manager.secure(sfi);
 }
@@ -16,8 +16,16 @@
 
 #include "test_pe.h"
 #include "test_elf.h"
+#include "test_assembler.h"
+#include "test_decoder.h"
+#include "test_liveness.h"
+#include "test_runtime.h"
+#include "test_concurrency.h"
+#include "test_emitter.h"
+#include "test_daemon.h"
 
 #include <core/file_types/pefile.h>
+#include <core/assembler/dassemblercache.h>
 
 /*
 int main(int argc, char **argv)
@@ -47,6 +55,26 @@ int main(int argc, char **argv) {
 
     LOG_MSG("Start!");
 
+    AssemblerTester asm_tester("../src/core");
+    asm_tester.test_all();
+    asm_tester.test_slots("detection/linux/x64/cc.asm");
+    asm_tester.test_slots("detection/linux/x86/cc.asm");
+    asm_tester.test_cache();
+
+    EmitterBenchmark emitter_benchmark(1000);
+    emitter_benchmark.test_branches();
+    emitter_benchmark.benchmark<Registers_x86>();
+    emitter_benchmark.benchmark<Registers_x64>();
+
+    DecoderTester decoder_tester(0);
+    decoder_tester.benchmark("bin/derby64");
+
+    LivenessTester liveness_tester;
+    liveness_tester.test_all();
+
+    RuntimeBenchmark runtime_benchmark("runtime_benchmark", "workloads", 5);
+    runtime_benchmark.benchmark(true);
+
     ELFTester tester("elf_test_outputs");
     QList<QString> file_names_x86 = { "bin/my32", "bin/myaslr32", "bin/derby32" };
     QList<QString> file_names_x64 = { "bin/my64", "bin/myaslr64", "bin/derby64", "bin/edb", "bin/dDeflect", "bin/telnet" };
@@ -60,6 +88,30 @@ int main(int argc, char **argv) {
     foreach (QString fname, file_names_x64)
         tester.test_everything_x64(fname, false);
     */
+    // added code in a new segment at the end of file, with and without huge page alignment
+    tester.set_placement(ELF::Placement::NewSegment);
+    tester.test_one("bin/my64", "my64_new_segment", ELFTester::Method::Trampoline, "lin_x64_ptrace", "lin_x64_ud2", false, true, false);
+    tester.set_placement(ELF::Placement::HugePageSegment);
+    tester.test_one("bin/my64", "my64_huge_segment", ELFTester::Method::Trampoline, "lin_x64_ptrace", "lin_x64_ud2", false, true, false);
+    tester.set_placement(ELF::Placement::ExtendSegment);
+
+    // concurrent jobs with per-job contexts give the same output as serial runs
+    ConcurrencyTester concurrency_tester("bin/my64", 16, 4);
+    concurrency_tester.stress("lin_x64_ptrace", "lin_x64_ud2");
+
+    // a job sent to the daemon gives the same log and output as a direct DManager::secure
+    DaemonTester daemon_tester("bin/my64", "lin_x64_ptrace", "lin_x64_ud2");
+    daemon_tester.test();
+
+    // PE injection sessions: blobs go to section slack and one new section
+    PETester pe_tester;
+    pe_tester.test_injection("bin/w32.exe", 3000);
+    pe_tester.test_injection("bin/w64.exe", 3000);
+
+    // PE base relocations: the original table plus the added entries, rewritten in place when possible
+    pe_tester.test_relocations("bin/w32.exe");
+    pe_tester.test_relocations("bin/w64.exe");
+
     SourceCodeDescription scd;
     DJsonParser json_parser("descriptions/src/");
     if (!json_parser.loadSourceCodeDescription("src_is_debugger_present.json", scd))
@@ -79,5 +131,8 @@ int main(int argc, char **argv) {
     tester.test_one("bin/edb", "__edb_jmp_x64", ELFTester::Method::OEP, "lin_x64_ptrace", "lin_x64_jmp", false, true, false);
     */
 
+    LOG_MSG(QString("Assembler cache: %1 hits, %2 misses.")
+            .arg(DAssemblerCache::getCache().getHits()).arg(DAssemblerCache::getCache().getMisses()));
+
     return 0;
 }
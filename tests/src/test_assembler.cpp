@@ -0,0 +1,191 @@
+#include "test_assembler.h"
+
+#include <QFile>
+#include <QDir>
+#include <QDirIterator>
+#include <QRegExp>
+#include <QThread>
+#include <QTemporaryDir>
+#include <QStringList>
+#include <core/assembler/nativeassembler.h>
+#include <core/assembler/nasmassembler.h>
+#include <core/assembler/dcodeobject.h>
+#include <core/assembler/dassemblercache.h>
+
+#include <helper/logger/dlogger.h>
+
+QList<QString> AssemblerTester::asm_dirs = {
+    "detection",
+    "handlers",
+    "helper_func",
+    "adding_methods/methods"
+};
+
+bool AssemblerTester::test_one(QString file_name) {
+    QFile f(file_name);
+    if (!f.open(QFile::ReadOnly)) {
+        LOG_ERROR(QString("%1: cannot open file").arg(file_name));
+        return false;
+    }
+
+    QString code = QString::fromUtf8(f.readAll());
+    f.close();
+
+    bool x64 = file_name.contains("x64");
+
+    // wypełnienie placeholderów przykładowymi wartościami
+    code.replace("(?^_^ddret^_^?)", x64 ? "rax" : "eax");
+    code.replace(QRegExp("\\(\\?\\^_\\^[^\\^]*\\^_\\^\\?\\)"), "4096");
+    code.replace(QRegExp("\\(rsj\\?\\^_\\^[^\\^]*\\^_\\^\\?rsj\\)"), "");
+
+    if (!code.contains("bits", Qt::CaseInsensitive))
+        code.prepend(x64 ? "[bits 64]\n" : "[bits 32]\n");
+
+    NativeAssembler native;
+    NasmAssembler nasm;
+    QByteArray native_code, nasm_code;
+
+    if (!nasm.assemble(code, nasm_code)) {
+        LOG_ERROR(QString("%1: %2").arg(file_name).arg(nasm.getLastError()));
+        return false;
+    }
+
+    if (!native.assemble(code, native_code)) {
+        LOG_ERROR(QString("%1: %2").arg(file_name).arg(native.getLastError()));
+        return false;
+    }
+
+    if (native_code != nasm_code) {
+        LOG_ERROR(QString("%1: native output differs from nasm (%2 vs %3 bytes)")
+                  .arg(file_name).arg(native_code.size()).arg(nasm_code.size()));
+        return false;
+    }
+
+    LOG_MSG(QString("%1: OK").arg(file_name));
+    return true;
+}
+
+bool AssemblerTester::test_all() {
+    bool ok = true;
+
+    foreach (QString dir, asm_dirs) {
+        QDirIterator it(QDir(sources_dir).filePath(dir), { "*.asm" }, QDir::Files, QDirIterator::Subdirectories);
+
+        while (it.hasNext())
+            ok = test_one(it.next()) && ok;
+    }
+
+    return ok;
+}
+
+bool AssemblerTester::test_slots(QString file_name) {
+    QFile f(QDir(sources_dir).filePath(file_name));
+    if (!f.open(QFile::ReadOnly)) {
+        LOG_ERROR(QString("%1: cannot open file").arg(file_name));
+        return false;
+    }
+
+    QString code = QString::fromUtf8(f.readAll());
+    f.close();
+
+    bool x64 = file_name.contains("x64");
+    code.prepend(x64 ? "[bits 64]\n" : "[bits 32]\n");
+
+    QMap<QString, QString> placeholders = {
+        { "magic!sec_size",     "(?^_^magic!sec_size^_^?)"      },
+        { "magic!sec_checksum", "(?^_^magic!sec_checksum^_^?)"  },
+        { "dyn_magic!offset",   "(?^_^dyn_magic!offset^_^?)"    }
+    };
+    QMap<QString, uint32_t> values = {
+        { "magic!sec_size",     0x2a0c0     },
+        { "magic!sec_checksum", 0x1d4be71e  },
+        { "dyn_magic!offset",   0xfffe1f00  }
+    };
+
+    DCodeObject obj;
+    if (!DCodeObject::assemble(code, x64 ? 64 : 32, placeholders, obj)) {
+        LOG_ERROR(QString("%1: assembling with patch slots failed").arg(file_name));
+        return false;
+    }
+
+    // patched object has to be the same as the code assembled with the values
+    QString filled(code);
+    foreach (QString name, values.keys()) {
+        if (obj.patch(name, values[name]) != 1) {
+            LOG_ERROR(QString("%1: patch slot %2 not found").arg(file_name).arg(name));
+            return false;
+        }
+        filled.replace(placeholders[name], QString::number(static_cast<int32_t>(values[name])));
+    }
+
+    NasmAssembler nasm;
+    QByteArray expected;
+    if (!nasm.assemble(filled, expected)) {
+        LOG_ERROR(QString("%1: %2").arg(file_name).arg(nasm.getLastError()));
+        return false;
+    }
+
+    if (obj.getCode() != expected) {
+        LOG_ERROR(QString("%1: patched code differs from assembled values").arg(file_name));
+        return false;
+    }
+
+    LOG_MSG(QString("%1: %2 patch slots OK").arg(file_name).arg(obj.getPatchSlots().size()));
+    return true;
+}
+
+bool AssemblerTester::test_cache() {
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        LOG_ERROR("Assembler cache: cannot create temporary directory");
+        return false;
+    }
+
+    // room for two 40-byte entries, the third one evicts the least recently used
+    DAssemblerCache cache(dir.path(), 100);
+    QString code_a("[bits 64]\nnop\n"), code_b("[bits 64]\nint3\n"), code_c("[bits 64]\nret\n");
+    QByteArray bin_a(40, 'a'), bin_b(40, 'b'), bin_c(40, 'c'), out;
+    QStringList errors;
+
+    if (!cache.isEnabled())
+        errors.append("cache not enabled");
+    if (cache.lookup(code_a, 64, out))
+        errors.append("hit in empty cache");
+
+    if (!cache.store(code_a, 64, bin_a) || !cache.lookup(code_a, 64, out) || out != bin_a)
+        errors.append("stored entry not found");
+
+    // key covers source and architecture
+    if (cache.lookup(code_a + "nop\n", 64, out))
+        errors.append("changed source hit");
+    if (cache.lookup(code_a, 32, out))
+        errors.append("other architecture hit");
+
+    // modification times order the entries, the delay keeps them distinct
+    cache.store(code_b, 64, bin_b);
+    QThread::msleep(20);
+    cache.lookup(code_a, 64, out);
+    QThread::msleep(20);
+    cache.store(code_c, 64, bin_c);
+
+    if (cache.lookup(code_b, 64, out))
+        errors.append("least recently used entry not evicted");
+    if (!cache.lookup(code_a, 64, out) || out != bin_a || !cache.lookup(code_c, 64, out) || out != bin_c)
+        errors.append("recently used entry evicted");
+
+    cache.clear();
+    if (cache.lookup(code_a, 64, out) || cache.lookup(code_c, 64, out) ||
+            !QDir(dir.path()).entryList(QDir::Files).isEmpty())
+        errors.append("entries left after clear");
+
+    if (cache.getHits() != 4 || cache.getMisses() != 6)
+        errors.append(QString("hits/misses: %1/%2, expected 4/6").arg(cache.getHits()).arg(cache.getMisses()));
+
+    if (!errors.isEmpty()) {
+        LOG_ERROR(QString("Assembler cache: %1").arg(errors.join(", ")));
+        return false;
+    }
+
+    LOG_MSG("Assembler cache: OK");
+    return true;
+}
@@ -0,0 +1,23 @@
+#ifndef TEST_ASSEMBLER_H
+#define TEST_ASSEMBLER_H
+
+#include <QString>
+#include <QList>
+
+class AssemblerTester {
+public:
+    AssemblerTester(QString sd) :
+        sources_dir(sd) {}
+    bool test_one(QString file_name);
+    bool test_all();
+    bool test_slots(QString file_name);
+    bool test_cache();
+
+private:
+    static QList<QString> asm_dirs;
+
+    QString sources_dir;
+};
+
+
+#endif // TEST_ASSEMBLER_H
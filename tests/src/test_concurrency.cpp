@@ -0,0 +1,112 @@
+#include "test_concurrency.h"
+
+#include <QFile>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QVector>
+#include <QAtomicInt>
+
+#include <core/file_types/elffile.h>
+#include <helper/job_context/djobcontext.h>
+#include <ApplicationManager/dlogger.h>
+
+namespace {
+
+class JobTask : public QRunnable {
+public:
+    JobTask(ConcurrencyTester &t, const QByteArray &d, QAtomicInt &n, QVector<QByteArray> &r,
+            const QString &m, const QString &h) :
+        tester(t), data(d), next(n), results(r), method(m), handler(h) {}
+
+    void run() override {
+        // every worker takes the next job until none are left
+        int i;
+        while ((i = next.fetchAndAddOrdered(1)) < results.size())
+            results[i] = tester.run_job(data, i + 1, method, handler);
+    }
+
+private:
+    ConcurrencyTester &tester;
+    const QByteArray &data;
+    QAtomicInt &next;
+    QVector<QByteArray> &results;
+    QString method;
+    QString handler;
+};
+
+}
+
+QByteArray ConcurrencyTester::run_job(const QByteArray &data, uint64_t seed, const QString &method, const QString &handler) {
+    DJobContext job(seed);
+    QStringList log;
+    job.setLogSink([&log](DLogger::Type type, QString msg) -> void {
+        if (type == DLogger::Type::Error || type == DLogger::Type::Warning)
+            log.append(msg);
+    });
+
+    DJobContext::Scope scope(job);
+
+    ELF elf(data);
+    if (!elf.is_valid())
+        return QByteArray();
+
+    ELFTester::SecuredState ss = tester.secure(&elf, ELFTester::Method::Trampoline, method, handler, false, true);
+
+    // errors of a failed job go to the shared logger, prefixed with its seed
+    if (ss != ELFTester::SecuredState::SECURED) {
+        job.setLogSink(DJobContext::LogSink());
+        foreach (const QString &msg, log)
+            LOG_ERROR(QString("job %1: %2").arg(seed).arg(msg));
+        return QByteArray();
+    }
+
+    return elf.getData();
+}
+
+bool ConcurrencyTester::stress(QString method, QString handler) {
+    QFile in(input);
+    if (!in.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray data = in.readAll();
+    in.close();
+
+    LOG_MSG(QString("Concurrency test: %1 jobs of %2 on %3 threads").arg(jobs).arg(input).arg(threads));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<QByteArray> serial(jobs);
+    for (int i = 0; i < jobs; ++i)
+        serial[i] = run_job(data, i + 1, method, handler);
+
+    qint64 serial_ms = timer.restart();
+
+    QVector<QByteArray> parallel(jobs);
+    QAtomicInt next(0);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    for (int i = 0; i < threads; ++i)
+        pool.start(new JobTask(*this, data, next, parallel, method, handler));
+    pool.waitForDone();
+
+    qint64 parallel_ms = timer.elapsed();
+
+    int failed = 0, mismatched = 0;
+    for (int i = 0; i < jobs; ++i) {
+        if (serial[i].isEmpty() || parallel[i].isEmpty())
+            ++failed;
+        else if (serial[i] != parallel[i])
+            ++mismatched;
+    }
+
+    // different seeds must give different outputs, otherwise the test proves nothing
+    bool seeded = jobs < 2 || serial[0] != serial[1];
+
+    LOG_MSG(QString("Concurrency test: serial %1 ms, parallel %2 ms, %3 failed, %4 mismatched%5")
+            .arg(serial_ms).arg(parallel_ms).arg(failed).arg(mismatched).arg(seeded ? "" : ", seed ignored"));
+
+    return !failed && !mismatched && seeded;
+}
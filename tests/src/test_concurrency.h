@@ -0,0 +1,37 @@
+#ifndef TEST_CONCURRENCY_H
+#define TEST_CONCURRENCY_H
+
+#include <QString>
+#include <QList>
+#include <QByteArray>
+
+#include "test_elf.h"
+
+/**
+ * @brief Test równoległego zabezpieczania plików w jednym procesie.
+ *
+ * Uruchamia jobs zadań zabezpieczenia i zaciemnienia tego samego pliku, każde z innym seedem,
+ * najpierw kolejno, a potem jednocześnie na threads wątkach. Każde zadanie ma własny DJobContext,
+ * więc wynik równoległy musi być identyczny bajt po bajcie z wynikiem sekwencyjnym.
+ */
+class ConcurrencyTester {
+public:
+    ConcurrencyTester(QString in, int j, int t) :
+        input(in), jobs(j), threads(t), tester("concurrency_test_outputs") {}
+
+    bool stress(QString method, QString handler);
+
+    /**
+     * @brief Wykonuje jedno zadanie z podanym seedem.
+     * @return Zabezpieczony plik, pusty w przypadku błędu.
+     */
+    QByteArray run_job(const QByteArray &data, uint64_t seed, const QString &method, const QString &handler);
+
+private:
+    QString input;
+    int jobs;
+    int threads;
+    ELFTester tester;
+};
+
+#endif // TEST_CONCURRENCY_H
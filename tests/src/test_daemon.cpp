@@ -0,0 +1,234 @@
+#include "test_daemon.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QCoreApplication>
+#include <QStringList>
+
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <helper/daemon/ddaemon.h>
+#include <helper/manager/dmanager.h>
+#include <helper/job_context/djobcontext.h>
+#include <ApplicationManager/dlogger.h>
+
+namespace {
+
+const QMap<DLogger::Type, QString> levels = {
+    { DLogger::Type::Error,   "error" },
+    { DLogger::Type::Warning, "warning" },
+    { DLogger::Type::Message, "message" },
+    { DLogger::Type::Debug,   "debug" }
+};
+
+bool connect_to(const QString &socket_path, int &fd) {
+    QByteArray path = QFile::encodeName(socket_path);
+    sockaddr_un addr;
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= static_cast<int>(sizeof(addr.sun_path)))
+        return false;
+    std::memcpy(addr.sun_path, path.constData(), path.size());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        ::close(fd);
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray read_file(const QString &name) {
+    QFile f(name);
+    return f.open(QFile::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+}
+
+bool DaemonTester::wait_for(const QString &socket_path) {
+    // the daemon starts listening in another thread
+    for (int i = 0; i < 100; ++i) {
+        int fd;
+        if (connect_to(socket_path, fd)) {
+            ::close(fd);
+            return true;
+        }
+        usleep(50000);
+    }
+
+    return false;
+}
+
+QList<QJsonObject> DaemonTester::request(const QString &socket_path, const QJsonObject &req) {
+    QList<QJsonObject> responses;
+    int fd;
+
+    if (!connect_to(socket_path, fd)) {
+        LOG_ERROR(QString("Daemon test: cannot connect to %1: %2").arg(socket_path).arg(strerror(errno)));
+        return responses;
+    }
+
+    QByteArray data = QJsonDocument(req).toJson(QJsonDocument::Compact).append('\n');
+    if (::write(fd, data.constData(), data.size()) != data.size()) {
+        ::close(fd);
+        return responses;
+    }
+
+    // one request per connection, the daemon closes it after the last line
+    QByteArray buffer;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR))
+        if (n > 0)
+            buffer.append(chunk, n);
+    ::close(fd);
+
+    foreach (const QByteArray &line, buffer.split('\n'))
+        if (!line.isEmpty())
+            responses.push_back(QJsonDocument::fromJson(line).object());
+
+    return responses;
+}
+
+bool DaemonTester::test() {
+    QDir tmp = QDir::temp();
+    QString pid = QString::number(QCoreApplication::applicationPid());
+    QString socket_path = tmp.absoluteFilePath(QString("ddeflect_test_%1.sock").arg(pid));
+    QString daemon_out = tmp.absoluteFilePath(QString("ddeflect_test_%1_daemon").arg(pid));
+    QString direct_out = tmp.absoluteFilePath(QString("ddeflect_test_%1_direct").arg(pid));
+    const int seed = 7, workers = 2;
+
+    QFile::remove(daemon_out);
+    QFile::remove(direct_out);
+
+    LOG_MSG(QString("Daemon test: %1 on %2").arg(input).arg(socket_path));
+
+    DManager manager;
+    DDaemon daemon(manager, socket_path, workers);
+    bool run_ok = false;
+    std::thread server([&daemon, &run_ok]() { run_ok = daemon.run(); });
+
+    bool ok = wait_for(socket_path);
+    if (!ok)
+        LOG_ERROR("Daemon test: daemon is not listening.");
+
+    // job: log lines and the result line at the end
+    QJsonObject job {
+        { "cmd", "secure" },
+        { "in", QFileInfo(input).absoluteFilePath() },
+        { "out", daemon_out },
+        { "adding_method", "Trampoline" },
+        { "method", method },
+        { "handler", handler },
+        { "change_x", false },
+        { "obfuscate", false },
+        { "placement", "extend" },
+        { "seed", seed }
+    };
+
+    QList<QJsonObject> responses = ok ? request(socket_path, job) : QList<QJsonObject>();
+    QStringList daemon_log;
+    bool job_ok = false;
+
+    if (responses.isEmpty() || responses.last()["type"].toString() != "result" ||
+            !responses.last().contains("ok") || !responses.last().contains("ms")) {
+        LOG_ERROR("Daemon test: job ended without a result line.");
+        ok = false;
+    }
+    else
+        job_ok = responses.last()["ok"].toBool();
+
+    for (int i = 0; i < responses.size() - 1; ++i) {
+        const QJsonObject &r = responses[i];
+        if (r["type"].toString() != "log" || !levels.values().contains(r["level"].toString()) || !r["msg"].isString()) {
+            LOG_ERROR(QString("Daemon test: invalid log line %1")
+                      .arg(QString(QJsonDocument(r).toJson(QJsonDocument::Compact))));
+            ok = false;
+        }
+        daemon_log.append(QString("%1: %2").arg(r["level"].toString()).arg(r["msg"].toString()));
+    }
+
+    if (daemon_log.isEmpty()) {
+        LOG_ERROR("Daemon test: job sent no log lines.");
+        ok = false;
+    }
+
+    // the same job run directly, with the same seed
+    DManager::secured_file_info sfi;
+    sfi.set_file_name(QFileInfo(input).absoluteFilePath());
+    sfi.set_output_file_name(direct_out);
+    sfi.set_adding_method(DManager::AddingMethodType::Trampoline);
+    sfi.set_dd_method(method);
+    sfi.set_dd_handler(handler);
+    sfi.set_change_x(false);
+    sfi.set_obfuscate(false);
+    sfi.set_placement(DManager::PlacementType::ExtendSegment);
+    sfi.set_seed(seed);
+
+    QStringList direct_log;
+    bool direct_ok;
+    {
+        DJobContext direct_job(seed);
+        direct_job.setLogSink([&direct_log](DLogger::Type type, QString msg) -> void {
+            direct_log.append(QString("%1: %2").arg(levels[type]).arg(msg));
+        });
+        DJobContext::Scope scope(direct_job);
+
+        direct_ok = manager.secure(sfi);
+    }
+
+    if (!job_ok || !direct_ok || daemon_log != direct_log) {
+        LOG_ERROR(QString("Daemon test: daemon job %1 with %2 log lines, direct run %3 with %4 log lines")
+                  .arg(job_ok ? "succeeded" : "failed").arg(daemon_log.size())
+                  .arg(direct_ok ? "succeeded" : "failed").arg(direct_log.size()));
+        ok = false;
+    }
+
+    QByteArray daemon_data = read_file(daemon_out), direct_data = read_file(direct_out);
+    if (daemon_data.isEmpty() || daemon_data != direct_data) {
+        LOG_ERROR("Daemon test: daemon output differs from direct DManager::secure output.");
+        ok = false;
+    }
+
+    // stats count the job above
+    responses = request(socket_path, QJsonObject { { "cmd", "stats" } });
+    if (responses.size() != 1 || responses[0]["type"].toString() != "stats" ||
+            responses[0]["jobs"].toInt() != 1 || responses[0]["failed"].toInt() != 0 ||
+            responses[0]["workers"].toInt() != workers) {
+        LOG_ERROR("Daemon test: unexpected stats response.");
+        ok = false;
+    }
+
+    responses = request(socket_path, QJsonObject { { "cmd", "shutdown" } });
+    if (responses.size() != 1 || responses[0]["type"].toString() != "result" || !responses[0]["ok"].toBool()) {
+        LOG_ERROR("Daemon test: unexpected shutdown response.");
+        ok = false;
+    }
+
+    server.join();
+
+    if (!run_ok || QFileInfo::exists(socket_path)) {
+        LOG_ERROR("Daemon test: daemon did not stop cleanly.");
+        ok = false;
+    }
+
+    QFile::remove(daemon_out);
+    QFile::remove(direct_out);
+
+    LOG_MSG(QString("Daemon test: job %1, %2 log lines, %3").arg(job_ok ? "secured" : "failed")
+            .arg(daemon_log.size()).arg(ok ? "passed" : "FAILED"));
+
+    return ok;
+}
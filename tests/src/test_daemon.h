@@ -0,0 +1,40 @@
+#ifndef TEST_DAEMON_H
+#define TEST_DAEMON_H
+
+#include <QString>
+#include <QList>
+#include <QJsonObject>
+
+/**
+ * @brief Test trybu demona.
+ *
+ * Uruchamia DDaemon::run() na tymczasowym gnieździe w osobnym wątku i wysyła do niego kolejno
+ * zadanie secure, żądanie stats i shutdown. Sprawdza linie komunikatów i wynik zadania, statystyki
+ * oraz to, że plik wynikowy i komunikaty są takie same jak przy bezpośrednim wywołaniu DManager::secure
+ * z tym samym seedem.
+ */
+class DaemonTester {
+public:
+    DaemonTester(QString in, QString m, QString h) :
+        input(in), method(m), handler(h) {}
+
+    bool test();
+
+private:
+    /**
+     * @brief Wysyła żądanie i odczytuje wszystkie linie odpowiedzi do zamknięcia połączenia.
+     * @return Odpowiedzi, pusta lista w przypadku błędu połączenia.
+     */
+    QList<QJsonObject> request(const QString &socket_path, const QJsonObject &req);
+
+    /**
+     * @brief Czeka, aż demon zacznie nasłuchiwać.
+     */
+    bool wait_for(const QString &socket_path);
+
+    QString input;
+    QString method;
+    QString handler;
+};
+
+#endif // TEST_DAEMON_H
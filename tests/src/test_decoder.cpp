@@ -0,0 +1,92 @@
+#include "test_decoder.h"
+
+#include <QFile>
+#include <QThread>
+#include <QElapsedTimer>
+#include <core/file_types/elffile.h>
+#include <core/file_types/pefile.h>
+#include <core/disassembler/lengthdecoder.h>
+
+#include <helper/logger/dlogger.h>
+
+#include <algorithm>
+
+const uint32_t DecoderTester::small_chunk_size = 16 * 1024;
+
+bool DecoderTester::benchmark(QString input) {
+    QFile f(input);
+    if (!f.open(QFile::ReadOnly)) {
+        LOG_ERROR(QString("%1: cannot open file").arg(input));
+        return false;
+    }
+
+    QByteArray data = f.readAll();
+    f.close();
+
+    QByteArray text;
+    bool x64;
+
+    ELF elf(data);
+    PEFile pe(data);
+    if (elf.is_valid()) {
+        QPair<QByteArray, Elf64_Addr> text_data;
+        if (!elf.get_section_content(ELF::SectionType::TEXT, text_data))
+            return false;
+        text = text_data.first;
+        x64 = elf.is_x64();
+    }
+    else if (pe.is_valid()) {
+        text = pe.getTextSection();
+        x64 = pe.is_x64();
+    }
+    else {
+        LOG_ERROR(QString("%1: not an ELF or PE file").arg(input));
+        return false;
+    }
+
+    int threads = max_threads > 0 ? max_threads : QThread::idealThreadCount();
+
+    // default chunk is 1 MiB, smaller .text would be decoded serially for every thread count
+    uint32_t chunk_size = std::min<uint32_t>(LengthDecoder::min_chunk_size, text.size() / threads);
+    LengthDecoder serial_decoder(x64);
+    LengthDecoder decoder(x64, chunk_size);
+
+    QVector<uint32_t> serial_calls, serial_jmps;
+    serial_decoder.findRelativeBranches(text, serial_calls, serial_jmps, 1);
+
+    qint64 serial_time = 0;
+    bool ok = true;
+
+    for (int t = 1; t <= threads; ++t) {
+        QVector<uint32_t> calls, jmps;
+        QElapsedTimer timer;
+
+        timer.start();
+        decoder.findRelativeBranches(text, calls, jmps, t);
+        qint64 time = timer.elapsed();
+
+        if (t == 1)
+            serial_time = time;
+
+        bool same = calls == serial_calls && jmps == serial_jmps;
+        ok = ok && same;
+
+        uint32_t chunks = std::max<uint32_t>(1, std::min<uint32_t>(t, text.size() / std::max<uint32_t>(chunk_size, 1)));
+
+        LOG_MSG(QString("%1: %2 MB, %3 threads, %4 chunks: %5 ms (x%6)%7")
+                .arg(input).arg(text.size() / (1024. * 1024.), 0, 'f', 1).arg(t).arg(chunks).arg(time)
+                .arg(time ? static_cast<double>(serial_time) / time : 1., 0, 'f', 2)
+                .arg(same ? "" : ", results differ from serial sweep!"));
+    }
+
+    // many small chunks exercise merging at chunk boundaries
+    QVector<uint32_t> calls, jmps;
+    LengthDecoder(x64, small_chunk_size).findRelativeBranches(text, calls, jmps, 64);
+    if (calls != serial_calls || jmps != serial_jmps) {
+        LOG_ERROR(QString("%1: %2 KB chunks give results different from serial sweep")
+                  .arg(input).arg(small_chunk_size / 1024));
+        ok = false;
+    }
+
+    return ok;
+}
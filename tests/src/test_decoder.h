@@ -0,0 +1,19 @@
+#ifndef TEST_DECODER_H
+#define TEST_DECODER_H
+
+#include <QString>
+
+class DecoderTester {
+public:
+    DecoderTester(int mt) :
+        max_threads(mt) {}
+    bool benchmark(QString input);
+
+private:
+    static const uint32_t small_chunk_size;
+
+    int max_threads;
+};
+
+
+#endif // TEST_DECODER_H
@@ -12,20 +12,20 @@
 #include <ApplicationManager/dsettings.h>
 #include <ApplicationManager/dlogger.h>
 
-QList<QString> ELFTester::methods_x64 = {
+const QList<QString> ELFTester::methods_x64 = {
     "lin_x64_cc",
     "lin_x64_ptrace",
     "lin_x64_rtdsc"
 };
 
-QList<QString> ELFTester::methods_x86 = {
+const QList<QString> ELFTester::methods_x86 = {
     "lin_x86_cc",
     "lin_x86_ptrace",
     "lin_x86_rtdsc",
     "lin_x86_sigtrap"
 };
 
-QList<QString> ELFTester::handlers_x86 = {
+const QList<QString> ELFTester::handlers_x86 = {
     "lin_x86_exit",
     "lin_x86_exit_group",
     "lin_x86_fpe",
@@ -34,7 +34,7 @@ QList<QString> ELFTester::handlers_x86 = {
     "lin_x86_mov"
 };
 
-QList<QString> ELFTester::handlers_x64 = {
+const QList<QString> ELFTester::handlers_x64 = {
     "lin_x64_exit",
     "lin_x64_exit_group",
     "lin_x64_fpe",
@@ -43,7 +43,7 @@ QList<QString> ELFTester::handlers_x64 = {
     "lin_x64_mov"
 };
 
-QMap<ELFTester::Method, QString> ELFTester::wrappers_x86 = {
+const QMap<ELFTester::Method, QString> ELFTester::wrappers_x86 = {
     { ELFTester::Method::OEP, "lin_x86_oepwrapper" },
     { ELFTester::Method::Thread, "lin_x86_threadwrapper" },
     { ELFTester::Method::Trampoline, "lin_x86_trampolinewrapper" },
@@ -52,7 +52,7 @@ QMap<ELFTester::Method, QString> ELFTester::wrappers_x86 = {
     { ELFTester::Method::INIT_ARRAY, "lin_x86_trampolinewrapper" }
 };
 
-QMap<ELFTester::Method, QString> ELFTester::wrappers_x64 = {
+const QMap<ELFTester::Method, QString> ELFTester::wrappers_x64 = {
     { ELFTester::Method::OEP, "lin_x64_oepwrapper" },
     { ELFTester::Method::Thread, "lin_x64_threadwrapper"},
     { ELFTester::Method::Trampoline, "lin_x64_trampolinewrapper" },
@@ -61,7 +61,7 @@ QMap<ELFTester::Method, QString> ELFTester::wrappers_x64 = {
     { ELFTester::Method::INIT_ARRAY, "lin_x64_trampolinewrapper" }
 };
 
-QMap<ELFTester::Method, QString> ELFTester::smethods = {
+const QMap<ELFTester::Method, QString> ELFTester::smethods = {
     { ELFTester::Method::OEP, "OEP" },
     { ELFTester::Method::Thread, "Thread" },
     { ELFTester::Method::Trampoline, "Trampoline" },
@@ -85,32 +85,25 @@ bool ELFTester::test_one(QString input, QString output, ELFTester::Method type,
     if(!elf.is_valid())
         return false;
 
-    SecuredState ss;
-    if(elf.is_x64()) {
-        ss = test_one_ex<Registers_x64>(&elf, type, method, handler, x, obfuscate);
-        if (ss == SecuredState::NONCOMPATIBLE)
-            return true;
-        if (ss != SecuredState::SECURED)
-            return false;
-    }
-
-    if(elf.is_x86()) {
-        ss = test_one_ex<Registers_x86>(&elf, type, method, handler, x, obfuscate);
-        if (ss == SecuredState::NONCOMPATIBLE)
-            return true;
-        if (ss != SecuredState::SECURED)
-            return false;
-    }
+    SecuredState ss = secure(&elf, type, method, handler, x, obfuscate);
+    if (ss == SecuredState::NONCOMPATIBLE)
+        return true;
+    if (ss != SecuredState::SECURED)
+        return false;
 
     QString fullpath = QFileInfo(secured_files_dir, output).absoluteFilePath();
-    QFile out(fullpath);
-    if(!out.open(QFile::WriteOnly))
+    if(!elf.write_to_file(fullpath, input))
         return false;
 
-    out.write(elf.getData());
+    in.close();
 
+    // only dirty ranges were written, the rest was cloned from the input file
+    QFile out(fullpath);
+    if(!out.open(QFile::ReadOnly) || out.readAll() != elf.getData()) {
+        LOG_ERROR("Written file differs from secured data.");
+        return false;
+    }
     out.close();
-    in.close();
 
     // make file executable
     QProcess chmod;
@@ -138,6 +131,19 @@ bool ELFTester::test_one(QString input, QString output, ELFTester::Method type,
     return true;
 }
 
+ELFTester::SecuredState ELFTester::secure(ELF *elf, ELFTester::Method type, QString method,
+                                          QString handler, bool x, bool obfuscate) {
+    elf->set_placement(placement);
+
+    if(elf->is_x64())
+        return test_one_ex<Registers_x64>(elf, type, method, handler, x, obfuscate);
+
+    if(elf->is_x86())
+        return test_one_ex<Registers_x86>(elf, type, method, handler, x, obfuscate);
+
+    return SecuredState::ERROR;
+}
+
 bool ELFTester::test_all_methods(QString input, ELFTester::Method type, QString handler, bool x, bool obfuscate, bool pack) {
     QFile in(input);
     if(!in.open(QFile::ReadOnly))
@@ -153,7 +159,7 @@ bool ELFTester::test_all_methods(QString input, ELFTester::Method type, QString
 
     in.close();
 
-    QList<QString> *methods = is_x64 ? &methods_x64 : &methods_x86;
+    const QList<QString> *methods = is_x64 ? &methods_x64 : &methods_x86;
 
     int i = 1;
     foreach(QString method, *methods) {
@@ -186,7 +192,7 @@ bool ELFTester::test_all_handlers(QString input, ELFTester::Method type, QString
 
     in.close();
 
-    QList<QString> *handlers = is_x64 ? &handlers_x64 : &handlers_x86;
+    const QList<QString> *handlers = is_x64 ? &handlers_x64 : &handlers_x86;
 
     int i = 1;
     foreach(QString handler, *handlers) {
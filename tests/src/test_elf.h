@@ -29,28 +29,37 @@ public:
     };
 
     ELFTester(QString sfd) :
-        secured_files_dir(sfd) {}
+        secured_files_dir(sfd), placement(ELF::Placement::ExtendSegment) {}
     bool test_one(QString input, QString output, Method type, QString method,
                   QString handler, bool x, bool obfuscate, bool pack);
 
+    SecuredState secure(ELF *elf, Method type, QString method, QString handler, bool x, bool obfuscate);
+
     bool test_all_methods(QString input, Method type, QString handler, bool x, bool obfuscate, bool pack);
     bool test_all_handlers(QString input, Method type, QString method, bool x, bool obfuscate, bool pack);
     bool test_everything_x86(QString input, bool pack);
     bool test_everything_x64(QString input, bool pack);
 
+    static const QList<QString> &get_methods(bool x64) { return x64 ? methods_x64 : methods_x86; }
+    static const QList<QString> &get_handlers(bool x64) { return x64 ? handlers_x64 : handlers_x86; }
+    static const QMap<Method, QString> &get_smethods() { return smethods; }
+
+    void set_placement(ELF::Placement p) { placement = p; }
+
 private:
     template <typename Reg>
     SecuredState test_one_ex(ELF *elf, Method type, QString method, QString handler, bool x, bool obfuscate);
 
-    static QList<QString> methods_x86;
-    static QList<QString> methods_x64;
-    static QList<QString> handlers_x86;
-    static QList<QString> handlers_x64;
-    static QMap<Method, QString> wrappers_x86;
-    static QMap<Method, QString> wrappers_x64;
-    static QMap<Method, QString> smethods;
+    static const QList<QString> methods_x86;
+    static const QList<QString> methods_x64;
+    static const QList<QString> handlers_x86;
+    static const QList<QString> handlers_x64;
+    static const QMap<Method, QString> wrappers_x86;
+    static const QMap<Method, QString> wrappers_x64;
+    static const QMap<Method, QString> smethods;
 
     QString secured_files_dir;
+    ELF::Placement placement;
 };
 
 
@@ -0,0 +1,158 @@
+#include "test_emitter.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <iterator>
+
+#include <core/adding_methods/wrappers/daddingmethods.h>
+#include <core/assembler/dcodeemitter.h>
+#include <core/assembler/nativeassembler.h>
+#include <core/file_types/codedefines.h>
+#include <helper/json_parser/djsonparser.h>
+#include <helper/settings_parser/dsettings.h>
+#include <helper/logger/dlogger.h>
+
+template <typename Reg>
+QList<Reg> EmitterBenchmark::saved_registers(const QList<Reg> &used_regs, Reg ret) {
+    QList<Reg> regs(used_regs);
+
+    // tak jak w wrapper_gen_code
+    foreach (Reg r, CodeDefines<Reg>::internalRegs)
+        if (!regs.contains(r))
+            regs.push_back(r);
+    regs.removeAll(ret);
+
+    // AsmCodeGenerator nie rozwija All na x64, oba sposoby dostają jawną listę
+    if (std::is_same<Reg, Registers_x64>::value && regs.contains(Reg::All)) {
+        regs.removeAll(Reg::All);
+        for (int i = 0; i < static_cast<int>(Reg::None); ++i)
+            if (static_cast<Registers_x64>(i) != Registers_x64::RSP && !regs.contains(static_cast<Reg>(i)))
+                regs.push_back(static_cast<Reg>(i));
+    }
+
+    return regs;
+}
+
+template <typename Reg>
+bool EmitterBenchmark::benchmark() {
+    bool x64 = std::is_same<Reg, Registers_x64>::value;
+    QString desc_dir = DSettings::getSettings().getDescriptionsPath<Reg>();
+    DJsonParser parser(desc_dir);
+    NativeAssembler assembler;
+
+    qint64 text_total = 0, emit_total = 0;
+    int errors = 0;
+
+    foreach (QString name, QDir(desc_dir).entryList(QStringList() << "*.json", QDir::Files, QDir::Name)) {
+        Wrapper<Reg> *wrap = parser.loadInjectDescription<Reg>(name);
+        if (!wrap) {
+            LOG_ERROR(QString("%1: cannot load description").arg(name));
+            ++errors;
+            continue;
+        }
+
+        QList<Reg> regs = saved_registers<Reg>(wrap->used_regs, wrap->ret);
+        QList<Reg> rregs;
+        std::reverse_copy(regs.begin(), regs.end(), std::back_inserter(rregs));
+        delete wrap;
+
+        QByteArray text_code, emit_code;
+        QElapsedTimer timer;
+
+        // tekst i asembler
+        timer.start();
+        for (int i = 0; i < iterations; ++i) {
+            QString code(x64 ? "[bits 64]\n" : "[bits 32]\n");
+            code.append(AsmCodeGenerator::save_flags<Reg>());
+            code.append(AsmCodeGenerator::push_regs<Reg>(regs));
+            code.append(AsmCodeGenerator::pop_regs<Reg>(rregs));
+            code.append(AsmCodeGenerator::restore_flags<Reg>());
+
+            if (!assembler.assemble(code, text_code)) {
+                LOG_ERROR(QString("%1: %2").arg(name).arg(assembler.getLastError()));
+                return false;
+            }
+        }
+        qint64 text_time = timer.nsecsElapsed();
+
+        // bezpośrednio do bufora
+        timer.restart();
+        for (int i = 0; i < iterations; ++i) {
+            DCodeEmitter<Reg> emitter;
+            emitter.pushFlags();
+            emitter.pushRegs(regs);
+            emitter.popRegs(rregs);
+            emitter.popFlags();
+
+            if (!emitter.finish())
+                return false;
+            emit_code = emitter.getCode();
+        }
+        qint64 emit_time = timer.nsecsElapsed();
+
+        bool same = text_code == emit_code;
+        if (!same)
+            ++errors;
+
+        text_total += text_time;
+        emit_total += emit_time;
+
+        LOG_MSG(QString("%1: %2 registers, text + assembler: %3 us, emitter: %4 us (x%5)%6")
+                .arg(name).arg(regs.size())
+                .arg(text_time / 1000. / iterations, 0, 'f', 2).arg(emit_time / 1000. / iterations, 0, 'f', 2)
+                .arg(emit_time ? static_cast<double>(text_time) / emit_time : 1., 0, 'f', 1)
+                .arg(same ? "" : ", code differs!"));
+    }
+
+    LOG_MSG(QString("%1: text + assembler: %2 ms, emitter: %3 ms (%4 iterations per description)")
+            .arg(desc_dir).arg(text_total / 1000000.).arg(emit_total / 1000000.).arg(iterations));
+
+    return errors == 0;
+}
+template bool EmitterBenchmark::benchmark<Registers_x86>();
+template bool EmitterBenchmark::benchmark<Registers_x64>();
+
+bool EmitterBenchmark::test_branches() {
+    // ten sam kod ze skokami w przód i w tył: krótkie tylko te, które mieszczą się w rel8, jak w nasm -Ox
+    QString code("[bits 64]\ntop:\njne fwd\njmp done\ncall next\nnext:\n");
+    DCodeEmitter<Registers_x64> emitter;
+    DCodeEmitter<Registers_x64>::Label top = emitter.newLabel(), fwd = emitter.newLabel(),
+            done = emitter.newLabel(), next = emitter.newLabel();
+
+    emitter.bind(top);
+    emitter.jcc(DCodeEmitter<Registers_x64>::Condition::NE, fwd);
+    emitter.jmp(done);
+    emitter.call(next);
+    emitter.bind(next);
+
+    code.append(QString("nop\n").repeated(100)).append("fwd:\n");
+    emitter.append(QByteArray(100, '\x90'));
+    emitter.bind(fwd);
+
+    code.append(QString("nop\n").repeated(30)).append("je top\n");
+    emitter.append(QByteArray(30, '\x90'));
+    emitter.jcc(DCodeEmitter<Registers_x64>::Condition::E, top);
+
+    code.append(QString("nop\n").repeated(200)).append("done:\n");
+    emitter.append(QByteArray(200, '\x90'));
+    emitter.bind(done);
+
+    NativeAssembler assembler;
+    QByteArray expected;
+
+    if (!assembler.assemble(code, expected) || !emitter.finish()) {
+        LOG_ERROR("Branch relaxation: assembling failed");
+        return false;
+    }
+
+    if (emitter.getCode() != expected) {
+        LOG_ERROR(QString("Branch relaxation: emitter output differs from assembler (%1 vs %2 bytes)")
+                  .arg(emitter.getCode().size()).arg(expected.size()));
+        return false;
+    }
+
+    LOG_MSG("Branch relaxation: OK");
+    return true;
+}
@@ -0,0 +1,29 @@
+#ifndef TEST_EMITTER_H
+#define TEST_EMITTER_H
+
+#include <QString>
+#include <QList>
+
+/**
+ * @brief Porównanie generowania kodu zachowującego rejestry dla każdego opisu metody:
+ * tekst z AsmCodeGenerator skompilowany asemblerem oraz bajty z DCodeEmitter.
+ * Oba sposoby muszą dać identyczny kod, wynikiem jest czas generowania dla każdego opisu.
+ */
+class EmitterBenchmark {
+public:
+    EmitterBenchmark(int i) :
+        iterations(i) {}
+
+    template <typename Reg>
+    bool benchmark();
+
+    bool test_branches();
+
+private:
+    template <typename Reg>
+    static QList<Reg> saved_registers(const QList<Reg> &used_regs, Reg ret);
+
+    int iterations;
+};
+
+#endif // TEST_EMITTER_H
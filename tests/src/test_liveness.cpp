@@ -0,0 +1,106 @@
+#include "test_liveness.h"
+
+#include <core/disassembler/liveness.h>
+
+#include <helper/logger/dlogger.h>
+
+#include <initializer_list>
+
+namespace {
+
+const uint16_t all_x64 = 0xffff;
+const uint16_t all_x86 = 0x00ff;
+
+uint16_t dead(uint16_t all, std::initializer_list<int> regs) {
+    for (int r : regs)
+        all &= ~(1 << r);
+    return all;
+}
+
+QByteArray bytes(std::initializer_list<uint8_t> b) {
+    return QByteArray(reinterpret_cast<const char*>(b.begin()), static_cast<int>(b.size()));
+}
+
+}
+
+// expected live registers (bit n = register number n in the encoding) and flags at the first instruction
+const QList<LivenessTester::test_case> LivenessTester::cases = {
+    // nothing known, everything is live
+    { "empty",                          true,  bytes({}),                                    all_x64, true },
+    { "ret",                            true,  bytes({ 0xc3 }),                              all_x64, true },
+    { "ret (x86)",                      false, bytes({ 0xc3 }),                              all_x86, true },
+
+    // full 32/64-bit writes kill, partial 8/16-bit writes do not
+    { "mov eax, 1; ret",                true,  bytes({ 0xb8, 1, 0, 0, 0, 0xc3 }),            dead(all_x64, { 0 }), true },
+    { "mov r8d, 1; ret",                true,  bytes({ 0x41, 0xb8, 1, 0, 0, 0, 0xc3 }),      dead(all_x64, { 8 }), true },
+    { "mov ax, 1; ret",                 true,  bytes({ 0x66, 0xb8, 1, 0, 0xc3 }),            all_x64, true },
+    { "mov al, 1; ret",                 true,  bytes({ 0xb0, 1, 0xc3 }),                     all_x64, true },
+    { "mov ax, 1; xor ecx, ecx (x86)",  false, bytes({ 0x66, 0xb8, 1, 0, 0x31, 0xc9, 0xc3 }), dead(all_x86, { 1 }), false },
+
+    // push reads the register before it is overwritten
+    { "mov ebx, 0; ret",                true,  bytes({ 0xbb, 0, 0, 0, 0, 0xc3 }),            dead(all_x64, { 3 }), true },
+    { "push rbx; mov ebx, 0; ret",      true,  bytes({ 0x53, 0xbb, 0, 0, 0, 0, 0xc3 }),      all_x64, true },
+    { "push ecx; xor ecx, ecx (x86)",   false, bytes({ 0x51, 0x31, 0xc9, 0xc3 }),            all_x86, false },
+
+    // xor/sub r, r do not read r
+    { "xor eax, eax; ret",              true,  bytes({ 0x31, 0xc0, 0xc3 }),                  dead(all_x64, { 0 }), false },
+    { "sub eax, eax; ret",              true,  bytes({ 0x29, 0xc0, 0xc3 }),                  dead(all_x64, { 0 }), false },
+    { "xor ecx, ecx; ret (x86)",        false, bytes({ 0x31, 0xc9, 0xc3 }),                  dead(all_x86, { 1 }), false },
+    { "xor eax, ecx; ret",              true,  bytes({ 0x31, 0xc8, 0xc3 }),                  all_x64, false },
+    { "cmp eax, ecx; xor eax, eax; xor ecx, ecx; ret",
+                                        true,  bytes({ 0x39, 0xc8, 0x31, 0xc0, 0x31, 0xc9, 0xc3 }), all_x64, false },
+
+    // the analysis stops at jcc, call and ret
+    { "mov eax, 1; jz; mov ecx, 1",     true,  bytes({ 0xb8, 1, 0, 0, 0, 0x74, 0x00, 0xb9, 1, 0, 0, 0 }), dead(all_x64, { 0 }), true },
+    { "xor eax, eax; call; xor ecx, ecx", true, bytes({ 0x31, 0xc0, 0xe8, 0, 0, 0, 0, 0x31, 0xc9 }), dead(all_x64, { 0 }), false },
+    { "call; xor eax, eax",             true,  bytes({ 0xe8, 0, 0, 0, 0, 0x31, 0xc0 }),      all_x64, true },
+    { "mov eax, 1; ret; mov ecx, 1",    true,  bytes({ 0xb8, 1, 0, 0, 0, 0xc3, 0xb9, 1, 0, 0, 0 }), dead(all_x64, { 0 }), true },
+
+    // flags: written by cmp, read by jcc, setcc, adc and rcl, not decided by shifts and inc
+    { "cmp eax, ecx; ret",              true,  bytes({ 0x39, 0xc8, 0xc3 }),                  all_x64, false },
+    { "cmp eax, ecx; jz",               true,  bytes({ 0x39, 0xc8, 0x74, 0x00 }),            all_x64, false },
+    { "cmp eax, ecx; sete al; ret",     true,  bytes({ 0x39, 0xc8, 0x0f, 0x94, 0xc0, 0xc3 }), all_x64, false },
+    { "cmp eax, ecx; adc eax, 0; ret",  true,  bytes({ 0x39, 0xc8, 0x83, 0xd0, 0x00, 0xc3 }), all_x64, false },
+    { "sete al; ret",                   true,  bytes({ 0x0f, 0x94, 0xc0, 0xc3 }),            all_x64, true },
+    { "adc eax, 0; ret",                true,  bytes({ 0x83, 0xd0, 0x00, 0xc3 }),            all_x64, true },
+    { "shl eax, 1; ret",                true,  bytes({ 0xd1, 0xe0, 0xc3 }),                  all_x64, true },
+    { "rcl eax, 1; ret",                true,  bytes({ 0xd1, 0xd0, 0xc3 }),                  all_x64, true },
+    { "inc eax; ret (x86)",             false, bytes({ 0x40, 0xc3 }),                        all_x86, true }
+};
+
+bool LivenessTester::test_one(const test_case &tc) {
+    LivenessAnalyzer analyzer(tc.x64);
+    LivenessAnalyzer::Result live =
+            analyzer.analyze(reinterpret_cast<const uint8_t*>(tc.code.constData()), tc.code.size());
+
+    if (live.regs != tc.regs || live.flags != tc.flags) {
+        LOG_ERROR(QString("Liveness test: %1: registers %2, flags %3, expected registers %4, flags %5")
+                  .arg(tc.name)
+                  .arg(live.regs, 4, 16, QChar('0')).arg(live.flags ? "live" : "dead")
+                  .arg(tc.regs, 4, 16, QChar('0')).arg(tc.flags ? "live" : "dead"));
+        return false;
+    }
+
+    return true;
+}
+
+bool LivenessTester::test_all() {
+    int failed = 0;
+
+    foreach (const test_case &tc, cases)
+        if (!test_one(tc))
+            ++failed;
+
+    // register numbers used by the trampolines
+    if (!LivenessAnalyzer::isLive(LivenessAnalyzer::Result { 0x0001, false }, Registers_x64::RAX) ||
+            LivenessAnalyzer::isLive(LivenessAnalyzer::Result { 0x0001, false }, Registers_x64::R8) ||
+            !LivenessAnalyzer::isLive(LivenessAnalyzer::Result { 0x0100, false }, Registers_x64::R8) ||
+            LivenessAnalyzer::isLive(LivenessAnalyzer::Result { 0x0001, false }, Registers_x86::ECX)) {
+        LOG_ERROR("Liveness test: wrong register numbers.");
+        ++failed;
+    }
+
+    LOG_MSG(QString("Liveness test: %1 cases, %2 failed").arg(cases.size() + 1).arg(failed));
+
+    return failed == 0;
+}
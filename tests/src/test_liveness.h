@@ -0,0 +1,26 @@
+#ifndef TEST_LIVENESS_H
+#define TEST_LIVENESS_H
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+
+class LivenessTester {
+public:
+    bool test_all();
+
+private:
+    struct test_case {
+        QString name;
+        bool x64;
+        QByteArray code;
+        uint16_t regs;
+        bool flags;
+    };
+
+    static const QList<test_case> cases;
+
+    bool test_one(const test_case &tc);
+};
+
+#endif // TEST_LIVENESS_H
@@ -4,12 +4,133 @@
 #include <QDir>
 #include <QByteArray>
 #include <QList>
+#include <QPair>
 #include <core/file_types/pefile.h>
 #include <core/adding_methods/wrappers/peaddingmethods.h>
 #include <ApplicationManager/DJsonParser/djsonparser.h>
 #include <ApplicationManager/dsettings.h>
 #include <ApplicationManager/dlogger.h>
 
+namespace {
+
+// headers read straight from the file, so the checks do not go through PEFile
+struct PELayout
+{
+    uint64_t imageBase;
+    IMAGE_DATA_DIRECTORY relocations;
+    QList<IMAGE_SECTION_HEADER> sections;
+};
+
+bool readLayout(const QByteArray &data, PELayout &layout)
+{
+    const char *raw = data.constData();
+
+    if(static_cast<size_t>(data.size()) < sizeof(IMAGE_DOS_HEADER))
+        return false;
+
+    uint32_t ntIdx = reinterpret_cast<const IMAGE_DOS_HEADER*>(raw)->e_lfanew;
+    if(static_cast<uint64_t>(ntIdx) + sizeof(IMAGE_NT_HEADERS64) > static_cast<uint64_t>(data.size()))
+        return false;
+
+    const IMAGE_FILE_HEADER *fileHeader = &reinterpret_cast<const IMAGE_NT_HEADERS32*>(raw + ntIdx)->FileHeader;
+    uint32_t optIdx = ntIdx + sizeof(DWORD) + sizeof(IMAGE_FILE_HEADER);
+
+    if(*reinterpret_cast<const WORD*>(raw + optIdx) == IMAGE_NT_OPTIONAL_HDR64_MAGIC)
+    {
+        const IMAGE_OPTIONAL_HEADER64 *opt = reinterpret_cast<const IMAGE_OPTIONAL_HEADER64*>(raw + optIdx);
+        layout.imageBase = opt->ImageBase;
+        layout.relocations = opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+    else
+    {
+        const IMAGE_OPTIONAL_HEADER32 *opt = reinterpret_cast<const IMAGE_OPTIONAL_HEADER32*>(raw + optIdx);
+        layout.imageBase = opt->ImageBase;
+        layout.relocations = opt->DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+    }
+
+    uint32_t sectionIdx = optIdx + fileHeader->SizeOfOptionalHeader;
+    if(sectionIdx + static_cast<uint64_t>(fileHeader->NumberOfSections) * sizeof(IMAGE_SECTION_HEADER) >
+            static_cast<uint64_t>(data.size()))
+        return false;
+
+    layout.sections.clear();
+    for(unsigned int i = 0; i < fileHeader->NumberOfSections; ++i)
+        layout.sections.append(reinterpret_cast<const IMAGE_SECTION_HEADER*>(raw + sectionIdx)[i]);
+
+    return true;
+}
+
+// section holding size bytes of raw data at rva, -1 if there is none
+int sectionOf(const PELayout &layout, uint32_t rva, uint32_t size)
+{
+    for(int i = 0; i < layout.sections.size(); ++i)
+    {
+        const IMAGE_SECTION_HEADER &hdr = layout.sections[i];
+        uint32_t len = qMin<uint32_t>(hdr.Misc.VirtualSize, hdr.SizeOfRawData);
+
+        if(rva >= hdr.VirtualAddress && static_cast<uint64_t>(rva) + size <= static_cast<uint64_t>(hdr.VirtualAddress) + len)
+            return i;
+    }
+
+    return -1;
+}
+
+// relocation entries (rva -> type), strict also checks that pages and offsets are sorted and unique
+bool readRelocations(const QByteArray &data, const PELayout &layout, QMap<uint32_t, uint8_t> &entries, bool strict)
+{
+    int section = sectionOf(layout, layout.relocations.VirtualAddress, layout.relocations.Size);
+    if(section < 0)
+        return false;
+
+    const IMAGE_SECTION_HEADER &hdr = layout.sections[section];
+    const char *raw = data.constData() + hdr.PointerToRawData + (layout.relocations.VirtualAddress - hdr.VirtualAddress);
+    uint32_t i = 0;
+    int64_t lastPage = -1;
+
+    while(i + IMAGE_SIZEOF_BASE_RELOCATION <= layout.relocations.Size)
+    {
+        const IMAGE_BASE_RELOCATION *block = reinterpret_cast<const IMAGE_BASE_RELOCATION*>(raw + i);
+
+        if(block->SizeOfBlock < IMAGE_SIZEOF_BASE_RELOCATION || i + block->SizeOfBlock > layout.relocations.Size)
+            return false;
+
+        if(strict && (block->SizeOfBlock % 4 != 0 || static_cast<int64_t>(block->VirtualAddress) <= lastPage))
+            return false;
+
+        lastPage = block->VirtualAddress;
+        int lastOffset = -1;
+        uint32_t count = (block->SizeOfBlock - IMAGE_SIZEOF_BASE_RELOCATION) / sizeof(uint16_t);
+
+        for(uint32_t j = 0; j < count; ++j)
+        {
+            uint16_t typeOffset = reinterpret_cast<const uint16_t*>(raw + i + IMAGE_SIZEOF_BASE_RELOCATION)[j];
+            uint8_t type = typeOffset >> 12;
+            int offset = typeOffset & 0x0FFF;
+
+            // padding is allowed only as the last entry of a block
+            if(type == IMAGE_REL_BASED_ABSOLUTE)
+            {
+                if(strict && j != count - 1)
+                    return false;
+                continue;
+            }
+
+            if(strict && offset <= lastOffset)
+                return false;
+
+            lastOffset = offset;
+            if(!entries.contains(block->VirtualAddress + offset))
+                entries.insert(block->VirtualAddress + offset, type);
+        }
+
+        i += block->SizeOfBlock;
+    }
+
+    return true;
+}
+
+}
+
 QList<QString> PETester::methods_x64 =
 {
     "win_x64_anti_step_over",
@@ -384,3 +505,216 @@ bool PETester::test_thread_ex(PEFile *pe, QString method, QString handler)
 
     return true;
 }
+
+bool PETester::test_injection(QString input, int blobs)
+{
+    QFile in(input);
+    if(!in.open(QFile::ReadOnly))
+        return false;
+
+    PEFile pe(in.readAll());
+    in.close();
+
+    PELayout before;
+    if(!pe.is_valid() || !readLayout(pe.getData(), before))
+    {
+        LOG_ERROR(QString("Injection test: %1 is not a valid PE file.").arg(input));
+        return false;
+    }
+
+    QMap<QByteArray, uint64_t> ptrs;
+    QList<QPair<QByteArray, uint64_t> > added;
+    QList<unsigned int> alignments;
+    int errors = 0;
+
+    if(!pe.beginInjection())
+    {
+        LOG_ERROR("Injection test: cannot begin injection.");
+        return false;
+    }
+
+    // blobs of different sizes and alignments, some go to section slack, the rest to the new section
+    for(int i = 0; i < blobs; ++i)
+    {
+        QByteArray blob(reinterpret_cast<const char*>(&i), sizeof(i));
+        blob.append(QByteArray(1 + (i * 37) % 200, static_cast<char>(i)));
+
+        unsigned int alignment = i % 4 == 0 ? 16 : 1;
+        bool inserted;
+        uint64_t va = pe.injectUniqueData(blob, ptrs, &inserted, alignment);
+
+        if(!va || !inserted || (va - pe.getImageBase()) % alignment != 0)
+        {
+            LOG_ERROR(QString("Injection test: blob %1 not added (VA 0x%2).").arg(i).arg(va, 0, 16));
+            ++errors;
+            continue;
+        }
+
+        added.append(qMakePair(blob, va));
+        alignments.append(alignment);
+    }
+
+    // the same data is not added twice
+    bool inserted;
+    if(!added.isEmpty() && (pe.injectUniqueData(added.first().first, ptrs, &inserted) != added.first().second || inserted))
+    {
+        LOG_ERROR("Injection test: a duplicate blob was added again.");
+        ++errors;
+    }
+
+    if(!pe.endInjection())
+    {
+        LOG_ERROR("Injection test: cannot end injection.");
+        return false;
+    }
+
+    PELayout after;
+    if(!readLayout(pe.getData(), after) || !PEFile(pe.getData()).is_valid())
+    {
+        LOG_ERROR("Injection test: output is not a valid PE file.");
+        return false;
+    }
+
+    if(after.sections.size() > before.sections.size() + 1)
+    {
+        LOG_ERROR(QString("Injection test: %1 sections added, expected at most one.")
+                  .arg(after.sections.size() - before.sections.size()));
+        ++errors;
+    }
+
+    // every blob is readable at its returned VA, in an executable section
+    const QByteArray &out = pe.getData();
+    for(int i = 0; i < added.size(); ++i)
+    {
+        const QByteArray &blob = added[i].first;
+        uint32_t rva = added[i].second - after.imageBase;
+        int section = sectionOf(after, rva, blob.size());
+
+        if(section < 0)
+        {
+            LOG_ERROR(QString("Injection test: blob at RVA 0x%1 is outside of sections.").arg(rva, 0, 16));
+            ++errors;
+            continue;
+        }
+
+        const IMAGE_SECTION_HEADER &hdr = after.sections[section];
+        uint32_t offset = hdr.PointerToRawData + (rva - hdr.VirtualAddress);
+
+        if(out.mid(offset, blob.size()) != blob || !(hdr.Characteristics & IMAGE_SCN_MEM_EXECUTE))
+        {
+            LOG_ERROR(QString("Injection test: blob at RVA 0x%1 (alignment %2) is not readable.")
+                      .arg(rva, 0, 16).arg(alignments[i]));
+            ++errors;
+        }
+    }
+
+    LOG_MSG(QString("Injection test: %1: %2 blobs, %3 sections added, %4 -> %5 bytes, %6 errors.")
+            .arg(input).arg(added.size()).arg(after.sections.size() - before.sections.size())
+            .arg(in.size()).arg(out.size()).arg(errors));
+
+    return errors == 0;
+}
+
+bool PETester::test_relocations(QString input)
+{
+    QFile in(input);
+    if(!in.open(QFile::ReadOnly))
+        return false;
+
+    QByteArray data = in.readAll();
+    in.close();
+
+    PELayout layout;
+    QMap<uint32_t, uint8_t> original;
+    if(!readLayout(data, layout) || layout.sections.isEmpty() || !layout.relocations.Size ||
+            !readRelocations(data, layout, original, false))
+    {
+        LOG_ERROR(QString("Relocation test: %1 has no readable relocation table.").arg(input));
+        return false;
+    }
+
+    // entries already in the table do not change its size, so it is rewritten in place
+    QList<uint32_t> existing = original.keys().mid(0, 64);
+
+    // new entries in the first section, a few for one page and many spread over all of its pages
+    const IMAGE_SECTION_HEADER &first = layout.sections.first();
+    uint32_t firstSize = qMin<uint32_t>(first.Misc.VirtualSize, first.SizeOfRawData) & ~7u;
+    uint32_t step = qMax<uint32_t>(8, (firstSize / 4096) & ~7u);
+    QList<uint32_t> small, large;
+
+    for(uint32_t off = 0; off < firstSize && small.size() < 16; off += 8)
+        if(!original.contains(first.VirtualAddress + off))
+            small.append(first.VirtualAddress + off);
+
+    for(uint32_t off = 4; off < firstSize && large.size() < 4096; off += step)
+        if(!original.contains(first.VirtualAddress + off))
+            large.append(first.VirtualAddress + off);
+
+    // added twice, duplicates are dropped in toBytes()
+    large.append(large.mid(0, 32));
+
+    int errors = 0;
+    errors += !test_relocations_ex(data, QString("%1 existing").arg(input), existing, true);
+    errors += !test_relocations_ex(data, QString("%1 small").arg(input), small, false);
+    errors += !test_relocations_ex(data, QString("%1 large").arg(input), large, false);
+
+    return errors == 0;
+}
+
+bool PETester::test_relocations_ex(const QByteArray &data, QString name, QList<uint32_t> rvas, bool inPlace)
+{
+    PEFile pe(data);
+    PELayout before, after;
+    QMap<uint32_t, uint8_t> expected, emitted;
+
+    if(!pe.is_valid() || !readLayout(data, before) || !readRelocations(data, before, expected, false))
+        return false;
+
+    uint8_t type = pe.is_x64() ? IMAGE_REL_BASED_DIR64 : IMAGE_REL_BASED_HIGHLOW;
+    QList<uint64_t> relocations;
+
+    foreach(uint32_t rva, rvas)
+    {
+        relocations.append(before.imageBase + rva);
+        if(!expected.contains(rva))
+            expected.insert(rva, type);
+    }
+
+    if(!pe.addRelocations(relocations))
+    {
+        LOG_ERROR(QString("Relocation test: %1: addRelocations failed.").arg(name));
+        return false;
+    }
+
+    QByteArray out = pe.getData();
+    if(!readLayout(out, after) || !readRelocations(out, after, emitted, true))
+    {
+        LOG_ERROR(QString("Relocation test: %1: emitted table is not sorted or not valid.").arg(name));
+        return false;
+    }
+
+    bool ok = true;
+
+    // the table is the original one plus the added entries
+    if(emitted != expected)
+    {
+        LOG_ERROR(QString("Relocation test: %1: %2 entries emitted, %3 expected.")
+                  .arg(name).arg(emitted.size()).arg(expected.size()));
+        ok = false;
+    }
+
+    bool reused = after.relocations.VirtualAddress == before.relocations.VirtualAddress &&
+            after.sections.size() == before.sections.size();
+
+    if(inPlace && (!reused || out.size() != data.size()))
+    {
+        LOG_ERROR(QString("Relocation test: %1: table was not rewritten in place.").arg(name));
+        ok = false;
+    }
+
+    LOG_MSG(QString("Relocation test: %1: %2 entries added, table %3 -> %4 bytes, %5, %6.")
+            .arg(name).arg(rvas.size()).arg(before.relocations.Size).arg(after.relocations.Size)
+            .arg(reused ? "in place" : "new section").arg(ok ? "passed" : "FAILED"));
+
+    return ok;
+}
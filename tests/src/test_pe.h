@@ -21,6 +21,8 @@ public:
     bool test_all_handlers(QString input, Method type, QString method);
     bool test_thread(QString input, QString output, QString method, QString handler);
     bool test_everything(QString input);
+    bool test_injection(QString input, int blobs);
+    bool test_relocations(QString input);
 
 private:
     template <typename Reg>
@@ -29,6 +31,8 @@ private:
     template <typename Reg>
     bool test_thread_ex(PEFile *pe, QString method, QString handler);
 
+    bool test_relocations_ex(const QByteArray &data, QString name, QList<uint32_t> rvas, bool inPlace);
+
     static QList<QString> methods_x86;
     static QList<QString> methods_x64;
     static QList<QString> handlers_x86;
@@ -0,0 +1,213 @@
+#include "test_runtime.h"
+
+#include <QFile>
+#include <QDir>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <algorithm>
+
+#include <helper/logger/dlogger.h>
+
+QStringList RuntimeBenchmark::workloads = {
+    "startup",
+    "call_loop",
+    "threads"
+};
+
+QMap<QString, QString> RuntimeBenchmark::workload_args = {
+    { "startup", "" },
+    { "call_loop", "50000000" },
+    { "threads", "200" }
+};
+
+bool RuntimeBenchmark::benchmark(bool x64) {
+    QDir().mkpath(work_dir);
+
+    // handlers run only after a detection, so one of them is enough to measure the overhead
+    ELFTester tester(work_dir);
+    QString handler = ELFTester::get_handlers(x64).first();
+    QList<variant> variants;
+    int errors = 0;
+
+    foreach (QString name, workloads) {
+        QString binary;
+        if (!build_workload(name, x64, binary))
+            return false;
+
+        variant base;
+        base.workload = name;
+        base.method = "none";
+        base.calling_method = "none";
+        base.obfuscate = false;
+
+        if (!run_many(binary, workload_args[name], base.baseline))
+            return false;
+
+        base.result = base.baseline;
+        variants.append(base);
+
+        foreach (ELFTester::Method type, ELFTester::get_smethods().keys()) {
+            foreach (QString method, ELFTester::get_methods(x64)) {
+                foreach (bool obfuscate, QList<bool>({ false, true })) {
+                    QString output = QString("%1_%2_%3_%4").arg(name).arg(ELFTester::get_smethods()[type])
+                            .arg(method).arg(obfuscate ? "obfuscate" : "plain");
+                    QString secured = QFileInfo(work_dir, output).absoluteFilePath();
+
+                    // incompatible combinations are reported as secured, but no file is written
+                    QFile::remove(secured);
+                    if (!tester.test_one(binary, output, type, method, handler, false, obfuscate, false)) {
+                        LOG_ERROR(QString("%1: securing failed").arg(output));
+                        ++errors;
+                        continue;
+                    }
+
+                    if (!QFile::exists(secured))
+                        continue;
+
+                    variant v;
+                    v.workload = name;
+                    v.method = method;
+                    v.calling_method = ELFTester::get_smethods()[type];
+                    v.obfuscate = obfuscate;
+                    v.baseline = base.baseline;
+
+                    if (!run_many(secured, workload_args[name], v.result)) {
+                        ++errors;
+                        continue;
+                    }
+
+                    variants.append(v);
+                }
+            }
+        }
+    }
+
+    return write_results(variants, x64) && errors == 0;
+}
+
+bool RuntimeBenchmark::build_workload(const QString &name, bool x64, QString &binary) {
+    binary = QFileInfo(work_dir, QString("%1%2").arg(name).arg(x64 ? 64 : 32)).absoluteFilePath();
+
+    QProcess gcc;
+    gcc.setProcessChannelMode(QProcess::MergedChannels);
+    gcc.start("gcc", { "-O2", "-pthread", x64 ? "-m64" : "-m32",
+                       QFileInfo(sources_dir, QString("%1.c").arg(name)).absoluteFilePath(), "-o", binary });
+
+    if (!gcc.waitForFinished(5 * 60 * 1000) || gcc.exitStatus() != QProcess::NormalExit || gcc.exitCode()) {
+        LOG_ERROR(QString("%1: build failed\n%2").arg(name).arg(QString(gcc.readAll())));
+        return false;
+    }
+
+    return true;
+}
+
+bool RuntimeBenchmark::run(const QString &binary, const QString &args, run_result &result) {
+    QProcess proc;
+    QElapsedTimer timer;
+
+    timer.start();
+    proc.start(binary, args.split(' ', QString::SkipEmptyParts));
+
+    if (!proc.waitForFinished(5 * 60 * 1000) || proc.exitStatus() != QProcess::NormalExit || proc.exitCode()) {
+        LOG_ERROR(QString("%1: run failed").arg(binary));
+        return false;
+    }
+
+    result.wall_ms = timer.nsecsElapsed() / 1e6;
+
+    // workload prints: <work time in ns> <max RSS in kB>
+    QStringList fields = QString(proc.readAllStandardOutput()).simplified().split(' ');
+    bool ok_work = false, ok_rss = false;
+
+    if (fields.size() == 2) {
+        result.work_ms = fields[0].toLongLong(&ok_work) / 1e6;
+        result.rss_kb = fields[1].toLongLong(&ok_rss);
+    }
+
+    if (!ok_work || !ok_rss) {
+        LOG_ERROR(QString("%1: unexpected output").arg(binary));
+        return false;
+    }
+
+    return true;
+}
+
+bool RuntimeBenchmark::run_many(const QString &binary, const QString &args, run_result &result) {
+    QList<double> wall, work;
+    result.rss_kb = 0;
+
+    for (int i = 0; i < runs; ++i) {
+        run_result r;
+        if (!run(binary, args, r))
+            return false;
+
+        wall.append(r.wall_ms);
+        work.append(r.work_ms);
+        result.rss_kb = std::max(result.rss_kb, r.rss_kb);
+    }
+
+    result.wall_ms = median(wall);
+    result.work_ms = median(work);
+
+    LOG_MSG(QString("%1: wall %2 ms, work %3 ms, rss %4 kB").arg(QFileInfo(binary).fileName())
+            .arg(result.wall_ms, 0, 'f', 3).arg(result.work_ms, 0, 'f', 3).arg(result.rss_kb));
+
+    return true;
+}
+
+bool RuntimeBenchmark::write_results(const QList<variant> &variants, bool x64) {
+    QString base = QFileInfo(work_dir, QString("runtime_benchmark%1").arg(x64 ? 64 : 32)).absoluteFilePath();
+    QFile csv(base + ".csv"), json(base + ".json");
+
+    if (!csv.open(QFile::WriteOnly | QFile::Text) || !json.open(QFile::WriteOnly | QFile::Text)) {
+        LOG_ERROR(QString("%1: cannot write results").arg(base));
+        return false;
+    }
+
+    QJsonArray rows;
+    csv.write("workload,method,calling_method,obfuscate,wall_ms,work_ms,rss_kb,"
+              "startup_latency_ms,slowdown,rss_delta_kb\n");
+
+    foreach (const variant &v, variants) {
+        // startup latency: time spent outside the measured work, compared to the unprotected program
+        double startup = (v.result.wall_ms - v.result.work_ms) - (v.baseline.wall_ms - v.baseline.work_ms);
+        double slowdown = v.baseline.work_ms > 0 ? v.result.work_ms / v.baseline.work_ms : 1.;
+        qint64 rss_delta = v.result.rss_kb - v.baseline.rss_kb;
+
+        csv.write(QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10\n").arg(v.workload).arg(v.method).arg(v.calling_method)
+                  .arg(v.obfuscate ? 1 : 0).arg(v.result.wall_ms, 0, 'f', 3).arg(v.result.work_ms, 0, 'f', 3)
+                  .arg(v.result.rss_kb).arg(startup, 0, 'f', 3).arg(slowdown, 0, 'f', 4).arg(rss_delta).toUtf8());
+
+        QJsonObject row;
+        row["workload"] = v.workload;
+        row["method"] = v.method;
+        row["calling_method"] = v.calling_method;
+        row["obfuscate"] = v.obfuscate;
+        row["wall_ms"] = v.result.wall_ms;
+        row["work_ms"] = v.result.work_ms;
+        row["rss_kb"] = static_cast<double>(v.result.rss_kb);
+        row["startup_latency_ms"] = startup;
+        row["slowdown"] = slowdown;
+        row["rss_delta_kb"] = static_cast<double>(rss_delta);
+        rows.append(row);
+    }
+
+    json.write(QJsonDocument(rows).toJson());
+
+    LOG_MSG(QString("Runtime benchmark: %1 variants, results in %2.csv and %2.json").arg(variants.size()).arg(base));
+
+    return true;
+}
+
+double RuntimeBenchmark::median(QList<double> values) {
+    if (values.isEmpty())
+        return 0;
+
+    std::sort(values.begin(), values.end());
+    int n = values.size();
+
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
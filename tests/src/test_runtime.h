@@ -0,0 +1,59 @@
+#ifndef TEST_RUNTIME_H
+#define TEST_RUNTIME_H
+
+#include <QString>
+#include <QList>
+#include <QStringList>
+
+#include "test_elf.h"
+
+/**
+ * @brief Pomiar narzutu zabezpieczeń w czasie działania programu.
+ *
+ * Buduje syntetyczne programy z katalogu workloads, zabezpiecza je każdą metodą wykrywania debuggera
+ * dla Linuksa, każdą metodą wywołania oraz z zaciemnianiem i bez, a następnie wielokrotnie uruchamia
+ * każdy wariant. Wynikiem jest tabela (CSV i JSON) z opóźnieniem startu, spowolnieniem pracy programu
+ * i przyrostem zużycia pamięci względem programu niezabezpieczonego.
+ */
+class RuntimeBenchmark {
+public:
+    RuntimeBenchmark(QString wd, QString sd, int r) :
+        work_dir(wd), sources_dir(sd), runs(r) {}
+
+    bool benchmark(bool x64);
+
+private:
+    typedef struct _run_result {
+        double wall_ms;
+        double work_ms;
+        qint64 rss_kb;
+
+        _run_result() :
+            wall_ms(0), work_ms(0), rss_kb(0) {}
+    } run_result;
+
+    typedef struct _variant {
+        QString workload;
+        QString method;
+        QString calling_method;
+        bool obfuscate;
+        run_result result;
+        run_result baseline;
+    } variant;
+
+    bool build_workload(const QString &name, bool x64, QString &binary);
+    bool run(const QString &binary, const QString &args, run_result &result);
+    bool run_many(const QString &binary, const QString &args, run_result &result);
+    bool write_results(const QList<variant> &variants, bool x64);
+
+    static double median(QList<double> values);
+
+    static QStringList workloads;
+    static QMap<QString, QString> workload_args;
+
+    QString work_dir;
+    QString sources_dir;
+    int runs;
+};
+
+#endif // TEST_RUNTIME_H
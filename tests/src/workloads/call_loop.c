@@ -0,0 +1,32 @@
+/*
+ * Steady-state workload: tight loop of calls to a small function.
+ * Prints "<work time in ns> <max RSS in kB>".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+static volatile unsigned long sink;
+
+__attribute__((noinline)) static unsigned long step(unsigned long x) {
+    return x * 2654435761u + 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned long i, n = argc > 1 ? strtoul(argv[1], NULL, 10) : 50000000ul;
+    unsigned long x = 1;
+    struct timespec start, end;
+    struct rusage ru;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < n; ++i)
+        x = step(x);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    sink = x;
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("%lld %ld\n", (end.tv_sec - start.tv_sec) * 1000000000ll + (end.tv_nsec - start.tv_nsec), ru.ru_maxrss);
+    return 0;
+}
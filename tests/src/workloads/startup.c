@@ -0,0 +1,15 @@
+/*
+ * Startup-only workload: exits right after main is reached.
+ * Prints "0 <max RSS in kB>".
+ */
+#include <stdio.h>
+#include <sys/resource.h>
+
+int main(void) {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("0 %ld\n", ru.ru_maxrss);
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+ * Thread-heavy workload: rounds of short-lived threads, each running a loop of calls.
+ * Prints "<work time in ns> <max RSS in kB>".
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#define THREADS 8
+
+static unsigned long iterations = 200000ul;
+static volatile unsigned long sink;
+
+__attribute__((noinline)) static unsigned long step(unsigned long x) {
+    return x * 2654435761u + 1;
+}
+
+static void *worker(void *arg) {
+    unsigned long i, x = (unsigned long)arg;
+
+    for (i = 0; i < iterations; ++i)
+        x = step(x);
+
+    sink = x;
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    unsigned long r, rounds = argc > 1 ? strtoul(argv[1], NULL, 10) : 200ul;
+    pthread_t threads[THREADS];
+    struct timespec start, end;
+    struct rusage ru;
+    int t;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (r = 0; r < rounds; ++r) {
+        for (t = 0; t < THREADS; ++t)
+            if (pthread_create(&threads[t], NULL, worker, (void *)(r + t)))
+                return 1;
+        for (t = 0; t < THREADS; ++t)
+            pthread_join(threads[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("%lld %ld\n", (end.tv_sec - start.tv_sec) * 1000000000ll + (end.tv_nsec - start.tv_nsec), ru.ru_maxrss);
+    return 0;
+}